@@ -29,6 +29,7 @@
 
 #include <string.h>
 #include "boot_clk.h"
+#include "boot_timing.h"
 #include "qm_flash.h"
 #include <x86intrin.h>
 
@@ -41,16 +42,156 @@
 #define OSC_TRIM_MSB (9)
 
 /*
- * Desired timestamp in sysclk ticks. Relative to RTC period and sysclk divider.
+ * Adaptive trim code calibration.
+ *
+ * The error of a measurement does not depend on its period: the start and the
+ * end of the period are both known within one AON counter polling iteration.
+ * When enabled, a measurement is checked after OSC_TRIM_MIN_PERIOD_RTC_TICKS
+ * and then whenever its period doubles: it stops as soon as the elapsed
+ * timestamp ticks are further than OSC_TRIM_GUARD_TS_TICKS from the desired
+ * ones, which is the case for most bits but the least-significant ones. The
+ * decisions, hence the trim codes, are those of full-period measurements,
+ * while the calibration time of each mode drops from ~1010 to ~540 RTC ticks.
+ */
+#ifndef OSC_TRIM_ADAPTIVE
+#define OSC_TRIM_ADAPTIVE (1)
+#endif
+/* Minimum calibration period. */
+#define OSC_TRIM_MIN_PERIOD_RTC_TICKS (8)
+/*
+ * Measurement error bound, in timestamp ticks: twice an AON counter polling
+ * iteration (in system clock cycles), with some margin.
+ */
+#define OSC_TRIM_GUARD_TS_TICKS (32)
+
+/*
+ * Seeded trim code calibration.
+ *
+ * When enabled and a (non-provisioned) trim code is found in the OTP, the
+ * search is restricted to the OSC_TRIM_SEED_BITS-bit range centered around it.
+ * If the result lies on the boundary of the range (i.e., the seed is too far
+ * from the actual trim code), the full search is performed.
+ */
+#ifndef OSC_TRIM_SEED
+#define OSC_TRIM_SEED (0)
+#endif
+/* Number of bits searched around the seed. */
+#define OSC_TRIM_SEED_BITS (5)
+/* Mask of the trim code value. */
+#define OSC_TRIM_CODE_MASK (BIT(OSC_TRIM_MSB + 1) - 1)
+/* The value of a blank OTP trim code. */
+#define OSC_TRIM_BLANK (0xFFFF)
+
+/*
+ * Desired timestamp in sysclk ticks per RTC tick. Relative to sysclk divider.
  */
-#define SYSCLK_32M_FREQ ((32000000 / 2 / 32768) * OSC_TRIM_PERIOD_RTC_TICKS)
-#define SYSCLK_16M_FREQ ((16000000 / 2 / 32768) * OSC_TRIM_PERIOD_RTC_TICKS)
-#define SYSCLK_8M_FREQ ((8000000 / 2 / 32768) * OSC_TRIM_PERIOD_RTC_TICKS)
-#define SYSCLK_4M_FREQ ((4000000 / 2 / 32768) * OSC_TRIM_PERIOD_RTC_TICKS)
+#define SYSCLK_32M_FREQ (32000000 / 2 / 32768)
+#define SYSCLK_16M_FREQ (16000000 / 2 / 32768)
+#define SYSCLK_8M_FREQ (8000000 / 2 / 32768)
+#define SYSCLK_4M_FREQ (4000000 / 2 / 32768)
 
 #define AONC_CFG_AONC_CNT_EN BIT(0)
 
 #if (HAS_RTC_XTAL)
+/*
+ * Apply a trim code and check whether the oscillator is too fast.
+ *
+ * The system clock must be set to hybrid oscillator in silicon mode, with trim
+ * mode enabled.
+ *
+ * @param[in] trim_code The trim code to be applied.
+ * @param[in] desired   The desired number of timestamp ticks per RTC tick.
+ *
+ * @return Whether the number of timestamp ticks elapsed during the calibration
+ * 	   period is greater than the desired one.
+ */
+static bool boot_clk_trim_too_fast(uint32_t trim_code, uint32_t desired)
+{
+	uint64_t ts_start, ts_elapsed, ts_desired;
+	volatile uint32_t aonc_start;
+	uint32_t period;
+
+	/* Apply trim code. */
+	QM_SCSS_CCU->osc0_cfg1 &= ~OSC0_CFG1_FTRIMOTP_MASK;
+	QM_SCSS_CCU->osc0_cfg1 |=
+	    (trim_code << OSC0_CFG1_FTRIMOTP_OFFS) & OSC0_CFG1_FTRIMOTP_MASK;
+	/*
+	 * Wait one RTC tick so as to eliminate any time inconsistencies
+	 * between clock domains.
+	 */
+	aonc_start = QM_AONC[QM_AONC_0]->aonc_cnt;
+	while (QM_AONC[QM_AONC_0]->aonc_cnt == aonc_start) {
+	}
+
+	/* Start calibration period. */
+	aonc_start = QM_AONC[QM_AONC_0]->aonc_cnt;
+	ts_start = get_ticks();
+
+#if (OSC_TRIM_ADAPTIVE)
+	period = OSC_TRIM_MIN_PERIOD_RTC_TICKS;
+#else
+	period = OSC_TRIM_PERIOD_RTC_TICKS;
+#endif
+	while (1) {
+		while (QM_AONC[QM_AONC_0]->aonc_cnt - aonc_start < period) {
+		}
+		ts_elapsed = get_ticks() - ts_start;
+		ts_desired = (uint64_t)desired * period;
+
+		/* Stop when the outcome is known or at the full period. */
+		if (period == OSC_TRIM_PERIOD_RTC_TICKS ||
+		    ts_elapsed > ts_desired + OSC_TRIM_GUARD_TS_TICKS ||
+		    ts_elapsed + OSC_TRIM_GUARD_TS_TICKS < ts_desired) {
+			break;
+		}
+		period = (period * 2 < OSC_TRIM_PERIOD_RTC_TICKS)
+			     ? period * 2
+			     : OSC_TRIM_PERIOD_RTC_TICKS;
+	}
+
+	/* Compare the number of elapsed timestamp ticks. */
+	return ts_elapsed > ts_desired;
+}
+
+/*
+ * Search a trim code by successive approximation.
+ *
+ * Bits are set from the most significant one: a bit is kept set unless the
+ * oscillator is too fast.
+ *
+ * @param[in] base    The trim code the searched offset is added to.
+ * @param[in] msb     The most-significant bit of the offset.
+ * @param[in] desired The desired number of timestamp ticks per RTC tick.
+ *
+ * @return The trim code.
+ */
+static uint32_t boot_clk_trim_search(uint32_t base, int msb, uint32_t desired)
+{
+	uint32_t offset = 0;
+	int i;
+
+	/*
+	 * Trim code calculation algorithm.
+	 *
+	 * 1. Start with offset = 0.
+	 * 2. Set the most significant bit.
+	 * 3. Apply trim code.
+	 * 4. Measure speed.
+	 * 5. Check if we are going too fast, if so, unset the bit, otherwise
+	 *    leave it set.
+	 * 6. Set the next most significant bit and go back to step 3.
+	 */
+	for (i = msb; i >= 0; i--) {
+		offset |= BIT(i);
+		if (boot_clk_trim_too_fast(base + offset, desired)) {
+			/* Clock is too fast, unset bit. */
+			offset &= ~BIT(i);
+		}
+	}
+
+	return base + offset;
+}
+
 /*
  * Compute the silicon oscillator trim code.
  *
@@ -62,21 +203,23 @@
  * therefore requires that both the RTC clock and the AON counter be enabled.
  *
  * @param[in] mode System clock source operating mode.
- * @param[out] trim Where to store computed trim code. Must not be null.
+ * @param[in,out] trim The OTP trim code (used as seed, if OSC_TRIM_SEED is
+ * 		       enabled) on input; the computed trim code on output.
+ * 		       Must not be null.
  *
  * @return Resulting status code.
  * @retval 0 if successful.
  */
 static int boot_clk_trim_compute(clk_sys_mode_t mode, uint16_t *const trim)
 {
-	uint64_t ts_start, ts_stop, ts_elapsed;
-	int i;
 	int rc = 0;
-	uint32_t trim_code = 0;
-	volatile uint32_t aonc_start;
+	uint32_t trim_code;
 	const uint32_t ts_desired[] = {
 	    SYSCLK_32M_FREQ, SYSCLK_16M_FREQ, SYSCLK_8M_FREQ, SYSCLK_4M_FREQ,
 	};
+#if (OSC_TRIM_SEED)
+	uint32_t base;
+#endif
 
 	/* Enable AON counter. */
 	QM_AONC[QM_AONC_0]->aonc_cfg |= AONC_CFG_AONC_CNT_EN;
@@ -87,50 +230,33 @@ static int boot_clk_trim_compute(clk_sys_mode_t mode, uint16_t *const trim)
 	/* Enable trim mode. */
 	QM_SCSS_CCU->osc0_cfg0 |= BIT(1);
 
-	/*
-	 * Trim code calculation algorithm.
-	 *
-	 * 1. Start with trim_code = 0.
-	 * 2. Set the most significant bit.
-	 * 3. Apply trim code.
-	 * 4. Measure speed.
-	 * 5. Check if we are going too fast, if so, unset the bit, otherwise
-	 *    leave it set.
-	 * 6. Set the next most significant bit and go back to step 3.
-	 */
-	for (i = OSC_TRIM_MSB; i >= 0; i--) {
-		trim_code |= BIT(i);
-
-		/* Apply trim code. */
-		QM_SCSS_CCU->osc0_cfg1 &= ~OSC0_CFG1_FTRIMOTP_MASK;
-		QM_SCSS_CCU->osc0_cfg1 |=
-		    (trim_code << OSC0_CFG1_FTRIMOTP_OFFS) &
-		    OSC0_CFG1_FTRIMOTP_MASK;
-		/*
-		 * Wait one RTC tick so as to eliminate any time
-		 * inconsistencies between clock domains.
-		 */
-		aonc_start = QM_AONC[QM_AONC_0]->aonc_cnt;
-		while (QM_AONC[QM_AONC_0]->aonc_cnt == aonc_start) {
+#if (OSC_TRIM_SEED)
+	trim_code = 0;
+	if (*trim != OSC_TRIM_BLANK) {
+		/* Search the range centered around the seed. */
+		base = *trim & OSC_TRIM_CODE_MASK;
+		base = (base > BIT(OSC_TRIM_SEED_BITS - 1))
+			   ? base - BIT(OSC_TRIM_SEED_BITS - 1)
+			   : 0;
+		if (base > OSC_TRIM_CODE_MASK - (BIT(OSC_TRIM_SEED_BITS) - 1)) {
+			base = OSC_TRIM_CODE_MASK - (BIT(OSC_TRIM_SEED_BITS) - 1);
 		}
-
-		/* Start calibration period. */
-		aonc_start = QM_AONC[QM_AONC_0]->aonc_cnt;
-		ts_start = get_ticks();
-
-		while (QM_AONC[QM_AONC_0]->aonc_cnt - aonc_start <
-		       OSC_TRIM_PERIOD_RTC_TICKS) {
-		}
-		ts_stop = get_ticks();
-
-		/* Calculate the number of elapsed timestamp ticks. */
-		ts_elapsed = ts_stop - ts_start;
-
-		if (ts_elapsed > ts_desired[mode]) {
-			/* Clock is too fast, unset bit. */
-			trim_code &= ~BIT(i);
+		trim_code = boot_clk_trim_search(base, OSC_TRIM_SEED_BITS - 1,
+						 ts_desired[mode]);
+		/* Values on the boundary of the range may be outside it. */
+		if ((trim_code == base && base != 0) ||
+		    (trim_code == base + BIT(OSC_TRIM_SEED_BITS) - 1 &&
+		     trim_code != OSC_TRIM_CODE_MASK)) {
+			trim_code = 0;
 		}
 	}
+	if (!trim_code) {
+		trim_code =
+		    boot_clk_trim_search(0, OSC_TRIM_MSB, ts_desired[mode]);
+	}
+#else
+	trim_code = boot_clk_trim_search(0, OSC_TRIM_MSB, ts_desired[mode]);
+#endif
 
 	*trim = trim_code;
 
@@ -248,6 +374,7 @@ int boot_clk_trim_code_compute(qm_flash_data_trim_t *const ptr_trim_codes)
 	int rc = 0;
 	clk_sys_mode_t mode;
 
+	BOOT_TS(BOOT_TS_TRIM_START);
 	(ptr_trim_codes->fields).osc_trim_4mhz =
 	    QM_FLASH_OTP_TRIM_CODE->osc_trim_4mhz;
 
@@ -266,6 +393,7 @@ int boot_clk_trim_code_compute(qm_flash_data_trim_t *const ptr_trim_codes)
 	}
 
 	boot_clk_hyb_set_mode(CLK_SYS_HYB_OSC_32MHZ, CLK_SYS_DIV_1);
+	BOOT_TS(BOOT_TS_TRIM_END);
 
 	return rc;
 }
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BOOT_TIMING_H__
+#define __BOOT_TIMING_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <x86intrin.h>
+
+/**
+ * Boot-phase timestamps.
+ *
+ * When the bootloader is compiled with ENABLE_BOOT_TIMING=1, rom_startup()
+ * records the Time Stamp Counter (TSC) at the end of each boot phase in a
+ * small record located in a reserved RAM area (see the 'esram_boot_timing'
+ * region in the linker script). The record is not cleared when jumping to the
+ * application, which can therefore read it at BOOT_TIMING_ADDR; it can also be
+ * retrieved by means of the QFM Boot Timing request.
+ *
+ * The TSC runs at the system clock frequency, which is the 32 MHz hybrid
+ * oscillator during the whole boot flow, but for the trim code computation
+ * (which switches to lower frequencies and therefore looks shorter than it
+ * is). Timestamps are truncated to 32 bits; a phase not executed during the
+ * last boot has a zero timestamp.
+ *
+ * @defgroup groupBootTiming Boot Timing
+ * @{
+ */
+
+/** The magic number identifying a valid boot timing record ('BTIM'). */
+#define BOOT_TIMING_MAGIC (0x4D495442)
+
+/** The TSC frequency during the boot flow. */
+#define BOOT_TIMING_TSC_HZ (32000000)
+
+/** The boot phases whose end is timestamped. */
+typedef enum {
+	BOOT_TS_START = 0,  /**< rom_startup() entry. */
+	BOOT_TS_CLOCK,      /**< Power and clock set-up. */
+	BOOT_TS_TRIM_START, /**< Trim code computation start. */
+	BOOT_TS_TRIM_END,   /**< Trim code computation end. */
+	BOOT_TS_BL_DATA,    /**< BL-Data sanitization. */
+	BOOT_TS_IRQ,        /**< Interrupt and security set-up. */
+	BOOT_TS_FM_HOOK,    /**< FM GPIO / sticky bit sampling. */
+	BOOT_TS_SRAM_SCRUB, /**< SRAM clean-up start (app entry). */
+	BOOT_TS_APP_ENTRY,  /**< SRAM clean-up end (app entry). */
+	BOOT_TS_NUM
+} boot_ts_t;
+
+/** The boot timing record. */
+typedef struct {
+	/** Set to BOOT_TIMING_MAGIC at the beginning of the boot flow. */
+	uint32_t magic;
+	/** The TSC (lower 32 bits) at the end of each phase (see boot_ts_t). */
+	uint32_t ts[BOOT_TS_NUM];
+} boot_timing_t;
+
+/** The boot timing record (defined by the linker script). */
+extern boot_timing_t __boot_timing;
+
+/** The address of the boot timing record. */
+#define BOOT_TIMING_ADDR ((uint32_t)&__boot_timing)
+
+#if (ENABLE_BOOT_TIMING)
+/** Reset the boot timing record (previous boot data is discarded). */
+#define BOOT_TIMING_INIT()                                                     \
+	do {                                                                   \
+		memset(&__boot_timing, 0, sizeof(__boot_timing));              \
+		__boot_timing.magic = BOOT_TIMING_MAGIC;                       \
+	} while (0)
+/** Timestamp the end of a boot phase. */
+#define BOOT_TS(phase) (__boot_timing.ts[(phase)] = (uint32_t)_rdtsc())
+#else
+#define BOOT_TIMING_INIT()
+#define BOOT_TS(phase)
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* __BOOT_TIMING_H__ */
@@ -29,6 +29,7 @@
 
 #include "boot.h"
 #include "boot_clk.h"
+#include "boot_timing.h"
 #include "flash_layout.h"
 #include "interrupt/idt.h"
 #include "power_states.h"
@@ -44,6 +45,9 @@
 #include "fm_hook.h"
 #include "bl_data.h"
 #include "rom_version.h"
+#if (FM_CONFIG_APP_STAGING)
+#include "qfu/qfu.h"
+#endif
 
 #if (DEBUG)
 static QM_ISR_DECLARE(double_fault_isr)
@@ -52,10 +56,6 @@ static QM_ISR_DECLARE(double_fault_isr)
 }
 #endif
 
-/* Stringify macros. */
-#define _STR(x) #x
-#define STR(x) _STR(x)
-
 /* Factory settings for Crystal Oscillator */
 /* 7.45 pF load cap for Crystal */
 #define OSC0_CFG1_OSC0_FADJ_XTAL_DEFAULT (0x4)
@@ -302,8 +302,12 @@ static __inline__ void clean_bootloader_traces(void)
 			     "xor %edx, %edx\n\t");
 }
 
-/* Set-up security context for application and boot it. */
-static void secure_app_entry(void)
+/*
+ * Set-up security context for application and boot it.
+ *
+ * @param[in] entry The entry point of the application.
+ */
+static void secure_app_entry(volatile const uint32_t *entry)
 {
 	extern uint32_t __esram_start[];
 	extern uint32_t __esram_size[];
@@ -326,21 +330,29 @@ static void secure_app_entry(void)
 	/* Setup MPR_0 so it protects Lakemont's stack, GDT and IDT. */
 	set_up_mpr();
 
-	/* Clean-up SRAM (but not stack).*/
+	/*
+	 * Clean-up SRAM (but not stack). Note: the boot timing record is not
+	 * part of the cleared area.
+	 */
+	BOOT_TS(BOOT_TS_SRAM_SCRUB);
 	memset(__esram_start, 0x0, (size_t)__esram_size);
+	BOOT_TS(BOOT_TS_APP_ENTRY);
 
-	/* Reset the stack pointer and clear the stack. */
-	__asm__ __volatile__("movl $__stack_start, %esp");
-	/* Note: stack_end is the top of the stack, i.e., the lower address. */
-	__asm__ __volatile__("xor %eax, %eax\n\t"
-			     "movl $__stack_end, %edi\n\t"
-			     "movl $__stack_size, %ecx\n\t"
-			     "rep stosb");
 	/*
-	 * Jump to the x86 application (must be done in assembly since we do
-	 * not have a valid stack anymore).
+	 * Reset the stack pointer, clear the stack and jump to the x86
+	 * application. This must be done in a single assembly block, since we
+	 * do not have a valid stack anymore: the entry point is kept in EDX.
+	 *
+	 * Note: stack_end is the top of the stack, i.e., the lower address.
 	 */
-	__asm__ __volatile__("jmp " STR(LMT_APP_ADDR) "\n\t");
+	__asm__ __volatile__("movl $__stack_start, %%esp\n\t"
+			     "xor %%eax, %%eax\n\t"
+			     "movl $__stack_end, %%edi\n\t"
+			     "movl $__stack_size, %%ecx\n\t"
+			     "rep stosb\n\t"
+			     "jmp *%%edx\n\t"
+			     :
+			     : "d"(entry));
 }
 
 /*
@@ -349,12 +361,16 @@ static void secure_app_entry(void)
  */
 void __attribute__((noreturn)) rom_startup(void)
 {
+	volatile const uint32_t *app_entry;
 	extern uint32_t __bss_start[];
 	extern uint32_t __data_vma[];
 	extern uint32_t __data_lma[];
 	extern uint32_t __data_size[];
 	extern uint32_t __bss_size[];
 
+	BOOT_TIMING_INIT();
+	BOOT_TS(BOOT_TS_START);
+
 	/* Zero out bss */
 	memset(__bss_start, 0x00, (size_t)__bss_size);
 
@@ -364,6 +380,7 @@ void __attribute__((noreturn)) rom_startup(void)
 	power_setup();
 	clock_setup();
 	boot_sense_jtag_probe();
+	BOOT_TS(BOOT_TS_CLOCK);
 
 	/*
 	 * Check and initialize trim codes and, if FW manager is enabled, also
@@ -376,6 +393,7 @@ void __attribute__((noreturn)) rom_startup(void)
 	 * is fine.
 	 */
 	bl_data_sanitize_wrap();
+	BOOT_TS(BOOT_TS_BL_DATA);
 
 	/* Apply trim code calibration. */
 	clk_trim_apply(QM_FLASH_DATA_TRIM_CODE->osc_trim_32mhz);
@@ -408,16 +426,33 @@ void __attribute__((noreturn)) rom_startup(void)
 	 * The policy is not locked, so applications can change it if required.
 	 */
 	set_violation_policy();
+	BOOT_TS(BOOT_TS_IRQ);
 #if (ENABLE_FIRMWARE_MANAGER)
 	/* Check if we must enter FM mode and if so enter it. */
 	fm_hook();
+#if (FM_CONFIG_TRIAL_BOOT)
+	/* Update the images on trial (or roll them back). */
+	bl_data_trial_boot();
+#endif
+#if (FM_CONFIG_APP_STAGING)
+	/*
+	 * Install the update staged by the application (if any). Done after
+	 * recording the outcome of the previous boot, which belongs to the
+	 * image that staged the update.
+	 */
+	qfu_commit_staged();
+#endif
+	/* Boot the active partition of the x86 target. */
+	app_entry = bl_data_app_entry(BL_TARGET_IDX_LMT);
+#else
+	app_entry = (volatile const uint32_t *)LMT_APP_ADDR;
 #endif
 	/*
 	 * Execute application on Lakemont, provided that the application has
 	 * been programmed.
 	 */
-	if (0xffffffff != *(uint32_t *)LMT_APP_ADDR) {
-		secure_app_entry();
+	if (0xffffffff != *app_entry) {
+		secure_app_entry(app_entry);
 	} else {
 #if (ENABLE_FIRMWARE_MANAGER)
 		/* Enter FM mode if no valid application has been found.*/
@@ -35,9 +35,15 @@
 #include "fw-manager_utils.h"
 #include "bl_data.h"
 #include "boot_clk.h"
+#include "fm_flash.h"
 #include "rom_version.h"
+#if (FM_CONFIG_TRIAL_BOOT)
+#include "fm_boot_confirm.h"
+#endif
 
-#define BL_DATA_BLANK_VALUE ((uint32_t)0xFFFFFFFF)
+#define BL_DATA_BLANK_VALUE (FM_FLASH_BLANK_VALUE)
+/* The number of attempts to write a BL-Data page that fails verification. */
+#define BL_DATA_WRITE_ATTEMPTS (2)
 
 #if (UNIT_TEST)
 /* Test variable simulating the 2-page BL-Data section in flash. */
@@ -50,7 +56,8 @@ static const bl_data_t *const bl_data_bck =
 uint8_t test_num_loops;
 #define FOREVER() --test_num_loops
 #define BL_DATA_SECTION_START ((uint32_t *)test_bl_data_pages)
-#define BL_DATA_SECTION_END ((uint32_t *)(test_bl_data_pages + 1))
+#define BL_DATA_SECTION_END                                                    \
+	((uint32_t *)(test_bl_data_pages + sizeof(test_bl_data_pages)))
 #else
 /* Pointer to BL-Data Main in flash. */
 static const bl_data_t *const bl_data_main =
@@ -83,14 +90,31 @@ static bl_data_t bl_data_shadow;
 /* Pointer to the RAM-copy of the bootloader data (BL-Data). */
 bl_data_t *const bl_data = &bl_data_shadow;
 
+/* The BL-Data flash statistics. */
+bl_data_stats_t bl_data_stats;
+
+#if (FM_CONFIG_BL_DATA_PING_PONG)
+/* The slot holding the newest copy of BL-Data (NULL if none). */
+static const bl_data_t *bl_data_newest;
+
+/* Check whether a BL-Data copy is newer than another one (wrap-safe). */
+#define bl_data_is_newer(a, b) ((int32_t)((a)->seq - (b)->seq) > 0)
+#endif
+
 /**
  * Initialize BL-Data.
  *
  * Both the RAM copy and the flash copies of BL-Data are initialized. As part
  * of the initialization process, trim codes are computed.
+ *
+ * @return 0 on success, negative errno otherwise.
  */
-static void bl_data_init(void)
+static int bl_data_init(void)
 {
+#if (FM_CONFIG_ERASE_ON_DEMAND)
+	int i;
+#endif
+
 	/* Trim codes computation. */
 	boot_clk_trim_code_compute(&bl_data->trim_codes);
 	/* Store ROM version in BL-Data. */
@@ -99,51 +123,336 @@ static void bl_data_init(void)
 	memcpy(&bl_data->targets, &targets_defaults, sizeof(bl_data->targets));
 	memcpy(&bl_data->partitions, &partitions_defaults,
 	       sizeof(bl_data->partitions));
+#if (FM_CONFIG_ERASE_ON_DEMAND)
+	/* Partitions may have been programmed before BL-Data existed. */
+	for (i = 0; i < BL_FLASH_PARTITIONS_NUM; i++) {
+		bl_data->partitions[i].used_pages =
+		    bl_data->partitions[i].num_pages;
+	}
+#endif
 	/* Save BL-Data to flash. */
-	bl_data_shadow_writeback();
+	return bl_data_shadow_writeback();
 }
 
 /**
  * Copy the BL-Data struct passed as input to a specific flash page.
  *
+ * The page is rewritten if verification fails, up to BL_DATA_WRITE_ATTEMPTS
+ * times.
+ *
  * @param[in] A pointer to the BL-Data to be saved in flash. Must not be null.
  * @patam[in] The flash page where to save the BL-Data.
+ * @param[in] The number of words to be copied.
+ *
+ * @return 0 on success, -EIO if the page could not be written.
+ */
+static int bl_data_copy(const bl_data_t *data, int bl_page, uint32_t len)
+{
+	int i;
+
+	for (i = 0; i < BL_DATA_WRITE_ATTEMPTS; i++) {
+		if (!fm_flash_write_pages(
+			BL_DATA_FLASH_CONTROLLER, BL_DATA_FLASH_REGION,
+			bl_page, BL_DATA_SECTION_START +
+				     ((bl_page - BL_DATA_SECTION_BASE_PAGE) *
+				      QM_FLASH_PAGE_SIZE_DWORDS),
+			(const uint32_t *)data, len)) {
+			return 0;
+		}
+	}
+
+	return -EIO;
+}
+
+#if (FM_CONFIG_BL_DATA_LOG)
+/*
+ * BL-Data log.
+ *
+ * Each BL-Data page holds a snapshot of BL-Data (bl_data_t) followed by a log
+ * of records, each one patching a range of words of the snapshot. A record is
+ * composed of:
+ * - a header word: BL_DATA_LOG_MAGIC (bits 31:24), number of words (bits
+ *   23:16) and index of the first word (bits 15:0) of the range;
+ * - the new value of the words;
+ * - a CRC word: the CRC16-CCITT of the new values (bits 15:0) and the index of
+ *   the first word (bits 31:16), so that it is never blank.
+ *
+ * The log ends at the first blank word. A page with an invalid record (e.g.,
+ * because writing it was interrupted) is invalid, like a page with a wrong
+ * snapshot CRC, and is restored from the other page.
+ *
+ * The CRC of the snapshot is not updated by records. Public data (trim codes
+ * and ROM version) is never patched, since applications read it from flash.
+ */
+#define BL_DATA_LOG_MAGIC (0xB1)
+#define BL_DATA_LOG_HDR(idx, len)                                              \
+	(((uint32_t)BL_DATA_LOG_MAGIC << 24) | ((uint32_t)(len) << 16) | (idx))
+#define BL_DATA_LOG_HDR_MAGIC(hdr) ((hdr) >> 24)
+#define BL_DATA_LOG_HDR_LEN(hdr) (((hdr) >> 16) & 0xFF)
+#define BL_DATA_LOG_HDR_IDX(hdr) ((hdr)&0xFFFF)
+#define BL_DATA_LOG_CRC(idx, data, len)                                        \
+	(((uint32_t)(idx) << 16) |                                             \
+	 fm_crc16_ccitt((const uint8_t *)(data), (len) * sizeof(uint32_t)))
+/* The maximum number of words patched by a record. */
+#define BL_DATA_LOG_MAX_LEN (0xFF)
+/* The index of the first word that can be patched. */
+#define BL_DATA_LOG_FIRST_WORD                                                 \
+	(offsetof(bl_data_t, partitions) / sizeof(uint32_t))
+/* The index of the CRC word (i.e., the number of words covered by the CRC). */
+#define BL_DATA_LOG_CRC_WORD (offsetof(bl_data_t, crc) / sizeof(uint32_t))
+/* The beginning and the end of the log of a BL-Data page. */
+#define BL_DATA_LOG_START(copy) ((const uint32_t *)((copy) + 1))
+#define BL_DATA_LOG_END(copy)                                                  \
+	((const uint32_t *)(copy) + QM_FLASH_PAGE_SIZE_DWORDS)
+
+/* Pages are restored with their log. */
+#define BL_DATA_RESTORE_DWORDS (QM_FLASH_PAGE_SIZE_DWORDS)
+
+/**
+ * Find the end of the log of a BL-Data page, checking all the records.
+ *
+ * @param[in] copy The BL-Data page. Must not be null.
+ *
+ * @return The word following the last record; NULL if a record is invalid.
+ */
+static const uint32_t *bl_data_log_end(const bl_data_t *copy)
+{
+	const uint32_t *rec = BL_DATA_LOG_START(copy);
+	const uint32_t *const end = BL_DATA_LOG_END(copy);
+	uint32_t idx;
+	uint32_t len;
+
+	while (rec < end && *rec != BL_DATA_BLANK_VALUE) {
+		idx = BL_DATA_LOG_HDR_IDX(*rec);
+		len = BL_DATA_LOG_HDR_LEN(*rec);
+		if (BL_DATA_LOG_HDR_MAGIC(*rec) != BL_DATA_LOG_MAGIC ||
+		    len == 0 || idx < BL_DATA_LOG_FIRST_WORD ||
+		    idx + len > BL_DATA_LOG_CRC_WORD || rec + len + 2 > end ||
+		    rec[len + 1] != BL_DATA_LOG_CRC(idx, rec + 1, len)) {
+			return NULL;
+		}
+		rec += len + 2;
+	}
+
+	return rec;
+}
+
+/**
+ * Get the current value of a BL-Data word in a BL-Data page.
+ *
+ * @param[in] copy The BL-Data page. Must not be null.
+ * @param[in] end  The end of the log of the page.
+ * @param[in] idx  The index of the word.
+ *
+ * @return The value of the word in the snapshot, patched by the log.
+ */
+static uint32_t bl_data_log_word(const bl_data_t *copy, const uint32_t *end,
+				 uint32_t idx)
+{
+	const uint32_t *rec;
+	uint32_t value = ((const uint32_t *)copy)[idx];
+
+	for (rec = BL_DATA_LOG_START(copy); rec < end;
+	     rec += BL_DATA_LOG_HDR_LEN(*rec) + 2) {
+		if (idx >= BL_DATA_LOG_HDR_IDX(*rec) &&
+		    idx < BL_DATA_LOG_HDR_IDX(*rec) + BL_DATA_LOG_HDR_LEN(*rec)) {
+			value = rec[1 + idx - BL_DATA_LOG_HDR_IDX(*rec)];
+		}
+	}
+
+	return value;
+}
+
+/**
+ * Check whether a BL-Data page is valid (snapshot CRC and log records).
+ *
+ * @param[in] copy The BL-Data page. Must not be null.
  */
-static void bl_data_copy(const bl_data_t *data, int bl_page)
+static bool bl_data_is_valid(const bl_data_t *copy)
 {
-	qm_flash_page_write(BL_DATA_FLASH_CONTROLLER, BL_DATA_FLASH_REGION,
-			    bl_page, (uint32_t *)data,
-			    sizeof(bl_data_t) / sizeof(uint32_t));
+	return copy->crc == fm_crc16_ccitt((uint8_t *)copy,
+					   offsetof(bl_data_t, crc)) &&
+	       bl_data_log_end(copy) != NULL;
 }
 
 /**
- * Erase partition.
+ * Load a (valid) BL-Data page into the RAM copy, replaying its log.
  *
- * Erase all the pages of an application partition.
+ * @param[in] copy The BL-Data page. Must not be null.
+ */
+static void bl_data_load(const bl_data_t *copy)
+{
+	const uint32_t *rec;
+	const uint32_t *const end = bl_data_log_end(copy);
+
+	memcpy(bl_data, copy, sizeof(*bl_data));
+	for (rec = BL_DATA_LOG_START(copy); rec < end;
+	     rec += BL_DATA_LOG_HDR_LEN(*rec) + 2) {
+		memcpy((uint32_t *)bl_data + BL_DATA_LOG_HDR_IDX(*rec), rec + 1,
+		       BL_DATA_LOG_HDR_LEN(*rec) * sizeof(uint32_t));
+	}
+}
+
+/**
+ * Write a log record to flash.
+ *
+ * @param[in] dst  The (blank) location of the record. Must not be null.
+ * @param[in] idx  The index of the first word patched by the record.
+ * @param[in] len  The number of words patched by the record.
  *
- * @param[in] part The partition to be erased. Must not be null.
+ * @return 0 on success, -EIO if the record could not be written.
  */
-static void bl_data_erase_partition(const bl_flash_partition_t *part)
+static int bl_data_log_write(const uint32_t *dst, uint32_t idx, uint32_t len)
 {
-	uint32_t page;
-	qm_flash_reg_t *flash_regs;
+	const uint32_t *const data = (const uint32_t *)bl_data + idx;
+	/* Relative to the section start, so that UNIT_TEST pages work too. */
+	uint32_t addr =
+	    BL_DATA_SECTION_BASE_PAGE * QM_FLASH_PAGE_SIZE_BYTES +
+	    ((uintptr_t)dst - (uintptr_t)BL_DATA_SECTION_START);
+	uint32_t i;
 
-	for (page = part->first_page;
-	     page < (part->first_page + part->num_pages); page++) {
-		qm_flash_page_erase(part->controller, QM_FLASH_REGION_SYS,
-				    page);
+	qm_flash_word_write(BL_DATA_FLASH_CONTROLLER, BL_DATA_FLASH_REGION,
+			    addr, BL_DATA_LOG_HDR(idx, len));
+	for (i = 0; i < len; i++) {
+		addr += sizeof(uint32_t);
+		qm_flash_word_write(BL_DATA_FLASH_CONTROLLER,
+				    BL_DATA_FLASH_REGION, addr, data[i]);
 	}
+	addr += sizeof(uint32_t);
+	qm_flash_word_write(BL_DATA_FLASH_CONTROLLER, BL_DATA_FLASH_REGION,
+			    addr, BL_DATA_LOG_CRC(idx, data, len));
 	/* Flash content has changed, flush prefetch buffer. */
-	flash_regs = QM_FLASH[part->controller];
-	flash_regs->ctrl |= QM_FLASH_CTRL_PRE_FLUSH_MASK;
-	flash_regs->ctrl &= ~QM_FLASH_CTRL_PRE_FLUSH_MASK;
+	fm_flash_flush_prefetch(BL_DATA_FLASH_CONTROLLER);
+	if (dst[0] != BL_DATA_LOG_HDR(idx, len) ||
+	    memcmp(dst + 1, data, len * sizeof(uint32_t)) ||
+	    dst[len + 1] != BL_DATA_LOG_CRC(idx, data, len)) {
+		bl_data_stats.verify_errors++;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/**
+ * Store the changes of the RAM copy of BL-Data as a log record.
+ *
+ * The record spans from the first to the last word that differs from the
+ * content of the BL-Data pages. It is appended to BL-Data Main first and to
+ * BL-Data Backup then.
+ *
+ * @return 0 on success (including when nothing has changed), negative errno
+ * 	   if a full writeback is needed (i.e., the pages are not in sync, the
+ * 	   record does not fit in the log, public data has changed or the
+ * 	   record could not be written).
+ */
+static int bl_data_log_append(void)
+{
+	const uint32_t *const shadow = (const uint32_t *)bl_data;
+	const uint32_t *main_end;
+	const uint32_t *bck_end;
+	uint32_t first = BL_DATA_LOG_CRC_WORD;
+	uint32_t last = 0;
+	uint32_t i;
+
+	/* The log can be used only if both pages are valid and in sync. */
+	if (!bl_data_is_valid(bl_data_main) ||
+	    memcmp(bl_data_main, bl_data_bck, QM_FLASH_PAGE_SIZE_BYTES)) {
+		return -EINVAL;
+	}
+	main_end = bl_data_log_end(bl_data_main);
+	bck_end = BL_DATA_LOG_START(bl_data_bck) +
+		  (main_end - BL_DATA_LOG_START(bl_data_main));
+
+	for (i = 0; i < BL_DATA_LOG_CRC_WORD; i++) {
+		if (shadow[i] != bl_data_log_word(bl_data_main, main_end, i)) {
+			if (i < BL_DATA_LOG_FIRST_WORD) {
+				return -EINVAL;
+			}
+			if (first == BL_DATA_LOG_CRC_WORD) {
+				first = i;
+			}
+			last = i;
+		}
+	}
+	if (first == BL_DATA_LOG_CRC_WORD) {
+		bl_data_stats.writebacks_skipped++;
+		return 0;
+	}
+	if (last - first + 1 > BL_DATA_LOG_MAX_LEN ||
+	    main_end + (last - first + 1) + 2 > BL_DATA_LOG_END(bl_data_main)) {
+		return -ENOSPC;
+	}
+	/* A failed record invalidates its page, which the compaction fixes. */
+	if (bl_data_log_write(main_end, first, last - first + 1) ||
+	    bl_data_log_write(bck_end, first, last - first + 1)) {
+		return -EIO;
+	}
+
+	return 0;
+}
+#else
+/* Pages hold BL-Data only. */
+#define BL_DATA_RESTORE_DWORDS (sizeof(bl_data_t) / sizeof(uint32_t))
+
+/* Check whether a BL-Data page is valid (i.e., its CRC is correct). */
+#define bl_data_is_valid(copy)                                                 \
+	((copy)->crc ==                                                        \
+	 fm_crc16_ccitt((uint8_t *)(copy), offsetof(bl_data_t, crc)))
+
+/* Load a (valid) BL-Data page into the RAM copy. */
+#define bl_data_load(copy) memcpy(bl_data, (copy), sizeof(*bl_data))
+#endif /* FM_CONFIG_BL_DATA_LOG */
+
+#if (FM_CONFIG_BL_DATA_PING_PONG)
+/**
+ * Write the RAM copy of BL-Data to the slot not holding the newest copy.
+ *
+ * The sequence number is incremented, so that the written slot becomes the
+ * newest one. If the write is interrupted or fails, the other slot is still
+ * valid and holds the previous content of BL-Data (and remains the newest
+ * one).
+ *
+ * @return 0 on success, -EIO if the slot could not be written.
+ */
+static int bl_data_commit(void)
+{
+	const bool to_main = (bl_data_newest != bl_data_main);
+
+	bl_data->seq++;
+	bl_data->crc =
+	    fm_crc16_ccitt((uint8_t *)bl_data, offsetof(bl_data_t, crc));
+	if (bl_data_copy(bl_data, to_main ? BL_DATA_SECTION_MAIN_PAGE
+					  : BL_DATA_SECTION_BACKUP_PAGE,
+			 sizeof(bl_data_t) / sizeof(uint32_t))) {
+		return -EIO;
+	}
+	bl_data_newest = to_main ? bl_data_main : bl_data_bck;
+
+	return 0;
+}
+#endif
+
+/* Erase a range of pages of an application partition. */
+void bl_data_erase_pages(const bl_flash_partition_t *part, uint32_t first,
+			 uint32_t end)
+{
+	if (first >= end) {
+		return;
+	}
+	fm_flash_erase_pages(part->controller, QM_FLASH_REGION_SYS,
+			     part->first_page + first,
+			     part->start_addr + (first * QM_FLASH_PAGE_SIZE_DWORDS),
+			     end - first);
 }
 
 /**
  * Sanitize application flash partitions.
  *
- * Check and fix inconsistent partitions. Fixing consists in erasing the entire
- * partition and marking it back as consistent.
+ * Check and fix inconsistent partitions. Fixing consists in erasing the
+ * partition (only the pages below its high-water mark, if
+ * FM_CONFIG_ERASE_ON_DEMAND is enabled) and marking it back as consistent.
+ * Partitions with a resumable update (if FM_CONFIG_QFU_RESUME is enabled) are
+ * left untouched.
  *
  * @note Empty partitions are not booted, even if marked as consistent.
  *
@@ -164,7 +473,22 @@ static bool bl_data_sanitize_partitions(void)
 	for (i = 0; i < BL_FLASH_PARTITIONS_NUM; i++) {
 		part = &bl_data->partitions[i];
 		if (part->is_consistent == false) {
-			bl_data_erase_partition(part);
+#if (FM_CONFIG_QFU_RESUME)
+			/*
+			 * Keep partitions whose update can be resumed; they are
+			 * not bootable anyway, since their first word is still
+			 * blank.
+			 */
+			if (part->resume_blk) {
+				continue;
+			}
+#endif
+#if (FM_CONFIG_ERASE_ON_DEMAND)
+			bl_data_erase_pages(part, 0, part->used_pages);
+			part->used_pages = 0;
+#else
+			bl_data_erase_pages(part, 0, part->num_pages);
+#endif
 			part->is_consistent = true;
 			wb_needed = true;
 		}
@@ -206,13 +530,45 @@ static void bl_loop_if_not_blank(void)
  */
 int bl_data_sanitize(void)
 {
-	const uint32_t crc_main =
-	    fm_crc16_ccitt((uint8_t *)bl_data_main, offsetof(bl_data_t, crc));
-	const uint32_t crc_bck =
-	    fm_crc16_ccitt((uint8_t *)bl_data_bck, offsetof(bl_data_t, crc));
+	int rc = 0;
+#if (FM_CONFIG_BL_DATA_PING_PONG)
+	const bool main_valid = bl_data_is_valid(bl_data_main);
+	const bool bck_valid = bl_data_is_valid(bl_data_bck);
 
-	if (bl_data_main->crc != crc_main) {
-		if (bl_data_bck->crc != crc_bck) {
+	if (!main_valid && !bck_valid) {
+		/*
+		 * Both slots are invalid, which is expected only when the
+		 * BL-Data flash section has not been initialized yet (see
+		 * below).
+		 */
+		bl_loop_if_not_blank();
+		rc = bl_data_init();
+	} else {
+		/* Load the newest valid copy. */
+		if (main_valid &&
+		    (!bck_valid || !bl_data_is_newer(bl_data_bck, bl_data_main))) {
+			bl_data_newest = bl_data_main;
+		} else {
+			bl_data_newest = bl_data_bck;
+		}
+		bl_data_load(bl_data_newest);
+	}
+	/*
+	 * An invalid slot is expected when a previous update failed while
+	 * writing it (or after initialization). Rewrite it now, so that both
+	 * slots hold valid public data (applications read it from BL-Data
+	 * Main). Since the other slot is the newest, the writeback targets the
+	 * invalid one.
+	 */
+	if (!rc &&
+	    (!bl_data_is_valid(bl_data_main) || !bl_data_is_valid(bl_data_bck))) {
+		rc = bl_data_commit();
+	}
+#else
+	const bl_data_t *src = bl_data_main;
+
+	if (!bl_data_is_valid(bl_data_main)) {
+		if (!bl_data_is_valid(bl_data_bck)) {
 			/*
 			 * Both BL-Data Main and BL-Data Backup are invalid.
 			 * This is expected when the BL-Data flash section has
@@ -227,7 +583,8 @@ int bl_data_sanitize(void)
 			 * initialize the BL-Data section in flash and the
 			 * RAM-copy of BL-Data.
 			 */
-			bl_data_init();
+			rc = bl_data_init();
+			src = NULL;
 		} else {
 			/*
 			 * BL-Main is corrupted. This can happen when a
@@ -235,11 +592,17 @@ int bl_data_sanitize(void)
 			 * updating BL-Data Main.
 			 *
 			 * Restore BL-Data Main by copying the content of
-			 * BL-Data Backup over it.
+			 * BL-Data Backup over it; if that fails, BL-Data is
+			 * loaded from the backup.
 			 */
-			bl_data_copy(bl_data_bck, BL_DATA_SECTION_MAIN_PAGE);
+			rc = bl_data_copy(bl_data_bck, BL_DATA_SECTION_MAIN_PAGE,
+					  BL_DATA_RESTORE_DWORDS);
+			if (rc) {
+				src = bl_data_bck;
+			}
 		}
-	} else if (memcmp(bl_data_main, bl_data_bck, sizeof(bl_data_t))) {
+	} else if (memcmp(bl_data_main, bl_data_bck,
+			  BL_DATA_RESTORE_DWORDS * sizeof(uint32_t))) {
 		/*
 		 * BL-Data Main is valid and up to date, but BL-Data Backup
 		 * has a different content than BL-Data Main. This means
@@ -251,37 +614,189 @@ int bl_data_sanitize(void)
 		 *
 		 * Restore BL-Data Backup with the content of BL-Data Main.
 		 */
-		bl_data_copy(bl_data_main, BL_DATA_SECTION_BACKUP_PAGE);
+		rc = bl_data_copy(bl_data_main, BL_DATA_SECTION_BACKUP_PAGE,
+				  BL_DATA_RESTORE_DWORDS);
 	}
 	/*
 	 * Update the shadowed BL-Data in RAM with the content of BL-Data Main
+	 * (replaying its log, if FM_CONFIG_BL_DATA_LOG is enabled). After the
+	 * initialization, the RAM copy is already up to date.
 	 */
-	memcpy(bl_data, bl_data_main, sizeof(*bl_data));
+	if (src) {
+		bl_data_load(src);
+	}
+#endif /* FM_CONFIG_BL_DATA_PING_PONG */
 	/*
 	 * Now that BL-Data is consistent, we can sanitize partitions.
 	 *
 	 * Note: if any partition is sanitized, shadowed bl-data is updated and
 	 * need to be written back.
 	 */
-	if (bl_data_sanitize_partitions()) {
-		bl_data_shadow_writeback();
+	if (bl_data_sanitize_partitions() && bl_data_shadow_writeback()) {
+		rc = -EIO;
 	}
 
-	return 0;
+	return rc;
 }
 
 /*
  * Store BL-Data to flash.
  *
  * The RAM-copy of BL-Data is written back to flash, on both pages: BL-Data
- * Main first, BL-Data backup then.
+ * Main first, BL-Data backup then. If FM_CONFIG_BL_DATA_PING_PONG is enabled,
+ * only the slot holding the older copy is written.
+ *
+ * The RAM-copy is modified in place by its users, so, rather than tracking
+ * changes, it is compared with the flash copies: a copy that is already up to
+ * date is not rewritten.
  */
 int bl_data_shadow_writeback(void)
 {
+	bool written = false;
+
+#if (FM_CONFIG_BL_DATA_PING_PONG)
+	if (!bl_data_newest ||
+	    memcmp(bl_data, bl_data_newest, offsetof(bl_data_t, crc))) {
+		if (bl_data_commit()) {
+			return -EIO;
+		}
+		written = true;
+	}
+#elif(FM_CONFIG_BL_DATA_LOG)
+	if (bl_data_log_append() == 0) {
+		return 0;
+	}
+	/*
+	 * Compact the log: rewrite both pages with a new snapshot. The log must
+	 * not be taken into account in the comparisons below (a page whose
+	 * snapshot matches may still have a log), so both pages are written.
+	 * If BL-Data Main cannot be written, BL-Data Backup is left untouched
+	 * and restores it at the next sanitization.
+	 */
 	bl_data->crc =
 	    fm_crc16_ccitt((uint8_t *)bl_data, offsetof(bl_data_t, crc));
-	bl_data_copy(bl_data, BL_DATA_SECTION_MAIN_PAGE);
-	bl_data_copy(bl_data, BL_DATA_SECTION_BACKUP_PAGE);
+	if (bl_data_copy(bl_data, BL_DATA_SECTION_MAIN_PAGE,
+			 sizeof(bl_data_t) / sizeof(uint32_t)) ||
+	    bl_data_copy(bl_data, BL_DATA_SECTION_BACKUP_PAGE,
+			 sizeof(bl_data_t) / sizeof(uint32_t))) {
+		return -EIO;
+	}
+	written = true;
+#else
+	bl_data->crc =
+	    fm_crc16_ccitt((uint8_t *)bl_data, offsetof(bl_data_t, crc));
+	/*
+	 * If BL-Data Main cannot be written, BL-Data Backup is left untouched
+	 * and restores it at the next sanitization.
+	 */
+	if (memcmp(bl_data, bl_data_main, sizeof(bl_data_t))) {
+		if (bl_data_copy(bl_data, BL_DATA_SECTION_MAIN_PAGE,
+				 sizeof(bl_data_t) / sizeof(uint32_t))) {
+			return -EIO;
+		}
+		written = true;
+	}
+	if (memcmp(bl_data, bl_data_bck, sizeof(bl_data_t))) {
+		if (bl_data_copy(bl_data, BL_DATA_SECTION_BACKUP_PAGE,
+				 sizeof(bl_data_t) / sizeof(uint32_t))) {
+			return -EIO;
+		}
+		written = true;
+	}
+#endif
+	if (!written) {
+		bl_data_stats.writebacks_skipped++;
+	}
 
 	return 0;
 }
+
+#if (FM_CONFIG_TRIAL_BOOT)
+/*
+ * The other partition of the target of a partition (with dual-bank, the
+ * partitions of target t are t and t + BL_BOOT_TARGETS_NUM).
+ */
+#define BL_DATA_OTHER_PARTITION(idx)                                           \
+	(((idx) + BL_BOOT_TARGETS_NUM) % BL_FLASH_PARTITIONS_NUM)
+
+/*
+ * The trial sticky bit is set when an image on trial is booted. Like the
+ * confirmation bit, it is cleared by power-on resets: if it is not set at the
+ * next boot, the outcome of the trial boot is unknown.
+ */
+#define BL_DATA_TRIAL_IS_PENDING() FM_BOOT_TRIAL_IS_PENDING()
+#define BL_DATA_TRIAL_SET_PENDING()                                            \
+	(QM_SCSS_GP->gps0 |= BIT(FM_CONFIG_TRIAL_BOOT_GPS0_PENDING_BIT))
+#define BL_DATA_TRIAL_CLEAR_PENDING()                                          \
+	(QM_SCSS_GP->gps0 &= ~BIT(FM_CONFIG_TRIAL_BOOT_GPS0_PENDING_BIT))
+
+/*
+ * Update the trial state of the targets before booting the application.
+ *
+ * A boot attempt is accounted when the previous trial boot ended with a warm
+ * reset (e.g., a watchdog reset of a hanging application) without being
+ * confirmed. Trial boots ended by a power-on reset are not accounted, as the
+ * reset clears the confirmation together with the pending bit.
+ *
+ * The sticky bits are consumed only if the new trial state is stored: if the
+ * BL-Data write-back fails, the RAM copy is restored and the confirmation bits
+ * are left set, so that the outcome is recorded at the next boot.
+ */
+void bl_data_trial_boot(void)
+{
+	const bool pending = BL_DATA_TRIAL_IS_PENDING();
+	const uint32_t confirm_bits = QM_SCSS_GP->gps0 & FM_BOOT_CONFIRM_MASK;
+	bl_boot_target_t saved[BL_BOOT_TARGETS_NUM];
+	const bl_flash_partition_t *other;
+	bl_boot_target_t *target;
+	bool on_trial = false;
+	int i;
+
+	memcpy(saved, bl_data->targets, sizeof(saved));
+	for (i = 0; i < BL_BOOT_TARGETS_NUM; i++) {
+		target = &bl_data->targets[i];
+		if (!target->is_on_trial) {
+			continue;
+		}
+		if (!(confirm_bits & FM_BOOT_CONFIRM_BIT(i))) {
+			if (pending) {
+				target->boot_attempts++;
+			}
+			if (target->boot_attempts <
+			    FM_CONFIG_TRIAL_BOOT_ATTEMPTS) {
+				on_trial = true;
+				continue;
+			}
+			/*
+			 * The image failed to confirm: roll back to the
+			 * previous one, unless there is none.
+			 */
+			other = &bl_data->partitions[BL_DATA_OTHER_PARTITION(
+			    target->active_partition_idx)];
+			if (other->is_consistent &&
+			    *other->start_addr != BL_DATA_BLANK_VALUE) {
+				target->active_partition_idx =
+				    other - bl_data->partitions;
+			}
+		}
+		target->is_on_trial = false;
+		target->boot_attempts = 0;
+	}
+	/* Nothing is written if no target is on trial. */
+	if (bl_data_shadow_writeback()) {
+		/*
+		 * Boot with the old trial state (this is still a trial boot)
+		 * and retry at the next boot.
+		 */
+		memcpy(bl_data->targets, saved, sizeof(saved));
+		BL_DATA_TRIAL_SET_PENDING();
+		return;
+	}
+	QM_SCSS_GP->gps0 &= ~FM_BOOT_CONFIRM_MASK;
+	if (on_trial) {
+		BL_DATA_TRIAL_SET_PENDING();
+	} else {
+		BL_DATA_TRIAL_CLEAR_PENDING();
+	}
+}
+#endif /* FM_CONFIG_TRIAL_BOOT */
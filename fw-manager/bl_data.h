@@ -30,6 +30,7 @@
 #ifndef __BL_DATA_H__
 #define __BL_DATA_H__
 
+#include "fw-manager_config.h"
 #include "qm_flash.h"
 #include "soc_flash_partitions.h"
 
@@ -52,6 +53,11 @@
  * The backup copy in a different page is necessary in order to recover from
  * power loss during updates, which may cause the corruption of an entire page.
  *
+ * If FM_CONFIG_BL_DATA_PING_PONG is enabled, the two pages are instead
+ * alternating slots: each update is written only to the slot holding the
+ * older copy (according to the sequence number) and the newest valid copy is
+ * the current one.
+ *
  * The general structure of each copy of bootloader data is the following (see
  * bl_data struct):
  * ----------------------------------
@@ -70,6 +76,8 @@
  * ----------------------------------
  * |         Revocation Key         | --> Revocation Key
  * ----------------------------------
+ * |        Sequence number         | --> Only if FM_CONFIG_BL_DATA_PING_PONG
+ * ----------------------------------
  * |              CRC               | --> CRC of the previous fields
  * ----------------------------------
  */
@@ -134,6 +142,12 @@ struct bl_boot_target {
 	 * image's SVN after the update succeeds.
 	 */
 	uint32_t svn;
+#if (FM_CONFIG_TRIAL_BOOT)
+	/** Whether the active partition is on trial (i.e., not confirmed). */
+	uint32_t is_on_trial;
+	/** The number of times the active partition was booted on trial. */
+	uint32_t boot_attempts;
+#endif
 };
 
 /**
@@ -167,6 +181,39 @@ struct bl_flash_partition {
 	uint32_t is_consistent;
 	/** The version of the application installed in the partition. */
 	uint32_t app_version;
+#if (FM_CONFIG_ERASE_ON_DEMAND)
+	/**
+	 * Page high-water mark.
+	 *
+	 * The number of pages (from the start of the partition) that may be
+	 * non-blank; the following pages are known to be blank and are not
+	 * erased by BL-Data sanitization.
+	 */
+	uint32_t used_pages;
+#endif
+#if (FM_CONFIG_QFU_RESUME)
+	/**
+	 * Resume watermark of an interrupted update.
+	 *
+	 * The number of data blocks of the image being written that have been
+	 * programmed and verified; 0 if the update cannot be resumed. While
+	 * non-zero, the partition is not erased by BL-Data sanitization.
+	 */
+	uint32_t resume_blk;
+#endif
+#if (FM_CONFIG_QFU_HOLD_FIRST_WORD)
+	/**
+	 * The first word of the image being written.
+	 *
+	 * The first word of the partition is programmed only when the update
+	 * completes, so that a partially written partition is never booted.
+	 */
+	uint32_t resume_first_word;
+#endif
+#if (FM_CONFIG_QFU_RESUME)
+	/** The tag identifying the image being written (see qfu.c). */
+	sha256_t resume_tag;
+#endif
 };
 
 /**
@@ -198,6 +245,10 @@ typedef struct bl_data {
 	hmac_key_t fw_key;
 	/** The current revocation key. */
 	hmac_key_t rv_key;
+#if (FM_CONFIG_BL_DATA_PING_PONG)
+	/** The sequence number of the copy, incremented at every update. */
+	uint32_t seq;
+#endif
 	/** The CRC of the previous fields. */
 	uint32_t crc;
 } bl_data_t;
@@ -207,6 +258,37 @@ typedef struct bl_data {
  */
 extern bl_data_t *const bl_data;
 
+/**
+ * BL-Data flash statistics.
+ *
+ * The statistics of the flash operations performed by the firmware manager
+ * (see fm_flash.h). Statistics are kept in RAM only (i.e., they are reset at
+ * every boot).
+ */
+typedef struct {
+	/** The number of page erases skipped because pages were blank. */
+	uint32_t erases_skipped;
+	/** The number of writebacks skipped because BL-Data was unchanged. */
+	uint32_t writebacks_skipped;
+	/** The number of flash pages written (i.e., erased and programmed). */
+	uint32_t page_writes;
+	/** The number of flash pages erased (not counting page writes). */
+	uint32_t page_erases;
+	/** The number of programming runs. */
+	uint32_t flash_runs;
+	/** The number of blank words not programmed (already erased). */
+	uint32_t words_skipped;
+	/** The number of prefetch buffer flushes. */
+	uint32_t prefetch_flushes;
+	/** The number of programming runs failing verification. */
+	uint32_t verify_errors;
+} bl_data_stats_t;
+
+/**
+ * The BL-Data flash statistics.
+ */
+extern bl_data_stats_t bl_data_stats;
+
 /**
  * Check validity of BL-Data and fix it if necessary.
  *
@@ -231,12 +313,54 @@ int bl_data_sanitize(void);
  * Store shadowed BL-Data to flash, over both BL-Data Main and BL-Data Backup.
  *
  * Store the RAM copy of BL-Data to flash, replacing both the main and the
- * backup copy on flash.
+ * backup copy on flash (only the older copy, if FM_CONFIG_BL_DATA_PING_PONG is
+ * enabled).
  *
  * @return 0 on success, negative errno otherwise.
  */
 int bl_data_shadow_writeback(void);
 
+/**
+ * Erase a range of pages of an application partition.
+ *
+ * @param[in] part  The partition. Must not be null.
+ * @param[in] first The first page to be erased (relative to the partition).
+ * @param[in] end   The page following the last one to be erased (relative to
+ * 		    the partition).
+ */
+void bl_data_erase_pages(const bl_flash_partition_t *part, uint32_t first,
+			 uint32_t end);
+
+/**
+ * Get the entry point of the application of a target.
+ *
+ * That is, the start address of the active partition of the target.
+ *
+ * @param[in] target_idx The index of the target.
+ *
+ * @return The entry point.
+ */
+#define bl_data_app_entry(target_idx)                                          \
+	(bl_data->partitions[bl_data->targets[target_idx].active_partition_idx] \
+	     .start_addr)
+
+#if (FM_CONFIG_TRIAL_BOOT)
+/**
+ * Update the trial state of the targets before booting the application.
+ *
+ * The targets on trial whose application confirmed the previous boot (see
+ * fm_boot_confirm.h) are confirmed; if the previous boot ended with a warm
+ * reset, a failed boot is accounted to each of the others and the ones reaching
+ * FM_CONFIG_TRIAL_BOOT_ATTEMPTS are rolled back to their other partition
+ * (provided that it contains an application). Boots ended by a power-on reset
+ * are not accounted. If BL-Data cannot be written, the trial state is left
+ * unchanged.
+ *
+ * Must be called at boot, after bl_data_sanitize().
+ */
+void bl_data_trial_boot(void);
+#endif
+
 /**
  * }@
  */
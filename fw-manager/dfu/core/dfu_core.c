@@ -30,6 +30,7 @@
 #include <string.h>
 
 #include "qm_common.h"
+#include "qm_interrupt.h"
 
 #include "../../qfm/qfm.h"
 #include "../../qfu/qfu.h"
@@ -70,6 +71,14 @@ static unsigned int block_cnt;
  * not necessary number zero.
  */
 static uint16_t next_block_num;
+/**
+ * Whether DNLOAD processing is asynchronous (see dfu_set_async_mode()).
+ */
+static bool async_mode;
+
+/** Whether the DFU state is a busy one (i.e., DNBUSY or MANIFEST). */
+#define DFU_STATE_IS_BUSY(s)                                                   \
+	((s) == DFU_STATE_DFU_DNBUSY || (s) == DFU_STATE_DFU_MANIFEST)
 
 /*-------------------------------------------------------------------------*/
 /*                        STATIC FUNCTIONS                                 */
@@ -78,12 +87,40 @@ static uint16_t next_block_num;
 /**
  * Transition to error state and set error status.
  *
+ * If the device is busy (i.e., in DNBUSY or MANIFEST state), the handler is
+ * still working in the background: only the status is set now, while the
+ * transition to the error state happens when the work is over (see
+ * dfu_process_bg_work()). This way, no handler function is called while the
+ * background work is in progress.
+ *
  * @param err_status The error status to set.
  */
 static void set_err(dfu_dev_status_t err_status)
 {
-	dfu_state = DFU_STATE_DFU_ERROR;
 	dfu_status = err_status;
+	if (!DFU_STATE_IS_BUSY(dfu_state)) {
+		dfu_state = DFU_STATE_DFU_ERROR;
+	}
+}
+
+/**
+ * Get the processing status from the handler, completing its background work
+ * first.
+ *
+ * Used when the DNLOAD processing is synchronous, to complete the
+ * manifestation before reporting the status.
+ *
+ * @param[out] poll_timeout_ms Where to store the poll timeout (always zero on
+ * 			       return). Must not be null.
+ */
+static void get_proc_status_sync(uint32_t *poll_timeout_ms)
+{
+	dfu_rh->get_proc_status(&dfu_status, poll_timeout_ms);
+	while (*poll_timeout_ms && dfu_rh->bg_work) {
+		dfu_rh->bg_work();
+		dfu_rh->get_proc_status(&dfu_status, poll_timeout_ms);
+	}
+	*poll_timeout_ms = 0;
 }
 
 /**
@@ -137,7 +174,8 @@ int dfu_usb_reset(void)
  */
 int dfu_set_alt_setting(uint8_t alt_setting)
 {
-	if (alt_setting >= DFU_NUM_ALT_SETTINGS) {
+	if (alt_setting >= DFU_NUM_ALT_SETTINGS ||
+	    DFU_STATE_IS_BUSY(dfu_state)) {
 		return -EIO;
 	}
 	reset_status();
@@ -313,38 +351,58 @@ int dfu_process_upload(uint16_t block_num, uint16_t req_len, uint8_t *data,
 int dfu_get_status(dfu_dev_status_t *status, dfu_dev_state_t *state,
 		   uint32_t *poll_timeout_ms)
 {
+	dfu_dev_status_t proc_status;
+
 	switch (dfu_state) {
 	case DFU_STATE_DFU_DNBUSY:
 	case DFU_STATE_DFU_MANIFEST:
 		/*
 		 * If we receive a request when in DFU_DNBUSY or DFU_MANIFEST
-		 * state, it means that the host is not respecting our poll
-		 * timeout.
+		 * state, the host is polling before our poll timeout has
+		 * expired (the timeout is just an estimate): instead of
+		 * stalling, report that we are still busy, together with an
+		 * updated estimate of the remaining time.
 		 */
-		set_err(DFU_STATUS_ERR_STALLEDPKT);
-		return -EIO;
+		dfu_rh->get_proc_status(&proc_status, poll_timeout_ms);
+		if (*poll_timeout_ms == 0) {
+			/* Just done: dfu_process_bg_work() is about to exit. */
+			*poll_timeout_ms = 1;
+		}
+		break;
 	case DFU_STATE_DFU_DNLOAD_SYNC:
 	case DFU_STATE_DFU_MANIFEST_SYNC:
 		/* Update the internal dfu_status and get poll_timeout value. */
-		dfu_rh->get_proc_status(&dfu_status, poll_timeout_ms);
+		if (async_mode) {
+			dfu_rh->get_proc_status(&dfu_status, poll_timeout_ms);
+		} else if (dfu_state == DFU_STATE_DFU_MANIFEST_SYNC) {
+			get_proc_status_sync(poll_timeout_ms);
+		} else {
+			/*
+			 * The programming of the block overlaps with the
+			 * reception of the next one: any error is reported
+			 * after the next block.
+			 */
+			dfu_rh->get_proc_status(&dfu_status, poll_timeout_ms);
+			*poll_timeout_ms = 0;
+		}
 		if (dfu_status != DFU_STATUS_OK) {
 			dfu_state = DFU_STATE_DFU_ERROR;
+			*poll_timeout_ms = 0;
 			break;
 		}
 		if (*poll_timeout_ms == 0) {
 			dfu_state = (dfu_state == DFU_STATE_DFU_DNLOAD_SYNC)
 					? DFU_STATE_DFU_DNLOAD_IDLE
 					: DFU_STATE_DFU_IDLE;
+		} else {
+			/*
+			 * The handler is still working: go busy until the
+			 * work is over (see dfu_process_bg_work()).
+			 */
+			dfu_state = (dfu_state == DFU_STATE_DFU_DNLOAD_SYNC)
+					? DFU_STATE_DFU_DNBUSY
+					: DFU_STATE_DFU_MANIFEST;
 		}
-		/*
-		 * NOTE: if poll_timeout != 0 we should set a timer and
-		 * transition to DFU_STATE_DFU_DNBUSY / DFU_STATE_DFU_MANIFEST.
-		 * However, for now, we just remain in the current state,
-		 * to avoid using timers.
-		 * (This is not a big issue: we are just not enforcing the
-		 * waiting time between two consecutive GET_STATUS requests; a
-		 * well-design host will respect it anyway).
-		 */
 		break;
 	default:
 		*poll_timeout_ms = 0;
@@ -382,16 +440,13 @@ int dfu_clr_status(void)
  */
 int dfu_get_state(dfu_dev_state_t *state)
 {
-	switch (dfu_state) {
-	case DFU_STATE_DFU_DNBUSY:
-	case DFU_STATE_DFU_MANIFEST:
+	if (DFU_STATE_IS_BUSY(dfu_state)) {
 		/* No request is allowed in DFU_DNBUSY or DFU_MANIFEST state. */
 		set_err(DFU_STATUS_ERR_STALLEDPKT);
 		return -EIO;
-	default:
-		*state = dfu_state;
-		return 0;
 	}
+	*state = dfu_state;
+	return 0;
 }
 
 /*
@@ -418,3 +473,49 @@ int dfu_abort(void)
 	dfu_state = DFU_STATE_DFU_IDLE;
 	return 0;
 }
+
+/*
+ * Enable or disable asynchronous DNLOAD processing.
+ *
+ * @param[in] enable Whether the processing must be asynchronous.
+ */
+void dfu_set_async_mode(bool enable)
+{
+	async_mode = enable;
+}
+
+/*
+ * Perform a step of the background work of the active DFU request handler.
+ */
+void dfu_process_bg_work(void)
+{
+	dfu_dev_status_t proc_status;
+	uint32_t poll_timeout_ms;
+
+	if (dfu_rh->bg_work) {
+		dfu_rh->bg_work();
+	}
+	/*
+	 * Leave the busy state once the handler is done. Interrupts are
+	 * disabled since the request handling (e.g., set_err()) may change the
+	 * state concurrently.
+	 */
+	qm_irq_disable();
+	if (DFU_STATE_IS_BUSY(dfu_state)) {
+		dfu_rh->get_proc_status(&proc_status, &poll_timeout_ms);
+		if (poll_timeout_ms == 0) {
+			if (dfu_status == DFU_STATUS_OK) {
+				dfu_status = proc_status;
+			}
+			if (dfu_status != DFU_STATUS_OK) {
+				dfu_state = DFU_STATE_DFU_ERROR;
+			} else {
+				dfu_state =
+				    (dfu_state == DFU_STATE_DFU_DNBUSY)
+					? DFU_STATE_DFU_DNLOAD_SYNC
+					: DFU_STATE_DFU_MANIFEST_SYNC;
+			}
+		}
+	}
+	qm_irq_enable();
+}
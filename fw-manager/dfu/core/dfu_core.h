@@ -30,6 +30,7 @@
 #ifndef __DFU_CORE_H__
 #define __DFU_CORE_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "qm_common.h"
@@ -153,6 +154,32 @@ int dfu_get_state(dfu_dev_state_t *state);
  */
 int dfu_abort(void);
 
+/**
+ * Enable or disable asynchronous DNLOAD processing.
+ *
+ * When disabled (default), the background work of a DNLOAD block overlaps
+ * with the reception of the next block: the device reports a zero poll
+ * timeout and any error is reported after the next block; the manifestation
+ * is completed before reporting the status. When enabled, the device reports
+ * the time the handler expects to need and goes to DNBUSY (or MANIFEST) state
+ * until the work is over; this requires the transport to call
+ * dfu_process_bg_work() outside of the request handling context (e.g., from
+ * the main loop while requests are handled in interrupt context).
+ *
+ * @param[in] enable Whether the processing must be asynchronous.
+ */
+void dfu_set_async_mode(bool enable);
+
+/**
+ * Perform a step of the background work of the active DFU request handler.
+ *
+ * This function is expected to be called by the transport layer when idle
+ * (e.g., while waiting for incoming data). It does nothing if the active
+ * handler has no background work. When the work is over, the device leaves
+ * the DNBUSY / MANIFEST state (if in there).
+ */
+void dfu_process_bg_work(void);
+
 /**
  * @}
  */
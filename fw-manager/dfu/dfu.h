@@ -43,7 +43,7 @@
 #define DFU_ATTR_MANIFESTATION_TOLERANT 0x4
 
 /* Maximum supported block size. */
-#define DFU_MAX_BLOCK_SIZE (QFU_BLOCK_SIZE)
+#define DFU_MAX_BLOCK_SIZE (QFU_MAX_BLOCK_SIZE)
 
 /* DFU Version (as BCD). */
 #define DFU_VERSION_BCD (0x0101)
@@ -277,6 +277,24 @@ typedef struct {
 	 * This function pointer must not be null.
 	 */
 	void (*abort_dnload_xfer)(void);
+	/**
+	 * Perform a step of pending background work.
+	 *
+	 * This function is called by the DFU logic (see dfu_process_bg_work())
+	 * when the transport layer is idle, e.g., while waiting for the next
+	 * request. A handler can use it to defer time-consuming operations
+	 * (like flash programming), so that they overlap with the reception of
+	 * the next block or, in asynchronous mode (see dfu_set_async_mode()),
+	 * with the host polling in DNBUSY / MANIFEST state. The result of the
+	 * deferred operations and the expected remaining time must be reported
+	 * by means of get_proc_status(), which may then be called while this
+	 * function is running and so must not change the handler state. Each
+	 * call should be short (e.g., the programming of a single flash page).
+	 *
+	 * This function pointer can be null, if the handler does not need to
+	 * perform any background work.
+	 */
+	void (*bg_work)(void);
 } dfu_request_handler_t;
 
 #endif /* __DFU_H__ */
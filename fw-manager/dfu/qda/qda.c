@@ -40,14 +40,34 @@
 #include "qda_packets.h"
 #include "xmodem.h"
 #include "xmodem_io_uart.h"
+#include "xmodem_stream.h"
 #include "fw-manager_config.h"
 
 /*--------------------------------------------------------------------------*/
 /*                              MACROS                                      */
 /*--------------------------------------------------------------------------*/
 
-/* Additional XMODEM_BLOCK_SIZE bytes needed because of QDA overhead */
-#define QDA_BUF_SIZE (QFU_BLOCK_SIZE + XMODEM_BLOCK_SIZE)
+/*
+ * Additional XMODEM_MAX_BLOCK_SIZE bytes needed because of QDA overhead (the
+ * QDA header makes a DFU block span one extra XMODEM packet).
+ */
+#define QDA_BUF_SIZE (DFU_MAX_BLOCK_SIZE + XMODEM_MAX_BLOCK_SIZE)
+
+/* The bitmap of supported transport modes. */
+#if (FM_CONFIG_XMODEM_STREAM)
+#define QDA_TRANSPORTS                                                         \
+	(BIT(QDA_TRANSPORT_XMODEM) | BIT(QDA_TRANSPORT_XMODEM_STREAM))
+#else
+#define QDA_TRANSPORTS (BIT(QDA_TRANSPORT_XMODEM))
+#endif
+
+/*
+ * The number of XMODEM start requests sent at a newly negotiated baud rate
+ * before reverting to the default one (each request waits for
+ * XMODEM_IO_TIMEOUT_MS). Two, so that a request sent while the host is still
+ * switching its port does not make the negotiation fail.
+ */
+#define QDA_BAUD_PROBE_TRIES (2)
 
 /*--------------------------------------------------------------------------*/
 /*                    GLOBAL VARIABLES                                      */
@@ -60,9 +80,26 @@
  */
 static uint8_t qda_buf[QDA_BUF_SIZE];
 
+/** The transport mode currently in use. */
+static qda_transport_t qda_transport = QDA_TRANSPORT_XMODEM;
+
+/** Whether the UART baud rate has been changed by the host. */
+static bool qda_baud_changed;
+
+/**
+ * Whether the new baud rate is still to be confirmed by a valid packet.
+ *
+ * Set by a 'set baud rate' request and cleared by the first packet received
+ * at the new baud rate.
+ */
+static bool qda_baud_unconfirmed;
+
 /*--------------------------------------------------------------------------*/
 /*                           FORWARD DECLARATIONS                           */
 /*--------------------------------------------------------------------------*/
+static int qda_receive(uint8_t *buf, size_t len);
+static void qda_revert_link(void);
+static int qda_transmit(const uint8_t *data, size_t len);
 static void qda_process_pkt(uint8_t *data, size_t len);
 static void qda_ack(void);
 static void qda_stall(void);
@@ -81,6 +118,8 @@ void qda_init(void)
 {
 	xmodem_io_uart_init();
 	dfu_init();
+	/* Let DFU handlers perform background work while waiting for data. */
+	xmodem_io_uart_set_idle_cb(dfu_process_bg_work);
 }
 
 /*
@@ -92,6 +131,7 @@ void qda_init(void)
 void qda_receive_loop(void)
 {
 	int len;
+	bool probing;
 
 	do {
 		/*
@@ -104,9 +144,18 @@ void qda_receive_loop(void)
 		 * returns the length of the received data on success, a
 		 * negative error code otherwise.
 		 */
-		len = xmodem_receive_package(qda_buf, sizeof(qda_buf));
+		probing = qda_baud_unconfirmed;
+		len = qda_receive(qda_buf, sizeof(qda_buf));
 		if (len > 0) {
+			qda_baud_unconfirmed = false;
 			qda_process_pkt(qda_buf, len);
+		} else if (probing) {
+			/*
+			 * The host did not follow the baud rate change: go
+			 * back to the default baud rate (and the standard
+			 * transport mode) and keep waiting for packets.
+			 */
+			qda_revert_link();
 		}
 		/*
 		 * NOTE: for this function to work properly, XMODEM must be
@@ -114,15 +163,74 @@ void qda_receive_loop(void)
 		 * a timeout and not an error.
 		 *
 		 * For now we do not distinguish between a timeout and an
-		 * unrecoverable error: in both cases we exit the loop.
+		 * unrecoverable error: in both cases we exit the loop (unless
+		 * the failure happened at a new, unconfirmed, baud rate).
 		 */
-	} while (len > 0);
+	} while ((len > 0) || probing);
+	/*
+	 * Fall back to the standard transport mode and the default baud rate:
+	 * the host may have gone away or the link may be unreliable.
+	 */
+	qda_revert_link();
 }
 
 /*--------------------------------------------------------------------------*/
 /*                    STATIC FUNCTION DEFINITION                            */
 /*--------------------------------------------------------------------------*/
 
+/**
+ * Receive a QDA packet using the current transport mode.
+ *
+ * @param[out] buf The buffer where to store the packet. Must not be null.
+ * @param[in]  len The size of the buffer.
+ *
+ * @return Number of received bytes (including padding) or negative error code.
+ */
+static int qda_receive(uint8_t *buf, size_t len)
+{
+	int tries;
+
+	/* Give up early if the host does not follow a baud rate change. */
+	tries = qda_baud_unconfirmed ? QDA_BAUD_PROBE_TRIES : XMODEM_START_TRIES;
+#if (FM_CONFIG_XMODEM_STREAM)
+	if (qda_transport == QDA_TRANSPORT_XMODEM_STREAM) {
+		return xmodem_stream_receive_package(buf, len, tries);
+	}
+#endif
+	return xmodem_receive_package(buf, len, tries);
+}
+
+/**
+ * Revert to the standard transport mode and the default baud rate.
+ */
+static void qda_revert_link(void)
+{
+	qda_transport = QDA_TRANSPORT_XMODEM;
+	if (qda_baud_changed) {
+		xmodem_io_uart_set_baud_div(FM_CONFIG_UART_BAUD_DIV);
+		qda_baud_changed = false;
+	}
+	qda_baud_unconfirmed = false;
+}
+
+/**
+ * Send a QDA packet using the current transport mode.
+ *
+ * @param[in] data The packet to send. Must not be null.
+ * @param[in] len  The length of the packet.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+static int qda_transmit(const uint8_t *data, size_t len)
+{
+#if (FM_CONFIG_XMODEM_STREAM)
+	if (qda_transport == QDA_TRANSPORT_XMODEM_STREAM) {
+		return xmodem_stream_transmit_package(data, len);
+	}
+#endif
+	return xmodem_transmit_package(data, len);
+}
+
 /**
  * Process a QDA packet.
  *
@@ -138,6 +246,9 @@ static void qda_process_pkt(uint8_t *data, size_t len)
 	qda_dnl_req_payload_t *dnload_req;
 	qda_upl_req_payload_t *upload_req;
 	qda_set_alt_setting_payload_t *altset_req;
+	qda_set_transport_payload_t *transport_req;
+	qda_set_baud_rate_payload_t *baud_req;
+	uint32_t baud_div;
 	size_t expected_len;
 	dfu_dev_state_t state;
 	dfu_dev_status_t status;
@@ -231,6 +342,37 @@ static void qda_process_pkt(uint8_t *data, size_t len)
 		}
 		qda_stall();
 		return;
+	case QDA_PKT_SET_TRANSPORT:
+		/*
+		 * Handle a 'set transport' request: the ACK is sent using the
+		 * current transport, the new one is used from the next packet.
+		 */
+		transport_req = (qda_set_transport_payload_t *)pkt->payload;
+		if ((transport_req->transport < 8) &&
+		    (QDA_TRANSPORTS & BIT(transport_req->transport))) {
+			qda_ack();
+			qda_transport = transport_req->transport;
+			return;
+		}
+		qda_stall();
+		return;
+	case QDA_PKT_SET_BAUD_RATE:
+		/*
+		 * Handle a 'set baud rate' request: the ACK is sent using the
+		 * current baud rate, the new one is used from the next packet.
+		 */
+		baud_req = (qda_set_baud_rate_payload_t *)pkt->payload;
+		retv = xmodem_io_uart_get_baud_div(baud_req->baud_rate,
+						   &baud_div);
+		if (retv == 0) {
+			qda_ack();
+			xmodem_io_uart_set_baud_div(baud_div);
+			qda_baud_changed = true;
+			qda_baud_unconfirmed = true;
+			return;
+		}
+		qda_stall();
+		return;
 	case QDA_PKT_RESET:
 		/* Handle a reset request. */
 		qda_ack();
@@ -256,7 +398,7 @@ static void qda_ack(void)
 {
 	static const qda_pkt_t pkt = {.type = QDA_PKT_ACK};
 
-	xmodem_transmit_package((uint8_t *)&pkt, sizeof(pkt));
+	qda_transmit((uint8_t *)&pkt, sizeof(pkt));
 }
 
 /*
@@ -270,7 +412,7 @@ static void qda_stall(void)
 {
 	static const qda_pkt_t pkt = {.type = QDA_PKT_STALL};
 
-	xmodem_transmit_package((uint8_t *)&pkt, sizeof(pkt));
+	qda_transmit((uint8_t *)&pkt, sizeof(pkt));
 }
 
 /*
@@ -304,7 +446,7 @@ static void handle_upload_req(qda_upl_req_payload_t *req)
 	retv =
 	    dfu_process_upload(block_num, max_len, rsp->data, &rsp->data_len);
 	if (retv == 0) {
-		xmodem_transmit_package(qda_buf, sizeof(*pkt) + sizeof(*rsp) +
+		qda_transmit(qda_buf, sizeof(*pkt) + sizeof(*rsp) +
 						     rsp->data_len);
 	} else {
 		qda_stall();
@@ -339,7 +481,7 @@ static void qda_dfu_get_status_rsp(dfu_dev_state_t state,
 	rsp->poll_timeout = poll_timeout;
 	rsp->state = state;
 
-	xmodem_transmit_package(qda_buf, sizeof(*pkt) + sizeof(*rsp));
+	qda_transmit(qda_buf, sizeof(*pkt) + sizeof(*rsp));
 }
 
 /*
@@ -361,7 +503,7 @@ static void qda_dfu_get_state_rsp(dfu_dev_state_t state)
 	rsp = (qda_get_state_rsp_payload_t *)pkt->payload;
 	rsp->state = state;
 
-	xmodem_transmit_package(qda_buf, sizeof(*pkt) + sizeof(*rsp));
+	qda_transmit(qda_buf, sizeof(*pkt) + sizeof(*rsp));
 }
 
 /*
@@ -380,6 +522,8 @@ static void qda_dfu_get_state_rsp(dfu_dev_state_t state)
  * ----------------------
  * |2B|DFU_VERSION      |
  * ----------------------
+ * |1B|TRANSPORTS       |
+ * ----------------------
  */
 static void qda_dfu_dsc_rsp(void)
 {
@@ -390,7 +534,8 @@ static void qda_dfu_dsc_rsp(void)
 	    .detach_timeout = DFU_DETACH_TIMEOUT,
 	    .transfer_size = DFU_MAX_BLOCK_SIZE,
 	    .bcd_dfu_ver = DFU_VERSION_BCD,
+	    .transports = QDA_TRANSPORTS,
 	};
 
-	xmodem_transmit_package((uint8_t *)&rsp, sizeof(rsp));
+	qda_transmit((uint8_t *)&rsp, sizeof(rsp));
 }
@@ -39,6 +39,8 @@ typedef enum {
 	/* Host requests */
 	QDA_PKT_RESET = 0x4D550000,
 	QDA_PKT_DEV_DESC_REQ = 0x4D550005,
+	QDA_PKT_SET_TRANSPORT = 0x4D550006,
+	QDA_PKT_SET_BAUD_RATE = 0x4D550007,
 	QDA_PKT_DFU_DESC_REQ = 0x4D5501FF,
 	QDA_PKT_DFU_SET_ALT_SETTING = 0x4D5501FE,
 	QDA_PKT_DFU_DETACH = 0x4D550100,
@@ -86,6 +88,30 @@ typedef struct __attribute__((__packed__)) {
 	uint16_t block_num;
 } qda_upl_req_payload_t;
 
+/**
+ * QDA transport modes (i.e., the XMODEM variant used to carry QDA packets).
+ */
+typedef enum {
+	/* Standard (stop-and-wait) XMODEM-CRC, always supported. */
+	QDA_TRANSPORT_XMODEM = 0,
+	/* XMODEM streaming mode (no per-packet ACK). */
+	QDA_TRANSPORT_XMODEM_STREAM = 1,
+} qda_transport_t;
+
+/**
+ * QDA_SET_TRANSPORT payload structure
+ */
+typedef struct __attribute__((__packed__)) {
+	uint8_t transport;
+} qda_set_transport_payload_t;
+
+/**
+ * QDA_SET_BAUD_RATE payload structure
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t baud_rate;
+} qda_set_baud_rate_payload_t;
+
 /**
  * QDA_USB_SET_ALT_SETTING payload structure
  */
@@ -120,6 +146,12 @@ typedef struct __attribute__((__packed__)) {
 	uint16_t detach_timeout;
 	uint16_t transfer_size;
 	uint16_t bcd_dfu_ver;
+	/*
+	 * Bitmap of supported transport modes (bit N set means that
+	 * qda_transport_t N is supported). Not part of the USB DFU descriptor;
+	 * hosts not aware of it simply ignore it.
+	 */
+	uint8_t transports;
 } qda_dfu_dsc_rsp_t;
 
 /**
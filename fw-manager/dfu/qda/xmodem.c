@@ -32,25 +32,10 @@
 #include "fw-manager_utils.h"
 #include "xmodem.h"
 #include "xmodem_io.h"
-
-/* The maximum number of times XMODEM tries to send a packet / control byte */
-#define MAX_RETRANSMIT (8)
-/* The maximum number of consecutive RX errors XMODEM tolerates */
-#define MAX_RX_ERRORS (5)
-
-/* Custom value, not transferred via XMODEM, but used as return codes */
-#define ERR (0xFF)
-#define DUP (0xFE)
-
-/* XMODEM control bytes */
-#define SOH (0x01)
-#define EOT (0x04)
-#define ACK (0x06)
-#define NAK (0x15)
-#define CAN (0x18)
+#include "xmodem_pkt.h"
 
 /* XMODEM block size */
-#define PACKET_PAYLOAD_SIZE (XMODEM_BLOCK_SIZE)
+#define PACKET_PAYLOAD_SIZE (XMODEM_MAX_BLOCK_SIZE)
 
 /* Activate debug messages by defining DEBUG_MSG to 1 */
 #define DEBUG_MSG (0)
@@ -61,49 +46,57 @@
 #define printd(...)
 #endif
 
+/* The size of the CRC field. */
+#define PACKET_CRC_SIZE (2)
+
+/* The size of a packet with the given payload size (i.e., including header). */
+#define PACKET_SIZE(pld_len) (3 + (pld_len) + PACKET_CRC_SIZE)
+
 /**
  * The XMODEM packet buffer.
  *
- * This buffer is used for both incoming and outgoing packets.
+ * This buffer is used for both incoming and outgoing packets. The data field
+ * is sized for the biggest supported frame; since the CRC immediately follows
+ * the (variable-length) payload, it is stored in the data field too, just
+ * after the payload. This way, the whole packet is always contiguous in
+ * memory and can be sent / received in one go.
  */
 static struct __attribute__((__packed__)) xmodem_packet {
 	uint8_t soh;
 	uint8_t seq_no;
 	uint8_t seq_no_inv;
-	uint8_t data[PACKET_PAYLOAD_SIZE];
-	uint8_t crc_u8[2];
+	uint8_t data[PACKET_PAYLOAD_SIZE + PACKET_CRC_SIZE];
 } pkt_buf;
 
 /**
- * Send a single XMODEM packet.
+ * Send a buffer byte by byte.
  *
- * @param[in] data     The payload of the packet. Must not be null.
- * @param[in] data_len The length of the payload. Must be at most 128 bytes.
- *		       If less, (random) padding is automatically added.
- * @param[in] pkt_no   The desired packet sequence number.
- *
- * @return Resulting status code.
- * @retval 0 Success (only possible retval for now).
+ * @param[in] buf The buffer to send. Must not be null.
+ * @param[in] len The length of the buffer.
  */
-static int xmodem_send_pkt(const uint8_t *data, size_t data_len, uint8_t pkt_no)
+static void xmodem_write_bytes(const uint8_t *buf, size_t len)
+{
+	while (len--) {
+		xmodem_io_putc(buf++);
+	}
+}
+
+/* Send a single XMODEM packet. */
+int xmodem_send_pkt(const uint8_t *data, size_t data_len, size_t pld_len,
+		    uint8_t pkt_no)
 {
-	size_t i;
-	uint8_t *buf;
 	uint16_t crc;
 
 	printd("xmodem_send_pkt(): pkt_no: %d\n", pkt_no);
-	pkt_buf.soh = SOH;
+	pkt_buf.soh = (pld_len == XMODEM_BLOCK_SIZE) ? SOH : STX;
 	memcpy(pkt_buf.data, data, data_len);
-	crc = fm_crc16_ccitt(pkt_buf.data, PACKET_PAYLOAD_SIZE);
-	pkt_buf.crc_u8[0] = (crc >> 8) & 0xFF;
-	pkt_buf.crc_u8[1] = crc & 0xFF;
+	crc = fm_crc16_ccitt(pkt_buf.data, pld_len);
+	pkt_buf.data[pld_len] = (crc >> 8) & 0xFF;
+	pkt_buf.data[pld_len + 1] = crc & 0xFF;
 	pkt_buf.seq_no = pkt_no;
 	pkt_buf.seq_no_inv = ~pkt_no;
-	buf = (uint8_t *)&pkt_buf;
 	/* Send the packet */
-	for (i = 0; i < sizeof(pkt_buf); i++) {
-		xmodem_io_putc(&buf[i]);
-	}
+	xmodem_write_bytes(&pkt_buf.soh, PACKET_SIZE(pld_len));
 
 	return 0;
 }
@@ -116,8 +109,10 @@ static int xmodem_send_pkt(const uint8_t *data, size_t data_len, uint8_t pkt_no)
  * 'MAX_RETRANSMIT' is exceeded.
  *
  * @param[in] data     The payload of the packet. Must not be null.
- * @param[in] data_len The length of the payload. Must be at most 128 bytes.
- *		       If less, (random) padding is automatically added.
+ * @param[in] data_len The length of the payload. Must be at most pld_len
+ *		       bytes. If less, (random) padding is automatically added.
+ * @param[in] pld_len  The payload size of the packet (XMODEM_BLOCK_SIZE or
+ *		       XMODEM_1K_BLOCK_SIZE).
  * @param[in] pkt_no   The packet sequence number.
  *
  * @return Exit status.
@@ -125,15 +120,16 @@ static int xmodem_send_pkt(const uint8_t *data, size_t data_len, uint8_t pkt_no)
  * @retval -1 Error, retransmit count exceeded.
  */
 static int xmodem_send_pkt_with_retry(const uint8_t *data, size_t data_len,
-				      uint8_t pkt_no)
+				      size_t pld_len, uint8_t pkt_no)
 {
 	uint8_t retransmit = MAX_RETRANSMIT;
 	uint8_t rsp;
 
 	printd("xmodem_send_pkt_with_retry(): pkt_no: %d\n", pkt_no);
 	while (retransmit--) {
-		xmodem_send_pkt(data, data_len, pkt_no);
+		xmodem_send_pkt(data, data_len, pld_len, pkt_no);
 		rsp = ERR;
+		xmodem_io_set_deadline(XMODEM_IO_TIMEOUT_MS);
 		xmodem_io_getc(&rsp);
 		if (rsp == ACK) {
 			printd("xmodem_send_pkt_with_retry(): done\n");
@@ -146,20 +142,8 @@ static int xmodem_send_pkt_with_retry(const uint8_t *data, size_t data_len,
 	return -1;
 }
 
-/**
- * Try to send a byte for MAX_RETRANSMIT times.
- *
- * This function sends a byte (typically an XMODEM control byte) and checks if
- * an ACK is received. If no ACK is received, the byte is retransmitted. This is
- * done until 'MAX_RETRANSMIT' is exceeded.
- *
- * @param[in] cmd The byte to send.
- *
- * @return Exit status.
- * @retval 0  Success, the byte has been transmitted and an ACK received.
- * @retval -1 Error, retransmit count exceeded.
- */
-static int xmodem_send_byte_with_retry(uint8_t cmd)
+/* Try to send a byte for MAX_RETRANSMIT times. */
+int xmodem_send_byte_with_retry(uint8_t cmd)
 {
 	uint8_t retransmit = MAX_RETRANSMIT;
 	uint8_t rsp;
@@ -167,6 +151,7 @@ static int xmodem_send_byte_with_retry(uint8_t cmd)
 	while (retransmit--) {
 		xmodem_io_putc(&cmd);
 		rsp = ERR;
+		xmodem_io_set_deadline(XMODEM_IO_TIMEOUT_MS);
 		xmodem_io_getc(&rsp);
 		if (rsp == ACK) {
 			return 0;
@@ -176,47 +161,28 @@ static int xmodem_send_byte_with_retry(uint8_t cmd)
 	return -1;
 }
 
-/*
- * Receive an XMODEM packet.
- *
- * @param[in] exp_seq_no The expected sequence number of the packet to be
- * 			 received.
- * @param[in] data       The buffer where to store the packet payload. Must not
- *			 be null.
- * @param[in] len        The size of the buffer.
- *
- * @return Status code.
- * @retval SOH The packet has been successful received.
- * @retval DUP The received packet is a duplicate of the previous one (based on
- *             the expected sequence number); nothing has been written to the
- *             data buffer.
- * @retval ERR An error has occurred (either a timeout or the reception of
- * 	       invalid / corrupted data), but the XMODEM session is not
- *	       compromised.
- * @retval CAN An unrecoverable error has occurred (either the sender and
- *	       receiver have lost sync or the passed buffer is too small).
- * @retval EOT The sender notified the end of transmission (i.e., there are no
- *	       more packets to receive).
- */
-static int xmodem_read_pkt(uint8_t exp_seq_no, uint8_t *data, size_t len)
+/* Receive an XMODEM packet. */
+int xmodem_read_pkt(uint8_t exp_seq_no, uint8_t *data, size_t len,
+		    size_t *pld_len)
 {
 	uint8_t cmd;
 	uint16_t crc_recv; /* received CRC */
 	uint16_t crc_comp; /* computed CRC */
-	uint8_t *buf;
-	uint8_t *buf_end;
 
 	cmd = ERR;
 
 	/*
+	 * A single deadline is used for the whole packet (header included).
+	 *
 	 * Wait for a character from the sender; if getc() timeouts (or fails
 	 * due to an I/O error) return error.
 	 */
+	xmodem_io_set_deadline(XMODEM_IO_TIMEOUT_MS);
 	if (xmodem_io_getc(&cmd) < 0) {
 		return ERR;
 	}
 
-	/* The first char we receive should be either SOH or EOT. */
+	/* The first char we receive should be either SOH, STX, or EOT. */
 	switch (cmd) {
 	case SOH:
 		/*
@@ -224,7 +190,15 @@ static int xmodem_read_pkt(uint8_t exp_seq_no, uint8_t *data, size_t len)
 		 * (just after this switch-case block).
 		 */
 		printd("xmodem_read_pkt(): cmd: SOH\n");
+		*pld_len = XMODEM_BLOCK_SIZE;
+		break;
+#if (FM_CONFIG_XMODEM_1K)
+	case STX:
+		/* Same as SOH, but the packet has a 1024-byte payload. */
+		printd("xmodem_read_pkt(): cmd: STX\n");
+		*pld_len = XMODEM_1K_BLOCK_SIZE;
 		break;
+#endif
 	case EOT:
 		/*
 		 * The previous packet we received was the last one.
@@ -245,42 +219,22 @@ static int xmodem_read_pkt(uint8_t exp_seq_no, uint8_t *data, size_t len)
 		printd("xmodem_read_pkt(): cmd: unexpected ctrl byte (0x%x)\n",
 		       cmd);
 		/* Wait until the sender stops sending bytes */
-		while (xmodem_io_getc(&cmd) >= 0) {
-			/*
-			 * Loop until we timeout
-			 *
-			 * NOTE: a special small timeout value should actually
-			 * be used; however, we do not do that in the target
-			 * for footprint minimization purposes.
-			 *
-			 * IMPORTANT: This choice forces the target to use a
-			 * timeout value smaller than the one used by the host,
-			 * otherwise we may end up in a communication loop if
-			 * for some reason both the target and the host enters
-			 * reception mode (because both will send and discard
-			 * NAKs).
-			 */
-		}
+		xmodem_purge();
 		return ERR;
 	}
 
 	/* Read the rest of the packet (seq_no, ~seq_no, data, and CRC). */
-	/* Start from seq_no, since we have already read SOH. */
-	buf = (uint8_t *)&pkt_buf.seq_no;
-	/* Compute end of buffer. */
-	buf_end = (uint8_t *)(&pkt_buf + 1);
-	while (buf < buf_end) {
-		if (xmodem_io_getc(buf++) < 0) {
-			printd("xmodem_read_pkt(): pkt: ERROR: timeout\n");
-			printd("----\n");
-			/* This is a timeout error */
-			return ERR;
-		}
+	/* Start from seq_no, since we have already read SOH / STX. */
+	if (xmodem_io_read(&pkt_buf.seq_no, PACKET_SIZE(*pld_len) - 1) < 0) {
+		printd("xmodem_read_pkt(): pkt: ERROR: timeout\n");
+		printd("----\n");
+		/* This is a timeout error */
+		return ERR;
 	}
 
 	/* Check sequence number fields and CRC */
-	crc_comp = fm_crc16_ccitt(pkt_buf.data, PACKET_PAYLOAD_SIZE);
-	crc_recv = (pkt_buf.crc_u8[0] << 8) | pkt_buf.crc_u8[1];
+	crc_comp = fm_crc16_ccitt(pkt_buf.data, *pld_len);
+	crc_recv = (pkt_buf.data[*pld_len] << 8) | pkt_buf.data[*pld_len + 1];
 	/*
 	 * NOTE: Using 'a == (~a &FF)' instead of 'a == ~a', since the latter
 	 * leads to a compilation error due to the following GCC bug:
@@ -308,24 +262,48 @@ static int xmodem_read_pkt(uint8_t exp_seq_no, uint8_t *data, size_t len)
 	 * not be anticipated, otherwise we risk to return a CAN in case of a
 	 * simple EOT from the sender).
 	 */
-	if (len < sizeof(pkt_buf.data)) {
+	if (len < *pld_len) {
 		printd("xmodem_read_pkt(): pkt: "
 		       "ERROR: user buffer out of space\n");
 		return CAN;
 	}
-	memcpy(data, pkt_buf.data, sizeof(pkt_buf.data));
+	memcpy(data, pkt_buf.data, *pld_len);
 	printd("xmodem_read_pkt(): pkt: received correctly\n");
 
 	return SOH;
 }
 
+/* Discard incoming bytes until the sender stops sending. */
+void xmodem_purge(void)
+{
+	uint8_t ch;
+
+	do {
+		/*
+		 * Loop until we timeout (the deadline is restarted for every
+		 * byte, so that we wait for the line to become silent).
+		 *
+		 * NOTE: a special small timeout value should actually be used;
+		 * however, we do not do that in the target for footprint
+		 * minimization purposes.
+		 *
+		 * IMPORTANT: This choice forces the target to use a timeout
+		 * value smaller than the one used by the host, otherwise we
+		 * may end up in a communication loop if for some reason both
+		 * the target and the host enters reception mode (because both
+		 * will send and discard NAKs).
+		 */
+		xmodem_io_set_deadline(XMODEM_IO_TIMEOUT_MS);
+	} while (xmodem_io_getc(&ch) >= 0);
+}
+
 /*
  * Receive data using XMODEM.
  *
  * The device starts sending 'C' (i.e., NAKs) to let the sender know that it is
  * ready for reception. When the sender replies the communication starts.
  */
-int xmodem_receive_package(uint8_t *buf, size_t buf_len)
+int xmodem_receive_package(uint8_t *buf, size_t buf_len, int start_tries)
 {
 	int status;
 	uint8_t exp_seq_no;
@@ -334,6 +312,7 @@ int xmodem_receive_package(uint8_t *buf, size_t buf_len)
 	int retv;
 	int data_cnt;
 	int err_cnt;
+	size_t pld_len;
 
 	/* XMODEM sequence number starts from 1 */
 	exp_seq_no = 1;
@@ -349,18 +328,20 @@ int xmodem_receive_package(uint8_t *buf, size_t buf_len)
 	err_cnt = 0;
 	data_cnt = 0;
 	retv = -1;
-	while (err_cnt < MAX_RX_ERRORS) {
+	/* Until the transmission is started, give up after start_tries. */
+	while (err_cnt < ((nak == 'C') ? start_tries : MAX_RX_ERRORS)) {
 		printd("xmodem_receive(): sending cmd: %x\n", cmd);
 		/* Send control byte (ACK, CAN, NAK, 'C'). */
 		xmodem_io_putc(&cmd);
 		/* Wait for incoming packet. */
-		status = xmodem_read_pkt(exp_seq_no, &buf[data_cnt], buf_len);
+		status = xmodem_read_pkt(exp_seq_no, &buf[data_cnt], buf_len,
+					 &pld_len);
 		switch (status) {
 		case SOH:
 			/* Packet successfully received. */
 			nak = NAK;
-			data_cnt += sizeof(pkt_buf.data);
-			buf_len -= sizeof(pkt_buf.data);
+			data_cnt += pld_len;
+			buf_len -= pld_len;
 			exp_seq_no++;
 			err_cnt = 0;
 		/* no 'break' on purpose */
@@ -404,23 +385,61 @@ exit:
 	return retv;
 }
 
+/* Send data packets, after the receiver has started the transmission. */
+int xmodem_send_data(const uint8_t *data, size_t len, size_t max_pld_len,
+		     bool stream)
+{
+	size_t mlen;
+	size_t pld_len;
+	uint8_t pkt_no;
+
+	printd("xmodem_send_data(): starting transmission\n");
+	pkt_no = 1;
+	/* Send packets as long as there is data to send. */
+	while (len) {
+		/*
+		 * Use a 1K packet only if it can be completely filled, so
+		 * that no more padding than plain XMODEM is added.
+		 */
+		pld_len = (len >= max_pld_len) ? max_pld_len : XMODEM_BLOCK_SIZE;
+		/* Packet length must be <= pld_len bytes. */
+		mlen = (len >= pld_len) ? pld_len : len;
+		if (stream) {
+			/* In streaming mode, packets are not acknowledged. */
+			xmodem_send_pkt(data, mlen, pld_len, pkt_no);
+		} else if (xmodem_send_pkt_with_retry(data, mlen, pld_len,
+						      pkt_no) < 0) {
+			return -1;
+		}
+		data += mlen;
+		len -= mlen;
+		pkt_no++;
+	}
+	/* Send End-of-Transmission constrol byte. */
+	if (xmodem_send_byte_with_retry(EOT) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * Send data using XMODEM.
  *
  * The device waits for the receiver to send the first NAK ('C') and then
- * starts the transmission (sending the data in 128-byte packets).
+ * starts the transmission (sending the data in 128-byte packets). If the
+ * receiver sends a 'K' instead of a 'C', 1024-byte packets are used as long as
+ * there are at least 1024 bytes left to send.
  */
 int xmodem_transmit_package(const uint8_t *data, size_t len)
 {
-	int mlen;
 	uint8_t retransmit;
 	uint8_t rsp;
-	uint8_t pkt_no;
 
 	retransmit = MAX_RETRANSMIT;
 
 	/*
-	 * Wait for the first 'C' from the receiver and then jump to
+	 * Wait for the first 'C' from the receiver and then start the
 	 * transmission; return error if no 'C' is received after
 	 * MAX_RETRANSMIT attempts.
 	 */
@@ -428,33 +447,19 @@ int xmodem_transmit_package(const uint8_t *data, size_t len)
 		printd("xmodem_transmit(): waiting for 'C' (%d)\n", retransmit);
 		rsp = ERR;
 		/* If getc() timeouts rsp value is not changed. */
+		xmodem_io_set_deadline(XMODEM_IO_TIMEOUT_MS);
 		xmodem_io_getc(&rsp);
 		if (rsp == 'C') {
-			goto start_transmit;
+			return xmodem_send_data(data, len, XMODEM_BLOCK_SIZE,
+						false);
 		}
-	}
-
-	return -1;
-
-start_transmit:
-	printd("xmodem_transmit(): starting transmission\n");
-	pkt_no = 1;
-	/* Send packets as long as there is data to send. */
-	while (len) {
-		/* Packet length must be <= 128 bytes. */
-		mlen =
-		    (len >= sizeof(pkt_buf.data)) ? sizeof(pkt_buf.data) : len;
-		if (xmodem_send_pkt_with_retry(data, mlen, pkt_no) < 0) {
-			return -1;
+#if (FM_CONFIG_XMODEM_1K)
+		if (rsp == NAK_1K) {
+			return xmodem_send_data(data, len,
+						XMODEM_1K_BLOCK_SIZE, false);
 		}
-		data += mlen;
-		len -= mlen;
-		pkt_no++;
-	}
-	/* Send End-of-Transmission constrol byte. */
-	if (xmodem_send_byte_with_retry(EOT) < 0) {
-		return -1;
+#endif
 	}
 
-	return 0;
+	return -1;
 }
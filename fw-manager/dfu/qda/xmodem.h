@@ -32,8 +32,22 @@
 
 #include <stdint.h>
 
+#include "fw-manager_config.h"
+
 /** XMODEM block size */
 #define XMODEM_BLOCK_SIZE (128)
+/** XMODEM-1K block size */
+#define XMODEM_1K_BLOCK_SIZE (1024)
+
+/** The biggest XMODEM block size supported by the current configuration. */
+#if (FM_CONFIG_XMODEM_1K)
+#define XMODEM_MAX_BLOCK_SIZE (XMODEM_1K_BLOCK_SIZE)
+#else
+#define XMODEM_MAX_BLOCK_SIZE (XMODEM_BLOCK_SIZE)
+#endif
+
+/** The number of start requests a receiver normally sends before giving up. */
+#define XMODEM_START_TRIES (5)
 
 /**
  * @defgroup groupXMODEM XMODEM
@@ -47,19 +61,27 @@
  * to the sender and waits for incoming transmissions. Received data is copied
  * into the provided buffer.
  *
- * This function is blocking, but timeouts after 5 retries (5 'C' are sent
- * without a successful reply).
+ * This function is blocking, but timeouts after start_tries retries (i.e.,
+ * start_tries 'C' are sent without the sender starting the transmission) or,
+ * once the transmission is started, after 5 consecutive reception errors.
+ *
+ * Both 128-byte (SOH) and, if FM_CONFIG_XMODEM_1K is enabled, 1024-byte (STX)
+ * frames are accepted, so senders not supporting XMODEM-1K keep working.
  *
  * @param[out] buf Buffer where to store the received data. Must not be null.
  * @param[in]  buf_size The size of the buffer.
+ * @param[in]  start_tries The number of 'C' to send before giving up if the
+ *			   sender does not start the transmission (usually
+ *			   XMODEM_START_TRIES). Must be at least 1.
  *
  * @return Number of received bytes or negative error code. Note that XMODEM
- *         may add up to 127 padding bytes at the end of the real data.
+ *         may add up to XMODEM_MAX_BLOCK_SIZE - 1 padding bytes at the end
+ *         of the real data.
  * @retval >0 Number of received bytes (including padding).
  * @retval -1 Error (either the reception failed for an unrecoverable protocol
  * 	      error or the provided buffer is too small)
  */
-int xmodem_receive_package(uint8_t *buf, size_t buf_size);
+int xmodem_receive_package(uint8_t *buf, size_t buf_size, int start_tries);
 
 /**
  * Send data using XMODEM.
@@ -69,6 +91,11 @@ int xmodem_receive_package(uint8_t *buf, size_t buf_size);
  * (padding) data is added to the last frame if the data size is not multiple
  * of 128 bytes.
  *
+ * If FM_CONFIG_XMODEM_1K is enabled and the receiver starts the transfer with
+ * a 'K' instead of a 'C', data is sent in 1024-byte (STX) frames for as long
+ * as at least 1024 bytes are left; the remainder is sent in 128-byte frames,
+ * so that the amount of padding is the same as in plain XMODEM-CRC.
+ *
  * This function is blocking, but timeouts after a certain amount of retries.
  *
  * @param[in] data The data to send. Must not be null.
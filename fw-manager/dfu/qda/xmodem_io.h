@@ -30,6 +30,7 @@
 #ifndef __XMODEM_IO_H__
 #define __XMODEM_IO_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -41,12 +42,27 @@
  * @{
  */
 
+/** The default timeout (in ms) used by the XMODEM I/O layer. */
+#define XMODEM_IO_TIMEOUT_MS (2000)
+
+/*
+ * Start a new reception deadline.
+ *
+ * xmodem_io_getc() and xmodem_io_read() fail once the deadline expires: a
+ * single deadline can therefore cover several reads (e.g., the header and the
+ * body of a packet). Any previous deadline is canceled.
+ *
+ * @param[in] timeout_ms The time (in milliseconds) from now to the deadline.
+ */
+void xmodem_io_set_deadline(uint32_t timeout_ms);
+
 /*
  * Get a character from the XMODEM I/O layer.
  *
- * This function must be blocking, but is also expected to timeout after a
- * certain amount of time. Moreover, in case of error, the function must not
- * set the output parameter (i.e., the pointed variable must remain unchanged).
+ * This function is blocking, until a character is received or the current
+ * deadline (see xmodem_io_set_deadline()) expires. Moreover, in case of error,
+ * the function must not set the output parameter (i.e., the pointed variable
+ * must remain unchanged).
  *
  * @param[out] ch A pointer to the variable where to store the read character.
  * 		  In case of error, the current value of the pointed variable
@@ -58,6 +74,23 @@
  */
 int xmodem_io_getc(uint8_t *ch);
 
+/*
+ * Read a buffer from the XMODEM I/O layer.
+ *
+ * This function blocks until the requested amount of bytes is received or the
+ * current deadline (see xmodem_io_set_deadline()) expires.
+ *
+ * @param[out] buf The buffer where to store the read bytes. Must not be null.
+ * @param[in]  len The number of bytes to read.
+ *
+ * @return Number of read bytes (i.e., len) on success, negative error code
+ *	   otherwise. In case of error, the content of the buffer is
+ *	   undefined.
+ * @retval -ETIME in case of timeout.
+ * @retval -EIO   in case of I/O error (e.g., data lost due to an overrun).
+ */
+int xmodem_io_read(uint8_t *buf, size_t len);
+
 /*
  * Pass a character to the XMODEM I/O layer.
  *
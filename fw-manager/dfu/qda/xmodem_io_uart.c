@@ -28,6 +28,7 @@
  */
 
 #include <errno.h>
+#include <stdbool.h>
 
 #include "qm_isr.h"
 #include "qm_pinmux.h"
@@ -37,42 +38,97 @@
 #include "qm_uart.h"
 #include "clk.h"
 
+#include "xmodem.h"
 #include "xmodem_io.h"
 #include "xmodem_io_uart.h"
+#include "../dfu.h"
 #include "../../fw-manager_comm.h"
 
 #define PIC_TIMER_ALARM_SECOND (0x2000000)
-#define XMODEM_UART_TIMEOUT_S (2)
+#define PIC_TIMER_ALARM_MS (PIC_TIMER_ALARM_SECOND / 1000)
+
+/*
+ * The size of the RX ring buffer; must be a power of 2.
+ *
+ * When QFU pipelined programming is enabled, the buffer must be able to hold
+ * the data received while a QFU block is programmed by the idle handler. In
+ * streaming mode, the host sends a whole QDA packet (DFU_MAX_BLOCK_SIZE plus
+ * one XMODEM block of QDA overhead, framed in XMODEM packets, and the final
+ * EOT) without waiting for any ACK, so that all of it may arrive during a
+ * single background slice: the buffer size is the smallest power of 2 holding
+ * such a packet (16 kB on Quark SE).
+ *
+ * Otherwise, the idle handler does no work and the buffer only has to cover
+ * the latency of the main loop between two reads.
+ */
+#if (FM_CONFIG_QFU_PIPELINE)
+/* XMODEM framing: header, block number and its complement, CRC. */
+#define RX_PKT_FRAMING (5)
+/* The XMODEM packets of a QDA packet. */
+#define RX_QDA_XMODEM_PKTS (DFU_MAX_BLOCK_SIZE / XMODEM_MAX_BLOCK_SIZE + 1)
+#define RX_QDA_PKT_SIZE                                                        \
+	(RX_QDA_XMODEM_PKTS * (XMODEM_MAX_BLOCK_SIZE + RX_PKT_FRAMING) + 1)
+#if (RX_QDA_PKT_SIZE <= 2048)
+#define RX_BUF_SIZE (2048)
+#elif(RX_QDA_PKT_SIZE <= 4096)
+#define RX_BUF_SIZE (4096)
+#elif(RX_QDA_PKT_SIZE <= 8192)
+#define RX_BUF_SIZE (8192)
+#elif(RX_QDA_PKT_SIZE <= 16384)
+#define RX_BUF_SIZE (16384)
+#elif(RX_QDA_PKT_SIZE <= 32768)
+#define RX_BUF_SIZE (32768)
+#else
+#error "QDA packets too big for the RX ring buffer"
+#endif
+#else
+#define RX_BUF_SIZE (256)
+#endif
+#define RX_BUF_MASK (RX_BUF_SIZE - 1)
+
+/* Maximum baud rate error (in percent). */
+#define BAUD_MAX_ERROR_PCT (2)
+
+/* UART line status errors. */
+#define UART_LSR_ERROR_BITS                                                    \
+	(QM_UART_LSR_OE | QM_UART_LSR_PE | QM_UART_LSR_FE | QM_UART_LSR_BI)
 
 /*-------------------------------------------------------------------------*/
 /*                          FORWARD DECLARATIONS                           */
 /*-------------------------------------------------------------------------*/
-static void uart_callback(void *data, int error, qm_uart_status_t status,
-			  uint32_t len);
 static void pic_timer_callback(void *data);
 
 /*-------------------------------------------------------------------------*/
 /*                            GLOBAL VARIABLES                             */
 /*-------------------------------------------------------------------------*/
 
-/** The variable where UART isr stores the read byte (see uart_transfer var). */
-static uint8_t in_byte;
+/**
+ * The RX ring buffer.
+ *
+ * The UART ISR is the only producer (and the only one updating rx_head),
+ * while xmodem_io_read() is the only consumer (and the only one updating
+ * rx_tail). The buffer is full when rx_head is just before rx_tail.
+ */
+static uint8_t rx_buf[RX_BUF_SIZE];
+static volatile uint16_t rx_head;
+static volatile uint16_t rx_tail;
+
+/** Set by the UART ISR on line errors or RX buffer overruns. */
+static volatile bool rx_error;
+
+/** Set by the PIC timer callback when the current read timeouts. */
+static volatile bool rx_timeout;
+
+/** The handler called while waiting for incoming data. */
+static void (*rx_idle_cb)(void);
 
 /** The XMODEM UART configuration. */
-static const qm_uart_config_t uart_config = {
+static qm_uart_config_t uart_config = {
     .baud_divisor = FM_CONFIG_UART_BAUD_DIV,
     .line_control = QM_UART_LC_8N1,
     .hw_fc = false,
 };
 
-/** The XMODEM UART transfer configuration. */
-static const qm_uart_transfer_t uart_transfer = {
-    .data = &in_byte,
-    .data_len = 1,
-    .callback = uart_callback,
-    .callback_data = NULL,
-};
-
 /** The XMODEM PIC Timer configuration. */
 static const qm_pic_timer_config_t pic_timer_cfg = {
     .mode = QM_PIC_TIMER_MODE_ONE_SHOT,
@@ -81,37 +137,50 @@ static const qm_pic_timer_config_t pic_timer_cfg = {
     .callback_data = NULL,
 };
 
-/** The XMODEM RX state enum. */
-static volatile enum rx_state {
-	STATE_UART_ERROR = -EIO,
-	STATE_TIMEOUT = -ETIME,
-	STATE_UART_RX_DONE = 1,
-	STATE_WAITING = 2,
-} xmodem_io_rx_state;
-
 /*-------------------------------------------------------------------------*/
 /*                             CALLBACKS                                   */
 /*-------------------------------------------------------------------------*/
 
-static void uart_callback(void *data, int error, qm_uart_status_t status,
-			  uint32_t len)
+/*
+ * The UART ISR.
+ *
+ * Move all the received bytes from the UART FIFO to the RX ring buffer. The
+ * RX interrupt is always enabled, so that no data is lost between two calls
+ * to xmodem_io_read().
+ */
+static QM_ISR_DECLARE(xmodem_io_uart_isr)
 {
-	(void)data;
-	(void)status;
-	(void)len;
+	qm_uart_reg_t *const regs = QM_UART[FM_CONFIG_UART];
+	uint32_t lsr;
+	uint16_t next;
 
-	if (error < 0) {
-		xmodem_io_rx_state = STATE_UART_ERROR;
-	} else {
-		xmodem_io_rx_state = STATE_UART_RX_DONE;
+	/* Reading LSR clears the line status interrupt. */
+	while (lsr = regs->lsr, lsr & (QM_UART_LSR_DR | UART_LSR_ERROR_BITS)) {
+		if (lsr & UART_LSR_ERROR_BITS) {
+			rx_error = true;
+		}
+		if (!(lsr & QM_UART_LSR_DR)) {
+			continue;
+		}
+		next = (rx_head + 1) & RX_BUF_MASK;
+		if (next == rx_tail) {
+			/* Buffer full: drop the byte. */
+			(void)regs->rbr_thr_dll;
+			rx_error = true;
+			continue;
+		}
+		rx_buf[rx_head] = regs->rbr_thr_dll;
+		rx_head = next;
 	}
+
+	QM_ISR_EOI(FM_COMM_UART_IRQ_VECTOR);
 }
 
 static void pic_timer_callback(void *data)
 {
 	(void)data;
 
-	xmodem_io_rx_state = STATE_TIMEOUT;
+	rx_timeout = true;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -123,45 +192,134 @@ int xmodem_io_putc(const uint8_t *ch)
 	return qm_uart_write(FM_CONFIG_UART, *ch);
 }
 
-/* Receive one byte. */
-int xmodem_io_getc(uint8_t *ch)
+/* Start a new reception deadline. */
+void xmodem_io_set_deadline(uint32_t timeout_ms)
 {
-	enum rx_state retv;
-
-	/* Set up timeout timer. */
+	/*
+	 * The flag is reset after (re)starting the timer, so that a pending
+	 * expiration of a previous deadline is ignored. The one-shot timer is
+	 * left running after the reads: its expiration only sets the flag.
+	 */
 	qm_pic_timer_set_config(&pic_timer_cfg);
-	qm_pic_timer_set(PIC_TIMER_ALARM_SECOND * XMODEM_UART_TIMEOUT_S);
+	qm_pic_timer_set(PIC_TIMER_ALARM_MS * timeout_ms);
+	rx_timeout = false;
+}
 
-	/* Resetting the state and read byte. */
-	xmodem_io_rx_state = STATE_WAITING;
-	qm_uart_irq_read(FM_CONFIG_UART, &uart_transfer);
+/* Receive a buffer, against the current deadline. */
+int xmodem_io_read(uint8_t *buf, size_t len)
+{
+	size_t cnt;
+	uint16_t tail;
+	int retv;
 
-	/* Wait for UART interruption or PIC Timer timeout callback. */
-	while (retv = xmodem_io_rx_state, retv == STATE_WAITING) {
-		; /* Busy wait until one of the callbacks is called. */
+	cnt = 0;
+	tail = rx_tail;
+	retv = len;
+	while (cnt < len) {
+		if (tail != rx_head) {
+			buf[cnt++] = rx_buf[tail];
+			tail = (tail + 1) & RX_BUF_MASK;
+			/* Free the slot as soon as possible. */
+			rx_tail = tail;
+			continue;
+		}
+		if (rx_error) {
+			rx_error = false;
+			retv = -EIO;
+			break;
+		}
+		if (rx_timeout) {
+			retv = -ETIME;
+			break;
+		}
+		if (rx_idle_cb) {
+			rx_idle_cb();
+		}
 	}
-	switch (retv) {
-	case STATE_TIMEOUT:
-		qm_uart_irq_read_terminate(FM_CONFIG_UART);
-		break;
-	case STATE_UART_RX_DONE:
+
+	return retv;
+}
+
+/* Receive one byte, against the current deadline. */
+int xmodem_io_getc(uint8_t *ch)
+{
+	uint8_t in_byte;
+	int retv;
+
+	retv = xmodem_io_read(&in_byte, 1);
+	if (retv > 0) {
 		/* Got byte. */
 		*ch = in_byte;
-		break;
-	default:
-		/*
-		 * Handle STATE_UART_ERROR case which can happen on UART read
-		 * error, and STATE_WAITING which is an impossible case.
-		 */
-		break;
 	}
 
 	return retv;
 }
 
+/*-------------------------------------------------------------------------*/
+/*                           STATIC FUNCTIONS                              */
+/*-------------------------------------------------------------------------*/
+/* Apply the UART configuration and (re-)enable RX interrupts. */
+static void xmodem_io_uart_config(void)
+{
+	/* Mask RX interrupts, so that the ISR cannot race the ring reset. */
+	QM_UART[FM_CONFIG_UART]->ier_dlh &=
+	    ~(QM_UART_IER_ERBFI | QM_UART_IER_ELSI);
+
+	qm_uart_set_config(FM_CONFIG_UART, &uart_config);
+
+	rx_head = 0;
+	rx_tail = 0;
+	rx_error = false;
+
+	QM_UART[FM_CONFIG_UART]->ier_dlh |= QM_UART_IER_ERBFI | QM_UART_IER_ELSI;
+}
+
 /*-------------------------------------------------------------------------*/
 /*                           GLOBAL FUNCTIONS                              */
 /*-------------------------------------------------------------------------*/
+int xmodem_io_uart_get_baud_div(uint32_t baud_rate, uint32_t *div)
+{
+	uint32_t div16;
+	uint32_t actual;
+	uint32_t error;
+
+	if (baud_rate == 0 || baud_rate > FM_CONFIG_UART_MAX_BAUD) {
+		return -EINVAL;
+	}
+	/*
+	 * The UART baud rate is clk / (16 * div), where div has a 4-bit
+	 * fractional part (DLF). Compute div * 16, rounded to the nearest
+	 * integer.
+	 */
+	div16 = (FM_CONFIG_UART_CLK_HZ + (baud_rate / 2)) / baud_rate;
+	if (div16 < 16) {
+		return -EINVAL;
+	}
+	actual = FM_CONFIG_UART_CLK_HZ / div16;
+	error = (actual > baud_rate) ? actual - baud_rate : baud_rate - actual;
+	if (error > (baud_rate / 100) * BAUD_MAX_ERROR_PCT) {
+		return -EINVAL;
+	}
+	*div = QM_UART_CFG_BAUD_DL_PACK((div16 >> 12) & 0xFF,
+					(div16 >> 4) & 0xFF, div16 & 0xF);
+
+	return 0;
+}
+
+void xmodem_io_uart_set_baud_div(uint32_t div)
+{
+	/* Wait for the transmission of pending data to complete. */
+	while (!(QM_UART[FM_CONFIG_UART]->lsr & QM_UART_LSR_TEMT)) {
+	}
+	uart_config.baud_divisor = div;
+	xmodem_io_uart_config();
+}
+
+void xmodem_io_uart_set_idle_cb(void (*idle_cb)(void))
+{
+	rx_idle_cb = idle_cb;
+}
+
 void xmodem_io_uart_init(void)
 {
 	/* Pin-muxing for UART_x. */
@@ -172,11 +330,12 @@ void xmodem_io_uart_init(void)
 	/* Enable UART clocks. */
 	clk_periph_enable(FM_COMM_UART_CLK | CLK_PERIPH_CLK);
 
-	/* Setup UART. */
-	qm_uart_set_config(FM_CONFIG_UART, &uart_config);
-
 	/* Request IRQ for UART. */
-	fm_comm_irq_request();
+	fm_comm_irq_request(xmodem_io_uart_isr);
+
+	/* Setup UART with the default baud rate and enable RX interrupts. */
+	uart_config.baud_divisor = FM_CONFIG_UART_BAUD_DIV;
+	xmodem_io_uart_config();
 
 #if (HAS_APIC)
 	/* Request interrupts for PIC Timer. */
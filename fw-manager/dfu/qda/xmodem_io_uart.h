@@ -30,9 +30,50 @@
 #ifndef __XMODEM_IO_UART_H__
 #define __XMODEM_IO_UART_H__
 
+#include <stdint.h>
+
 /**
  * Initialize the XMODEM I/O UART layer.
+ *
+ * The UART is configured with the default baud rate (FM_CONFIG_UART_BAUD_DIV).
  */
 void xmodem_io_uart_init(void);
 
+/**
+ * Compute the UART baud divisor for a given baud rate.
+ *
+ * @param[in]  baud_rate The desired baud rate.
+ * @param[out] div       The resulting baud divisor (as expected by
+ *			 qm_uart_config_t). Must not be null.
+ *
+ * @return 0 on success, negative error code otherwise.
+ * @retval -EINVAL The baud rate is not supported (i.e., it is higher than
+ *		   FM_CONFIG_UART_MAX_BAUD or cannot be generated with an error
+ *		   lower than 2%).
+ */
+int xmodem_io_uart_get_baud_div(uint32_t baud_rate, uint32_t *div);
+
+/**
+ * Reconfigure the UART with a new baud divisor.
+ *
+ * The function waits for the pending transmission to complete before
+ * reconfiguring the UART. Any pending received data is discarded.
+ *
+ * @param[in] div The new baud divisor.
+ */
+void xmodem_io_uart_set_baud_div(uint32_t div);
+
+/**
+ * Set the idle handler.
+ *
+ * The idle handler is called repeatedly while the I/O layer is waiting for
+ * incoming data. It can be used to perform background work (e.g., flash
+ * programming) overlapping with data reception. The handler is expected to
+ * return quickly: while it runs, incoming data is buffered in the RX ring
+ * buffer.
+ *
+ * @param[in] idle_cb The idle handler, or null to disable it.
+ */
+void xmodem_io_uart_set_idle_cb(void (*idle_cb)(void));
+
 #endif /* __XMODEM_IO_UART_H__ */
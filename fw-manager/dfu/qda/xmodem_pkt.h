@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __XMODEM_PKT_H__
+#define __XMODEM_PKT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * XMODEM packet layer.
+ *
+ * Internal interface shared by the XMODEM transfer modes (i.e., the standard
+ * stop-and-wait mode and the streaming mode).
+ *
+ * @defgroup groupXMODEM_PKT XMODEM packet layer
+ * @{
+ */
+
+/* The maximum number of times XMODEM tries to send a packet / control byte */
+#define MAX_RETRANSMIT (8)
+/* The maximum number of consecutive RX errors XMODEM tolerates */
+#define MAX_RX_ERRORS (5)
+
+/* Custom value, not transferred via XMODEM, but used as return codes */
+#define ERR (0xFF)
+#define DUP (0xFE)
+
+/* XMODEM control bytes */
+#define SOH (0x01)
+#define STX (0x02)
+#define EOT (0x04)
+#define ACK (0x06)
+#define NAK (0x15)
+#define CAN (0x18)
+
+/* Receiver request for XMODEM-1K transmission (sent instead of 'C'). */
+#define NAK_1K ('K')
+/* Receiver request for streaming transmission (sent instead of 'C'). */
+#define NAK_STREAM ('G')
+
+/**
+ * Send a single XMODEM packet.
+ *
+ * @param[in] data     The payload of the packet. Must not be null.
+ * @param[in] data_len The length of the payload. Must be at most pld_len
+ *		       bytes. If less, (random) padding is automatically added.
+ * @param[in] pld_len  The payload size of the packet: either
+ *		       XMODEM_BLOCK_SIZE (SOH packet) or XMODEM_1K_BLOCK_SIZE
+ *		       (STX packet).
+ * @param[in] pkt_no   The desired packet sequence number.
+ *
+ * @return Resulting status code.
+ * @retval 0 Success (only possible retval for now).
+ */
+int xmodem_send_pkt(const uint8_t *data, size_t data_len, size_t pld_len,
+		    uint8_t pkt_no);
+
+/**
+ * Try to send a byte for MAX_RETRANSMIT times.
+ *
+ * This function sends a byte (typically an XMODEM control byte) and checks if
+ * an ACK is received. If no ACK is received, the byte is retransmitted. This is
+ * done until 'MAX_RETRANSMIT' is exceeded.
+ *
+ * @param[in] cmd The byte to send.
+ *
+ * @return Exit status.
+ * @retval 0  Success, the byte has been transmitted and an ACK received.
+ * @retval -1 Error, retransmit count exceeded.
+ */
+int xmodem_send_byte_with_retry(uint8_t cmd);
+
+/**
+ * Receive an XMODEM packet.
+ *
+ * @param[in] exp_seq_no The expected sequence number of the packet to be
+ * 			 received.
+ * @param[in] data       The buffer where to store the packet payload. Must not
+ *			 be null.
+ * @param[in] len        The size of the buffer.
+ * @param[out] pld_len   The size of the received payload (XMODEM_BLOCK_SIZE
+ *			 or XMODEM_1K_BLOCK_SIZE); only valid if SOH is
+ *			 returned.
+ *
+ * @return Status code.
+ * @retval SOH The packet (either a SOH or a STX one) has been successful
+ *	       received.
+ * @retval DUP The received packet is a duplicate of the previous one (based on
+ *             the expected sequence number); nothing has been written to the
+ *             data buffer.
+ * @retval ERR An error has occurred (either a timeout or the reception of
+ * 	       invalid / corrupted data), but the XMODEM session is not
+ *	       compromised.
+ * @retval CAN An unrecoverable error has occurred (either the sender and
+ *	       receiver have lost sync or the passed buffer is too small).
+ * @retval EOT The sender notified the end of transmission (i.e., there are no
+ *	       more packets to receive).
+ */
+int xmodem_read_pkt(uint8_t exp_seq_no, uint8_t *data, size_t len,
+		    size_t *pld_len);
+
+/**
+ * Send data packets, after the receiver has started the transmission.
+ *
+ * Data is split into packets (using 1024-byte packets, if allowed by
+ * max_pld_len, as long as at least 1024 bytes are left) and an EOT is sent at
+ * the end of the transmission.
+ *
+ * @param[in] data        The data to send. Must not be null.
+ * @param[in] len         The length of the data.
+ * @param[in] max_pld_len The maximum payload size to be used
+ *			  (XMODEM_BLOCK_SIZE or XMODEM_1K_BLOCK_SIZE).
+ * @param[in] stream      Whether packets must be sent back-to-back (streaming
+ *			  mode) or each packet must be acknowledged before
+ *			  sending the next one.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int xmodem_send_data(const uint8_t *data, size_t len, size_t max_pld_len,
+		     bool stream);
+
+/**
+ * Discard incoming bytes until the sender stops sending.
+ *
+ * I.e., read (and discard) bytes until the XMODEM I/O layer timeouts.
+ */
+void xmodem_purge(void);
+
+/**
+ * @}
+ */
+
+#endif /* __XMODEM_PKT_H__ */
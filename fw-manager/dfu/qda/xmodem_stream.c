@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "xmodem.h"
+#include "xmodem_io.h"
+#include "xmodem_pkt.h"
+#include "xmodem_stream.h"
+
+/* Activate debug messages by defining DEBUG_MSG to 1 */
+#define DEBUG_MSG (0)
+
+#if DEBUG_MSG
+#define printd(...) QM_PRINTF(__VA_ARGS__)
+#else
+#define printd(...)
+#endif
+
+/*
+ * Cancel the current streaming transfer.
+ *
+ * The sender does not wait for ACKs, so it may still be sending: discard
+ * incoming data until the line is idle and then notify the cancellation.
+ */
+static void xmodem_stream_cancel(void)
+{
+	uint8_t cmd = CAN;
+
+	xmodem_purge();
+	/* As per YMODEM-G, two CANs are sent. */
+	xmodem_io_putc(&cmd);
+	xmodem_io_putc(&cmd);
+}
+
+/*
+ * Receive data using XMODEM streaming mode.
+ *
+ * The device sends 'G' until the sender starts the transmission. After that,
+ * packets are received back-to-back and only the final EOT is acknowledged.
+ */
+int xmodem_stream_receive_package(uint8_t *buf, size_t buf_len,
+				  int start_tries)
+{
+	int status;
+	uint8_t exp_seq_no;
+	uint8_t cmd;
+	int data_cnt;
+	int err_cnt;
+	size_t pld_len;
+
+	/* XMODEM sequence number starts from 1 */
+	exp_seq_no = 1;
+	data_cnt = 0;
+
+	/* Send 'G' until the first packet (or an EOT) is received. */
+	cmd = NAK_STREAM;
+	for (err_cnt = 0; err_cnt < start_tries; err_cnt++) {
+		printd("xmodem_stream_receive(): sending 'G'\n");
+		xmodem_io_putc(&cmd);
+		status = xmodem_read_pkt(exp_seq_no, buf, buf_len, &pld_len);
+		if (status != ERR) {
+			break;
+		}
+	}
+	if (status == ERR) {
+		/* The sender never started the transmission. */
+		return -1;
+	}
+
+	/* Receive packets back-to-back; no ACK is sent for them. */
+	while (status == SOH) {
+		data_cnt += pld_len;
+		buf_len -= pld_len;
+		exp_seq_no++;
+		status = xmodem_read_pkt(exp_seq_no, &buf[data_cnt], buf_len,
+					 &pld_len);
+	}
+
+	if (status != EOT) {
+		/*
+		 * Any error (timeout, corrupted or out-of-sequence packet, or
+		 * out of buffer space) is fatal in streaming mode.
+		 */
+		printd("xmodem_stream_receive(): ERROR: reception failed\n");
+		xmodem_stream_cancel();
+		return -1;
+	}
+	/* Acknowledge EOT. */
+	cmd = ACK;
+	xmodem_io_putc(&cmd);
+
+	return data_cnt;
+}
+
+/*
+ * Send data using XMODEM streaming mode.
+ *
+ * The device waits for the receiver to send the first 'G' and then sends all
+ * the packets back-to-back. If a 'C' or a 'K' is received instead, the
+ * standard (stop-and-wait) XMODEM mode is used.
+ */
+int xmodem_stream_transmit_package(const uint8_t *data, size_t len)
+{
+	uint8_t retransmit;
+	uint8_t rsp;
+
+	retransmit = MAX_RETRANSMIT;
+
+	while (retransmit--) {
+		printd("xmodem_stream_transmit(): waiting for 'G' (%d)\n",
+		       retransmit);
+		rsp = ERR;
+		/* If getc() timeouts rsp value is not changed. */
+		xmodem_io_set_deadline(XMODEM_IO_TIMEOUT_MS);
+		xmodem_io_getc(&rsp);
+		switch (rsp) {
+		case NAK_STREAM:
+			return xmodem_send_data(data, len,
+						XMODEM_MAX_BLOCK_SIZE, true);
+		case 'C':
+			return xmodem_send_data(data, len, XMODEM_BLOCK_SIZE,
+						false);
+#if (FM_CONFIG_XMODEM_1K)
+		case NAK_1K:
+			return xmodem_send_data(data, len,
+						XMODEM_1K_BLOCK_SIZE, false);
+#endif
+		default:
+			break;
+		}
+	}
+
+	return -1;
+}
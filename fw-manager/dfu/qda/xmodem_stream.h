@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __XMODEM_STREAM_H__
+#define __XMODEM_STREAM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * XMODEM streaming mode.
+ *
+ * A streaming variant of XMODEM-CRC, in the spirit of YMODEM-G: the receiver
+ * starts the transfer by sending a 'G' (instead of a 'C') and the sender then
+ * transmits all the packets back-to-back, without waiting for a per-packet
+ * ACK. Only the final EOT is acknowledged.
+ *
+ * The streaming mode relies on an error-free link: packets are still
+ * protected by a CRC, but there is no retransmission; any error causes the
+ * transfer to be canceled (the receiver sends CAN) and the upper layer must
+ * retry the whole transfer.
+ *
+ * Packet framing is the same as the one of the standard XMODEM mode
+ * (including the XMODEM-1K extension, if enabled).
+ *
+ * @defgroup groupXMODEM_STREAM XMODEM streaming mode
+ * @{
+ */
+
+/**
+ * Receive data using XMODEM streaming mode.
+ *
+ * Send 'G' messages until the sender starts the transmission, then receive
+ * packets back-to-back. Received data is copied into the provided buffer.
+ *
+ * This function is blocking, but timeouts after start_tries retries
+ * (start_tries 'G' are sent without a successful reply).
+ *
+ * @param[out] buf Buffer where to store the received data. Must not be null.
+ * @param[in]  buf_size The size of the buffer.
+ * @param[in]  start_tries The number of 'G' to send before giving up if the
+ *			   sender does not start the transmission (usually
+ *			   XMODEM_START_TRIES). Must be at least 1.
+ *
+ * @return Number of received bytes or negative error code. Note that XMODEM
+ *         may add up to XMODEM_MAX_BLOCK_SIZE - 1 padding bytes at the end
+ *         of the real data.
+ * @retval >0 Number of received bytes (including padding).
+ * @retval -1 Error (any reception error, the transfer has been canceled).
+ */
+int xmodem_stream_receive_package(uint8_t *buf, size_t buf_size,
+				  int start_tries);
+
+/**
+ * Send data using XMODEM streaming mode.
+ *
+ * Wait for the 'G' message from the receiver, then send all the packets
+ * without waiting for ACKs. If the receiver sends a 'C' or a 'K' instead, fall
+ * back to the standard (stop-and-wait) XMODEM mode.
+ *
+ * @param[in] data The data to send. Must not be null.
+ * @param[in] len  The length of the data.
+ *
+ * @return 0 on success, negative error code otherwise.
+ * @retval 0 Success.
+ * @retval -1 Error (timeout, transfer canceled, or number of retries
+ *	      exceeded).
+ */
+int xmodem_stream_transmit_package(const uint8_t *data, size_t len);
+
+/**
+ * @}
+ */
+
+#endif /* __XMODEM_STREAM_H__ */
@@ -100,12 +100,12 @@
 #define LOW_BYTE(x) ((x)&0xFF)
 #define HIGH_BYTE(x) ((x) >> 8)
 
-/* Lakemont application's entry point (Flash1). */
+/* Lakemont application's entry point (active partition of the x86 target). */
 #if (UNIT_TEST)
 uint32_t test_lmt_app;
 #define LMT_APP_ADDR (&test_lmt_app)
 #else
-#define LMT_APP_ADDR (0x40030000)
+#define LMT_APP_ADDR (bl_data_app_entry(BL_TARGET_IDX_LMT))
 #endif
 
 /* Generates one interrupt after 10 seconds with a 32MHz sysclk. */
@@ -504,6 +504,11 @@ int usb_dfu_start(void)
 
 	/* Initialize the DFU state machine. */
 	dfu_init();
+	/*
+	 * DNLOAD blocks are processed in the background (see fm_entry_usb()):
+	 * report DNBUSY and a poll timeout until done.
+	 */
+	dfu_set_async_mode(true);
 	/* Set alternate setting for partition 0 (x86). */
 	dfu_set_alt_setting(1);
 
@@ -34,6 +34,7 @@
 
 #include "clk.h"
 
+#include "dfu/core/dfu_core.h"
 #include "dfu/usb-dfu/usb_dfu.h"
 
 #if UNIT_TEST
@@ -57,11 +58,15 @@ int fm_entry_usb(void)
 	QM_IR_UNMASK_INT(QM_IRQ_USB_0_INT);
 
 	/*
+	 * DFU requests are handled in the USB interrupt; the time-consuming
+	 * part of their processing (e.g., flash programming) is done here, so
+	 * that the USB stack stays responsive meanwhile.
+	 *
 	 * NOTE: consider making this loop smarter by moving the timeout logic
 	 * in the USB/DFU module here.
 	 */
 	while (FOREVER()) {
-		/* do nothing */
+		dfu_process_bg_work();
 	}
 
 	return 0;
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FM_BOOT_CONFIRM_H__
+#define __FM_BOOT_CONFIRM_H__
+
+#include "fw-manager_config.h"
+#include "qm_common.h"
+#include "qm_soc_regs.h"
+#include "soc_flash_partitions.h"
+
+/**
+ * Boot confirmation API.
+ *
+ * After a firmware update, the new image is booted on trial (see
+ * FM_CONFIG_TRIAL_BOOT): the application must confirm that it booted
+ * correctly, or the bootloader will roll it back. Applications include this
+ * header and call fm_boot_confirm() once they are known to work (e.g., after
+ * their self-tests).
+ *
+ * Every target has its own confirmation bit, so an image on trial is confirmed
+ * only by its own application (on Quark SE, the x86 application confirms
+ * BL_TARGET_IDX_LMT and the sensor application BL_TARGET_IDX_ARC). The bits
+ * share the GPS0 register, which is updated with a read-modify-write: the two
+ * cores must not confirm at the same time (e.g., the sensor application
+ * confirms before signalling the x86 application that it is running).
+ *
+ * BL-Data is not writable by applications, so the confirmation is signalled
+ * through a sticky bit, which survives warm resets and is recorded in BL-Data
+ * at the next boot (the image is then no longer on trial). A power-on reset
+ * clears the bit before it is recorded: the bootloader detects it and neither
+ * confirms the image nor counts the boot against it, so a good image is never
+ * rolled back because of power cycles; the image stays on trial until a boot
+ * is confirmed and followed by a warm reset.
+ *
+ * @defgroup groupFM_Boot_Confirm Boot Confirmation
+ * @{
+ */
+
+/** The boot confirmation bit of a target. */
+#define FM_BOOT_CONFIRM_BIT(target_idx)                                        \
+	BIT(FM_CONFIG_TRIAL_BOOT_GPS0_BIT + (target_idx))
+/** The boot confirmation bits of all the targets. */
+#define FM_BOOT_CONFIRM_MASK                                                   \
+	((BIT(BL_BOOT_TARGETS_NUM) - 1) << FM_CONFIG_TRIAL_BOOT_GPS0_BIT)
+/** Clear the boot confirmation bit of a target. */
+#define FM_BOOT_CONFIRM_DEASSERT(target_idx)                                   \
+	(QM_SCSS_GP->gps0 &= ~FM_BOOT_CONFIRM_BIT(target_idx))
+
+/**
+ * Check if a trial boot is in progress.
+ *
+ * The bit is set by the bootloader when at least one target is on trial. It
+ * lets applications (which cannot read BL-Data) know whether the running image
+ * may still be rolled back.
+ */
+#define FM_BOOT_TRIAL_IS_PENDING()                                             \
+	(QM_SCSS_GP->gps0 & BIT(FM_CONFIG_TRIAL_BOOT_GPS0_PENDING_BIT))
+
+/**
+ * Confirm that the running application of a target booted correctly.
+ *
+ * It is safe to call this function at every boot, even if the application is
+ * not on trial.
+ *
+ * @param[in] target_idx The index of the target of the application (e.g.,
+ *			 BL_TARGET_IDX_LMT for the x86 application).
+ */
+static __inline__ void fm_boot_confirm(unsigned int target_idx)
+{
+	QM_SCSS_GP->gps0 |= FM_BOOT_CONFIRM_BIT(target_idx);
+}
+
+/**
+ * @}
+ */
+
+#endif /* __FM_BOOT_CONFIRM_H__ */
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "qm_common.h"
+
+#include "bl_data.h"
+#include "fm_flash.h"
+
+/**
+ * Erase the non-blank pages of a run (without flushing the prefetch buffer).
+ *
+ * @return The number of pages erased.
+ */
+static uint32_t fm_flash_erase_run(qm_flash_t ctrl, qm_flash_region_t region,
+				   uint32_t page, const volatile uint32_t *addr,
+				   uint32_t n_pages)
+{
+	uint32_t i, erased = 0;
+
+	for (i = 0; i < n_pages; i++, addr += QM_FLASH_PAGE_SIZE_DWORDS) {
+#if (FM_CONFIG_BLANK_CHECK)
+		/*
+		 * Reading is much faster than erasing: skip blank pages. The
+		 * check stops at the first non-blank word, which is usually
+		 * the first one of a page holding data.
+		 */
+		if (fm_flash_page_is_blank(addr)) {
+			bl_data_stats.erases_skipped++;
+			continue;
+		}
+#endif
+		qm_flash_page_erase(ctrl, region, page + i);
+		erased++;
+	}
+
+	return erased;
+}
+
+/**
+ * Program words into a blank area (without flushing the prefetch buffer).
+ *
+ * Blank words are skipped, since the area already holds them.
+ */
+static void fm_flash_program(qm_flash_t ctrl, qm_flash_region_t region,
+			     uint32_t offset, const uint32_t *data,
+			     uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++, offset += sizeof(uint32_t)) {
+		if (data[i] == FM_FLASH_BLANK_VALUE) {
+			bl_data_stats.words_skipped++;
+			continue;
+		}
+		qm_flash_word_write(ctrl, region, offset, data[i]);
+	}
+}
+
+/**
+ * Verify a run once the prefetch buffer has been flushed.
+ *
+ * @return 0 on success, -EIO otherwise.
+ */
+static int fm_flash_verify(const volatile uint32_t *addr, const uint32_t *data,
+			   uint32_t len)
+{
+#if (!UNIT_TEST)
+	if (memcmp(data, (const uint32_t *)addr, len * sizeof(uint32_t))) {
+		bl_data_stats.verify_errors++;
+		return -EIO;
+	}
+#else
+	(void)addr;
+	(void)data;
+	(void)len;
+#endif
+
+	return 0;
+}
+
+void fm_flash_flush_prefetch(qm_flash_t ctrl)
+{
+	qm_flash_reg_t *const flash_regs = QM_FLASH[ctrl];
+
+	flash_regs->ctrl |= QM_FLASH_CTRL_PRE_FLUSH_MASK;
+	flash_regs->ctrl &= ~QM_FLASH_CTRL_PRE_FLUSH_MASK;
+	bl_data_stats.prefetch_flushes++;
+}
+
+bool fm_flash_page_is_blank(const volatile uint32_t *addr)
+{
+	const volatile uint32_t *const end = addr + QM_FLASH_PAGE_SIZE_DWORDS;
+
+	while (addr < end) {
+		if (*addr++ != FM_FLASH_BLANK_VALUE) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void fm_flash_erase_pages(qm_flash_t ctrl, qm_flash_region_t region,
+			  uint32_t page, const volatile uint32_t *addr,
+			  uint32_t n_pages)
+{
+	const uint32_t erased =
+	    fm_flash_erase_run(ctrl, region, page, addr, n_pages);
+
+	bl_data_stats.page_erases += erased;
+	if (erased) {
+		fm_flash_flush_prefetch(ctrl);
+	}
+}
+
+int fm_flash_write_pages(qm_flash_t ctrl, qm_flash_region_t region,
+			 uint32_t page, const volatile uint32_t *addr,
+			 const uint32_t *data, uint32_t len)
+{
+	const uint32_t n_pages =
+	    (len + QM_FLASH_PAGE_SIZE_DWORDS - 1) / QM_FLASH_PAGE_SIZE_DWORDS;
+
+	fm_flash_erase_run(ctrl, region, page, addr, n_pages);
+	fm_flash_program(ctrl, region, page * QM_FLASH_PAGE_SIZE_BYTES, data,
+			 len);
+	bl_data_stats.page_writes += n_pages;
+	bl_data_stats.flash_runs++;
+	fm_flash_flush_prefetch(ctrl);
+
+	return fm_flash_verify(addr, data, len);
+}
+
+int fm_flash_write_words(qm_flash_t ctrl, qm_flash_region_t region,
+			 uint32_t offset, const volatile uint32_t *addr,
+			 const uint32_t *data, uint32_t len)
+{
+	fm_flash_program(ctrl, region, offset, data, len);
+	bl_data_stats.flash_runs++;
+	fm_flash_flush_prefetch(ctrl);
+
+	return fm_flash_verify(addr, data, len);
+}
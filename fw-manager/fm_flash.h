@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FM_FLASH_H__
+#define __FM_FLASH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "qm_flash.h"
+
+/**
+ * Firmware Manager flash programming.
+ *
+ * The flash routines shared by BL-Data and QFU. Pages are programmed in runs:
+ * each page of a run is erased (unless already blank) and then programmed
+ * word by word, skipping the words that are blank in the data (an erased page
+ * already holds them). The prefetch buffer is flushed once at the end of the
+ * run, and the run is then verified in a single pass. Operations are counted
+ * in bl_data_stats.
+ *
+ * @defgroup groupFM_Flash FM Flash Programming
+ * @{
+ */
+
+/** The value of an erased flash word. */
+#define FM_FLASH_BLANK_VALUE ((uint32_t)0xFFFFFFFF)
+
+/**
+ * Flush the prefetch buffer of a flash controller.
+ *
+ * Must be called after the flash content has changed.
+ *
+ * @param[in] ctrl The flash controller.
+ */
+void fm_flash_flush_prefetch(qm_flash_t ctrl);
+
+/**
+ * Check whether a flash page is blank.
+ *
+ * @param[in] addr The address of the page. Must not be null.
+ *
+ * @return Whether or not the page is entirely 0xFF.
+ */
+bool fm_flash_page_is_blank(const volatile uint32_t *addr);
+
+/**
+ * Erase a run of flash pages.
+ *
+ * Blank pages are not erased (if FM_CONFIG_BLANK_CHECK is enabled).
+ *
+ * @param[in] ctrl    The flash controller.
+ * @param[in] region  The flash region.
+ * @param[in] page    The first page (within the region).
+ * @param[in] addr    The address of the first page. Must not be null.
+ * @param[in] n_pages The number of pages.
+ */
+void fm_flash_erase_pages(qm_flash_t ctrl, qm_flash_region_t region,
+			  uint32_t page, const volatile uint32_t *addr,
+			  uint32_t n_pages);
+
+/**
+ * Program a run of flash pages.
+ *
+ * The pages are erased first, so the words following the data in the last
+ * page are left blank.
+ *
+ * @param[in] ctrl   The flash controller.
+ * @param[in] region The flash region.
+ * @param[in] page   The first page (within the region).
+ * @param[in] addr   The address of the first page. Must not be null.
+ * @param[in] data   The data. Must not be null.
+ * @param[in] len    The length of the data in words.
+ *
+ * @return 0 on success, -EIO if verification failed.
+ */
+int fm_flash_write_pages(qm_flash_t ctrl, qm_flash_region_t region,
+			 uint32_t page, const volatile uint32_t *addr,
+			 const uint32_t *data, uint32_t len);
+
+/**
+ * Program words into a blank area of flash.
+ *
+ * The area is not erased: the words to be programmed must be blank.
+ *
+ * @param[in] ctrl   The flash controller.
+ * @param[in] region The flash region.
+ * @param[in] offset The offset of the first word (within the region).
+ * @param[in] addr   The address of the first word. Must not be null.
+ * @param[in] data   The data. Must not be null.
+ * @param[in] len    The length of the data in words.
+ *
+ * @return 0 on success, -EIO if verification failed.
+ */
+int fm_flash_write_words(qm_flash_t ctrl, qm_flash_region_t region,
+			 uint32_t offset, const volatile uint32_t *addr,
+			 const uint32_t *data, uint32_t len);
+
+/**
+ * @}
+ */
+
+#endif /* __FM_FLASH_H__ */
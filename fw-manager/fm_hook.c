@@ -36,6 +36,7 @@
 
 #include "clk.h"
 
+#include "boot_timing.h"
 #include "fm_entry.h"
 #include "fw-manager_config.h"
 #include "soc_flash_partitions.h"
@@ -121,6 +122,7 @@ void fm_hook(void)
 #else  /* Don't check FM GPIO status */
 	state = QM_GPIO_HIGH;
 #endif /* FM_CONFIG_ENABLE_GPIO_PIN */
+	BOOT_TS(BOOT_TS_FM_HOOK);
 
 	/* Enter FM mode if FM sticky bit is set or FM_CONFIG_GPIO_PIN is low */
 	if (FM_STICKY_BIT_IS_ASSERTED() || (state == QM_GPIO_LOW)) {
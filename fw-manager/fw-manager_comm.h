@@ -45,11 +45,13 @@
 #define FM_COMM_UART_PIN_TX_FN (QM_PMUX_FN_0)
 #define FM_COMM_UART_PIN_RX_ID (QM_PIN_ID_19)
 #define FM_COMM_UART_PIN_RX_FN (QM_PMUX_FN_0)
+#define FM_COMM_UART_IRQ (QM_IRQ_UART_0_INT)
+#define FM_COMM_UART_IRQ_VECTOR (QM_IRQ_UART_0_INT_VECTOR)
 #define FM_COMM_UART_CLK (CLK_PERIPH_UARTA_REGISTER)
-#define fm_comm_irq_request()                                                  \
+#define fm_comm_irq_request(isr)                                               \
 	do {                                                                   \
 		QM_IR_UNMASK_INT(QM_IRQ_UART_0_INT);                           \
-		QM_IRQ_REQUEST(QM_IRQ_UART_0_INT, qm_uart_0_isr);              \
+		QM_IRQ_REQUEST(QM_IRQ_UART_0_INT, isr);                        \
 	} while (0);
 #elif(FM_CONFIG_UART == 1)
 #define FM_COMM_UART_PIN_TX_ID (QM_PIN_ID_16)
@@ -57,11 +59,12 @@
 #define FM_COMM_UART_PIN_RX_ID (QM_PIN_ID_17)
 #define FM_COMM_UART_PIN_RX_FN (QM_PMUX_FN_2)
 #define FM_COMM_UART_IRQ (QM_IRQ_UART_1_INT)
+#define FM_COMM_UART_IRQ_VECTOR (QM_IRQ_UART_1_INT_VECTOR)
 #define FM_COMM_UART_CLK (CLK_PERIPH_UARTB_REGISTER)
-#define fm_comm_irq_request()                                                  \
+#define fm_comm_irq_request(isr)                                               \
 	do {                                                                   \
 		QM_IR_UNMASK_INT(QM_IRQ_UART_1_INT);                           \
-		QM_IRQ_REQUEST(QM_IRQ_UART_1_INT, qm_uart_1_isr);              \
+		QM_IRQ_REQUEST(QM_IRQ_UART_1_INT, isr);                        \
 	} while (0);
 #else
 #error "Invalid UART ID for FM comm"
@@ -72,11 +75,13 @@
 #define FM_COMM_UART_PIN_TX_FN (QM_PMUX_FN_2)
 #define FM_COMM_UART_PIN_RX_ID (QM_PIN_ID_13)
 #define FM_COMM_UART_PIN_RX_FN (QM_PMUX_FN_2)
+#define FM_COMM_UART_IRQ (QM_IRQ_UART_0_INT)
+#define FM_COMM_UART_IRQ_VECTOR (QM_IRQ_UART_0_INT_VECTOR)
 #define FM_COMM_UART_CLK (CLK_PERIPH_UARTA_REGISTER)
-#define fm_comm_irq_request()                                                  \
+#define fm_comm_irq_request(isr)                                               \
 	do {                                                                   \
 		QM_IR_UNMASK_INT(QM_IRQ_UART_0_INT);                           \
-		QM_IRQ_REQUEST(QM_IRQ_UART_0_INT, qm_uart_0_isr);              \
+		QM_IRQ_REQUEST(QM_IRQ_UART_0_INT, isr);                        \
 	} while (0);
 #elif(FM_CONFIG_UART == 1)
 #define FM_COMM_UART_PIN_TX_ID (QM_PIN_ID_20)
@@ -84,11 +89,12 @@
 #define FM_COMM_UART_PIN_RX_ID (QM_PIN_ID_21)
 #define FM_COMM_UART_PIN_RX_FN (QM_PMUX_FN_2)
 #define FM_COMM_UART_IRQ (QM_IRQ_UART_1_INT)
+#define FM_COMM_UART_IRQ_VECTOR (QM_IRQ_UART_1_INT_VECTOR)
 #define FM_COMM_UART_CLK (CLK_PERIPH_UARTB_REGISTER)
-#define fm_comm_irq_request()                                                  \
+#define fm_comm_irq_request(isr)                                               \
 	do {                                                                   \
 		QM_IR_UNMASK_INT(QM_IRQ_UART_1_INT);                           \
-		QM_IRQ_REQUEST(QM_IRQ_UART_1_INT, qm_uart_1_isr);              \
+		QM_IRQ_REQUEST(QM_IRQ_UART_1_INT, isr);                        \
 	} while (0);
 #else
 #error "Invalid UART ID for FM comm"
@@ -47,6 +47,38 @@
 #define FM_CONFIG_UART (0)
 #endif
 #define FM_CONFIG_UART_BAUD_DIV (BOOTROM_UART_115200)
+/*
+ * The UART input clock frequency (i.e., the system clock frequency the ROM
+ * runs at) and the maximum baud rate the host can request by means of the
+ * QDA 'set baud rate' request.
+ */
+#define FM_CONFIG_UART_CLK_HZ (32000000)
+#define FM_CONFIG_UART_MAX_BAUD (2000000)
+
+/*
+ * XMODEM-1K support (STX frames with 1024-byte payload).
+ *
+ * When enabled, the XMODEM layer accepts both 128-byte (SOH) and 1024-byte
+ * (STX) frames and, if the receiver asks for it, transmits using 1024-byte
+ * frames. Disabled on D2000 to save RAM.
+ */
+#if (QUARK_SE)
+#define FM_CONFIG_XMODEM_1K (1)
+#elif(QUARK_D2000)
+#define FM_CONFIG_XMODEM_1K (0)
+#endif
+
+/*
+ * XMODEM streaming mode support (no per-packet ACK, see xmodem_stream.h).
+ *
+ * When enabled, the host can switch QDA to the streaming mode using the QDA
+ * 'set transport' request.
+ */
+#if (QUARK_SE)
+#define FM_CONFIG_XMODEM_STREAM (1)
+#elif(QUARK_D2000)
+#define FM_CONFIG_XMODEM_STREAM (0)
+#endif
 
 /* GPIO pin for FM requests. */
 #define FM_CONFIG_ENABLE_GPIO_PIN (1)
@@ -66,6 +98,242 @@
 #define FM_CONFIG_GPIO_PIN (2)
 #endif
 
+/*
+ * CRC16-CCITT implementation (used by XMODEM and BL-Data).
+ *
+ * - FM_CRC16_IMPL_BITWISE: byte-wise algebraic form (the polynomial terms are
+ *   computed with a few shifts and XORs per byte); no lookup table.
+ * - FM_CRC16_IMPL_SLICE4:  slicing-by-4 lookup; 2 kB table.
+ *
+ * A byte-wise lookup table (512 bytes) is not offered: it is no faster than
+ * the algebraic form (see 'make crc-bench').
+ *
+ * Can be overridden at build time, e.g., by adding
+ * -DFM_CONFIG_CRC16_IMPL=FM_CRC16_IMPL_SLICE4 to CFLAGS.
+ */
+#define FM_CRC16_IMPL_BITWISE (0)
+#define FM_CRC16_IMPL_SLICE4 (1)
+#ifndef FM_CONFIG_CRC16_IMPL
+#define FM_CONFIG_CRC16_IMPL (FM_CRC16_IMPL_BITWISE)
+#endif
+
+/*
+ * QFU pipelined flash programming.
+ *
+ * When enabled, the programming of a QFU block is deferred and performed (as a
+ * single flash run) while the transport layer waits for the next block, thus
+ * overlapping flash programming with data reception. Errors are reported in
+ * the DFU status of a following request. Only the QDA (UART) transport drives
+ * the background programming; with other transports, the pending block is
+ * programmed when the next block (or the end of the transfer) is received.
+ */
+#if (QUARK_SE)
+#define FM_CONFIG_QFU_PIPELINE (1)
+#elif(QUARK_D2000)
+#define FM_CONFIG_QFU_PIPELINE (0)
+#endif
+
+/*
+ * Support for compressed QFU images (QFU_EXT_HDR_LZ flag).
+ *
+ * The decompressor uses the partition being programmed as its history window,
+ * so it needs no RAM other than the QFU block buffer.
+ */
+#if (QUARK_SE)
+#define FM_CONFIG_QFU_COMPRESSION (1)
+#elif(QUARK_D2000)
+#define FM_CONFIG_QFU_COMPRESSION (0)
+#endif
+
+/*
+ * Support for delta QFU images (QFU_EXT_HDR_DELTA flag).
+ *
+ * A delta image is applied to the inactive partition of a target, using the
+ * image in the active one as base; therefore, dual-bank mode is required. The
+ * base image is verified with SHA256, which is available only when
+ * authentication is enabled.
+ */
+#if (FM_CONFIG_QFU_COMPRESSION && BL_CONFIG_DUAL_BANK &&                       \
+     ENABLE_FIRMWARE_MANAGER_AUTH)
+#define FM_CONFIG_QFU_DELTA (1)
+#else
+#define FM_CONFIG_QFU_DELTA (0)
+#endif
+
+/*
+ * Multi-image QFU bundles (QFU_EXT_HDR_BUNDLE flag).
+ *
+ * A bundle carries the images of several partitions (e.g., the x86 and the
+ * sensor subsystem ones), which are programmed in a single DFU session and
+ * committed by a single BL-Data update, so that either all of them or none
+ * are installed. Bundles cannot be compressed or resumed.
+ */
+#if (QUARK_SE)
+#define FM_CONFIG_QFU_BUNDLE (1)
+#elif(QUARK_D2000)
+#define FM_CONFIG_QFU_BUNDLE (0)
+#endif
+
+/*
+ * Trial boot of updated images (dual-bank only).
+ *
+ * After an update, the new image of a target is booted on trial: unless the
+ * application confirms a good boot (see fm_boot_confirm.h) within
+ * FM_CONFIG_TRIAL_BOOT_ATTEMPTS boots, the bootloader switches the target back
+ * to its other partition. The confirmation is signalled through a sticky bit
+ * per target (bit FM_CONFIG_TRIAL_BOOT_GPS0_BIT + target index) and recorded
+ * at the next boot. The FM_CONFIG_TRIAL_BOOT_GPS0_PENDING_BIT sticky bit marks
+ * a trial boot in progress, so that boots ended by a power-on reset are not
+ * accounted; it follows the confirmation bits of the (up to two) targets.
+ */
+#if (BL_CONFIG_DUAL_BANK)
+#define FM_CONFIG_TRIAL_BOOT (1)
+#else
+#define FM_CONFIG_TRIAL_BOOT (0)
+#endif
+#define FM_CONFIG_TRIAL_BOOT_ATTEMPTS (3)
+#define FM_CONFIG_TRIAL_BOOT_GPS0_BIT (8)
+#define FM_CONFIG_TRIAL_BOOT_GPS0_PENDING_BIT (10)
+
+/*
+ * In-application staging.
+ *
+ * If enabled, the x86 application can stage an update into the inactive x86
+ * partition while running (see fw-manager/staging/qfu_stage.h); the staged
+ * image is verified and installed by the bootloader at the next boot. The
+ * application needs write access to flash, therefore staging requires the
+ * ROM to be built with ENABLE_FLASH_WRITE_PROTECTION=0 (and dual-bank
+ * support).
+ */
+#if (QUARK_SE && BL_CONFIG_DUAL_BANK && !ENABLE_FLASH_WRITE_PROTECTION)
+#define FM_CONFIG_APP_STAGING (1)
+#else
+#define FM_CONFIG_APP_STAGING (0)
+#endif
+
+/*
+ * Resumable QFU downloads.
+ *
+ * When enabled, the number of data blocks programmed so far (the watermark)
+ * is stored in BL-Data every FM_CONFIG_QFU_RESUME_INTERVAL blocks. After a
+ * failure (or a power loss), the partition is not erased and a new download
+ * of the same image can continue from the watermark (see QFM_RESUME_REQ).
+ * Compressed and delta images cannot be resumed.
+ *
+ * The image is identified by the HMAC signature of its header, which covers
+ * the hashes of all its blocks, so authentication is required: without it, a
+ * rebuilt image with the same header would be resumed on top of the blocks of
+ * the previous one.
+ */
+#if (QUARK_SE && ENABLE_FIRMWARE_MANAGER_AUTH)
+#define FM_CONFIG_QFU_RESUME (1)
+#else
+#define FM_CONFIG_QFU_RESUME (0)
+#endif
+#define FM_CONFIG_QFU_RESUME_INTERVAL (4)
+
+/*
+ * Hold back the first word of an image until the update is committed, so that
+ * a partially written partition is never booted. Needed by resumable
+ * downloads and by staged images (whose first word is kept in the staging
+ * descriptor); not user configurable.
+ */
+#define FM_CONFIG_QFU_HOLD_FIRST_WORD                                          \
+	(FM_CONFIG_QFU_RESUME || FM_CONFIG_APP_STAGING)
+
+/*
+ * Skipping of unchanged QFU blocks (see QFM_BLOCK_MAP_REQ).
+ *
+ * Before a download, the host can send the block hashes of the image: the
+ * device compares them with the hashes of the blocks already in the partition
+ * and returns a map of the blocks that differ, which are the only ones the
+ * host needs to send. Block hashes are part of the HMAC extended header, so
+ * authentication is required.
+ */
+#if (QUARK_SE && ENABLE_FIRMWARE_MANAGER_AUTH)
+#define FM_CONFIG_QFU_SKIP_UNCHANGED (1)
+#else
+#define FM_CONFIG_QFU_SKIP_UNCHANGED (0)
+#endif
+
+/*
+ * QFU update profiling.
+ *
+ * When enabled, the QFU handler accounts the CPU cycles (TSC ticks) spent
+ * verifying hashes and programming flash during the last update, as well as
+ * the total duration of the update; they are reported by the QFM Statistics
+ * response, so that the host can break down the update time.
+ */
+#if (QUARK_SE)
+#define FM_CONFIG_QFU_PROFILE (1)
+#elif(QUARK_D2000)
+#define FM_CONFIG_QFU_PROFILE (0)
+#endif
+
+/*
+ * Erase-on-demand of application partitions.
+ *
+ * When enabled, BL-Data keeps track of how many pages of each partition may be
+ * non-blank, so that BL-Data sanitization erases only those pages (instead of
+ * the entire partition). QFU updates erase only the pages they write plus the
+ * ones left over from the previous (bigger) image.
+ *
+ * Disabled on D2000, where the bookkeeping does not fit in the 8 kB ROM and
+ * partitions are small enough for a full erase to be cheap.
+ */
+#if (QUARK_SE)
+#define FM_CONFIG_ERASE_ON_DEMAND (1)
+#elif(QUARK_D2000)
+#define FM_CONFIG_ERASE_ON_DEMAND (0)
+#endif
+
+/*
+ * Blank check before erase.
+ *
+ * When enabled, the pages of an application partition are read back before
+ * being erased and the erase is skipped if they are already blank. The number
+ * of erases avoided is reported by the QFM Statistics response.
+ *
+ * Enabled on D2000 as well, where it is what keeps sanitization from erasing
+ * the blank part of application partitions (erase-on-demand being disabled
+ * there): it takes 85 bytes of ROM and the check of a D2000 page (7
+ * instructions per word, stopping at the first non-blank one) takes well
+ * under 0.1 ms, while a page erase takes several milliseconds.
+ */
+#define FM_CONFIG_BLANK_CHECK (1)
+
+/*
+ * Ping-pong BL-Data.
+ *
+ * When enabled, the two BL-Data pages are used as alternating slots, each one
+ * carrying a sequence number: a BL-Data writeback programs only the slot with
+ * the older copy and BL-Data sanitization loads the newest valid one. This
+ * halves the page writes of each update, while keeping a valid copy in case of
+ * power loss. The BL-Data log requires mirrored pages, so it is disabled when
+ * this mode is enabled.
+ *
+ * Can be enabled at build time by adding -DFM_CONFIG_BL_DATA_PING_PONG=1 to
+ * CFLAGS.
+ */
+#ifndef FM_CONFIG_BL_DATA_PING_PONG
+#define FM_CONFIG_BL_DATA_PING_PONG (0)
+#endif
+
+/*
+ * Log-structured BL-Data.
+ *
+ * When enabled, the space following BL-Data in each BL-Data page is used as a
+ * log of records patching BL-Data, so that most BL-Data updates (e.g., marking
+ * a partition as inconsistent) are performed with a few word writes instead of
+ * erasing and programming both BL-Data pages. The pages are rewritten (i.e.,
+ * the log is compacted) only when the log is full.
+ */
+#if (QUARK_SE && !FM_CONFIG_BL_DATA_PING_PONG)
+#define FM_CONFIG_BL_DATA_LOG (1)
+#else
+#define FM_CONFIG_BL_DATA_LOG (0)
+#endif
+
 /* The size of a QFU block in number of pages */
 #if (QUARK_SE)
 #define QFU_BLOCK_SIZE_PAGES (2)
@@ -74,6 +342,27 @@
 #endif
 #define QFU_BLOCK_SIZE (QM_FLASH_PAGE_SIZE_BYTES * QFU_BLOCK_SIZE_PAGES)
 
+/*
+ * The maximum size of a QFU block in number of pages.
+ *
+ * QFU images can use any block size that is a power-of-two multiple of
+ * QFU_BLOCK_SIZE up to QFU_MAX_BLOCK_SIZE (bigger blocks mean fewer DFU round
+ * trips). The QFU block buffer and the transport buffers are sized according
+ * to the maximum, which is therefore bounded by the available RAM.
+ *
+ * Can be overridden at build time, e.g., by adding
+ * -DQFU_MAX_BLOCK_SIZE_PAGES=8 to CFLAGS; must be a power-of-two multiple of
+ * QFU_BLOCK_SIZE_PAGES.
+ */
+#ifndef QFU_MAX_BLOCK_SIZE_PAGES
+#if (QUARK_SE)
+#define QFU_MAX_BLOCK_SIZE_PAGES (4)
+#elif(QUARK_D2000)
+#define QFU_MAX_BLOCK_SIZE_PAGES (1)
+#endif
+#endif
+#define QFU_MAX_BLOCK_SIZE (QM_FLASH_PAGE_SIZE_BYTES * QFU_MAX_BLOCK_SIZE_PAGES)
+
 /**
  * DFU configuration defines.
  */
@@ -36,6 +36,7 @@
 #include "bl_data.h"
 #include "fw-manager_utils.h"
 #include "../dfu/dfu.h"
+#include "../qfu/qfu.h"
 /* qfu_format.h included because of authentication enum (qfm_auth_type_t) */
 #include "../qfu/qfu_format.h"
 #include "tinycrypt/hmac.h"
@@ -94,7 +95,7 @@ static void qfm_abort_transfer(void);
 const dfu_request_handler_t qfm_dfu_rh = {
     &qfm_init, &qfm_get_processing_status, &qfm_clear_status,
     &qfm_dnl_process_block, &qfm_dnl_finalize_transfer, &qfm_upl_fill_block,
-    &qfm_abort_transfer,
+    &qfm_abort_transfer, NULL,
 };
 
 /** The variable holding the outgoing QFM System Information response packet. */
@@ -108,8 +109,36 @@ static qfm_sys_info_rsp_t sys_info_rsp = {
     .targets = QFM_SYS_INFO_INIT_TARGET_LIST,
 };
 
-/** Flag indicating whether a SySInfo response is pending or not. */
-static bool sys_info_rsp_pending;
+#if (FM_CONFIG_QFU_RESUME)
+/** The variable holding the outgoing QFM Resume Information response. */
+static qfm_resume_rsp_t resume_rsp = {
+    .qfm_pkt_type = QFM_RESUME_RSP,
+};
+#endif
+
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED)
+/** The variable holding the outgoing QFM Block Map response. */
+static qfm_block_map_rsp_t block_map_rsp = {
+    .qfm_pkt_type = QFM_BLOCK_MAP_RSP,
+};
+#endif
+
+/** The variable holding the outgoing QFM Statistics response packet. */
+static qfm_stats_rsp_t stats_rsp = {
+    .qfm_pkt_type = QFM_STATS_RSP,
+};
+
+#if (ENABLE_BOOT_TIMING)
+/** The variable holding the outgoing QFM Boot Timing response packet. */
+static qfm_boot_timing_rsp_t boot_timing_rsp = {
+    .qfm_pkt_type = QFM_BOOT_TIMING_RSP, .tsc_hz = BOOT_TIMING_TSC_HZ,
+};
+#endif
+
+/** The pending QFM response (NULL if no response is pending). */
+static const void *pending_rsp;
+/** The length of the pending QFM response. */
+static uint16_t pending_rsp_len;
 
 /**
  * The DFU status of this DFU request handler.
@@ -143,9 +172,123 @@ static void prepare_sys_info_rsp(void)
 		    bl_data->targets[i].active_partition_idx;
 	}
 
-	sys_info_rsp_pending = true;
+	pending_rsp = &sys_info_rsp;
+	pending_rsp_len = sizeof(sys_info_rsp);
 }
 
+/**
+ * Prepare a QFM Statistics response (QFM_STATS_RSP) packet.
+ *
+ * This function is called when a QFM Statistics request (QFM_STATS_REQ) is
+ * received.
+ */
+static void prepare_stats_rsp(void)
+{
+	stats_rsp.erases_skipped = bl_data_stats.erases_skipped;
+	stats_rsp.writebacks_skipped = bl_data_stats.writebacks_skipped;
+	stats_rsp.page_writes = bl_data_stats.page_writes;
+	stats_rsp.page_erases = bl_data_stats.page_erases;
+	stats_rsp.flash_runs = bl_data_stats.flash_runs;
+	stats_rsp.words_skipped = bl_data_stats.words_skipped;
+	stats_rsp.prefetch_flushes = bl_data_stats.prefetch_flushes;
+	stats_rsp.verify_errors = bl_data_stats.verify_errors;
+#if (FM_CONFIG_QFU_PROFILE)
+	stats_rsp.qfu_blocks = qfu_profile.blocks;
+	stats_rsp.qfu_total_cycles = qfu_profile.total_cycles;
+	stats_rsp.qfu_hash_cycles = qfu_profile.hash_cycles;
+	stats_rsp.qfu_flash_cycles = qfu_profile.flash_cycles;
+#endif
+
+	pending_rsp = &stats_rsp;
+	pending_rsp_len = sizeof(stats_rsp);
+}
+
+#if (ENABLE_BOOT_TIMING)
+/**
+ * Prepare a QFM Boot Timing response (QFM_BOOT_TIMING_RSP) packet.
+ *
+ * This function is called when a QFM Boot Timing request (QFM_BOOT_TIMING_REQ)
+ * is received.
+ */
+static void prepare_boot_timing_rsp(void)
+{
+	if (__boot_timing.magic == BOOT_TIMING_MAGIC) {
+		boot_timing_rsp.n_ts = BOOT_TS_NUM;
+		memcpy(boot_timing_rsp.ts, __boot_timing.ts,
+		       sizeof(boot_timing_rsp.ts));
+	}
+
+	pending_rsp = &boot_timing_rsp;
+	pending_rsp_len = sizeof(boot_timing_rsp);
+}
+#endif /* ENABLE_BOOT_TIMING */
+
+#if (FM_CONFIG_QFU_RESUME)
+/**
+ * Process a QFM Resume Information request (QFM_RESUME_REQ).
+ *
+ * Prepare the response and allow the next QFU download to the partition to
+ * resume the interrupted one.
+ *
+ * @param[in] req The request. Must not be null.
+ *
+ * @return The DFU Device Status of the processing result.
+ */
+static dfu_dev_status_t process_resume_req(const qfm_resume_req_t *req)
+{
+	const bl_flash_partition_t *part;
+
+	if (req->partition_idx >= BL_FLASH_PARTITIONS_NUM) {
+		return DFU_STATUS_ERR_TARGET;
+	}
+	part = &bl_data->partitions[req->partition_idx];
+	resume_rsp.resume_blk = part->is_consistent ? 0 : part->resume_blk;
+	memcpy(&resume_rsp.tag, &part->resume_tag, sizeof(resume_rsp.tag));
+	qfu_allow_resume(req->partition_idx);
+
+	pending_rsp = &resume_rsp;
+	pending_rsp_len = sizeof(resume_rsp);
+
+	return DFU_STATUS_OK;
+}
+#endif /* FM_CONFIG_QFU_RESUME */
+
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED)
+/**
+ * Process a QFM Block Map request (QFM_BLOCK_MAP_REQ).
+ *
+ * Prepare the response and allow the next QFU download to the partition to
+ * skip the blocks that have not changed.
+ *
+ * @param[in] req The request. Must not be null.
+ * @param[in] len The length of the request.
+ *
+ * @return The DFU Device Status of the processing result.
+ */
+static dfu_dev_status_t process_block_map_req(const qfm_block_map_req_t *req,
+					      uint16_t len)
+{
+	/* Hashes are not copied, so make sure they have all been received. */
+	if (len < sizeof(*req) ||
+	    len < sizeof(*req) + req->n_blocks * sizeof(sha256_t)) {
+		return DFU_STATUS_ERR_TARGET;
+	}
+	if (req->block_sz_log2 >= 16 ||
+	    qfu_get_block_map(req->partition_idx, req->hashes, req->n_blocks,
+			      req->block_sz_log2 ? BIT(req->block_sz_log2)
+						 : QFU_BLOCK_SIZE,
+			      block_map_rsp.map)) {
+		return DFU_STATUS_ERR_TARGET;
+	}
+	block_map_rsp.n_blocks = req->n_blocks;
+
+	pending_rsp = &block_map_rsp;
+	pending_rsp_len = sizeof(block_map_rsp);
+
+	return DFU_STATUS_OK;
+}
+#endif /* FM_CONFIG_QFU_SKIP_UNCHANGED */
+
 #if (ENABLE_FIRMWARE_MANAGER_AUTH == 0)
 /*
  * Application Erase.
@@ -153,8 +296,10 @@ static void prepare_sys_info_rsp(void)
  * Erase all application code from flash.
  *
  * This functionality is not available when authentication is enabled.
+ *
+ * @return DFU_STATUS_OK on success, DFU_STATUS_ERR_WRITE otherwise.
  */
-static void app_erase(void)
+static dfu_dev_status_t app_erase(void)
 {
 	int i;
 	bl_flash_partition_t *part;
@@ -166,13 +311,19 @@ static void app_erase(void)
 	for (i = 0; i < BL_FLASH_PARTITIONS_NUM; i++) {
 		part = &bl_data->partitions[i];
 		part->is_consistent = false;
+#if (FM_CONFIG_QFU_RESUME)
+		/* Interrupted updates must be erased as well. */
+		part->resume_blk = 0;
+#endif
+	}
+	if (bl_data_shadow_writeback()) {
+		return DFU_STATUS_ERR_WRITE;
 	}
-	bl_data_shadow_writeback();
 	/*
 	 * Then call bl_data_sanitize() to make it erase the partitions and
 	 * mark them back as consistent.
 	 */
-	bl_data_sanitize();
+	return bl_data_sanitize() ? DFU_STATUS_ERR_WRITE : DFU_STATUS_OK;
 }
 #endif
 
@@ -202,9 +353,8 @@ static dfu_dev_status_t qfm_update_key(const qfm_update_pkt_t *pkt,
 		 * since the DFU buffer (where the packet is located) is cleared
 		 * by the DFU Core module.
 		 */
-		bl_data_shadow_writeback();
-		/* Update return value to success. */
-		retv = DFU_STATUS_OK;
+		retv = bl_data_shadow_writeback() ? DFU_STATUS_ERR_WRITE
+						  : DFU_STATUS_OK;
 	}
 	/* Re-enable interrupts */
 	qm_irq_enable();
@@ -241,6 +391,22 @@ static dfu_dev_status_t process_qfm_req(const uint8_t *data, uint16_t len)
 	case QFM_SYS_INFO_REQ:
 		prepare_sys_info_rsp();
 		return DFU_STATUS_OK;
+	case QFM_STATS_REQ:
+		prepare_stats_rsp();
+		return DFU_STATUS_OK;
+#if (ENABLE_BOOT_TIMING)
+	case QFM_BOOT_TIMING_REQ:
+		prepare_boot_timing_rsp();
+		return DFU_STATUS_OK;
+#endif
+#if (FM_CONFIG_QFU_RESUME)
+	case QFM_RESUME_REQ:
+		return process_resume_req((qfm_resume_req_t *)pkt);
+#endif
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED)
+	case QFM_BLOCK_MAP_REQ:
+		return process_block_map_req((qfm_block_map_req_t *)pkt, len);
+#endif
 #if (ENABLE_FIRMWARE_MANAGER_AUTH == 0)
 	/* App erase is enabled only if authentication is disabled. */
 	case QFM_APP_ERASE:
@@ -248,8 +414,7 @@ static dfu_dev_status_t process_qfm_req(const uint8_t *data, uint16_t len)
 		 * App erase takes just a few ms so we can safely perform it
 		 * here, instead of replying to the DFU_DNLOAD request first.
 		 */
-		app_erase();
-		return DFU_STATUS_OK;
+		return app_erase();
 #else /* ENABLE_FIRMWARE_MANAGER_AUTH == 1 */
 	/* Key provisioning is enabled only when authentication is enabled. */
 	case QFM_UPDATE_FW_KEY:
@@ -316,7 +481,7 @@ static void qfm_clear_status(void)
 static void qfm_dnl_process_block(uint32_t block_num, const uint8_t *data,
 				  uint16_t len)
 {
-	sys_info_rsp_pending = false;
+	pending_rsp = NULL;
 	/*
 	 * We do not support QFM requests split in multiple blocks: the entire
 	 * request must be in the first (and only) block. Therefore we return
@@ -357,8 +522,8 @@ static int qfm_dnl_finalize_transfer(uint32_t block_num)
  * When QFM mode (i.e., alternate setting 0) is active, the host sends a
  * DFU_UPLOAD request to retrieve the response to the QFM Request previously
  * sent in DFU_DNLOAD transfer. Note, however, that not every QFM request
- * expects a QFM response. In fact, at the moment, only the QFM SysInfo request
- * expects a QFM response.
+ * expects a QFM response. In fact, at the moment, only the QFM SysInfo and
+ * Resume Information requests expect a QFM response.
  *
  * For the sake of code-size minimization, we require the host to use a block
  * size (i.e., req_len) greater than the response length.  In other words, the
@@ -375,14 +540,14 @@ static void qfm_upl_fill_block(uint32_t blk_num, uint8_t *data,
 	/* By default no response is returned. */
 	*len = 0;
 	/*
-	 * But if a SysInfo response is pending and the block size is large
-	 * enough to contain it, we return it.
+	 * But if a response is pending and the block size is large enough to
+	 * contain it, we return it.
 	 */
-	if (sys_info_rsp_pending && (req_len >= sizeof(sys_info_rsp))) {
-		memcpy(data, &sys_info_rsp, sizeof(sys_info_rsp));
-		*len = sizeof(sys_info_rsp);
+	if (pending_rsp && (req_len >= pending_rsp_len)) {
+		memcpy(data, pending_rsp, pending_rsp_len);
+		*len = pending_rsp_len;
 	}
-	sys_info_rsp_pending = false;
+	pending_rsp = NULL;
 }
 
 /**
@@ -392,5 +557,5 @@ static void qfm_upl_fill_block(uint32_t blk_num, uint8_t *data,
  */
 static void qfm_abort_transfer(void)
 {
-	sys_info_rsp_pending = false;
+	pending_rsp = NULL;
 }
@@ -33,6 +33,8 @@
 #include <stdint.h>
 
 #include "bl_data.h"
+#include "boot_timing.h"
+#include "../qfu/qfu_format.h"
 
 /**
  * The enumeration of QFM packet types.
@@ -43,8 +45,16 @@ typedef enum {
 	QFM_APP_ERASE = 0x444D0001,     /**< Application Erase request. */
 	QFM_UPDATE_FW_KEY = 0x444D0002, /**< Firmware Key Update request. */
 	QFM_UPDATE_RV_KEY = 0x444D0003, /**< Revocation Key Update request. */
+	QFM_RESUME_REQ = 0x444D0004,    /**< Resume Information request. */
+	QFM_BLOCK_MAP_REQ = 0x444D0005, /**< Block Map request. */
+	QFM_STATS_REQ = 0x444D0006,     /**< Statistics request. */
+	QFM_BOOT_TIMING_REQ = 0x444D0007, /**< Boot Timing request. */
 	/* Responses */
 	QFM_SYS_INFO_RSP = 0x444D8000, /**< System Information response. */
+	QFM_RESUME_RSP = 0x444D8001,   /**< Resume Information response. */
+	QFM_BLOCK_MAP_RSP = 0x444D8002, /**< Block Map response. */
+	QFM_STATS_RSP = 0x444D8003,     /**< Statistics response. */
+	QFM_BOOT_TIMING_RSP = 0x444D8004, /**< Boot Timing response. */
 } qfm_pkt_type_t;
 
 /**
@@ -117,4 +127,118 @@ typedef struct __attribute__((__packed__)) {
 	sha256_t mac;
 } qfm_update_pkt_t;
 
+/**
+ * Type-specific structure for the QFM Resume Information request packet.
+ *
+ * Besides retrieving the resume information of a partition, the request
+ * allows the next QFU download to the partition to resume the interrupted one.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t type;
+	uint8_t partition_idx; /**< The index of the partition. */
+} qfm_resume_req_t;
+
+/**
+ * Type-specific structure for the QFM Resume Information response packet.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t qfm_pkt_type;
+	/**
+	 * The number of data blocks already programmed.
+	 *
+	 * If non-zero, a download of the image identified by 'tag' can skip
+	 * the first resume_blk data blocks (i.e., send the header followed by
+	 * data block resume_blk). If zero, the download cannot be resumed.
+	 */
+	uint32_t resume_blk;
+	/**
+	 * The tag of the image being downloaded.
+	 *
+	 * That is the HMAC256 signature of the QFU header, if authentication is
+	 * enabled, or the CRC16-CCITT of the QFU header block (padding
+	 * included) in the first (little endian) word, otherwise.
+	 */
+	sha256_t tag;
+} qfm_resume_rsp_t;
+
+/**
+ * Type-specific structure for the QFM Block Map request packet.
+ *
+ * The request carries the SHA256 hashes of the data blocks of a QFU image
+ * (i.e., the hashes of its HMAC extended header). Besides retrieving the map
+ * of the blocks that differ from the ones in the partition, the request allows
+ * the next QFU download to the partition to skip the unchanged blocks (see
+ * qfu_get_block_map()).
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t type;
+	uint8_t partition_idx; /**< The index of the partition. */
+	/**
+	 * The log2 of the block size of the image (0 for QFU_BLOCK_SIZE).
+	 */
+	uint8_t block_sz_log2;
+	uint16_t n_blocks;  /**< The number of data blocks of the image. */
+	sha256_t hashes[];  /**< The hashes of the data blocks. */
+} qfm_block_map_req_t;
+
+/**
+ * Type-specific structure for the QFM Block Map response packet.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t qfm_pkt_type;
+	uint16_t n_blocks; /**< The number of data blocks of the image. */
+	/**
+	 * The map of the data blocks the host must send (bit i % 8 of byte
+	 * i / 8 is set if data block i must be sent).
+	 */
+	uint8_t map[QFU_BLOCK_MAP_SIZE];
+} qfm_block_map_rsp_t;
+
+/**
+ * Type-specific structure for the QFM Statistics response packet.
+ *
+ * Statistics are counted since the last boot. New fields are appended at the
+ * end, so hosts must accept responses longer than expected.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t qfm_pkt_type;
+	/** The number of page erases skipped because pages were blank. */
+	uint32_t erases_skipped;
+	/** The number of BL-Data writebacks skipped (BL-Data unchanged). */
+	uint32_t writebacks_skipped;
+	/** The number of flash pages written (i.e., erased and programmed). */
+	uint32_t page_writes;
+	/** The number of flash pages erased (not counting page writes). */
+	uint32_t page_erases;
+	/** Last QFU update: data blocks received (0 if not profiled). */
+	uint32_t qfu_blocks;
+	/** Last QFU update: total cycles (0 if failed or not profiled). */
+	uint32_t qfu_total_cycles;
+	/** Last QFU update: cycles spent verifying hashes. */
+	uint32_t qfu_hash_cycles;
+	/** Last QFU update: cycles spent programming flash. */
+	uint32_t qfu_flash_cycles;
+	/** The number of flash programming runs. */
+	uint32_t flash_runs;
+	/** The number of blank words not programmed (already erased). */
+	uint32_t words_skipped;
+	/** The number of flash prefetch buffer flushes. */
+	uint32_t prefetch_flushes;
+	/** The number of programming runs failing verification. */
+	uint32_t verify_errors;
+} qfm_stats_rsp_t;
+
+/**
+ * Type-specific structure for the QFM Boot Timing response packet.
+ * The timestamps are the ones recorded by the ROM during the last boot (see
+ * boot_timing.h); the FM session itself is not part of the timeline.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t qfm_pkt_type;
+	uint32_t tsc_hz; /**< The TSC frequency during the boot flow. */
+	uint32_t n_ts;   /**< The number of timestamps (0 if not recorded). */
+	/** The TSC at the end of each boot phase (0 if not executed). */
+	uint32_t ts[BOOT_TS_NUM];
+} qfm_boot_timing_rsp_t;
+
 #endif /* __QFM_PACKETS_H__ */
@@ -36,21 +36,28 @@
 #include "../bl_data.h"
 #include "../dfu/dfu.h"
 #include "bl_data.h"
+#include "fm_flash.h"
+#if (FM_CONFIG_TRIAL_BOOT)
+#include "fm_boot_confirm.h"
+#endif
 #include "fw-manager_config.h"
+#include "fw-manager_utils.h"
+#include "qfu.h"
 #include "qfu_format.h"
 #include "qfu_hmac.h"
+#include "qfu_lz.h"
 #include "qm_interrupt.h"
+#if (FM_CONFIG_QFU_PROFILE)
+#include <x86intrin.h>
+#endif
 
 /* Set DEBUG_MSG to 1 to enable debugging messages. */
 #define DEBUG_MSG (0)
 #if (DEBUG_MSG)
 #define DBG_PRINTF(...) QM_PRINTF(__VA_ARGS__)
-/* Replace calls to qm_flash with calls to the debugging printf. */
-#define qm_flash_page_write(ctrl, reg, pg, data, len)                          \
-	do {                                                                   \
-		DBG_PRINTF("[SUPPRESSED] qm_flash_page_write()\n");            \
-		(void)(pg);                                                    \
-	} while (0);
+/* Replace flash programming with calls to the debugging printf. */
+#define fm_flash_write_pages(ctrl, reg, pg, addr, data, len)                   \
+	(DBG_PRINTF("[SUPPRESSED] fm_flash_write_pages()\n"), (void)(pg), 0)
 #else
 #define DBG_PRINTF(...)
 #endif
@@ -59,9 +66,20 @@
  * The size of the header buffer.
  *
  * It is equal to the size of the QFU base header plus the maximum size of the
- * extended header.
+ * extended header (including the delta or bundle descriptor, if supported).
+ * The extended header of a bundle, which has the hashes of the blocks of all
+ * its payloads, is always bigger than the one of a delta image.
  */
+#if (FM_CONFIG_QFU_BUNDLE)
+#define HDR_BUF_SIZE                                                           \
+	(sizeof(qfu_hdr_t) + QFU_HDR_BUNDLE_SIZE(QFU_BUNDLE_MAX_PAYLOADS) +    \
+	 QFU_HMAC_FIXED_SIZE + (sizeof(sha256_t) * QFU_BUNDLE_MAX_DATA_BLOCKS))
+#elif (FM_CONFIG_QFU_DELTA)
+#define HDR_BUF_SIZE                                                           \
+	(sizeof(qfu_hdr_t) + sizeof(qfu_hdr_delta_t) + QFU_HMAC_HDR_MAX_SIZE)
+#else
 #define HDR_BUF_SIZE (sizeof(qfu_hdr_t) + QFU_HMAC_HDR_MAX_SIZE)
+#endif
 
 /** Number of blocks used for header (always 1 with current block sizes). */
 #define NUM_HDR_BLOCKS (1)
@@ -92,6 +110,75 @@
 #define qfu_check_ext_hdr(img_hdr, data_blocks, part) (0)
 #endif /* ENABLE_FIRMWARE_MANAGER_AUTH */
 
+#if (FM_CONFIG_QFU_DELTA)
+/* Extended header flags related to compression. */
+#define QFU_LZ_EXT_HDR_FLAGS (QFU_EXT_HDR_LZ | QFU_EXT_HDR_DELTA)
+#elif(FM_CONFIG_QFU_COMPRESSION)
+#define QFU_LZ_EXT_HDR_FLAGS (QFU_EXT_HDR_LZ)
+#else
+#define QFU_LZ_EXT_HDR_FLAGS (0)
+#endif
+
+#if (FM_CONFIG_QFU_BUNDLE)
+#define QFU_BUNDLE_EXT_HDR_FLAGS (QFU_EXT_HDR_BUNDLE)
+#else
+#define QFU_BUNDLE_EXT_HDR_FLAGS (0)
+#endif
+
+/* Extended header flags that can be combined with the expected type. */
+#define QFU_SUPPORTED_EXT_HDR_FLAGS                                            \
+	(QFU_LZ_EXT_HDR_FLAGS | QFU_BUNDLE_EXT_HDR_FLAGS)
+
+#if (FM_CONFIG_QFU_PIPELINE)
+/*
+ * Estimates (upper bounds) used to compute the DFU poll timeout: the time
+ * needed to erase and program a flash page and the time needed by the
+ * manifestation (i.e., erasing the tail of the previous image and updating
+ * BL-Data).
+ */
+#define QFU_PAGE_PROG_TIME_MS (10)
+#define QFU_MANIFEST_TIME_MS (50)
+#endif
+
+#if (FM_CONFIG_QFU_PROFILE)
+/* Start timing a profiled phase. */
+#define QFU_PROF_START() (prof_ts = (uint32_t)_rdtsc())
+/* Account the cycles elapsed since QFU_PROF_START() to a profile field. */
+#define QFU_PROF_END(field) (qfu_profile.field += (uint32_t)_rdtsc() - prof_ts)
+#else
+#define QFU_PROF_START()
+#define QFU_PROF_END(field)
+#endif
+
+#if (FM_CONFIG_QFU_COMPRESSION)
+/* Whether the image being processed is compressed (or a delta image). */
+#define QFU_IMG_IS_LZ() (img_hdr->ext_hdr_type & QFU_EXT_HDR_LZ)
+#else
+#define QFU_IMG_IS_LZ() (0)
+#endif
+
+#if (FM_CONFIG_QFU_BUNDLE)
+/* Whether the image being processed is a bundle. */
+#define QFU_IMG_IS_BUNDLE() (img_hdr->ext_hdr_type & QFU_EXT_HDR_BUNDLE)
+/* The number of partitions written by the image being processed. */
+#define QFU_IMG_PARTS() (QFU_IMG_IS_BUNDLE() ? bundle->n_payloads : 1)
+/* The number of data blocks of the current payload. */
+#define QFU_PART_DATA_BLOCKS()                                                 \
+	(QFU_IMG_IS_BUNDLE() ? bundle->payloads[payload_idx].n_blocks          \
+			     : (uint32_t)(img_hdr->n_blocks - NUM_HDR_BLOCKS))
+/* The firmware version of the current payload. */
+#define QFU_PART_VERSION()                                                     \
+	(QFU_IMG_IS_BUNDLE() ? bundle->payloads[payload_idx].version           \
+			     : img_hdr->version)
+#else
+#define QFU_IMG_IS_BUNDLE() (0)
+#define QFU_IMG_PARTS() (1)
+#define QFU_PART_DATA_BLOCKS()                                                 \
+	((uint32_t)(img_hdr->n_blocks - NUM_HDR_BLOCKS))
+#define QFU_PART_VERSION() (img_hdr->version)
+#define qfu_select_payload(idx) ((void)(idx))
+#endif
+
 /*-----------------------------------------------------------------------*/
 /* FORWARD DECLARATIONS                                                  */
 /*-----------------------------------------------------------------------*/
@@ -104,6 +191,11 @@ static int qfu_dnl_finalize_transfer(uint32_t block_num);
 static void qfu_upl_fill_block(uint32_t block_num, uint8_t *data,
 			       uint16_t max_len, uint16_t *len);
 static void qfu_abort_transfer(void);
+#if (FM_CONFIG_QFU_PIPELINE)
+static void qfu_bg_work(void);
+#else
+#define qfu_bg_work NULL
+#endif
 
 /*-----------------------------------------------------------------------*/
 /* GLOBAL VARIABLES                                                      */
@@ -117,12 +209,16 @@ static void qfu_abort_transfer(void);
 const dfu_request_handler_t qfu_dfu_rh = {
     &qfu_init, &qfu_get_status, &qfu_clear_status, &qfu_dnl_process_block,
     &qfu_dnl_finalize_transfer, &qfu_upl_fill_block, &qfu_abort_transfer,
+    qfu_bg_work,
 };
 
 /** The DFU (error) status of this DFU request handler. */
 static dfu_dev_status_t qfu_err_status;
 
-/** The partition associated with the current alternate setting. */
+/**
+ * The partition associated with the current alternate setting (for bundles,
+ * the partition of the payload being processed).
+ */
 static bl_flash_partition_t *part;
 /** The current alternate setting; needed to verify the QFU header. */
 static uint8_t active_alt_setting;
@@ -136,26 +232,454 @@ static qfu_hdr_t *const img_hdr = (void *)&hdr_buf;
 /** The buffer where we store the QFU block being processed. */
 /*
  * NOTE: this buffer is introduced to simplify the handling of the last block,
- * which may be smaller than QFU_BLOCK_SIZE and not a multiple of 4 bytes (look
+ * which may be smaller than the block size and not a multiple of 4 bytes (look
  * at qfu_handle_blk() for more details); however, if RAM usage becomes a
  * problem, it can be removed, reusing the qda_buf or usb_buf in some ugly way.
  */
-static uint8_t blk_buf[QFU_BLOCK_SIZE];
+static uint8_t blk_buf[QFU_MAX_BLOCK_SIZE];
+/**
+ * The number of pages of a block of the image being processed (for compressed
+ * images, of a block of decoded data).
+ */
+static uint8_t blk_pages;
 
+/*
+ * Programming state of the block in blk_buf.
+ *
+ * If FM_CONFIG_QFU_PIPELINE is enabled, the block in blk_buf is programmed in
+ * the background (as a single run), while the next block is received in
+ * the transport buffer: i.e., the transport buffer and blk_buf act as a double
+ * buffer. Otherwise, the block is programmed as soon as it is received.
+ */
+/** The number of pages of the block in blk_buf still to be programmed. */
+static uint8_t pending_pages;
+/** The sequence number of the block in blk_buf. */
+static uint32_t pending_blk_num;
+#if (FM_CONFIG_QFU_PIPELINE)
 /**
- * Prepare BL-Data Section to firmware update.
+ * Whether the manifestation of the downloaded image (see qfu_manifest()) is
+ * pending, i.e., deferred to qfu_bg_work().
+ */
+static bool manifest_pending;
+#endif
+
+#if (FM_CONFIG_QFU_COMPRESSION)
+/*
+ * The decoder of compressed images.
+ *
+ * Compressed blocks are decoded into blk_buf, which is programmed every time
+ * it gets full; back-references are resolved by reading back the partition.
+ */
+static qfu_lz_t lz;
+#endif
+
+#if (FM_CONFIG_QFU_BUNDLE)
+/** The bundle descriptor of the image being processed (if a bundle). */
+static const qfu_hdr_bundle_t *const bundle =
+    (const void *)&hdr_buf[sizeof(qfu_hdr_t)];
+/** The index of the payload being processed. */
+static uint32_t payload_idx;
+/** The index (within the image) of the first data block of the payload. */
+static uint32_t payload_first_blk;
+#else
+#define payload_first_blk (0)
+#endif
+
+#if (FM_CONFIG_QFU_DELTA)
+/** The partition containing the base image of the delta image (if any). */
+static const bl_flash_partition_t *base_part;
+#endif
+
+#if (FM_CONFIG_QFU_RESUME)
+/** The partition whose next download can be resumed (see qfu_allow_resume). */
+static uint32_t resume_part_idx = BL_FLASH_PARTITIONS_NUM;
+/** The tag of the QFU image being processed. */
+static sha256_t img_tag;
+#endif
+
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED)
+/** The partition whose next download can skip unchanged blocks. */
+static uint32_t map_part_idx = BL_FLASH_PARTITIONS_NUM;
+/** The number of data blocks covered by block_map. */
+static uint16_t map_n_blocks;
+/** The block size (in pages) of the image block_map refers to. */
+static uint8_t map_blk_pages;
+/** The map of the data blocks to be sent (see qfu_get_block_map()). */
+static uint8_t block_map[QFU_BLOCK_MAP_SIZE];
+/** Whether the current download skips the blocks not in block_map. */
+static bool map_active;
+
+/* Whether data block i is set in a block map. */
+#define BLOCK_MAP_IS_SET(map, i) ((map)[(i) / 8] & BIT((i) % 8))
+#endif
+
+#if (FM_CONFIG_QFU_RESUME || FM_CONFIG_QFU_SKIP_UNCHANGED)
+/**
+ * The number of data blocks skipped so far by the current download (i.e., the
+ * blocks already in flash, which the host does not send).
+ */
+static uint32_t blk_offset;
+#else
+#define blk_offset (0)
+#endif
+
+#if (FM_CONFIG_QFU_PROFILE)
+/* The profile of the last update. */
+qfu_profile_t qfu_profile;
+/* The TSC at the start of the current profiled phase. */
+static uint32_t prof_ts;
+/* The TSC when the QFU header was received. */
+static uint32_t prof_hdr_ts;
+#endif
+
+/**
+ * Get the number of pages of a QFU block.
+ *
+ * @param[in] block_sz The block size in bytes (see QFU_BLOCK_SIZE_IS_VALID()).
+ *
+ * @return The number of pages, 0 if the block size is not valid.
+ */
+static uint8_t qfu_block_pages(uint32_t block_sz)
+{
+	if (!QFU_BLOCK_SIZE_IS_VALID(block_sz)) {
+		return 0;
+	}
+
+	return block_sz / QM_FLASH_PAGE_SIZE_BYTES;
+}
+
+#if (FM_CONFIG_ERASE_ON_DEMAND)
+/**
+ * Get the number of pages written by the image being processed.
+ *
+ * @param[in] decoded Whether the decoding of a compressed image is complete
+ * 		      (if not, the size of compressed images is unknown).
+ *
+ * @return The number of pages.
+ */
+static uint32_t qfu_img_pages(bool decoded)
+{
+#if (FM_CONFIG_QFU_COMPRESSION)
+	if (QFU_IMG_IS_LZ()) {
+		if (!decoded) {
+			return part->num_pages;
+		}
+		return ((lz.out_len + QFU_BLOCK_SIZE - 1) / QFU_BLOCK_SIZE) *
+		       QFU_BLOCK_SIZE_PAGES;
+	}
+#else
+	(void)decoded;
+#endif
+
+	return QFU_PART_DATA_BLOCKS() * blk_pages;
+}
+
+/**
+ * Erase the pages left over from the previous image (i.e., the ones between
+ * the end of the new image and the high-water mark of the partition).
+ */
+static void qfu_erase_tail(void)
+{
+	const uint32_t pages = qfu_img_pages(true);
+
+	if (part->used_pages > pages) {
+		bl_data_erase_pages(part, pages, part->used_pages);
+	}
+	part->used_pages = pages;
+}
+#endif /* FM_CONFIG_ERASE_ON_DEMAND */
+
+#if (FM_CONFIG_QFU_BUNDLE)
+/**
+ * Select a payload of the bundle being processed (if any).
+ *
+ * Set the partition the payload is written to and the index of its first data
+ * block within the image.
+ *
+ * @param[in] idx The index of the payload.
+ */
+static void qfu_select_payload(uint32_t idx)
+{
+	uint32_t i;
+
+	if (!QFU_IMG_IS_BUNDLE()) {
+		return;
+	}
+	payload_idx = idx;
+	payload_first_blk = 0;
+	for (i = 0; i < idx; i++) {
+		payload_first_blk += bundle->payloads[i].n_blocks;
+	}
+	part = &bl_data->partitions[bundle->payloads[idx].partition - 1];
+}
+
+/**
+ * Check the payloads of a bundle.
  *
- * Mark the partition that is going to be updated as inconsistent, so that if
- * the upgrade fails, the partition will be erased during BL-Data sanitization
- * at boot.
+ * Every payload must fit the partition it is written to, and no two payloads
+ * can target the same boot target; the payloads must account for all the
+ * data blocks of the image, starting with the payload of the partition in the
+ * header. On success, the first payload is selected.
+ *
+ * @param[in] n_data_blocks The number of data blocks in the image.
+ *
+ * @return DFU_STATUS_OK if the bundle is valid, an error DFU status otherwise.
  */
-static void prepare_bl_data(void)
+static dfu_dev_status_t qfu_check_bundle(uint16_t n_data_blocks)
+{
+	const qfu_bundle_payload_t *pl;
+	const bl_flash_partition_t *p;
+	uint32_t targets = 0;
+	uint32_t blocks = 0;
+	uint32_t i;
+
+	for (i = 0; i < bundle->n_payloads; i++) {
+		pl = &bundle->payloads[i];
+		if (pl->partition == 0 ||
+		    pl->partition > BL_FLASH_PARTITIONS_NUM || !pl->n_blocks) {
+			return DFU_STATUS_ERR_ADDRESS;
+		}
+		p = &bl_data->partitions[pl->partition - 1];
+		if (pl->n_blocks * blk_pages > QFU_PART_IMG_PAGES(p) ||
+		    (targets & BIT(p->target_idx))) {
+			return DFU_STATUS_ERR_ADDRESS;
+		}
+#if (ENABLE_FIRMWARE_MANAGER_AUTH)
+		/* The SVN must be valid for all the targets. */
+		if (((const qfu_hdr_hmac_t *)QFU_HDR_AUTH_EXT_HDR(img_hdr))
+			->svn < bl_data->targets[p->target_idx].svn) {
+			return DFU_STATUS_ERR_FILE;
+		}
+#endif
+		targets |= BIT(p->target_idx);
+		blocks += pl->n_blocks;
+	}
+	/*
+	 * The payloads must account for all the data blocks, and the first one
+	 * must be the one of the partition of the header.
+	 */
+	if (blocks != n_data_blocks ||
+	    bundle->payloads[0].partition != img_hdr->partition) {
+		return DFU_STATUS_ERR_FILE;
+	}
+	qfu_select_payload(0);
+
+	return DFU_STATUS_OK;
+}
+#endif /* FM_CONFIG_QFU_BUNDLE */
+
+/**
+ * Mark the current partition as inconsistent.
+ */
+static void qfu_prepare_part(void)
 {
 	/* Flag partition as invalid */
 	part->is_consistent = false;
+#if (FM_CONFIG_ERASE_ON_DEMAND)
+	/* Make sanitization erase the pages the image is going to write. */
+	if (part->used_pages < qfu_img_pages(false)) {
+		part->used_pages = qfu_img_pages(false);
+	}
+#endif
+#if (FM_CONFIG_QFU_RESUME)
+	/* A new update begins: nothing to resume yet. */
+	part->resume_blk = 0;
+	memcpy(&part->resume_tag, &img_tag, sizeof(img_tag));
+#endif
+}
+
+/**
+ * Prepare BL-Data Section to firmware update.
+ *
+ * Mark the partitions that are going to be updated (more than one for
+ * bundles) as inconsistent, so that if the upgrade fails, the partitions will
+ * be erased during BL-Data sanitization at boot.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+static int prepare_bl_data(void)
+{
+	uint32_t i;
+
+	/* The loop ends with the first payload selected. */
+	for (i = QFU_IMG_PARTS(); i-- > 0;) {
+		qfu_select_payload(i);
+		qfu_prepare_part();
+	}
 	/* Write back bl-data to flash */
-	bl_data_shadow_writeback();
+	return bl_data_shadow_writeback();
+}
+
+#if (FM_CONFIG_QFU_RESUME)
+/**
+ * Set up the resumption (if allowed) of the download of the current image.
+ *
+ * The image is identified by a tag: the HMAC signature of the header, which
+ * covers the hashes of all the data blocks. The download is resumed if the
+ * host asked for it and the tag matches the one of the interrupted update of
+ * the partition.
+ *
+ * @param[in] n_data_blocks The number of data blocks in the image.
+ */
+static void qfu_setup_resume(uint16_t n_data_blocks)
+{
+	const bool allowed = (resume_part_idx == active_alt_setting - 1U);
+
+	resume_part_idx = BL_FLASH_PARTITIONS_NUM;
+	memcpy(&img_tag,
+	       &((const qfu_hdr_hmac_t *)QFU_HDR_AUTH_EXT_HDR(img_hdr))
+		    ->hashes[n_data_blocks],
+	       sizeof(img_tag));
+	/*
+	 * Compressed images cannot be resumed (the decoder state is lost), nor
+	 * can bundles (the watermark refers to a single partition).
+	 */
+	if (allowed && !QFU_IMG_IS_LZ() && !QFU_IMG_IS_BUNDLE() &&
+	    !part->is_consistent &&
+	    part->resume_blk <= n_data_blocks &&
+	    !memcmp(&part->resume_tag, &img_tag, sizeof(img_tag))) {
+		DBG_PRINTF("Resuming from data block %u\n", part->resume_blk);
+		blk_offset = part->resume_blk;
+	}
+}
+
+/**
+ * Update the resume watermark after a block has been programmed.
+ *
+ * To limit BL-Data writes, the watermark is stored once every
+ * FM_CONFIG_QFU_RESUME_INTERVAL blocks.
+ *
+ * @param[in] blk_num The sequence number of the programmed block.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+static int qfu_update_watermark(uint32_t blk_num)
+{
+	const uint32_t done = blk_num - NUM_HDR_BLOCKS + 1;
+
+	if (QFU_IMG_IS_LZ() || QFU_IMG_IS_BUNDLE() ||
+	    (done % FM_CONFIG_QFU_RESUME_INTERVAL)) {
+		return 0;
+	}
+	part->resume_blk = done;
+
+	return bl_data_shadow_writeback();
+}
+#endif /* FM_CONFIG_QFU_RESUME */
+
+#if (FM_CONFIG_QFU_HOLD_FIRST_WORD)
+/**
+ * Program the first word of the image, which is held back until the update
+ * completes (see resume_first_word).
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+static int qfu_program_first_word(void)
+{
+	return fm_flash_write_words(part->controller, QM_FLASH_REGION_SYS,
+				    part->first_page * QM_FLASH_PAGE_SIZE_BYTES,
+				    part->start_addr, &part->resume_first_word,
+				    1);
 }
+#endif /* FM_CONFIG_QFU_HOLD_FIRST_WORD */
+
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED)
+/**
+ * Set up the skipping of unchanged blocks (if requested) for the current image.
+ *
+ * The block map has been computed (see qfu_get_block_map()) using hashes
+ * provided by the host, so the blocks to be skipped are verified against the
+ * (authenticated) hashes in the header.
+ *
+ * @param[in] n_data_blocks The number of data blocks in the image.
+ *
+ * @return DFU_STATUS_OK on success, an error DFU status otherwise.
+ */
+static dfu_dev_status_t qfu_setup_block_map(uint16_t n_data_blocks)
+{
+	const bool requested = (map_part_idx == active_alt_setting - 1U);
+	const uint8_t *blk_addr = (const uint8_t *)part->start_addr;
+	uint16_t i;
+
+	map_part_idx = BL_FLASH_PARTITIONS_NUM;
+	map_active = false;
+	if (!requested) {
+		return DFU_STATUS_OK;
+	}
+	/*
+	 * The map must be the one of this image (compressed images and bundles
+	 * have none).
+	 */
+	if (map_n_blocks != n_data_blocks || map_blk_pages != blk_pages ||
+	    QFU_IMG_IS_LZ() || QFU_IMG_IS_BUNDLE()) {
+		return DFU_STATUS_ERR_FILE;
+	}
+	for (i = 0; i < n_data_blocks; i++, blk_addr += img_hdr->block_sz) {
+		if (!BLOCK_MAP_IS_SET(block_map, i) &&
+		    qfu_hmac_check_block_hash(blk_addr, img_hdr->block_sz,
+					      img_hdr, i)) {
+			return DFU_STATUS_ERR_FILE;
+		}
+	}
+	map_active = true;
+
+	return DFU_STATUS_OK;
+}
+
+/**
+ * Skip the unchanged blocks preceding the next block sent by the host.
+ *
+ * @param[in] block_num The sequence number of the DFU block being processed.
+ */
+static void qfu_skip_unchanged(uint32_t block_num)
+{
+	uint32_t idx;
+
+	if (!map_active) {
+		return;
+	}
+	idx = block_num + blk_offset - NUM_HDR_BLOCKS;
+	while (idx < map_n_blocks && !BLOCK_MAP_IS_SET(block_map, idx)) {
+		idx++;
+		blk_offset++;
+	}
+}
+#endif /* FM_CONFIG_QFU_SKIP_UNCHANGED */
+
+#if (FM_CONFIG_QFU_DELTA)
+/**
+ * Check the base image of a delta image.
+ *
+ * The base image must be the one in the active partition of the target, while
+ * the delta image must be written to the inactive one. On success, base_part
+ * is set.
+ *
+ * @return DFU_STATUS_OK if the base image is valid, an error DFU status
+ * 	   otherwise.
+ */
+static dfu_dev_status_t qfu_check_delta_base(void)
+{
+	const bl_flash_partition_t *base;
+
+	/* Delta images are LZ streams. */
+	if (!(img_hdr->ext_hdr_type & QFU_EXT_HDR_LZ)) {
+		return DFU_STATUS_ERR_FILE;
+	}
+	base = &bl_data->partitions[bl_data->targets[part->target_idx]
+					.active_partition_idx];
+	if (base == part || !base->is_consistent) {
+		return DFU_STATUS_ERR_TARGET;
+	}
+	/* Hash the base image (the delta descriptor is authenticated). */
+	if (qfu_hmac_check_base_hash(img_hdr, base)) {
+		DBG_PRINTF("Base image mismatch\n");
+		return DFU_STATUS_ERR_TARGET;
+	}
+	base_part = base;
+
+	return DFU_STATUS_OK;
+}
+#endif /* FM_CONFIG_QFU_DELTA */
 
 /**
  * Handle a block expected to contain a QFU header.
@@ -169,13 +693,17 @@ static dfu_dev_status_t qfu_handle_hdr(const uint8_t *data, int len)
 {
 	DBG_PRINTF("handle_qfu_hdr()\n");
 	uint16_t n_data_blocks;
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED || FM_CONFIG_QFU_BUNDLE)
+	dfu_dev_status_t status;
+#endif
 
 	/*
 	 * The length of header blocks must be equal to the QFU block size
 	 * (since the host is expected to pad the header to make its size a
-	 * multiple of the QFU block size).
+	 * multiple of the QFU block size), which is at least QFU_BLOCK_SIZE;
+	 * the block size of the image is checked below.
 	 */
-	if (len != QFU_BLOCK_SIZE) {
+	if (len < QFU_BLOCK_SIZE || len > QFU_MAX_BLOCK_SIZE) {
 		return DFU_STATUS_ERR_ADDRESS;
 	}
 
@@ -208,43 +736,268 @@ static dfu_dev_status_t qfu_handle_hdr(const uint8_t *data, int len)
 	if (img_hdr->partition != active_alt_setting) {
 		return DFU_STATUS_ERR_ADDRESS;
 	}
+#if (FM_CONFIG_QFU_BUNDLE)
+	/* A previous bundle may have left another payload selected. */
+	part = &bl_data->partitions[active_alt_setting - 1];
+	payload_idx = 0;
+	payload_first_blk = 0;
+#endif
 	/*
-	 * Note: even if DFU allows host tools to use a block size smaller than
-	 * the maximum one specified by the device, we force the block size to
-	 * be equal to the maximum block size (i.e., the page size), since this
-	 * simplifies the flashing logic, thus leading to smaller footprint.
-	 *
-	 * This is not a huge limitation, since by default dfu-util uses the
-	 * maximum block size and there is no benefit for users to specify a
-	 * smaller one.
+	 * Note: the block size must be a power-of-two multiple of
+	 * QFU_BLOCK_SIZE (so that a block is made of whole pages), up to the
+	 * maximum block size specified by the device; the host tool must use
+	 * the block size of the image as DFU transfer size (e.g., by means of
+	 * the dfu-util '-t' option).
 	 */
-	if (img_hdr->block_sz != QFU_BLOCK_SIZE) {
+	blk_pages = qfu_block_pages(img_hdr->block_sz);
+	if (!blk_pages) {
 		DBG_PRINTF("Block size error: %d\n", img_hdr->block_sz);
 		return DFU_STATUS_ERR_FILE;
 	}
+	if (len != img_hdr->block_sz) {
+		return DFU_STATUS_ERR_ADDRESS;
+	}
 	n_data_blocks = img_hdr->n_blocks - NUM_HDR_BLOCKS;
-	/* Image size cannot be bigger than the partition size (in pages). */
-	if (n_data_blocks * QFU_BLOCK_SIZE_PAGES > part->num_pages) {
+	/*
+	 * Image size cannot be bigger than the partition size (in pages,
+	 * excluding the staging area, if any); the size of the payloads of
+	 * bundles is checked by qfu_check_bundle().
+	 */
+	if (!QFU_IMG_IS_BUNDLE() &&
+	    n_data_blocks * blk_pages > QFU_PART_IMG_PAGES(part)) {
 		DBG_PRINTF("ERROR: data_blocks > part->num_pages\n");
 		DBG_PRINTF("data_blocks: %d\n", n_data_blocks);
 		DBG_PRINTF("img_hdr->n_blocks: %d\n", img_hdr->n_blocks);
 		return DFU_STATUS_ERR_ADDRESS;
 	}
-	/* The extended header must be the expected one. */
-	if (img_hdr->ext_hdr_type != QFU_EXPECTED_EXT_HDR) {
+	/* The extended header must be the expected one (plus supported flags). */
+	if ((img_hdr->ext_hdr_type & ~QFU_SUPPORTED_EXT_HDR_FLAGS) !=
+	    QFU_EXPECTED_EXT_HDR) {
 		return DFU_STATUS_ERR_FILE;
 	}
+#if (FM_CONFIG_QFU_BUNDLE)
+	/*
+	 * The bundle descriptor determines the layout of the rest of the
+	 * extended header (which must fit our buffer): validate its size
+	 * before authenticating the header. Bundles cannot be compressed.
+	 */
+	if (QFU_IMG_IS_BUNDLE() &&
+	    (QFU_IMG_IS_LZ() || bundle->n_payloads == 0 ||
+	     bundle->n_payloads > QFU_BUNDLE_MAX_PAYLOADS ||
+	     n_data_blocks > QFU_BUNDLE_MAX_DATA_BLOCKS)) {
+		return DFU_STATUS_ERR_FILE;
+	}
+#endif
 	/* Perform checks specific for the current extended header. */
+	QFU_PROF_START();
 	if (qfu_check_ext_hdr(img_hdr, n_data_blocks, part)) {
 		return DFU_STATUS_ERR_FILE;
 	}
+	QFU_PROF_END(hash_cycles);
+#if (FM_CONFIG_QFU_BUNDLE)
+	if (QFU_IMG_IS_BUNDLE()) {
+		status = qfu_check_bundle(n_data_blocks);
+		if (status != DFU_STATUS_OK) {
+			return status;
+		}
+	}
+#endif
+#if (FM_CONFIG_QFU_RESUME || FM_CONFIG_QFU_SKIP_UNCHANGED)
+	blk_offset = 0;
+#endif
+#if (FM_CONFIG_QFU_RESUME)
+	qfu_setup_resume(n_data_blocks);
+#endif
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED)
+	status = qfu_setup_block_map(n_data_blocks);
+	if (status != DFU_STATUS_OK) {
+		return status;
+	}
+#endif
+#if (FM_CONFIG_QFU_DELTA)
+	/* Delta images can be applied only on top of the right base image. */
+	if (img_hdr->ext_hdr_type & QFU_EXT_HDR_DELTA) {
+		return qfu_check_delta_base();
+	}
+#endif
+
+	return DFU_STATUS_OK;
+}
+
+/**
+ * Write a run of pages of the block stored in blk_buf to flash.
+ *
+ * @param[in] blk_num The sequence number of the block in blk_buf.
+ * @param[in] pg_idx  The index of the first page within the block.
+ * @param[in] n_pages The number of pages to be written.
+ *
+ * @return DFU_STATUS_OK on success, DFU_STATUS_ERR_VERIFY otherwise.
+ */
+static dfu_dev_status_t qfu_write_pages(uint32_t blk_num, int pg_idx,
+					int n_pages)
+{
+	uint32_t pg_offset;
+	uint32_t *buf_ptr;
+
+	QFU_PROF_START();
+	pg_offset = blk_num - NUM_HDR_BLOCKS - payload_first_blk;
+	pg_offset = (pg_offset * blk_pages) + pg_idx;
+	buf_ptr = (uint32_t *)blk_buf + (pg_idx * QM_FLASH_PAGE_SIZE_DWORDS);
+#if (FM_CONFIG_QFU_HOLD_FIRST_WORD)
+	/* Hold back the first word of the image (see resume_first_word). */
+	if (pg_offset == 0 && !QFU_IMG_IS_LZ()) {
+		part->resume_first_word = buf_ptr[0];
+		buf_ptr[0] = 0xFFFFFFFF;
+	}
+#endif
+
+	/* The run is verified (in a single pass) once it is programmed. */
+	if (fm_flash_write_pages(part->controller, QM_FLASH_REGION_SYS,
+				 part->first_page + pg_offset,
+				 part->start_addr +
+				     (pg_offset * QM_FLASH_PAGE_SIZE_DWORDS),
+				 buf_ptr, n_pages * QM_FLASH_PAGE_SIZE_DWORDS)) {
+		return DFU_STATUS_ERR_VERIFY;
+	}
+	QFU_PROF_END(flash_cycles);
 
 	return DFU_STATUS_OK;
 }
 
+/**
+ * Program all the pending pages of the block in blk_buf.
+ *
+ * The pages are programmed as a single run (i.e., with a single prefetch
+ * buffer flush and verification). On error, the error is stored in
+ * qfu_err_status (to be reported by qfu_get_status()).
+ *
+ * @return The status of the programming (i.e., qfu_err_status).
+ */
+static dfu_dev_status_t qfu_flush_pending(void)
+{
+	dfu_dev_status_t status;
+
+	if (!pending_pages) {
+		return qfu_err_status;
+	}
+	status = qfu_write_pages(pending_blk_num, blk_pages - pending_pages,
+				 pending_pages);
+	pending_pages = 0;
+	if (status != DFU_STATUS_OK) {
+		qfu_err_status = status;
+	}
+#if (FM_CONFIG_QFU_RESUME)
+	else if (qfu_update_watermark(pending_blk_num)) {
+		qfu_err_status = DFU_STATUS_ERR_WRITE;
+	}
+#endif
+
+	return qfu_err_status;
+}
+
+#if (FM_CONFIG_QFU_COMPRESSION)
+/**
+ * Program the output block of the LZ decoder (i.e., blk_buf) to flash.
+ *
+ * @param[in] blk_idx The index of the decoded block within the partition.
+ *
+ * @return 0 on success, 1 otherwise (the error is stored in qfu_err_status).
+ */
+static int qfu_lz_flush(uint32_t blk_idx)
+{
+	pending_blk_num = blk_idx + NUM_HDR_BLOCKS;
+	pending_pages = blk_pages;
+	if (qfu_flush_pending() != DFU_STATUS_OK) {
+		return 1;
+	}
+	/* Pad the next block with 0xFF, like uncompressed blocks. */
+	memset(blk_buf, 0xFF, sizeof(blk_buf));
+
+	return 0;
+}
+
+/**
+ * Convert a return code of the LZ decoder to a DFU status.
+ */
+static dfu_dev_status_t qfu_lz_status(int rc)
+{
+	switch (rc) {
+	case 0:
+		return DFU_STATUS_OK;
+	case -EIO:
+		/* Flash programming failed. */
+		return qfu_err_status;
+	case -ENOSPC:
+		/* Decoded image bigger than the partition. */
+		return DFU_STATUS_ERR_ADDRESS;
+	default:
+		return DFU_STATUS_ERR_FILE;
+	}
+}
+
+/**
+ * Handle a data block of a compressed QFU image.
+ *
+ * The block is decoded into blk_buf, which is written to flash every time it
+ * gets full; therefore, programming is never deferred for compressed images.
+ *
+ * @param[in] blk_num The sequence number of the block to be processed.
+ * @param[in] data The block to be processed. Must not be null.
+ * @param[in] len  The len of the block.
+ *
+ * @return DFU_STATUS_OK on success, an error DFU status otherwise.
+ */
+static dfu_dev_status_t qfu_handle_lz_blk(uint32_t blk_num,
+					  const uint8_t *data, uint32_t len)
+{
+#if (ENABLE_FIRMWARE_MANAGER_AUTH)
+	/*
+	 * blk_buf holds the decoder output, so the block is verified in place;
+	 * this is safe, since interrupts are disabled while we process it.
+	 */
+	QFU_PROF_START();
+	if (qfu_hmac_check_block_hash(data, len, img_hdr,
+				      blk_num - NUM_HDR_BLOCKS)) {
+		bl_data_sanitize();
+		return DFU_STATUS_ERR_FILE;
+	}
+	QFU_PROF_END(hash_cycles);
+#endif
+	if (blk_num == NUM_HDR_BLOCKS) {
+		if (prepare_bl_data()) {
+			return DFU_STATUS_ERR_WRITE;
+		}
+		/*
+		 * Whatever the block size of the image, data is decoded in
+		 * blocks of QFU_BLOCK_SIZE bytes; the decoded image must not
+		 * overlap the staging area either.
+		 */
+		blk_pages = QFU_BLOCK_SIZE_PAGES;
+		memset(blk_buf, 0xFF, sizeof(blk_buf));
+		qfu_lz_init(&lz, blk_buf, QFU_BLOCK_SIZE,
+			    (const volatile uint8_t *)part->start_addr,
+			    QFU_PART_IMG_PAGES(part) * QM_FLASH_PAGE_SIZE_BYTES,
+			    qfu_lz_flush);
+#if (FM_CONFIG_QFU_DELTA)
+		if (img_hdr->ext_hdr_type & QFU_EXT_HDR_DELTA) {
+			qfu_lz_set_base(
+			    &lz, (const volatile uint8_t *)base_part->start_addr,
+			    ((const qfu_hdr_delta_t *)img_hdr->ext_hdr)
+				->base_len);
+		}
+#endif
+	}
+
+	return qfu_lz_status(qfu_lz_decode(&lz, data, len));
+}
+#endif /* FM_CONFIG_QFU_COMPRESSION */
+
 /**
  * Handle a block expected to contain a QFU data block to be written to flash.
  *
+ * If FM_CONFIG_QFU_PIPELINE is enabled, the block is only validated and
+ * stored in blk_buf: its programming is deferred (see qfu_bg_work()).
+ *
  * @param[in] blk_num The sequence number of the block to be processed.
  * @param[in] data The block to be processed. Must not be null.
  * @param[in] len  The len of the block.
@@ -255,11 +1008,7 @@ static dfu_dev_status_t qfu_handle_blk(uint32_t blk_num, const uint8_t *data,
 				       uint32_t len)
 {
 	DBG_PRINTF("handle_qfu_blk(): blk_num = %u; len = %u\n", blk_num, len);
-	uint32_t target_page;
-	const uint32_t *page_addr;
-	uint32_t *buf_ptr;
-	int i;
-	qm_flash_reg_t *flash_regs;
+	dfu_dev_status_t status;
 
 	/*
 	 * Verify block validity:
@@ -271,6 +1020,28 @@ static dfu_dev_status_t qfu_handle_blk(uint32_t blk_num, const uint8_t *data,
 	    (blk_num + 1 < img_hdr->n_blocks && len != img_hdr->block_sz)) {
 		return DFU_STATUS_ERR_ADDRESS;
 	}
+	/*
+	 * Complete the programming of the previous block (which may still be
+	 * in blk_buf if FM_CONFIG_QFU_PIPELINE is enabled), failing if it was
+	 * not successful.
+	 */
+	status = qfu_flush_pending();
+	if (status != DFU_STATUS_OK) {
+		return status;
+	}
+#if (FM_CONFIG_QFU_BUNDLE)
+	/* Move to the next payload once the current one is complete. */
+	if (QFU_IMG_IS_BUNDLE() &&
+	    blk_num - NUM_HDR_BLOCKS ==
+		payload_first_blk + QFU_PART_DATA_BLOCKS()) {
+		qfu_select_payload(payload_idx + 1);
+	}
+#endif
+#if (FM_CONFIG_QFU_COMPRESSION)
+	if (img_hdr->ext_hdr_type & QFU_EXT_HDR_LZ) {
+		return qfu_handle_lz_blk(blk_num, data, len);
+	}
+#endif
 	/*
 	 * Set our internal block buffer to 0xFF so that we can always write it
 	 * entirely to flash (i.e., we do not have to handle the length of the
@@ -280,6 +1051,7 @@ static dfu_dev_status_t qfu_handle_blk(uint32_t blk_num, const uint8_t *data,
 	/* Copy the block in our internal buffer. */
 	memcpy(blk_buf, data, len);
 #if (ENABLE_FIRMWARE_MANAGER_AUTH)
+	QFU_PROF_START();
 	if (qfu_hmac_check_block_hash(blk_buf, len, img_hdr,
 				      blk_num - NUM_HDR_BLOCKS)) {
 		/*
@@ -291,45 +1063,270 @@ static dfu_dev_status_t qfu_handle_blk(uint32_t blk_num, const uint8_t *data,
 		bl_data_sanitize();
 		return DFU_STATUS_ERR_FILE;
 	}
+	QFU_PROF_END(hash_cycles);
 #endif
 	/* If first data block, prepare bl_data (mark partition as invalid). */
-	if (blk_num == NUM_HDR_BLOCKS) {
-		prepare_bl_data();
+	if (blk_num == NUM_HDR_BLOCKS && prepare_bl_data()) {
+		return DFU_STATUS_ERR_WRITE;
 	}
 	/*
-	 * Write the block to flash, one page at a time (a block can be
-	 * composed of multiple pages.
+	 * Write the block to flash (a block can be composed of multiple
+	 * pages, which are programmed as a single run unless pipelined).
 	 */
-	target_page = part->first_page +
-		      ((blk_num - NUM_HDR_BLOCKS) * QFU_BLOCK_SIZE_PAGES);
-	buf_ptr = (uint32_t *)blk_buf;
-	page_addr = (uint32_t *)part->start_addr +
-		    ((blk_num - NUM_HDR_BLOCKS) * QFU_BLOCK_SIZE_PAGES *
-		     QM_FLASH_PAGE_SIZE_DWORDS);
-	for (i = 0; i < QFU_BLOCK_SIZE_PAGES; i++) {
-		qm_flash_page_write(part->controller, QM_FLASH_REGION_SYS,
-				    target_page, buf_ptr,
-				    QM_FLASH_PAGE_SIZE_DWORDS);
-		/* Flash content has changed, flush prefetch buffer. */
-		flash_regs = QM_FLASH[part->controller];
-		flash_regs->ctrl |= QM_FLASH_CTRL_PRE_FLUSH_MASK;
-		flash_regs->ctrl &= ~QM_FLASH_CTRL_PRE_FLUSH_MASK;
-#if (!UNIT_TEST)
-		/* Verify flash write has been successfully completed. */
-		if (memcmp(buf_ptr, page_addr, QM_FLASH_PAGE_SIZE_BYTES)) {
-			return DFU_STATUS_ERR_VERIFY;
-		}
+	pending_blk_num = blk_num;
+	pending_pages = blk_pages;
+#if (FM_CONFIG_QFU_PIPELINE)
+	/* Defer programming: pages are written by qfu_bg_work(). */
+	return DFU_STATUS_OK;
 #else
-		(void)page_addr;
+	return qfu_flush_pending();
+#endif
+}
+
+/**
+ * Update the BL-Data shadow copy with information about the new firmware in
+ * the current partition.
+ */
+static void qfu_commit_part(void)
+{
+	int t_idx;
+
+#if (FM_CONFIG_ERASE_ON_DEMAND)
+	/*
+	 * Erase what is left of the previous image before marking the
+	 * partition as consistent (if this is interrupted, sanitization erases
+	 * the whole image).
+	 */
+	qfu_erase_tail();
+#endif
+	part->is_consistent = true;
+	part->app_version = QFU_PART_VERSION();
+	t_idx = part->target_idx;
+	bl_data->targets[t_idx].active_partition_idx =
+	    part - bl_data->partitions;
+#if (ENABLE_FIRMWARE_MANAGER_AUTH)
+	bl_data->targets[t_idx].svn =
+	    ((const qfu_hdr_hmac_t *)QFU_HDR_AUTH_EXT_HDR(img_hdr))->svn;
+#endif
+#if (FM_CONFIG_QFU_RESUME)
+	part->resume_blk = 0;
 #endif
-		buf_ptr += QM_FLASH_PAGE_SIZE_DWORDS;
-		page_addr += QM_FLASH_PAGE_SIZE_DWORDS;
-		target_page++;
+#if (FM_CONFIG_TRIAL_BOOT)
+	/*
+	 * Boot the new image on trial (see bl_data_trial_boot()); a
+	 * confirmation left by the previous image must not confirm it.
+	 */
+	bl_data->targets[t_idx].is_on_trial = true;
+	bl_data->targets[t_idx].boot_attempts = 0;
+	FM_BOOT_CONFIRM_DEASSERT(t_idx);
+#endif
+}
+
+/**
+ * Perform the manifestation of the downloaded image.
+ *
+ * Update BL-Data (e.g., application version, SVN, image selector, etc.) with
+ * information about the new application firmware and make the image bootable.
+ * All the partitions written by a bundle are committed by the same BL-Data
+ * update, so that either all of them or none are switched to.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+static int qfu_manifest(void)
+{
+	uint32_t i;
+
+	for (i = QFU_IMG_PARTS(); i-- > 0;) {
+		qfu_select_payload(i);
+		qfu_commit_part();
+	}
+	/* The images are not made bootable if BL-Data cannot be updated. */
+	if (bl_data_shadow_writeback()) {
+		return -EIO;
 	}
+#if (FM_CONFIG_QFU_HOLD_FIRST_WORD)
+	/*
+	 * Make the images bootable only now that BL-Data is updated; if this
+	 * fails, the partition is left consistent but empty.
+	 */
+	for (i = QFU_IMG_PARTS(); i-- > 0;) {
+		qfu_select_payload(i);
+		if (!QFU_IMG_IS_LZ() && qfu_program_first_word()) {
+			return -EIO;
+		}
+	}
+#endif
+#if (FM_CONFIG_QFU_PROFILE)
+	qfu_profile.total_cycles = (uint32_t)_rdtsc() - prof_hdr_ts;
+#endif
 
-	return DFU_STATUS_OK;
+	return 0;
+}
+
+#if (FM_CONFIG_QFU_RESUME)
+void qfu_allow_resume(uint32_t part_idx)
+{
+	resume_part_idx = part_idx;
+}
+#endif
+
+#if (FM_CONFIG_APP_STAGING)
+/**
+ * Verify an image staged by the application into the current (inactive)
+ * partition.
+ *
+ * @param[in] desc The staging descriptor.
+ *
+ * @return 0 if the image is valid, negative errno otherwise.
+ */
+static int qfu_check_staged(const qfu_stage_desc_t *desc)
+{
+	uint16_t n_data_blocks;
+#if (ENABLE_FIRMWARE_MANAGER_AUTH)
+	const uint8_t *blk_addr;
+	uint32_t i, len;
+#endif
+
+	if (qfu_handle_hdr(QFU_STAGE_HDR(part),
+			   ((const qfu_hdr_t *)QFU_STAGE_HDR(part))->block_sz) !=
+	    DFU_STATUS_OK) {
+		return -EINVAL;
+	}
+	/* Only plain images can be staged. */
+	n_data_blocks = img_hdr->n_blocks - NUM_HDR_BLOCKS;
+	if (QFU_IMG_IS_LZ() || QFU_IMG_IS_BUNDLE() || !n_data_blocks ||
+	    desc->img_len > n_data_blocks * img_hdr->block_sz ||
+	    desc->img_len <= (n_data_blocks - 1U) * img_hdr->block_sz) {
+		return -EINVAL;
+	}
+#if (ENABLE_FIRMWARE_MANAGER_AUTH)
+	/* The first word is held back: hash the first block from RAM. */
+	for (i = 0; i < n_data_blocks; i++) {
+		blk_addr = (const uint8_t *)part->start_addr +
+			   (i * img_hdr->block_sz);
+		len = desc->img_len - (i * img_hdr->block_sz);
+		if (len > img_hdr->block_sz) {
+			len = img_hdr->block_sz;
+		}
+		if (i == 0) {
+			memcpy(blk_buf, blk_addr, len);
+			memcpy(blk_buf, &desc->first_word, sizeof(uint32_t));
+			blk_addr = blk_buf;
+		}
+		if (qfu_hmac_check_block_hash(blk_addr, len, img_hdr, i)) {
+			return -EINVAL;
+		}
+	}
+#endif
+
+	return 0;
 }
 
+int qfu_commit_staged(void)
+{
+	const qfu_stage_desc_t *desc;
+	uint32_t i;
+
+	/*
+	 * The active partition is never considered: it holds the running
+	 * application, which must not be touched whatever its staging area
+	 * contains.
+	 */
+	for (i = 0; i < BL_FLASH_PARTITIONS_NUM; i++) {
+		part = &bl_data->partitions[i];
+		desc = QFU_STAGE_DESC(part);
+		if (part->target_idx == BL_TARGET_IDX_LMT &&
+		    bl_data->targets[BL_TARGET_IDX_LMT].active_partition_idx !=
+			i &&
+		    desc->magic == QFU_STAGE_MAGIC) {
+			break;
+		}
+	}
+	if (i == BL_FLASH_PARTITIONS_NUM) {
+		return 0;
+	}
+#if (FM_CONFIG_TRIAL_BOOT)
+	/*
+	 * The staging partition is the one the running image would be rolled
+	 * back to: keep the staged image until the running one is confirmed
+	 * (the library refuses to stage in this case, but the x86 target may
+	 * have been updated through DFU after the image was staged).
+	 */
+	if (bl_data->targets[BL_TARGET_IDX_LMT].is_on_trial) {
+		return -EBUSY;
+	}
+#endif
+	active_alt_setting = i + 1;
+	pending_pages = 0;
+	if (qfu_check_staged(desc)) {
+		/*
+		 * Discard the staged image by erasing the staging area only
+		 * (the partition is inactive); the application may have
+		 * programmed any page below it, so raise the high-water mark
+		 * to have them erased by the next download.
+		 */
+		bl_data_erase_pages(part, part->num_pages - QFU_STAGE_PAGES,
+				    part->num_pages);
+		part->used_pages = part->num_pages;
+		bl_data_shadow_writeback();
+		return -EINVAL;
+	}
+	/*
+	 * Mark the partition as inconsistent (including the staging area, so
+	 * that an interrupted commit is sanitized) and install the image as if
+	 * it had just been downloaded: qfu_manifest() erases the staging area,
+	 * activates the partition and programs the first word.
+	 */
+	qfu_prepare_part();
+	part->used_pages = part->num_pages;
+	part->resume_first_word = desc->first_word;
+	if (bl_data_shadow_writeback()) {
+		return -EIO;
+	}
+
+	return qfu_manifest();
+}
+#endif /* FM_CONFIG_APP_STAGING */
+
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED)
+int qfu_get_block_map(uint32_t part_idx, const sha256_t *hashes,
+		      uint16_t n_blocks, uint32_t block_sz, uint8_t *map)
+{
+	const bl_flash_partition_t *p;
+	const uint8_t *blk_addr;
+	const uint8_t pages = qfu_block_pages(block_sz);
+	uint16_t i;
+
+	if (part_idx >= BL_FLASH_PARTITIONS_NUM || !pages) {
+		return -EINVAL;
+	}
+	p = &bl_data->partitions[part_idx];
+	if (n_blocks == 0 || n_blocks * pages > p->num_pages) {
+		return -EINVAL;
+	}
+	memset(map, 0, QFU_BLOCK_MAP_SIZE);
+	blk_addr = (const uint8_t *)p->start_addr;
+	for (i = 0; i < n_blocks; i++, blk_addr += block_sz) {
+		/*
+		 * The first block is always sent, so that the image becomes
+		 * bootable only when the download completes (see
+		 * qfu_write_pages()); so is the last one, since its length (on
+		 * which its hash depends) is unknown.
+		 */
+		if (i == 0 || i == n_blocks - 1 ||
+		    qfu_hmac_check_sha256(blk_addr, block_sz, &hashes[i])) {
+			map[i / 8] |= BIT(i % 8);
+		}
+	}
+	memcpy(block_map, map, sizeof(block_map));
+	map_n_blocks = n_blocks;
+	map_blk_pages = pages;
+	map_part_idx = part_idx;
+
+	return 0;
+}
+#endif
+
 /*-----------------------------------------------------------------------*/
 /* STATIC FUNCTIONS (DFU Request Handler implementation)                 */
 /*-----------------------------------------------------------------------*/
@@ -346,6 +1343,17 @@ static void qfu_init(uint8_t alt_setting)
 	/* Decrement alt setting since first QFU alt setting is 1 and not 0 */
 	part = &bl_data->partitions[alt_setting - 1];
 	qfu_err_status = DFU_STATUS_OK;
+	/* Drop any pending programming of a previous (unfinished) transfer. */
+	pending_pages = 0;
+#if (FM_CONFIG_QFU_PIPELINE)
+	manifest_pending = false;
+#endif
+#if (FM_CONFIG_QFU_RESUME || FM_CONFIG_QFU_SKIP_UNCHANGED)
+	blk_offset = 0;
+#endif
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED)
+	map_active = false;
+#endif
 	/* Call bl-data for extra safety (we ensure bl-data consistency) */
 	bl_data_sanitize();
 }
@@ -359,12 +1367,20 @@ static void qfu_init(uint8_t alt_setting)
 static void qfu_get_status(dfu_dev_status_t *status, uint32_t *poll_timeout_ms)
 {
 	*status = qfu_err_status;
+#if (FM_CONFIG_QFU_PIPELINE)
 	/*
-	 * NOTE: poll_timeout is always set to zero because the flash is
-	 * updated in qfu_dnl_process_block() (i.e., as soon as the block is
-	 * received). This is fine for QDA but may need to be changed for USB.
+	 * Report the time needed by the pending background work: DFU core
+	 * uses it as poll timeout (in asynchronous mode) or drops it, letting
+	 * the work overlap with the reception of the next block.
 	 */
+	*poll_timeout_ms = pending_pages * QFU_PAGE_PROG_TIME_MS;
+	if (manifest_pending) {
+		*poll_timeout_ms += QFU_MANIFEST_TIME_MS;
+	}
+#else
+	/* The flash is updated as soon as the block is received. */
 	*poll_timeout_ms = 0;
+#endif
 }
 
 /*
@@ -380,6 +1396,10 @@ static void qfu_clear_status(void)
 	 * upgrade; therefore we call bl_data_sanitize() to ensure that bl-data
 	 * is fixed and inconsistent partitions are erased if needed.
 	 */
+	pending_pages = 0;
+#if (FM_CONFIG_QFU_PIPELINE)
+	manifest_pending = false;
+#endif
 	bl_data_sanitize();
 	qfu_err_status = DFU_STATUS_OK;
 }
@@ -396,10 +1416,25 @@ static void qfu_dnl_process_block(uint32_t block_num, const uint8_t *data,
 	qm_irq_disable();
 	if (block_num == 0) {
 		/* Header block */
+#if (FM_CONFIG_QFU_PROFILE)
+		memset(&qfu_profile, 0, sizeof(qfu_profile));
+		prof_hdr_ts = (uint32_t)_rdtsc();
+#endif
 		qfu_err_status = qfu_handle_hdr(data, len);
 	} else {
-		/* Data block */
-		qfu_err_status = qfu_handle_blk(block_num, data, len);
+#if (FM_CONFIG_QFU_PROFILE)
+		qfu_profile.blocks++;
+#endif
+		/*
+		 * Data block (if the download has been resumed or skips
+		 * unchanged blocks, the blocks already in flash have been
+		 * skipped by the host).
+		 */
+#if (FM_CONFIG_QFU_SKIP_UNCHANGED)
+		qfu_skip_unchanged(block_num);
+#endif
+		qfu_err_status =
+		    qfu_handle_blk(block_num + blk_offset, data, len);
 	}
 	/* Re-enable interrupts before returning */
 	qm_irq_enable();
@@ -411,34 +1446,51 @@ static void qfu_dnl_process_block(uint32_t block_num, const uint8_t *data,
  * This function is called by DFU Core when an empty DFU_DNLOAD request
  * (signaling the end of the current DFU_DNLOAD transfer) is received.
  *
- * In case of the QFU handler, this is where bootloader data (e.g., application
- * version, SVN, image selector, etc.) get updated with information about the
- * new application firmware.
+ * In case of the QFU handler, this is where the download is verified and the
+ * manifestation (see qfu_manifest()) is started; if FM_CONFIG_QFU_PIPELINE is
+ * enabled, the manifestation is performed in the background and its result is
+ * reported by qfu_get_status().
  *
  * A error is returned if additional header blocks were expected.
  */
 static int qfu_dnl_finalize_transfer(uint32_t block_num)
 {
 	DBG_PRINTF("Finalize update\n");
-	int t_idx;
 
-	/* Fail if we did not received the right number of blocks. */
-	if (block_num != img_hdr->n_blocks) {
+#if (FM_CONFIG_QFU_PIPELINE)
+	/* Complete the programming of the last block. */
+	qm_irq_disable();
+	qfu_flush_pending();
+	qm_irq_enable();
+#endif
+#if (FM_CONFIG_QFU_COMPRESSION)
+	/* Complete the decoding and program the last decoded block. */
+	if ((img_hdr->ext_hdr_type & QFU_EXT_HDR_LZ) &&
+	    block_num > NUM_HDR_BLOCKS && qfu_err_status == DFU_STATUS_OK) {
+		qm_irq_disable();
+		qfu_err_status = qfu_lz_status(qfu_lz_finish(&lz));
+		qm_irq_enable();
+	}
+#endif
+	/*
+	 * Fail if we did not received the right number of blocks or if the
+	 * programming of a block failed.
+	 */
+	if (block_num + blk_offset != img_hdr->n_blocks ||
+	    qfu_err_status != DFU_STATUS_OK) {
 		/* call bl_data_sanitize() to erase inconsistent partitions. */
 		bl_data_sanitize();
 		return -EINVAL;
 	}
 
-	part->is_consistent = true;
-	part->app_version = img_hdr->version;
-	t_idx = part->target_idx;
-	bl_data->targets[t_idx].active_partition_idx = active_alt_setting - 1;
-#if (ENABLE_FIRMWARE_MANAGER_AUTH)
-	bl_data->targets[t_idx].svn = ((qfu_hdr_hmac_t *)img_hdr->ext_hdr)->svn;
-#endif
-	bl_data_shadow_writeback();
+#if (FM_CONFIG_QFU_PIPELINE)
+	/* Defer the manifestation: it is performed by qfu_bg_work(). */
+	manifest_pending = true;
 
 	return 0;
+#else
+	return qfu_manifest();
+#endif
 }
 
 /*
@@ -469,6 +1521,40 @@ static void qfu_upl_fill_block(uint32_t blk_num, uint8_t *data,
  */
 static void qfu_abort_transfer(void)
 {
+	pending_pages = 0;
+#if (FM_CONFIG_QFU_PIPELINE)
+	manifest_pending = false;
+#endif
 	/* bl_data_sanitize() erases inconsistent partitions if needed. */
 	bl_data_sanitize();
 }
+
+#if (FM_CONFIG_QFU_PIPELINE)
+/*
+ * Perform a step of background work.
+ *
+ * This function is called by DFU core (on behalf of the transport layer) when
+ * idle: program the pending pages of the last received block (as a single
+ * run) or, once the download is over, perform the manifestation.
+ *
+ * NOTE: unlike qfu_dnl_process_block(), interrupts are not disabled here,
+ * since the transport layer relies on them to receive the next block while we
+ * program the flash; in FM mode, the only interrupts enabled are the ones of
+ * the FM transport itself.
+ */
+static void qfu_bg_work(void)
+{
+	if (pending_pages) {
+		/*
+		 * The transport keeps receiving (in its ISR) while the block
+		 * is programmed; see RX_BUF_SIZE in xmodem_io_uart.c.
+		 */
+		qfu_flush_pending();
+	} else if (manifest_pending) {
+		if (qfu_manifest()) {
+			qfu_err_status = DFU_STATUS_ERR_WRITE;
+		}
+		manifest_pending = false;
+	}
+}
+#endif
@@ -31,6 +31,7 @@
 #define __QFU_H__
 
 #include "../dfu/dfu.h"
+#include "qfu_format.h"
 
 /**
  * Quark Firmware Update (QFU).
@@ -54,6 +55,93 @@
  */
 extern const dfu_request_handler_t qfu_dfu_rh;
 
+/**
+ * QFU update profile (see FM_CONFIG_QFU_PROFILE).
+ *
+ * The profile of the last (or current) update, in CPU cycles (lower 32 bits
+ * of the TSC). It is reset when a QFU header is received.
+ */
+typedef struct {
+	/** The number of data blocks received. */
+	uint32_t blocks;
+	/** The cycles from the header to the end of the update (0 if failed). */
+	uint32_t total_cycles;
+	/** The cycles spent verifying the header and block hashes. */
+	uint32_t hash_cycles;
+	/** The cycles spent programming (and verifying) flash pages. */
+	uint32_t flash_cycles;
+} qfu_profile_t;
+
+/**
+ * The QFU update profile.
+ *
+ * Only available if FM_CONFIG_QFU_PROFILE is enabled.
+ */
+extern qfu_profile_t qfu_profile;
+
+/**
+ * Allow the next QFU download to a partition to resume an interrupted one.
+ *
+ * If the image of the next QFU download to the partition is the one whose
+ * download was interrupted (i.e., its tag matches the one stored in BL-Data),
+ * the download is resumed from the BL-Data watermark: the data blocks already
+ * programmed are expected to be omitted by the host, i.e., the header block is
+ * followed by data block 'resume_blk'. Otherwise, the download starts from
+ * scratch as usual.
+ *
+ * Only available if FM_CONFIG_QFU_RESUME is enabled.
+ *
+ * @param[in] part_idx The index of the partition.
+ */
+void qfu_allow_resume(uint32_t part_idx);
+
+/**
+ * Compute the map of the blocks of an image that differ from the partition.
+ *
+ * Compare the hash of each data block of the image with the hash of the
+ * corresponding block in the partition and set the bit of the blocks that
+ * differ (the first and the last data blocks are always set). Then allow the
+ * next QFU download to the partition to skip the unchanged blocks: the host is
+ * expected to send the header block followed by the blocks set in the map
+ * only. The skipped blocks are verified again against the authenticated
+ * hashes in the QFU header.
+ *
+ * Only available if FM_CONFIG_QFU_SKIP_UNCHANGED is enabled.
+ *
+ * @param[in]  part_idx The index of the partition.
+ * @param[in]  hashes   The SHA256 hashes of the data blocks of the image.
+ * 			Must not be null.
+ * @param[in]  n_blocks The number of data blocks of the image.
+ * @param[in]  block_sz The block size of the image.
+ * @param[out] map      The map of the blocks to be sent (QFU_BLOCK_MAP_SIZE
+ * 			bytes). Must not be null.
+ *
+ * @return 0 on success, -EINVAL if the partition, the number of blocks or the
+ * 	   block size is not valid.
+ */
+int qfu_get_block_map(uint32_t part_idx, const sha256_t *hashes,
+		      uint16_t n_blocks, uint32_t block_sz, uint8_t *map);
+
+/**
+ * Install the image staged by the application (if any).
+ *
+ * Look for an image staged into an inactive x86 partition (see
+ * fw-manager/staging/qfu_stage.h) and verify it as if it had been downloaded
+ * with DFU: the staged QFU header is checked (and authenticated) and, if
+ * authentication is enabled, so is every data block. A valid image is then
+ * made active (and booted on trial), while an invalid one is erased.
+ *
+ * While the x86 target is on trial, the staged image is left in place and
+ * committed at a later boot, once the running image is confirmed: this
+ * function must therefore be called after bl_data_trial_boot().
+ *
+ * Only available if FM_CONFIG_APP_STAGING is enabled.
+ *
+ * @return 0 if no image is staged or the staged image has been installed,
+ * 	   -EBUSY if the x86 target is on trial, negative errno otherwise.
+ */
+int qfu_commit_staged(void);
+
 /**
  * @}
  */
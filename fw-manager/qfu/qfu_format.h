@@ -46,6 +46,84 @@ typedef enum {
 	QFU_EXT_HDR_HMAC256 = 2, /**< HMAC256 authentication extended header. */
 } qfu_auth_type_t;
 
+/**
+ * Compressed-payload flag of the extended header type.
+ *
+ * The flag can be combined with any authentication type (e.g.,
+ * QFU_EXT_HDR_HMAC256 | QFU_EXT_HDR_LZ) and does not change the layout of the
+ * extended header. When set, the data blocks are the QFU LZ stream (see below)
+ * of the firmware image split in blocks of block_sz bytes; block hashes (if
+ * any) are computed on the compressed blocks.
+ */
+#define QFU_EXT_HDR_LZ (0x0100)
+/**
+ * Delta-payload flag of the extended header type.
+ *
+ * The flag must be combined with QFU_EXT_HDR_LZ: the data blocks are a QFU LZ
+ * stream that can also copy data from a base image (i.e., the image in the
+ * active partition of the target). When set, the extended header starts with
+ * a delta descriptor (qfu_hdr_delta_t) followed by the authentication-specific
+ * part (e.g., qfu_hdr_hmac_t).
+ */
+#define QFU_EXT_HDR_DELTA (0x0200)
+/**
+ * Bundle flag of the extended header type.
+ *
+ * When set, the image carries the payloads (i.e., the firmware images) of
+ * several partitions, typically one for each target, to be updated together:
+ * the extended header starts with a bundle descriptor (qfu_hdr_bundle_t)
+ * followed by the authentication-specific part, and the data blocks are the
+ * concatenation of the payloads, each one padded to a multiple of block_sz
+ * bytes. Block hashes (if any) are indexed by the position of the block in the
+ * image. The flag cannot be combined with QFU_EXT_HDR_LZ.
+ */
+#define QFU_EXT_HDR_BUNDLE (0x0400)
+/** Mask to extract the authentication type from the extended header type. */
+#define QFU_EXT_HDR_AUTH_MASK (0x00FF)
+
+/*
+ * QFU LZ stream format.
+ *
+ * The stream is a sequence of tokens, each starting with a control byte C:
+ *
+ * - C < 0x80: literal run; (C + 1) bytes follow and are copied to the output.
+ * - C >= 0x80: match; the length is (C & 0x7F) + QFU_LZ_MIN_MATCH, unless
+ *   (C & 0x7F) == 0x7F, in which case extension bytes follow and are added to
+ *   the length until one different from 0xFF is found. Then a 16-bit little
+ *   endian offset (1 to 65535) follows: the match is a copy of 'length' bytes
+ *   starting 'offset' bytes back in the output (the copy may overlap itself,
+ *   e.g., an offset of 1 repeats the last byte).
+ */
+/*
+ * In delta streams, a match with offset 0 is a copy from the base image: a
+ * 24-bit little endian position in the base image follows the offset.
+ */
+#define QFU_LZ_MIN_MATCH (3)
+#define QFU_LZ_MATCH_FLAG (0x80)
+#define QFU_LZ_LEN_MASK (0x7F)
+
+/** The maximum number of data blocks of a QFU image. */
+#define QFU_MAX_DATA_BLOCKS (BL_PARTITION_MAX_PAGES / QFU_BLOCK_SIZE_PAGES)
+
+/**
+ * Whether a QFU block size is valid.
+ *
+ * Valid block sizes are the power-of-two multiples of QFU_BLOCK_SIZE up to
+ * QFU_MAX_BLOCK_SIZE.
+ */
+#define QFU_BLOCK_SIZE_IS_VALID(sz)                                            \
+	((sz) >= QFU_BLOCK_SIZE && (sz) <= QFU_MAX_BLOCK_SIZE &&               \
+	 !((sz) % QFU_BLOCK_SIZE) &&                                           \
+	 !(((sz) / QFU_BLOCK_SIZE) & (((sz) / QFU_BLOCK_SIZE) - 1)))
+
+/**
+ * The size of a QFU block map.
+ *
+ * A block map has one bit per data block (bit i % 8 of byte i / 8 for data
+ * block i); see QFM_BLOCK_MAP_REQ.
+ */
+#define QFU_BLOCK_MAP_SIZE ((QFU_MAX_DATA_BLOCKS + 7) / 8)
+
 /**
  * The structure of the QFU header.
  *
@@ -66,6 +144,69 @@ typedef struct __attribute__((__packed__)) {
 	uint32_t ext_hdr[];    /**< Pointer to the extended header. */
 } qfu_hdr_t;
 
+/**
+ * The structure of the QFU delta descriptor.
+ *
+ * Present at the beginning of the extended header of delta images.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t base_len;	/**< Length of the base image. */
+	sha256_t base_digest;	/**< SHA256 hash of the base image. */
+} qfu_hdr_delta_t;
+
+/** The maximum number of payloads of a bundle (one for each target). */
+#define QFU_BUNDLE_MAX_PAYLOADS (BL_BOOT_TARGETS_NUM)
+/** The maximum number of data blocks of a bundle. */
+#define QFU_BUNDLE_MAX_DATA_BLOCKS                                             \
+	(QFU_BUNDLE_MAX_PAYLOADS * QFU_MAX_DATA_BLOCKS)
+
+/**
+ * The structure describing a payload of a bundle.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint16_t partition; /**< Target partition ID. */
+	uint16_t n_blocks;  /**< Number of data blocks of the payload. */
+	uint32_t version;   /**< Firmware version of the payload. */
+} qfu_bundle_payload_t;
+
+/**
+ * The structure of the QFU bundle descriptor.
+ *
+ * Present at the beginning of the extended header of bundles.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t n_payloads;              /**< Number of payloads. */
+	qfu_bundle_payload_t payloads[]; /**< Payloads, in image order. */
+} qfu_hdr_bundle_t;
+
+/** The size of a bundle descriptor with n payloads. */
+#define QFU_HDR_BUNDLE_SIZE(n)                                                 \
+	(sizeof(qfu_hdr_bundle_t) + ((n) * sizeof(qfu_bundle_payload_t)))
+
+/**
+ * Get the size of the descriptor (if any) preceding the authentication-specific
+ * part of the extended header.
+ *
+ * For bundles, the number of payloads must have been validated.
+ */
+#define QFU_HDR_PREFIX_SIZE(hdr)                                               \
+	(((hdr)->ext_hdr_type & QFU_EXT_HDR_DELTA)                             \
+	     ? sizeof(qfu_hdr_delta_t)                                         \
+	     : ((hdr)->ext_hdr_type & QFU_EXT_HDR_BUNDLE)                      \
+		   ? QFU_HDR_BUNDLE_SIZE(                                      \
+			 ((const qfu_hdr_bundle_t *)(hdr)->ext_hdr)->n_payloads) \
+		   : 0)
+
+/**
+ * Get the authentication-specific part of the extended header.
+ *
+ * That is, the extended header itself, unless a delta or bundle descriptor
+ * precedes it.
+ */
+#define QFU_HDR_AUTH_EXT_HDR(hdr)                                              \
+	((const void *)((const uint8_t *)(hdr)->ext_hdr +                      \
+			QFU_HDR_PREFIX_SIZE(hdr)))
+
 /**
  * The structure of the QFU SHA256 extended header.
  */
@@ -103,4 +244,60 @@ typedef struct __attribute__((__packed__)) {
 	sha256_t hashes[];
 } qfu_hdr_hmac_t;
 
+/*
+ * In-application staging (see FM_CONFIG_APP_STAGING).
+ *
+ * An application can stage an (uncompressed) QFU image into an inactive
+ * partition: the data blocks are programmed at the beginning of the partition
+ * as usual (with the first word held back), while the last QFU_STAGE_PAGES
+ * pages of the partition (the staging area) hold the QFU header followed,
+ * at the very end, by a staging descriptor (qfu_stage_desc_t). The image is
+ * verified and installed by the bootloader at the next boot.
+ */
+
+/** The number of pages of the staging area. */
+#define QFU_STAGE_PAGES (QFU_MAX_BLOCK_SIZE_PAGES)
+/** The number of header bytes kept in the staging area. */
+#define QFU_STAGE_HDR_SIZE                                                     \
+	(QFU_STAGE_PAGES * QM_FLASH_PAGE_SIZE_BYTES - sizeof(qfu_stage_desc_t))
+/** QFU_STAGE_MAGIC = "QSTG" */
+#define QFU_STAGE_MAGIC (0x47545351)
+
+/**
+ * The structure of the staging descriptor.
+ *
+ * The descriptor is programmed once all the data blocks have been staged,
+ * magic last.
+ */
+typedef struct __attribute__((__packed__)) {
+	uint32_t img_len;    /**< The length of the image (data blocks only). */
+	uint32_t first_word; /**< The first word of the image (held back). */
+	uint32_t magic;      /**< QFU_STAGE_MAGIC if an image is staged. */
+} qfu_stage_desc_t;
+
+/** Get the staged QFU header of a partition. */
+#define QFU_STAGE_HDR(part)                                                    \
+	((const uint8_t *)(part)->start_addr +                                 \
+	 (((part)->num_pages - QFU_STAGE_PAGES) * QM_FLASH_PAGE_SIZE_BYTES))
+
+/** Get the staging descriptor of a partition. */
+#define QFU_STAGE_DESC(part)                                                   \
+	((const qfu_stage_desc_t *)(QFU_STAGE_HDR(part) +                      \
+				    QFU_STAGE_HDR_SIZE))
+
+/**
+ * Get the number of pages of a partition an image can occupy.
+ *
+ * Images downloaded into x86 partitions must not overlap the staging area,
+ * which is otherwise mistaken for a staged image at the next boot.
+ */
+#if (FM_CONFIG_APP_STAGING)
+#define QFU_PART_IMG_PAGES(part)                                               \
+	((part)->target_idx == BL_TARGET_IDX_LMT                               \
+	     ? (part)->num_pages - QFU_STAGE_PAGES                             \
+	     : (part)->num_pages)
+#else
+#define QFU_PART_IMG_PAGES(part) ((part)->num_pages)
+#endif
+
 #endif /* __QFU_FORMAT_H__ */
@@ -50,7 +50,7 @@ int qfu_hmac_check_hdr(const qfu_hdr_t *qfu_hdr, uint16_t n_data_blocks,
 	sha256_t hmac_digest;
 	int hdr_size;
 	int retv;
-	const qfu_hdr_hmac_t *hmac_hdr = (void *)qfu_hdr->ext_hdr;
+	const qfu_hdr_hmac_t *hmac_hdr = QFU_HDR_AUTH_EXT_HDR(qfu_hdr);
 	const int t_idx = part->target_idx;
 
 	/*
@@ -77,6 +77,8 @@ int qfu_hmac_check_hdr(const qfu_hdr_t *qfu_hdr, uint16_t n_data_blocks,
 	 */
 	hdr_size = sizeof(*qfu_hdr) + sizeof(qfu_hdr_hmac_t) +
 		   (sizeof(sha256_t) * (n_data_blocks));
+	/* The delta or bundle descriptor (if any) is authenticated as well. */
+	hdr_size += QFU_HDR_PREFIX_SIZE(qfu_hdr);
 	/* Compute HMAC and verify that the one in the header matches it. */
 	fm_hmac_compute_hmac(qfu_hdr, hdr_size, &bl_data->fw_key, &hmac_digest);
 	retv = memcmp(&hmac_digest, &hmac_hdr->hashes[n_data_blocks],
@@ -85,18 +87,41 @@ int qfu_hmac_check_hdr(const qfu_hdr_t *qfu_hdr, uint16_t n_data_blocks,
 	return retv;
 }
 
-/* Validate image block. */
-int qfu_hmac_check_block_hash(const uint8_t *data, uint32_t len,
-			      const qfu_hdr_t *qfu_hdr, uint32_t data_blk_num)
+/* Check the SHA256 hash of some data. */
+int qfu_hmac_check_sha256(const uint8_t *data, uint32_t len,
+			  const sha256_t *expected)
 {
 	struct tc_sha256_state_struct ctx;
 	sha256_t digest;
-	const qfu_hdr_hmac_t *hmac_hdr = (void *)qfu_hdr->ext_hdr;
-	const sha256_t *block_hash = &hmac_hdr->hashes[data_blk_num];
 
 	tc_sha256_init(&ctx);
 	tc_sha256_update(&ctx, data, len);
 	tc_sha256_final(digest.u8, &ctx);
 
-	return memcmp(&digest, block_hash, sizeof(sha256_t));
+	return memcmp(&digest, expected, sizeof(sha256_t));
+}
+
+/* Validate image block. */
+int qfu_hmac_check_block_hash(const uint8_t *data, uint32_t len,
+			      const qfu_hdr_t *qfu_hdr, uint32_t data_blk_num)
+{
+	const qfu_hdr_hmac_t *hmac_hdr = QFU_HDR_AUTH_EXT_HDR(qfu_hdr);
+
+	return qfu_hmac_check_sha256(data, len,
+				     &hmac_hdr->hashes[data_blk_num]);
+}
+
+/* Validate the base image of a delta image. */
+int qfu_hmac_check_base_hash(const qfu_hdr_t *qfu_hdr,
+			     const bl_flash_partition_t *base)
+{
+	const qfu_hdr_delta_t *delta_hdr = (void *)qfu_hdr->ext_hdr;
+
+	if (delta_hdr->base_len > base->num_pages * QM_FLASH_PAGE_SIZE_BYTES) {
+		return -1;
+	}
+
+	return qfu_hmac_check_sha256((const uint8_t *)base->start_addr,
+				     delta_hdr->base_len,
+				     &delta_hdr->base_digest);
 }
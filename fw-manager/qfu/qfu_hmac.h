@@ -48,7 +48,7 @@
  */
 #define QFU_HMAC_HDR_MAX_SIZE                                                  \
 	(QFU_HMAC_FIXED_SIZE +                                                 \
-	 (sizeof(sha256_t) * (BL_PARTITION_MAX_PAGES / QFU_BLOCK_SIZE_PAGES)))
+	 (sizeof(sha256_t) * QFU_MAX_DATA_BLOCKS))
 
 /**
  * Check validity of the QFU HMAC header.
@@ -66,6 +66,19 @@
 int qfu_hmac_check_hdr(const qfu_hdr_t *qfu_hdr, uint16_t n_data_blocks,
 		       const bl_flash_partition_t *part);
 
+/**
+ * Check the SHA256 hash of some data.
+ *
+ * @param[in] data A pointer to the data. Must not be null.
+ * @param[in] len  The length of the data.
+ * @param[in] expected The expected hash. Must not be null.
+ *
+ * @return 0 if the hash of the data matches the expected one, nonzero value
+ * 	   otherwise.
+ */
+int qfu_hmac_check_sha256(const uint8_t *data, uint32_t len,
+			  const sha256_t *expected);
+
 /**
  * Check validity of a data block.
  *
@@ -79,4 +92,19 @@ int qfu_hmac_check_hdr(const qfu_hdr_t *qfu_hdr, uint16_t n_data_blocks,
 int qfu_hmac_check_block_hash(const uint8_t *data, uint32_t len,
 			      const qfu_hdr_t *qfu_hdr, uint32_t data_blk_num);
 
+/**
+ * Check validity of the base image of a delta image.
+ *
+ * Verify that the SHA256 hash of the first base_len bytes of the base
+ * partition matches the one in the delta descriptor.
+ *
+ * @param[in] qfu_hdr A pointer to the entire QFU header of a delta image. Must
+ * 		      not be null.
+ * @param[in] base The partition containing the base image. Must not be null.
+ *
+ * @return 0 if the base image is valid, nonzero value otherwise.
+ */
+int qfu_hmac_check_base_hash(const qfu_hdr_t *qfu_hdr,
+			     const bl_flash_partition_t *base);
+
 #endif /* __QFU_HMAC_H__ */
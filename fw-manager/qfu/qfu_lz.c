@@ -0,0 +1,239 @@
+/**
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "qm_common.h"
+
+#include "qfu_format.h"
+#include "qfu_lz.h"
+
+/** Decoder states. */
+enum {
+	LZ_CTRL = 0, /**< Waiting for a control byte. */
+	LZ_LIT,      /**< Copying literal bytes. */
+	LZ_LEN_EXT,  /**< Waiting for a match length extension byte. */
+	LZ_OFF_LO,   /**< Waiting for the low byte of the match offset. */
+	LZ_OFF_HI,   /**< Waiting for the high byte of the match offset. */
+	LZ_BASE_0,   /**< Waiting for the 1st byte of the base position. */
+	LZ_BASE_1,   /**< Waiting for the 2nd byte of the base position. */
+	LZ_BASE_2,   /**< Waiting for the 3rd byte of the base position. */
+};
+
+/**
+ * Append a byte to the output, flushing the block buffer when full.
+ */
+static int lz_put(qfu_lz_t *lz, uint8_t byte)
+{
+	if (lz->out_len >= lz->max_len) {
+		return -ENOSPC;
+	}
+	lz->buf[lz->buf_idx++] = byte;
+	lz->out_len++;
+	if (lz->buf_idx == lz->buf_size) {
+		lz->buf_idx = 0;
+		if (lz->flush((lz->out_len / lz->buf_size) - 1)) {
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Get an output byte, either from the block buffer or from the history.
+ */
+static uint8_t lz_get(const qfu_lz_t *lz, uint32_t pos)
+{
+	const uint32_t buf_start = lz->out_len - lz->buf_idx;
+
+	if (pos >= buf_start) {
+		return lz->buf[pos - buf_start];
+	}
+	return lz->hist[pos];
+}
+
+/**
+ * Copy the current match to the output.
+ */
+static int lz_copy(qfu_lz_t *lz)
+{
+	uint32_t src;
+	int rc;
+
+	if (lz->offset == 0 || lz->offset > lz->out_len) {
+		return -EINVAL;
+	}
+	if (lz->cnt > lz->max_len - lz->out_len) {
+		return -ENOSPC;
+	}
+	src = lz->out_len - lz->offset;
+	for (; lz->cnt; lz->cnt--) {
+		rc = lz_put(lz, lz_get(lz, src++));
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Copy the current base copy to the output.
+ */
+static int lz_copy_base(qfu_lz_t *lz)
+{
+	int rc;
+
+	if (lz->cnt > lz->base_len || lz->src > lz->base_len - lz->cnt) {
+		return -EINVAL;
+	}
+	for (; lz->cnt; lz->cnt--) {
+		rc = lz_put(lz, lz->base[lz->src++]);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+void qfu_lz_init(qfu_lz_t *lz, uint8_t *buf, uint32_t buf_size,
+		 const volatile uint8_t *hist, uint32_t max_len,
+		 int (*flush)(uint32_t blk_idx))
+{
+	lz->buf = buf;
+	lz->buf_size = buf_size;
+	lz->buf_idx = 0;
+	lz->hist = hist;
+	lz->max_len = max_len;
+	lz->out_len = 0;
+	lz->flush = flush;
+	lz->base = NULL;
+	lz->base_len = 0;
+	lz->cnt = 0;
+	lz->src = 0;
+	lz->offset = 0;
+	lz->state = LZ_CTRL;
+}
+
+void qfu_lz_set_base(qfu_lz_t *lz, const volatile uint8_t *base,
+		     uint32_t base_len)
+{
+	lz->base = base;
+	lz->base_len = base_len;
+}
+
+int qfu_lz_decode(qfu_lz_t *lz, const uint8_t *data, uint32_t len)
+{
+	uint8_t byte;
+	int rc;
+
+	while (len--) {
+		byte = *data++;
+		switch (lz->state) {
+		case LZ_CTRL:
+			if (!(byte & QFU_LZ_MATCH_FLAG)) {
+				lz->cnt = byte + 1;
+				lz->state = LZ_LIT;
+				break;
+			}
+			byte &= QFU_LZ_LEN_MASK;
+			lz->cnt = byte + QFU_LZ_MIN_MATCH;
+			lz->state =
+			    (byte == QFU_LZ_LEN_MASK) ? LZ_LEN_EXT : LZ_OFF_LO;
+			break;
+		case LZ_LIT:
+			rc = lz_put(lz, byte);
+			if (rc) {
+				return rc;
+			}
+			if (--lz->cnt == 0) {
+				lz->state = LZ_CTRL;
+			}
+			break;
+		case LZ_LEN_EXT:
+			lz->cnt += byte;
+			if (lz->cnt > lz->max_len) {
+				return -ENOSPC;
+			}
+			if (byte != 0xFF) {
+				lz->state = LZ_OFF_LO;
+			}
+			break;
+		case LZ_OFF_LO:
+			lz->offset = byte;
+			lz->state = LZ_OFF_HI;
+			break;
+		case LZ_OFF_HI:
+			lz->offset |= (uint16_t)byte << 8;
+			if (lz->offset == 0 && lz->base) {
+				/* Copy from the base image. */
+				lz->state = LZ_BASE_0;
+				break;
+			}
+			rc = lz_copy(lz);
+			if (rc) {
+				return rc;
+			}
+			lz->state = LZ_CTRL;
+			break;
+		case LZ_BASE_0:
+			lz->src = byte;
+			lz->state = LZ_BASE_1;
+			break;
+		case LZ_BASE_1:
+			lz->src |= (uint32_t)byte << 8;
+			lz->state = LZ_BASE_2;
+			break;
+		case LZ_BASE_2:
+			lz->src |= (uint32_t)byte << 16;
+			rc = lz_copy_base(lz);
+			if (rc) {
+				return rc;
+			}
+			lz->state = LZ_CTRL;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+int qfu_lz_finish(qfu_lz_t *lz)
+{
+	if (lz->state != LZ_CTRL) {
+		return -EINVAL;
+	}
+	if (lz->buf_idx && lz->flush(lz->out_len / lz->buf_size)) {
+		return -EIO;
+	}
+
+	return 0;
+}
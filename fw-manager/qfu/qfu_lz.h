@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QFU_LZ_H__
+#define __QFU_LZ_H__
+
+#include <stdint.h>
+
+/**
+ * QFU LZ decoder.
+ *
+ * The decoder writes its output into a block buffer; when the buffer is full,
+ * the flush callback is called to store it (e.g., to flash) and to reset it.
+ * Back-references to output bytes that are no longer in the block buffer are
+ * resolved by reading the already flushed output through the history pointer
+ * (e.g., the memory-mapped flash partition being programmed). Therefore, the
+ * decoder does not need a RAM window of its own.
+ *
+ * The format of the stream is described in qfu_format.h.
+ *
+ * Delta streams can also copy data from a base image (see qfu_lz_set_base()).
+ */
+typedef struct {
+	uint8_t *buf;			/**< Output block buffer. */
+	uint32_t buf_size;		/**< Size of the output block buffer. */
+	uint32_t buf_idx;		/**< Write index in the block buffer. */
+	const volatile uint8_t *hist;	/**< Flushed output (memory mapped). */
+	uint32_t max_len;		/**< Maximum output length. */
+	uint32_t out_len;		/**< Bytes decoded so far. */
+	int (*flush)(uint32_t blk_idx); /**< Store the block buffer. */
+	const volatile uint8_t *base;	/**< Base image (delta streams). */
+	uint32_t base_len;		/**< Length of the base image. */
+	uint32_t cnt;			/**< Bytes left in the current token. */
+	uint32_t src;			/**< Base position of the current copy. */
+	uint16_t offset;		/**< Offset of the current match. */
+	uint8_t state;			/**< Decoder state. */
+} qfu_lz_t;
+
+/**
+ * Initialize the decoder.
+ *
+ * @param[out] lz       The decoder context. Must not be null.
+ * @param[in]  buf      The output block buffer. Must not be null.
+ * @param[in]  buf_size The size of the output block buffer.
+ * @param[in]  hist     The location where flushed blocks are stored.
+ * @param[in]  max_len  The maximum length of the decoded output.
+ * @param[in]  flush    The function storing the (full) output block buffer;
+ *                     it gets the index of the block and must return 0 on
+ *                     success. Must not be null.
+ */
+void qfu_lz_init(qfu_lz_t *lz, uint8_t *buf, uint32_t buf_size,
+		 const volatile uint8_t *hist, uint32_t max_len,
+		 int (*flush)(uint32_t blk_idx));
+
+/**
+ * Set the base image for decoding a delta stream.
+ *
+ * Must be called after qfu_lz_init(); without a base image, copies from the
+ * base are rejected as malformed.
+ *
+ * @param[in,out] lz       The decoder context. Must not be null.
+ * @param[in]     base     The base image (memory mapped). Must not be null.
+ * @param[in]     base_len The length of the base image.
+ */
+void qfu_lz_set_base(qfu_lz_t *lz, const volatile uint8_t *base,
+		     uint32_t base_len);
+
+/**
+ * Decode a chunk of the compressed stream.
+ *
+ * Tokens can span across chunks.
+ *
+ * @param[in,out] lz   The decoder context. Must not be null.
+ * @param[in]     data The chunk of compressed data. Must not be null.
+ * @param[in]     len  The length of the chunk.
+ *
+ * @return 0 on success, negative errno otherwise.
+ * @retval -EINVAL The stream is malformed.
+ * @retval -ENOSPC The output would exceed the maximum length.
+ * @retval -EIO    The flush callback failed.
+ */
+int qfu_lz_decode(qfu_lz_t *lz, const uint8_t *data, uint32_t len);
+
+/**
+ * Complete the decoding.
+ *
+ * Check that the stream did not end in the middle of a token and flush the
+ * last (partially filled) output block.
+ *
+ * @param[in,out] lz The decoder context. Must not be null.
+ *
+ * @return 0 on success, negative errno otherwise (see qfu_lz_decode()).
+ */
+int qfu_lz_finish(qfu_lz_t *lz);
+
+#endif /* __QFU_LZ_H__ */
@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "qm_common.h"
+#include "qm_flash.h"
+
+#include "bl_data.h"
+#include "fm_boot_confirm.h"
+#include "fw-manager_config.h"
+#include "qfu_format.h"
+#include "qfu_stage.h"
+#if (ENABLE_FIRMWARE_MANAGER_AUTH)
+#include "tinycrypt/sha256.h"
+#endif
+
+#if (!FM_CONFIG_APP_STAGING)
+#error "In-application staging is not enabled in this configuration."
+#endif
+
+/* The number of header blocks in a QFU image. */
+#define NUM_HDR_BLOCKS (1)
+
+/*
+ * The application partitions.
+ *
+ * BL-Data is not readable by applications: use the default partition layout
+ * (the same used by the bootloader).
+ */
+static const bl_flash_partition_t stage_parts[BL_FLASH_PARTITIONS_NUM] =
+    BL_PARTITION_LIST;
+
+/** The state of the staging in progress. */
+static struct {
+	/** The partition being staged into (NULL if none). */
+	const bl_flash_partition_t *part;
+	/** The staged QFU header (in the staging area). */
+	const qfu_hdr_t *hdr;
+	/** The number of data blocks of the image. */
+	uint32_t n_data_blocks;
+	/** The sequence number of the next expected block. */
+	uint32_t next_blk;
+	/** The number of data pages programmed so far. */
+	uint32_t pages;
+	/** The length of the data received so far. */
+	uint32_t img_len;
+	/** The first word of the image (held back until the commit). */
+	uint32_t first_word;
+} stage;
+
+/** The buffer used to program a flash page. */
+static uint32_t page_buf[QM_FLASH_PAGE_SIZE_DWORDS];
+
+/**
+ * Program a page of the partition being staged into.
+ *
+ * @param[in] page The page, relative to the partition.
+ * @param[in] data The data to program (padded with 0xFF to the page size).
+ * @param[in] len  The length of the data (at most one page).
+ *
+ * @return 0 on success, -EIO otherwise.
+ */
+static int stage_write_page(uint32_t page, const uint8_t *data, uint32_t len)
+{
+	const bl_flash_partition_t *const p = stage.part;
+	qm_flash_reg_t *flash_regs;
+
+	memset(page_buf, 0xFF, sizeof(page_buf));
+	if (len) {
+		memcpy(page_buf, data, len);
+	}
+	/* Hold back the first word of the image (see qfu_stage_desc_t). */
+	if (page == 0) {
+		stage.first_word = page_buf[0];
+		page_buf[0] = 0xFFFFFFFF;
+	}
+	if (qm_flash_page_write(p->controller, QM_FLASH_REGION_SYS,
+				p->first_page + page, page_buf,
+				QM_FLASH_PAGE_SIZE_DWORDS)) {
+		return -EIO;
+	}
+	/* Flash content has changed, flush prefetch buffer. */
+	flash_regs = QM_FLASH[p->controller];
+	flash_regs->ctrl |= QM_FLASH_CTRL_PRE_FLUSH_MASK;
+	flash_regs->ctrl &= ~QM_FLASH_CTRL_PRE_FLUSH_MASK;
+	/* Verify flash write has been successfully completed. */
+	if (memcmp(page_buf,
+		   (const uint32_t *)p->start_addr +
+		       (page * QM_FLASH_PAGE_SIZE_DWORDS),
+		   QM_FLASH_PAGE_SIZE_BYTES)) {
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/**
+ * Validate the header of the image to be staged and select its partition.
+ *
+ * The checks mirror the ones performed by qfu.c, but for the ones requiring
+ * BL-Data (e.g., authentication), which are performed by the bootloader when
+ * the image is committed.
+ *
+ * @param[in] hdr The QFU header.
+ * @param[in] len The length of the header block.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+static int stage_check_hdr(const qfu_hdr_t *hdr, uint32_t len)
+{
+	const bl_flash_partition_t *p;
+	const uintptr_t here = (uintptr_t)&stage_check_hdr;
+	uint32_t blk_pages, hdr_size;
+
+	if (len < QFU_BLOCK_SIZE || hdr->magic != QFU_HDR_MAGIC ||
+	    !QFU_BLOCK_SIZE_IS_VALID(hdr->block_sz) || len != hdr->block_sz) {
+		return -EINVAL;
+	}
+	if (hdr->partition == 0 || hdr->partition > BL_FLASH_PARTITIONS_NUM) {
+		return -EINVAL;
+	}
+	/*
+	 * Only the x86 target can be staged, and never into the partition the
+	 * application is running from.
+	 */
+	p = &stage_parts[hdr->partition - 1];
+	if (p->target_idx != BL_TARGET_IDX_LMT ||
+	    (here >= (uintptr_t)p->start_addr &&
+	     here < (uintptr_t)p->start_addr +
+			(p->num_pages * QM_FLASH_PAGE_SIZE_BYTES))) {
+		return -EACCES;
+	}
+	/*
+	 * The inactive partition holds the image a trial boot rolls back to:
+	 * do not overwrite it until the running image has confirmed its boot
+	 * (the confirmation is recorded before the staged image is committed).
+	 */
+	if (FM_BOOT_TRIAL_IS_PENDING() &&
+	    !(QM_SCSS_GP->gps0 & FM_BOOT_CONFIRM_BIT(BL_TARGET_IDX_LMT))) {
+		return -EBUSY;
+	}
+	/* The data blocks must fit the partition minus the staging area. */
+	blk_pages = hdr->block_sz / QM_FLASH_PAGE_SIZE_BYTES;
+	if (hdr->n_blocks <= NUM_HDR_BLOCKS ||
+	    (hdr->n_blocks - NUM_HDR_BLOCKS) * blk_pages >
+		p->num_pages - QFU_STAGE_PAGES) {
+		return -EINVAL;
+	}
+	/* The image must be a plain one. */
+	if (hdr->ext_hdr_type & ~QFU_EXT_HDR_AUTH_MASK) {
+		return -EINVAL;
+	}
+	/* The whole header must fit the staging area. */
+	hdr_size = sizeof(*hdr);
+	if ((hdr->ext_hdr_type & QFU_EXT_HDR_AUTH_MASK) == QFU_EXT_HDR_HMAC256) {
+		hdr_size += sizeof(qfu_hdr_hmac_t) +
+			    (sizeof(sha256_t) * hdr->n_blocks);
+	}
+	if (hdr_size > QFU_STAGE_HDR_SIZE) {
+		return -EINVAL;
+	}
+	stage.part = p;
+	stage.n_data_blocks = hdr->n_blocks - NUM_HDR_BLOCKS;
+
+	return 0;
+}
+
+/**
+ * Store the header of the image in the staging area.
+ *
+ * @param[in] data The header block.
+ * @param[in] len  The length of the header block.
+ *
+ * @return 0 on success, -EIO otherwise.
+ */
+static int stage_write_hdr(const uint8_t *data, uint32_t len)
+{
+	const uint32_t first = stage.part->num_pages - QFU_STAGE_PAGES;
+	uint32_t i, chunk;
+
+	if (len > QFU_STAGE_HDR_SIZE) {
+		len = QFU_STAGE_HDR_SIZE;
+	}
+	/* The descriptor, in the last page, is left blank. */
+	for (i = 0; i < QFU_STAGE_PAGES; i++) {
+		chunk = (len > QM_FLASH_PAGE_SIZE_BYTES) ? QM_FLASH_PAGE_SIZE_BYTES
+							 : len;
+		if (stage_write_page(first + i, data, chunk)) {
+			return -EIO;
+		}
+		data += chunk;
+		len -= chunk;
+	}
+	stage.hdr = (const qfu_hdr_t *)QFU_STAGE_HDR(stage.part);
+
+	return 0;
+}
+
+#if (ENABLE_FIRMWARE_MANAGER_AUTH)
+/**
+ * Check a data block against its hash in the (staged) QFU header.
+ *
+ * @param[in] data   The data block.
+ * @param[in] len    The length of the data block.
+ * @param[in] blk_idx The index of the data block.
+ *
+ * @return 0 if the block matches its hash (or the image has no block
+ * 	   hashes), -EINVAL otherwise.
+ */
+static int stage_check_blk_hash(const uint8_t *data, uint32_t len,
+				uint32_t blk_idx)
+{
+	const qfu_hdr_hmac_t *hmac_hdr = QFU_HDR_AUTH_EXT_HDR(stage.hdr);
+	struct tc_sha256_state_struct ctx;
+	sha256_t digest;
+
+	if ((stage.hdr->ext_hdr_type & QFU_EXT_HDR_AUTH_MASK) !=
+	    QFU_EXT_HDR_HMAC256) {
+		return 0;
+	}
+	tc_sha256_init(&ctx);
+	tc_sha256_update(&ctx, data, len);
+	tc_sha256_final(digest.u8, &ctx);
+	if (memcmp(&digest, &hmac_hdr->hashes[blk_idx], sizeof(sha256_t))) {
+		return -EINVAL;
+	}
+
+	return 0;
+}
+#endif /* ENABLE_FIRMWARE_MANAGER_AUTH */
+
+/**
+ * Program a data block into the partition.
+ *
+ * @param[in] data The data block.
+ * @param[in] len  The length of the data block.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+static int stage_write_blk(const uint8_t *data, uint32_t len)
+{
+	const uint32_t blk_sz = stage.hdr->block_sz;
+	const uint32_t blk_idx = stage.next_blk - NUM_HDR_BLOCKS;
+	uint32_t chunk;
+
+	/* All the blocks but the last one must be full. */
+	if (len == 0 || len > blk_sz ||
+	    (blk_idx + 1 < stage.n_data_blocks && len != blk_sz)) {
+		return -EINVAL;
+	}
+#if (ENABLE_FIRMWARE_MANAGER_AUTH)
+	if (stage_check_blk_hash(data, len, blk_idx)) {
+		return -EINVAL;
+	}
+#endif
+	while (len) {
+		chunk = (len > QM_FLASH_PAGE_SIZE_BYTES) ? QM_FLASH_PAGE_SIZE_BYTES
+							 : len;
+		if (stage_write_page(stage.pages, data, chunk)) {
+			return -EIO;
+		}
+		stage.pages++;
+		stage.img_len += chunk;
+		data += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+int qfu_stage_process_block(uint32_t block_num, const uint8_t *data,
+			    uint32_t len)
+{
+	int rc;
+
+	QM_CHECK(data != NULL, -EINVAL);
+
+	if (block_num == 0) {
+		/* A new image: discard the previous one (if any). */
+		qfu_stage_abort();
+		rc = stage_check_hdr((const qfu_hdr_t *)data, len);
+		if (!rc) {
+			rc = stage_write_hdr(data, len);
+		}
+	} else if (!stage.part || !stage.hdr || block_num != stage.next_blk ||
+		   block_num > stage.n_data_blocks) {
+		rc = -EINVAL;
+	} else {
+		rc = stage_write_blk(data, len);
+	}
+	if (rc) {
+		qfu_stage_abort();
+		return rc;
+	}
+	stage.next_blk = block_num + 1;
+
+	return 0;
+}
+
+int qfu_stage_finalize(void)
+{
+	const bl_flash_partition_t *const p = stage.part;
+	const qfu_stage_desc_t *desc;
+	uint32_t offset;
+	qm_flash_reg_t *flash_regs;
+
+	if (!p || !stage.hdr ||
+	    stage.next_blk != stage.n_data_blocks + NUM_HDR_BLOCKS) {
+		return -EINVAL;
+	}
+	desc = QFU_STAGE_DESC(p);
+	offset = (p->first_page * QM_FLASH_PAGE_SIZE_BYTES) +
+		 ((uintptr_t)desc - (uintptr_t)p->start_addr);
+	/* The magic is written last: it marks the descriptor as valid. */
+	qm_flash_word_write(p->controller, QM_FLASH_REGION_SYS,
+			    offset + offsetof(qfu_stage_desc_t, img_len),
+			    stage.img_len);
+	qm_flash_word_write(p->controller, QM_FLASH_REGION_SYS,
+			    offset + offsetof(qfu_stage_desc_t, first_word),
+			    stage.first_word);
+	qm_flash_word_write(p->controller, QM_FLASH_REGION_SYS,
+			    offset + offsetof(qfu_stage_desc_t, magic),
+			    QFU_STAGE_MAGIC);
+	/* Flash content has changed, flush prefetch buffer. */
+	flash_regs = QM_FLASH[p->controller];
+	flash_regs->ctrl |= QM_FLASH_CTRL_PRE_FLUSH_MASK;
+	flash_regs->ctrl &= ~QM_FLASH_CTRL_PRE_FLUSH_MASK;
+	if (desc->img_len != stage.img_len ||
+	    desc->first_word != stage.first_word ||
+	    desc->magic != QFU_STAGE_MAGIC) {
+		qfu_stage_abort();
+		return -EIO;
+	}
+	/* The image is now the bootloader's business. */
+	memset(&stage, 0, sizeof(stage));
+
+	return 0;
+}
+
+void qfu_stage_abort(void)
+{
+	const bl_flash_partition_t *const p = stage.part;
+	uint32_t i;
+
+	if (!p) {
+		return;
+	}
+	/* Erase the staging area first, then the data pages. */
+	for (i = p->num_pages - QFU_STAGE_PAGES; i < p->num_pages; i++) {
+		qm_flash_page_erase(p->controller, QM_FLASH_REGION_SYS,
+				    p->first_page + i);
+	}
+	for (i = 0; i < stage.pages; i++) {
+		qm_flash_page_erase(p->controller, QM_FLASH_REGION_SYS,
+				    p->first_page + i);
+	}
+	memset(&stage, 0, sizeof(stage));
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QFU_STAGE_H__
+#define __QFU_STAGE_H__
+
+#include <stdint.h>
+
+/**
+ * In-application staging API.
+ *
+ * Applications link this library to stage a QFU image into the inactive x86
+ * partition while they keep running (see FM_CONFIG_APP_STAGING). The image is
+ * received over whatever channel the application uses and passed, one QFU
+ * block at a time, to qfu_stage_process_block(), starting from the header
+ * block; the data blocks are programmed as soon as they are received. Once
+ * the last block is processed, qfu_stage_finalize() marks the image as
+ * staged: at the next reset, the bootloader verifies it (including its HMAC
+ * signature, since the key is not readable by the application) and makes it
+ * the active image (booted on trial, see fm_boot_confirm.h).
+ *
+ * While a trial boot is in progress, the application must confirm its own boot
+ * (fm_boot_confirm(BL_TARGET_IDX_LMT)) before staging: the inactive partition
+ * holds the image the running one would be rolled back to.
+ *
+ * Only uncompressed, non-delta, non-bundle images can be staged, and their
+ * data blocks must fit the partition minus the staging area (QFU_STAGE_PAGES
+ * pages at the end of the partition). Blocks must be processed in order.
+ *
+ * Note: the CPU is stalled while a flash page is being programmed.
+ *
+ * @defgroup groupQFU_Stage In-Application Staging
+ * @{
+ */
+
+/**
+ * Process a block of the QFU image being staged.
+ *
+ * Block 0 (the QFU header) starts a new staging, discarding any previous one.
+ * Data blocks are validated (against the block hashes in the header, if the
+ * image is authenticated and the library is built with
+ * ENABLE_FIRMWARE_MANAGER_AUTH) and programmed into the partition.
+ *
+ * @param[in] block_num The sequence number of the block.
+ * @param[in] data      The block. Must not be null.
+ * @param[in] len       The length of the block (the QFU block size, but for
+ * 			the last block).
+ *
+ * @return 0 on success, negative errno otherwise:
+ * 	   -EINVAL if the image or the block is not valid (or out of order),
+ * 	   -EACCES if the target partition cannot be staged into,
+ * 	   -EBUSY if a trial boot is in progress and the application has not
+ * 	   confirmed its boot yet (see fm_boot_confirm.h),
+ * 	   -EIO if programming failed.
+ * 	   On error, the staging is aborted.
+ */
+int qfu_stage_process_block(uint32_t block_num, const uint8_t *data,
+			    uint32_t len);
+
+/**
+ * Complete the staging.
+ *
+ * Mark the staged image as ready to be installed by the bootloader at the
+ * next reset. The application is expected to reset the device afterwards.
+ *
+ * @return 0 on success, -EINVAL if the image is not complete, -EIO if
+ * 	   programming failed.
+ */
+int qfu_stage_finalize(void);
+
+/**
+ * Abort the staging in progress (if any).
+ *
+ * The pages programmed so far are erased.
+ */
+void qfu_stage_abort(void);
+
+/**
+ * @}
+ */
+
+#endif /* __QFU_STAGE_H__ */
@@ -0,0 +1,68 @@
+#
+# Copyright (c) 2017, Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+# 3. Neither the name of the Intel Corporation nor the names of its
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+
+# In-application staging library (see qfu_stage.h).
+#
+# This makefile is not part of the ROM build: it is meant to be included by the
+# makefile of applications using the library, which must define BL_BASE_DIR
+# (the bootloader base directory), SOC and OBJ_DIR, and link STAGING_OBJS. The
+# application must be built with the same BL_CONFIG_DUAL_BANK,
+# ENABLE_FLASH_WRITE_PROTECTION and ENABLE_FIRMWARE_MANAGER_AUTH settings as
+# the bootloader.
+
+### Variables
+STAGING_DIR = $(BL_BASE_DIR)/fw-manager/staging
+STAGING_SOURCES = $(wildcard $(STAGING_DIR)/*.c)
+STAGING_OBJ_DIR = $(OBJ_DIR)/staging
+STAGING_OBJS = $(addprefix $(STAGING_OBJ_DIR)/,$(notdir $(STAGING_SOURCES:.c=.o)))
+
+### Flags
+CFLAGS += -I$(STAGING_DIR)
+CFLAGS += -I$(BL_BASE_DIR)/fw-manager
+CFLAGS += -I$(BL_BASE_DIR)/fw-manager/qfu
+CFLAGS += -I$(BL_BASE_DIR)/bootstrap/soc/$(SOC)/include
+
+### Block hashes are checked with TinyCrypt's SHA256
+ifeq ($(ENABLE_FIRMWARE_MANAGER_AUTH),1)
+ifeq ($(TINYCRYPT_SRC_DIR),)
+$(error TINYCRYPT_SRC_DIR is not defined)
+endif
+CFLAGS += -DENABLE_FIRMWARE_MANAGER_AUTH=1
+CFLAGS += -I$(TINYCRYPT_SRC_DIR)/lib/include
+STAGING_OBJS += $(STAGING_OBJ_DIR)/sha256.o $(STAGING_OBJ_DIR)/utils.o
+
+$(STAGING_OBJ_DIR)/%.o: $(TINYCRYPT_SRC_DIR)/lib/source/%.c
+	$(call mkdir, $(STAGING_OBJ_DIR))
+	$(CC) $(CFLAGS) -c -o $@ $<
+endif
+
+### Build C files
+$(STAGING_OBJ_DIR)/%.o: $(STAGING_DIR)/%.c
+	$(call mkdir, $(STAGING_OBJ_DIR))
+	$(CC) $(CFLAGS) -c -o $@ $<
@@ -58,6 +58,16 @@ $(call support_error,ENABLE_FLASH_WRITE_PROTECTION,\
 		     $(SUPPORTED_ENABLE_FLASH_WRITE_PROTECTION))
 endif
 
+# Option to enable/disable boot-phase timestamps
+ENABLE_BOOT_TIMING ?= 0
+SUPPORTED_ENABLE_BOOT_TIMING = 0 \
+			       1
+$(info ENABLE_BOOT_TIMING = $(ENABLE_BOOT_TIMING))
+ifeq ($(strip $(filter $(ENABLE_BOOT_TIMING),\
+				$(SUPPORTED_ENABLE_BOOT_TIMING))), )
+$(call support_error,ENABLE_BOOT_TIMING,$(SUPPORTED_ENABLE_BOOT_TIMING))
+endif
+
 # Exceptions
 ifeq ($(ENABLE_FIRMWARE_MANAGER),uart)
 ifeq ($(BUILD),debug)
@@ -91,12 +91,21 @@ CFLAGS += -DENABLE_FLASH_WRITE_PROTECTION=0
 ROM_SUFFIX_NO_FLASH_WRITE_PROTECTION = _no_flash_write_protection
 endif
 
+# Add boot timing macro
+ifeq ($(ENABLE_BOOT_TIMING),1)
+CFLAGS += -DENABLE_BOOT_TIMING=1
+ROM_SUFFIX_BOOT_TIMING = _boot_timing
+else
+CFLAGS += -DENABLE_BOOT_TIMING=0
+endif
+
 # Define ROM file name
 # (Suffix is built on multiple lines to respect 80 chars limit)
 ROM_SUFFIX := $(ROM_SUFFIX_FM)
 ROM_SUFFIX := $(ROM_SUFFIX)$(FM_AUTH_SUFFIX)
 ROM_SUFFIX := $(ROM_SUFFIX)$(ROM_SUFFIX_NO_RESTORE_CONTEXT)
 ROM_SUFFIX := $(ROM_SUFFIX)$(ROM_SUFFIX_NO_FLASH_WRITE_PROTECTION)
+ROM_SUFFIX := $(ROM_SUFFIX)$(ROM_SUFFIX_BOOT_TIMING)
 ROM_NAME := $(SOC)_rom$(ROM_SUFFIX)
 ROM = $(ROM_BUILD_DIR)/$(ROM_NAME).bin
 
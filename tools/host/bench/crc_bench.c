@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bl_data.h"
+#include "fw-manager_config.h"
+#include "fw-manager_utils.h"
+#include "dfu/qda/xmodem.h"
+
+/*
+ * CRC16-CCITT benchmark.
+ *
+ * Time fm_crc16_ccitt(), as built with the FM_CONFIG_CRC16_IMPL of this
+ * program, over the buffer sizes it is used for: XMODEM packets (per received
+ * and transmitted packet) and BL-Data (twice per bl_data_sanitize() call).
+ *
+ * Timings are taken on the host, in TSC cycles: they rank the implementations
+ * but are not Lakemont cycle counts.
+ */
+
+/* The CRC-16/XMODEM check value (CRC of "123456789"). */
+#define CRC16_CHECK (0x31C3)
+
+/* Minimum duration of a measurement, in ns. */
+#define MIN_DURATION_NS (20000000ULL)
+/* Number of measurements (the fastest one is kept). */
+#define MEASUREMENTS (5)
+
+#if (FM_CONFIG_CRC16_IMPL == FM_CRC16_IMPL_BITWISE)
+#define IMPL_NAME "bitwise"
+#define TABLE_BYTES (0)
+#elif(FM_CONFIG_CRC16_IMPL == FM_CRC16_IMPL_SLICE4)
+#define IMPL_NAME "slice4"
+#define TABLE_BYTES (4 * 256 * sizeof(uint16_t))
+#endif
+
+static uint8_t buf[sizeof(bl_data_t) > XMODEM_1K_BLOCK_SIZE
+		       ? sizeof(bl_data_t)
+		       : XMODEM_1K_BLOCK_SIZE];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Return the TSC cycles per byte of fm_crc16_ccitt() over len bytes. */
+static double cycles_per_byte(int len)
+{
+	volatile uint16_t sink;
+	double best = 0;
+	uint64_t start_ns, cycles;
+	unsigned long calls;
+	int i;
+
+	for (i = 0; i < MEASUREMENTS; i++) {
+		calls = 0;
+		start_ns = now_ns();
+		cycles = __builtin_ia32_rdtsc();
+		do {
+			sink = fm_crc16_ccitt(buf, len);
+			calls++;
+		} while (now_ns() - start_ns < MIN_DURATION_NS);
+		cycles = __builtin_ia32_rdtsc() - cycles;
+		if (!i || (double)cycles / calls / len < best) {
+			best = (double)cycles / calls / len;
+		}
+	}
+	(void)sink;
+
+	return best;
+}
+
+int main(void)
+{
+	static const char check[] = "123456789";
+	const uint16_t crc =
+	    fm_crc16_ccitt((const uint8_t *)check, sizeof(check) - 1);
+	size_t i;
+
+	if (crc != CRC16_CHECK) {
+		printf("%-8s: wrong CRC of \"%s\": 0x%04X (expected 0x%04X)\n",
+		       IMPL_NAME, check, crc, CRC16_CHECK);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < sizeof(buf); i++) {
+		buf[i] = (uint8_t)rand();
+	}
+	printf("%-8s: %4u table bytes, cycles/byte: %5.2f (%d B), "
+	       "%5.2f (%d B), %5.2f (bl_data_t, %u B)\n",
+	       IMPL_NAME, (unsigned int)TABLE_BYTES,
+	       cycles_per_byte(XMODEM_BLOCK_SIZE), XMODEM_BLOCK_SIZE,
+	       cycles_per_byte(XMODEM_1K_BLOCK_SIZE), XMODEM_1K_BLOCK_SIZE,
+	       cycles_per_byte(sizeof(bl_data_t)),
+	       (unsigned int)sizeof(bl_data_t));
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,277 @@
+#!/usr/bin/python -tt
+# -*- coding: utf-8 -*-
+# Copyright (c) 2017, Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+# 3. Neither the name of the Intel Corporation nor the names of its
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+"""fm_bench: firmware update benchmark on the host simulator.
+
+Run canonical update scenarios (with qm_manage.py against the simulator) and
+report, for each of them, the transfer rate, the round trips, the flash
+operations and the CPU cycles spent in each phase (communication, hashing,
+flash programming). The simulator runs in virtual time, so that the results
+do not depend on the host.
+
+The results are compared with a baseline: the benchmark fails if a metric is
+worse than its baseline value by more than the threshold.
+
+::
+
+   usage: fm_bench.py [-h] [--baseline FILE] [--threshold PCT] [--update]
+                      [--scenario NAME] BUILD_DIR"""
+
+from __future__ import print_function, division
+import argparse
+import json
+import os
+import random
+import shutil
+import sys
+import tempfile
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(os.path.dirname(BENCH_DIR), "sim"))
+from fmsim import Simulator, SimError, make_image
+
+# The CPU frequency the simulator assumes, to convert times to cycles.
+CPU_HZ = 32000000
+
+# How long the simulator waits for the host before a timeout, in ms.
+HOST_WAIT_MS = 2000
+
+# The size of the application partition (partition 1), in bytes.
+PARTITION_SIZE = {"quark_se": 96 * 2048, "quark_d2000": 16 * 2048}
+
+
+class Scenario(object):
+    """An update scenario.
+
+    Args:
+        name (string): The scenario name.
+        soc (string): The SoC.
+        size (int): The image size, in bytes (None: the whole partition).
+        hmac (bool): Whether authentication is enabled.
+        block_size (int): The QFU block size.
+        baud (int): The baud rate.
+        error_rate (int): Corrupt one received byte out of error_rate (0:
+                          no corruption)."""
+
+    def __init__(self, name, soc, size=None, hmac=False, block_size=None,
+                 baud=1000000, error_rate=0):
+        self.name = name
+        self.soc = soc
+        self.size = size or PARTITION_SIZE[soc]
+        self.hmac = hmac
+        self.block_size = block_size
+        self.baud = baud
+        self.error_rate = error_rate
+
+
+SCENARIOS = [
+    Scenario("se_small", "quark_se", size=8192),
+    Scenario("se_full", "quark_se"),
+    Scenario("se_full_hmac", "quark_se", hmac=True),
+    Scenario("se_full_4k", "quark_se", block_size=4096),
+    Scenario("se_full_loss", "quark_se", error_rate=50000),
+    Scenario("se_full_115200", "quark_se", baud=115200),
+    Scenario("d2000_small", "quark_d2000", size=4096),
+    Scenario("d2000_full", "quark_d2000"),
+    Scenario("d2000_full_hmac", "quark_d2000", hmac=True),
+    Scenario("d2000_full_loss", "quark_d2000", error_rate=2000),
+]
+
+# The reported metrics: (name, unit, whether higher values are better).
+METRICS = [
+    ("bytes_per_s", "B/s", True),
+    ("time_ms", "ms", False),
+    ("round_trips", "", False),
+    ("page_erases", "", False),
+    ("page_programs", "", False),
+    ("comm_kcycles", "kcycles", False),
+    ("hash_kcycles", "kcycles", False),
+    ("flash_kcycles", "kcycles", False),
+]
+
+
+def ns_to_kcycles(time_ns):
+    return int(round(time_ns * CPU_HZ / 1e12))
+
+
+def run_scenario(scenario, build_dir, work_dir):
+    """Run a scenario and return its metrics."""
+    rnd = random.Random(scenario.name)
+    path = lambda name: os.path.join(work_dir, name)
+    binary = os.path.join(build_dir, scenario.soc,
+                          "fm_sim_hmac" if scenario.hmac else "fm_sim")
+    with open(path("app.bin"), "wb") as app:
+        app.write(bytearray(rnd.getrandbits(8)
+                            for _ in range(scenario.size)))
+    extra = []
+    if scenario.block_size:
+        extra += ["--block-size", str(scenario.block_size)]
+    key = None
+    flash = None
+    if scenario.hmac:
+        key = path("fw.key")
+        for name in ("rv.key", "fw.key"):
+            with open(path(name), "wb") as key_file:
+                key_file.write(bytearray(rnd.getrandbits(8)
+                                         for _ in range(32)))
+        with Simulator(binary, work_dir) as sim:
+            sim.provision(path("rv.key"), path("fw.key"))
+        flash = path("provisioned.bin")
+        shutil.copyfile(sim.flash, flash)
+    make_image(path("app.bin"), path("app.dfu"), 1, scenario.soc, key=key,
+               extra=extra)
+
+    # The host is assumed to answer instantly: let it take its (real) time,
+    # so that a slow host does not make device timeouts expire.
+    options = ["--host-wait-ms", str(HOST_WAIT_MS)]
+    if scenario.error_rate:
+        options += ["--error-rate", str(scenario.error_rate)]
+    with Simulator(binary, work_dir, flash=flash, options=options) as sim:
+        sim.manage("download", "-b", str(scenario.baud), path("app.dfu"))
+    stats = sim.stats
+
+    # The update starts with the first request of the host and ends with
+    # its last one (sent once the device has processed the whole image).
+    time_ns = stats["rx_last_ns"] - stats["rx_first_ns"]
+    busy_ns = stats["flash_ns"] + stats["sha_ns"]
+    return {
+        "bytes_per_s": int(scenario.size * 1e9 / time_ns),
+        "time_ms": int(round(time_ns / 1e6)),
+        "round_trips": stats["round_trips"],
+        "page_erases": stats["page_erases"],
+        "page_programs": stats["bl_page_writes"],
+        "comm_kcycles": ns_to_kcycles(time_ns - busy_ns),
+        "hash_kcycles": ns_to_kcycles(stats["sha_ns"]),
+        "flash_kcycles": ns_to_kcycles(stats["flash_ns"]),
+    }
+
+
+def compare(results, baseline, threshold):
+    """Compare the results with the baseline.
+
+    Returns:
+        The list of regressions (as strings)."""
+    regressions = []
+    for name in sorted(results):
+        if name not in baseline:
+            continue
+        for metric, _, higher_is_better in METRICS:
+            value = results[name][metric]
+            base = baseline[name].get(metric)
+            if base is None:
+                continue
+            limit = base * threshold / 100.0
+            if higher_is_better:
+                worse = value < base - limit
+            else:
+                worse = value > base + limit
+            if worse:
+                regressions.append("%s: %s = %s (baseline %s)" %
+                                   (name, metric, value, base))
+    return regressions
+
+
+def print_results(results, baseline):
+    header = "%-16s" % "Scenario"
+    for metric, _, _ in METRICS:
+        header += " %14s" % metric
+    print(header)
+    for name in sorted(results):
+        line = "%-16s" % name
+        for metric, _, _ in METRICS:
+            value = results[name][metric]
+            base = baseline.get(name, {}).get(metric)
+            if base:
+                cell = "%d (%+.0f%%)" % (value, (value - base) * 100.0 / base)
+            else:
+                cell = "%d" % value
+            line += " %14s" % cell
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Firmware update benchmark on the host simulator.")
+    parser.add_argument("build_dir",
+                        help="the simulator build directory (build/host)")
+    parser.add_argument("--baseline",
+                        default=os.path.join(BENCH_DIR, "baseline.json"),
+                        help="the baseline file [default: %(default)s]")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="the tolerated regression, in percent "
+                             "[default: %(default)s]")
+    parser.add_argument("--update", action="store_true",
+                        help="store the results as the new baseline")
+    parser.add_argument("--scenario", action="append",
+                        choices=[s.name for s in SCENARIOS],
+                        help="run only the given scenario(s)")
+    args = parser.parse_args()
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as baseline_file:
+            baseline = json.load(baseline_file)
+
+    results = {}
+    for scenario in SCENARIOS:
+        if args.scenario and scenario.name not in args.scenario:
+            continue
+        work_dir = tempfile.mkdtemp(prefix="fm_bench_")
+        try:
+            results[scenario.name] = run_scenario(scenario,
+                                                  os.path.abspath(
+                                                      args.build_dir),
+                                                  work_dir)
+        except SimError as error:
+            print("%s: FAIL: %s" % (scenario.name, error))
+            print("(files kept in %s)" % work_dir)
+            return 1
+        shutil.rmtree(work_dir)
+
+    print_results(results, baseline)
+    if args.update:
+        baseline.update(results)
+        with open(args.baseline, "w") as baseline_file:
+            json.dump(baseline, baseline_file, indent=2, sort_keys=True,
+                      separators=(",", ": "))
+            baseline_file.write("\n")
+        print("Baseline updated.")
+        return 0
+
+    regressions = compare(results, baseline, args.threshold)
+    for regression in regressions:
+        print("REGRESSION: %s" % regression)
+    if regressions:
+        return 1
+    print("No regression (threshold: %.1f%%)." % args.threshold)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
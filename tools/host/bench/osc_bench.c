@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "qm_common.h"
+#include "qm_soc_regs.h"
+#include "boot_clk.h"
+
+/*
+ * Oscillator trim code calibration benchmark.
+ *
+ * Run boot_clk_trim_code_compute(), as built with the OSC_TRIM_* options of
+ * this program, against a model of the hybrid oscillator, for a population of
+ * devices, and report the total calibration time (all 4 modes) and how close
+ * the computed trim codes are to the reference ones.
+ *
+ * The model runs in virtual time:
+ *
+ * - the oscillator frequency is linear in the trim code, with a per-device
+ *   and per-mode center code and slope; over each RTC tick, it deviates from
+ *   that frequency by a random (gaussian) jitter;
+ * - the TSC counts system clock cycles (the oscillator frequency divided by
+ *   the system clock divider);
+ * - time flows only while the AON counter is polled: each access to it costs
+ *   a fixed number of system clock cycles.
+ *
+ * The reference trim code of a mode is the one an exhaustive search of the
+ * model finds without jitter and with an infinite measurement period: the
+ * highest code for which the system clock does not exceed the desired number
+ * of timestamp ticks per RTC tick. The calibration has not converged if the
+ * frequency of a computed trim code is more than MAX_FREQ_ERROR away from the
+ * one of the reference code.
+ */
+
+#ifndef OSC_TRIM_ADAPTIVE
+#define OSC_TRIM_ADAPTIVE (1)
+#endif
+#ifndef OSC_TRIM_SEED
+#define OSC_TRIM_SEED (0)
+#endif
+
+#if (OSC_TRIM_SEED)
+#define VARIANT_NAME "seeded"
+#elif(OSC_TRIM_ADAPTIVE)
+#define VARIANT_NAME "adaptive"
+#else
+#define VARIANT_NAME "full"
+#endif
+
+#define RTC_HZ (32768)
+#define TRIM_CODES (1024)
+#define MODES (4)
+
+/* The maximum frequency error, relative to the reference trim code. */
+#define MAX_FREQ_ERROR (0.005)
+
+#define DEFAULT_DEVICES (200)
+#define DEFAULT_JITTER_PPM (100)
+#define DEFAULT_POLL_CYCLES (8)
+#define DEFAULT_SEED_OFFSET (8)
+
+/* Range of the center trim code and of the slope (relative step per code). */
+#define CENTER_MIN (256)
+#define CENTER_MAX (768)
+#define SLOPE_MIN (0.0006)
+#define SLOPE_MAX (0.0010)
+
+/* The nominal frequency of each mode. */
+static const double nominal_hz[MODES] = {32e6, 16e6, 8e6, 4e6};
+
+/* Registers accessed by boot_clk.c. */
+qm_scss_ccu_reg_t test_scss_ccu;
+qm_flash_otp_trim_t test_otp_trim;
+static qm_aonc_reg_t aonc;
+static qm_aonc_reg_t *aonc_regs[QM_AONC_NUM] = {&aonc};
+
+/* The oscillator of the current device. */
+static struct {
+	double center[MODES];
+	double slope[MODES];
+	/* The jitter factor of the current RTC tick. */
+	double noise;
+	/* The time elapsed in the current RTC tick, in s. */
+	double phase;
+	/* The TSC and the virtual time, in s. */
+	double tsc;
+	double now;
+	uint32_t rtc_ticks;
+} osc;
+
+static double jitter;
+static double poll_cycles = DEFAULT_POLL_CYCLES;
+
+/* Uniform random number in [0, 1). */
+static double uniform(void)
+{
+	return rand() / (RAND_MAX + 1.0);
+}
+
+/* Gaussian random number (Box-Muller). */
+static double gaussian(void)
+{
+	return sqrt(-2 * log(1 - uniform())) * cos(2 * M_PI * uniform());
+}
+
+/* The oscillator frequency of a mode and a trim code, without jitter. */
+static double osc_hz(unsigned int mode, unsigned int code)
+{
+	return nominal_hz[mode] *
+	       (1 + osc.slope[mode] * ((double)code - osc.center[mode]));
+}
+
+/* The current system clock frequency, as set up in the CCU registers. */
+static double sys_clk_hz(void)
+{
+	const uint32_t cfg1 = test_scss_ccu.osc0_cfg1;
+	const uint32_t ctl = test_scss_ccu.ccu_sys_clk_ctl;
+	const unsigned int mode =
+	    (cfg1 & OSC0_CFG1_SI_FREQ_SEL_MASK) >> OSC0_CFG1_SI_FREQ_SEL_OFFS;
+	const unsigned int code =
+	    (cfg1 & OSC0_CFG1_FTRIMOTP_MASK) >> OSC0_CFG1_FTRIMOTP_OFFS;
+	unsigned int div = 1;
+
+	if (ctl & QM_CCU_SYS_CLK_DIV_EN) {
+		div <<= (ctl & QM_CCU_SYS_CLK_DIV_MASK) >>
+			QM_CCU_SYS_CLK_DIV_OFFSET;
+	}
+
+	return osc_hz(mode, code) * osc.noise / div;
+}
+
+/* Let a number of system clock cycles elapse. */
+static void osc_run(double cycles)
+{
+	const double tick = 1.0 / RTC_HZ;
+	double hz, left;
+
+	while (cycles > 0) {
+		hz = sys_clk_hz();
+		left = (tick - osc.phase) * hz;
+		if (cycles < left) {
+			osc.phase += cycles / hz;
+			osc.now += cycles / hz;
+			osc.tsc += cycles;
+			break;
+		}
+		osc.now += tick - osc.phase;
+		osc.tsc += left;
+		cycles -= left;
+		osc.phase = 0;
+		osc.rtc_ticks++;
+		osc.noise = 1 + jitter * gaussian();
+	}
+}
+
+uint64_t _rdtsc(void)
+{
+	return (uint64_t)osc.tsc;
+}
+
+qm_aonc_reg_t **test_aonc_access(void)
+{
+	osc_run(poll_cycles);
+	aonc.aonc_cnt = osc.rtc_ticks;
+
+	return aonc_regs;
+}
+
+/* The reference trim code of a mode (see above). */
+static unsigned int reference_code(unsigned int mode)
+{
+	const uint32_t desired = nominal_hz[mode] / 2 / RTC_HZ;
+	unsigned int code, ref = 0;
+
+	for (code = 0; code < TRIM_CODES; code++) {
+		if (osc_hz(mode, code) / 2 / RTC_HZ <= desired) {
+			ref = code;
+		}
+	}
+
+	return ref;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -n, --devices N        number of devices (default %d)\n"
+		"  -j, --jitter-ppm PPM   frequency jitter per RTC tick "
+		"(default %d)\n"
+		"  -p, --poll-cycles N    cycles per AON counter read "
+		"(default %d)\n"
+		"  -o, --seed-offset N    max OTP seed error, in codes "
+		"(default %d)\n",
+		name, DEFAULT_DEVICES, DEFAULT_JITTER_PPM, DEFAULT_POLL_CYCLES,
+		DEFAULT_SEED_OFFSET);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option options[] = {
+	    {"devices", required_argument, NULL, 'n'},
+	    {"jitter-ppm", required_argument, NULL, 'j'},
+	    {"poll-cycles", required_argument, NULL, 'p'},
+	    {"seed-offset", required_argument, NULL, 'o'},
+	    {NULL, 0, NULL, 0},
+	};
+	unsigned int devices = DEFAULT_DEVICES;
+	int seed_offset = DEFAULT_SEED_OFFSET;
+	unsigned int ref[MODES];
+	unsigned int device, mode, exact = 0, max_error = 0;
+	double start, elapsed, total = 0, longest = 0;
+	double freq_error, max_freq_error = 0;
+	qm_flash_data_trim_t trim;
+	QM_RW uint16_t *const otp = &test_otp_trim.osc_trim_32mhz;
+	unsigned int error, code;
+	int seed, opt;
+
+	jitter = DEFAULT_JITTER_PPM / 1e6;
+	while ((opt = getopt_long(argc, argv, "n:j:p:o:", options, NULL)) !=
+	       -1) {
+		switch (opt) {
+		case 'n':
+			devices = strtoul(optarg, NULL, 0);
+			break;
+		case 'j':
+			jitter = strtod(optarg, NULL) / 1e6;
+			break;
+		case 'p':
+			poll_cycles = strtod(optarg, NULL);
+			break;
+		case 'o':
+			seed_offset = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || !devices || poll_cycles <= 0) {
+		usage(argv[0]);
+	}
+
+	/* The same devices for every variant. */
+	srand(1);
+	for (device = 0; device < devices; device++) {
+		test_scss_ccu = (qm_scss_ccu_reg_t){.osc0_stat1 =
+							QM_OSC0_LOCK_SI};
+		test_otp_trim.magic = 0xFFFFFFFF;
+		osc.phase = uniform() / RTC_HZ;
+		osc.noise = 1;
+		for (mode = 0; mode < MODES; mode++) {
+			osc.center[mode] =
+			    CENTER_MIN + uniform() * (CENTER_MAX - CENTER_MIN);
+			osc.slope[mode] =
+			    SLOPE_MIN + uniform() * (SLOPE_MAX - SLOPE_MIN);
+			ref[mode] = reference_code(mode);
+			/* Not provisioned; seeded close to the reference. */
+			seed = ref[mode] - seed_offset +
+			       (int)(uniform() * (2 * seed_offset + 1));
+			seed = seed < 0 ? 0 : seed >= TRIM_CODES ? TRIM_CODES - 1
+								 : seed;
+			otp[mode] = OSC_TRIM_SEED
+					? QM_FLASH_TRIM_PRESENT_MASK | seed
+					: 0xFFFF;
+		}
+
+		start = osc.now;
+		boot_clk_trim_code_compute(&trim);
+		elapsed = osc.now - start;
+		total += elapsed;
+		longest = elapsed > longest ? elapsed : longest;
+
+		for (mode = 0; mode < MODES; mode++) {
+			code = trim.osc_trim_u16[mode] & (TRIM_CODES - 1);
+			error = code > ref[mode] ? code - ref[mode]
+						 : ref[mode] - code;
+			exact += !error;
+			max_error = error > max_error ? error : max_error;
+			freq_error = fabs(osc_hz(mode, code) /
+						  osc_hz(mode, ref[mode]) -
+					      1);
+			if (freq_error > max_freq_error) {
+				max_freq_error = freq_error;
+			}
+		}
+	}
+
+	printf("%-8s: %6.2f ms per device (max %6.2f), trim codes: "
+	       "%5.1f%% exact, max error %2u (%.2f%% of frequency)%s\n",
+	       VARIANT_NAME, total * 1e3 / devices, longest * 1e3,
+	       exact * 100.0 / (devices * MODES), max_error,
+	       max_freq_error * 100,
+	       max_freq_error > MAX_FREQ_ERROR ? ", NOT CONVERGED" : "");
+
+	return max_freq_error > MAX_FREQ_ERROR ? EXIT_FAILURE : EXIT_SUCCESS;
+}
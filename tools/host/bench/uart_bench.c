@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "qm_common.h"
+#include "qm_interrupt.h"
+#include "qm_uart.h"
+
+#include "fw-manager_config.h"
+#include "dfu/qda/xmodem.h"
+#include "dfu/qda/xmodem_io.h"
+#include "dfu/qda/xmodem_io_uart.h"
+#include "dfu/qda/xmodem_pkt.h"
+
+#include "sim.h"
+
+/*
+ * XMODEM UART I/O layer benchmark.
+ *
+ * Measure the throughput of xmodem_io_read() on the simulator: the host sends
+ * the payload in packets and the device reads each packet with a single
+ * xmodem_io_read() call and ACKs it; the host sends the next packet as soon
+ * as it gets the ACK.
+ *
+ * Optionally, the device starts some background work (e.g., programming the
+ * previous block) after each ACK, in the idle handler, while the next packet
+ * is arriving: the RX ring buffer must absorb the data received meanwhile.
+ *
+ * Time is virtual (see sim.h): the results are the same on every host.
+ */
+
+/* XMODEM-1K packet: header, block number and its complement, data, CRC. */
+#define DEFAULT_PACKET_SIZE (3 + XMODEM_MAX_BLOCK_SIZE + 2)
+#define DEFAULT_PAYLOAD_SIZE (64 * 1024)
+#define DEFAULT_BAUD (115200)
+#define MAX_PACKET_SIZE (16 * 1024)
+
+sim_options_t sim_opts;
+volatile int sim_quit;
+
+/* The duration of the background work done after each packet. */
+static sim_time_t work_ns;
+static bool work_pending;
+
+void sim_exit(int status)
+{
+	exit(status);
+}
+
+/* Idle handler: do the pending background work, or wait for an interrupt. */
+static void bench_idle(void)
+{
+	if (work_pending) {
+		work_pending = false;
+		sim_busy(work_ns);
+	} else {
+		sim_wait();
+	}
+}
+
+/* The payload byte at a given offset. */
+static uint8_t payload(size_t offset)
+{
+	return (uint8_t)(offset * 131 + (offset >> 8));
+}
+
+/* Send a packet of the payload, as the host would. */
+static size_t host_send(size_t offset, size_t len)
+{
+	static uint8_t buf[MAX_PACKET_SIZE];
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		buf[i] = payload(offset + i);
+	}
+
+	return sim_uart_host_send(buf, len);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -b, --baud BAUD        baud rate (default %d)\n"
+		"  -n, --bytes N          payload size (default %d)\n"
+		"  -p, --packet N         packet size (default %d, max %d)\n"
+		"  -w, --work-us US       background work after each packet "
+		"(default 0)\n",
+		name, DEFAULT_BAUD, DEFAULT_PAYLOAD_SIZE, DEFAULT_PACKET_SIZE,
+		MAX_PACKET_SIZE);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option options[] = {
+	    {"baud", required_argument, NULL, 'b'},
+	    {"bytes", required_argument, NULL, 'n'},
+	    {"packet", required_argument, NULL, 'p'},
+	    {"work-us", required_argument, NULL, 'w'},
+	    {NULL, 0, NULL, 0},
+	};
+	static uint8_t buf[MAX_PACKET_SIZE];
+	uint32_t baud = DEFAULT_BAUD;
+	size_t total = DEFAULT_PAYLOAD_SIZE;
+	size_t packet = DEFAULT_PACKET_SIZE;
+	size_t sent, received, len, i;
+	size_t data_errors = 0;
+	const uint8_t ack = ACK;
+	sim_time_t start, elapsed;
+	uint32_t div;
+	int opt;
+	int retv = 0;
+
+	while ((opt = getopt_long(argc, argv, "b:n:p:w:", options, NULL)) !=
+	       -1) {
+		switch (opt) {
+		case 'b':
+			baud = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			total = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			packet = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			work_ns = strtod(optarg, NULL) * 1000;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || !packet || packet > MAX_PACKET_SIZE) {
+		usage(argv[0]);
+	}
+
+	sim_uart_init();
+	xmodem_io_uart_init();
+	if (xmodem_io_uart_get_baud_div(baud, &div)) {
+		fprintf(stderr, "%u baud not supported\n", baud);
+		return EXIT_FAILURE;
+	}
+	xmodem_io_uart_set_baud_div(div);
+	xmodem_io_uart_set_idle_cb(bench_idle);
+	qm_irq_enable();
+
+	start = sim_now;
+	sent = host_send(0, packet < total ? packet : total);
+	for (received = 0; received < total; received += len) {
+		len = total - received < packet ? total - received : packet;
+		xmodem_io_set_deadline(XMODEM_IO_TIMEOUT_MS);
+		retv = xmodem_io_read(buf, len);
+		if (retv < 0) {
+			break;
+		}
+		for (i = 0; i < len; i++) {
+			if (buf[i] != payload(received + i)) {
+				data_errors++;
+			}
+		}
+		xmodem_io_putc(&ack);
+		if (sent < total) {
+			/* The host sends the next packet when the ACK is out. */
+			while (!(QM_UART[FM_CONFIG_UART]->lsr &
+				 QM_UART_LSR_TEMT)) {
+			}
+			sent += host_send(sent, total - sent < packet
+						    ? total - sent
+						    : packet);
+		}
+		work_pending = (work_ns != 0);
+	}
+	elapsed = sim_now - start;
+
+	printf("%7u baud, %5zu-byte packets, %6.2f ms work: ", baud, packet,
+	       work_ns / 1e6);
+	if (retv < 0) {
+		printf("FAIL (%s after %zu bytes, %llu FIFO overruns)\n",
+		       retv == -ETIME ? "timeout" : "I/O error", received,
+		       (unsigned long long)sim_stats.rx_overruns);
+		return EXIT_FAILURE;
+	}
+	printf("%8.0f B/s (%5.1f%% of line rate), %.3f ISRs/byte%s\n",
+	       received * (double)SIM_NS_PER_SEC / elapsed,
+	       received * 1000.0 * SIM_NS_PER_SEC / elapsed / baud,
+	       (double)sim_stats.isrs / received,
+	       data_errors ? ", DATA ERRORS" : "");
+
+	return data_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
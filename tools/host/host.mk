@@ -0,0 +1,266 @@
+#
+# Copyright (c) 2017, Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+# 3. Neither the name of the Intel Corporation nor the names of its
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+
+# This file is included by the top-level Makefile in place of base.mk and
+# rom.mk when a host target is requested: it builds the firmware manager for
+# the host (see tools/host/README.rst) and does not need the IAMCU toolchain,
+# QMSI or TinyCrypt.
+
+include $(MK_BASE_DIR)/modes.mk
+
+ifeq ($(filter $(SOC),$(SUPPORTED_SOCS)),)
+$(error Supported SOC values are: $(SUPPORTED_SOCS); given value is '$(SOC)')
+endif
+
+V ?= 0
+
+# The simulator relies on POSIX pseudo-terminals and signals: Unix only.
+BUILD_DIR = $(BL_BASE_DIR)/build
+mkdir = @mkdir -p $(1)
+
+### Tools
+HOST_CC ?= gcc
+PYTHON2 ?= python2
+
+HOST_CC_0 = @echo "HOST_CC $@" && $(HOST_CC)
+HOST_CC_1 = $(HOST_CC)
+HOST_LD_0 = @echo "HOST_LD $@" && $(HOST_CC)
+HOST_LD_1 = $(HOST_CC)
+
+### Variables
+HOST_DIR = $(BL_BASE_DIR)/tools/host
+SIM_DIR = $(HOST_DIR)/sim
+BENCH_DIR = $(HOST_DIR)/bench
+FM_DIR = $(BL_BASE_DIR)/fw-manager
+HOST_BUILD_DIR = $(BUILD_DIR)/host/$(SOC)
+
+# The firmware manager sources run by the simulator (FM over UART, as in the
+# ROM).
+SIM_FM_SOURCES = $(addprefix $(FM_DIR)/, \
+		 bl_data.c \
+		 fm_flash.c \
+		 fw-manager_utils.c \
+		 dfu/core/dfu_core.c \
+		 dfu/qda/qda.c \
+		 dfu/qda/xmodem.c \
+		 dfu/qda/xmodem_io_uart.c \
+		 dfu/qda/xmodem_stream.c \
+		 qfm/qfm.c \
+		 qfu/qfu.c \
+		 qfu/qfu_hmac.c \
+		 qfu/qfu_lz.c \
+		 entries/fm_entry_uart.c)
+SIM_SOURCES = $(wildcard $(SIM_DIR)/*.c)
+
+### Flags
+HOST_CFLAGS = -std=c99 -O2 -g
+HOST_CFLAGS += -Wall -Wextra -Werror
+# Packed structures are accessed through aligned pointers on the target, and
+# the XMODEM state machine falls through on purpose.
+HOST_CFLAGS += -Wno-address-of-packed-member -Wno-implicit-fallthrough
+HOST_CFLAGS += -MMD -MP
+# As on the target, unused code (e.g., the QFU HMAC checks when authentication
+# is disabled) is discarded at link time.
+HOST_CFLAGS += -ffunction-sections -fdata-sections
+HOST_CFLAGS += -D$(shell echo $(SOC) | tr a-z A-Z)=1
+HOST_CFLAGS += -DENABLE_FIRMWARE_MANAGER=1 -DENABLE_FIRMWARE_MANAGER_UART=1
+HOST_CFLAGS += -DENABLE_FLASH_WRITE_PROTECTION=$(ENABLE_FLASH_WRITE_PROTECTION)
+HOST_CFLAGS += -DENABLE_BOOT_TIMING=0
+HOST_CFLAGS += -DHAS_RTC_XTAL=1 -DHAS_HYB_XTAL=1
+HOST_CFLAGS += -I$(HOST_DIR)/include -I$(SIM_DIR)
+HOST_CFLAGS += -I$(FM_DIR) -I$(FM_DIR)/entries
+HOST_CFLAGS += -I$(BL_BASE_DIR)/bootstrap
+HOST_CFLAGS += -I$(BL_BASE_DIR)/bootstrap/soc/$(SOC)/include
+
+# The register traps of sim_regs.c rely on the firmware accessing registers
+# at fixed addresses.
+HOST_LDFLAGS = -no-pie -Wl,--gc-sections
+# The idle callback of XMODEM is hooked by sim_main.c.
+SIM_LDFLAGS = -Wl,--wrap=xmodem_io_uart_set_idle_cb
+
+### Simulator variants
+# One simulator per FM authentication mode (the '_hmac' suffix matches the
+# name of the ROM), one with ping-pong BL-Data and, on Quark SE, a dual-bank
+# one (trial boot, delta images and in-application staging, which requires
+# flash write protection to be disabled). The dual-bank simulator also links
+# the staging library, which it runs on behalf of the application.
+SIM_VARIANTS = fm_sim fm_sim_hmac fm_sim_ping_pong $(SIM_VARIANTS_$(SOC))
+SIM_VARIANTS_quark_se = fm_sim_dual_hmac
+SIM_CFLAGS_fm_sim =
+SIM_CFLAGS_fm_sim_hmac = -DENABLE_FIRMWARE_MANAGER_AUTH=1
+SIM_CFLAGS_fm_sim_ping_pong = -DFM_CONFIG_BL_DATA_PING_PONG=1
+SIM_CFLAGS_fm_sim_dual_hmac = -DENABLE_FIRMWARE_MANAGER_AUTH=1 \
+			      -DBL_CONFIG_DUAL_BANK=1 \
+			      -UENABLE_FLASH_WRITE_PROTECTION \
+			      -DENABLE_FLASH_WRITE_PROTECTION=0 \
+			      -I$(FM_DIR)/qfu -I$(FM_DIR)/staging
+SIM_EXTRA_SOURCES_fm_sim_dual_hmac = $(FM_DIR)/staging/qfu_stage.c
+
+# sim_template: the rules building the simulator variant $(1).
+define sim_template
+$(1)_OBJ_DIR = $(HOST_BUILD_DIR)/obj/$(1)
+$(1)_OBJS = $$(patsubst $(BL_BASE_DIR)/%.c,$$($(1)_OBJ_DIR)/%.o, \
+	    $(SIM_FM_SOURCES) $(SIM_EXTRA_SOURCES_$(1)) $(SIM_SOURCES))
+
+$$($(1)_OBJ_DIR)/%.o: $(BL_BASE_DIR)/%.c
+	$$(call mkdir, $$(dir $$@))
+	$$(HOST_CC_$(V)) $$(HOST_CFLAGS) $$(SIM_CFLAGS_$(1)) -c -o $$@ $$<
+
+$(HOST_BUILD_DIR)/$(1): $$($(1)_OBJS)
+	$$(HOST_LD_$(V)) $$(HOST_LDFLAGS) $$(SIM_LDFLAGS) -o $$@ $$^
+
+-include $$($(1)_OBJS:.o=.d)
+endef
+
+$(foreach variant,$(SIM_VARIANTS),$(eval $(call sim_template,$(variant))))
+
+SIM_BINS = $(addprefix $(HOST_BUILD_DIR)/,$(SIM_VARIANTS))
+
+### Benchmarks
+# Benchmarks of single FM layers, linked with the simulator core (no
+# pseudo-terminal host needed).
+SIM_CORE_SOURCES = $(addprefix $(SIM_DIR)/,sim_soc.c sim_uart.c sim_regs.c)
+BENCH_OBJ_DIR = $(HOST_BUILD_DIR)/obj/bench
+bench_objs = $(patsubst $(BL_BASE_DIR)/%.c,$(BENCH_OBJ_DIR)/%.o,$(1))
+
+UART_BENCH = $(HOST_BUILD_DIR)/uart_bench
+UART_BENCH_OBJS = $(call bench_objs,$(BENCH_DIR)/uart_bench.c \
+		  $(FM_DIR)/dfu/qda/xmodem_io_uart.c $(SIM_CORE_SOURCES))
+# The baud rates measured by 'make uart-bench'.
+UART_BENCH_BAUDS = 115200 1000000 2000000
+# With QFU pipelined programming, also receive whole stream-mode QDA packets
+# (8 kB block) while the previous block is programmed in the background
+# (4 page erases and 2048 word writes with the default cost model).
+UART_BENCH_PIPELINE_quark_se = -p 9262 -w 61000
+
+# The CRC16 benchmark is built once per FM_CONFIG_CRC16_IMPL value.
+CRC_BENCH_IMPLS = bitwise slice4
+CRC_BENCH_CFLAGS_bitwise = -DFM_CONFIG_CRC16_IMPL=FM_CRC16_IMPL_BITWISE
+CRC_BENCH_CFLAGS_slice4 = -DFM_CONFIG_CRC16_IMPL=FM_CRC16_IMPL_SLICE4
+
+# crc_bench_template: the rules building the CRC16 benchmark for the
+# implementation $(1).
+define crc_bench_template
+crc_$(1)_OBJ_DIR = $(HOST_BUILD_DIR)/obj/crc_$(1)
+crc_$(1)_OBJS = $$(patsubst $(BL_BASE_DIR)/%.c,$$(crc_$(1)_OBJ_DIR)/%.o, \
+		$(BENCH_DIR)/crc_bench.c $(FM_DIR)/fw-manager_utils.c)
+
+$$(crc_$(1)_OBJ_DIR)/%.o: $(BL_BASE_DIR)/%.c
+	$$(call mkdir, $$(dir $$@))
+	$$(HOST_CC_$(V)) $$(HOST_CFLAGS) $$(CRC_BENCH_CFLAGS_$(1)) -c -o $$@ $$<
+
+$(HOST_BUILD_DIR)/crc_bench_$(1): $$(crc_$(1)_OBJS)
+	$$(HOST_LD_$(V)) $$(HOST_LDFLAGS) -o $$@ $$^
+
+-include $$(crc_$(1)_OBJS:.o=.d)
+endef
+
+$(foreach impl,$(CRC_BENCH_IMPLS),$(eval $(call crc_bench_template,$(impl))))
+
+CRC_BENCHES = $(addprefix $(HOST_BUILD_DIR)/crc_bench_,$(CRC_BENCH_IMPLS))
+
+# The trim code calibration benchmark runs bootstrap/boot_clk.c against an
+# oscillator model, once per calibration mode: full-period search, adaptive
+# periods, and adaptive periods seeded from the OTP.
+OSC_BENCH_VARIANTS = full adaptive seeded
+OSC_BENCH_CFLAGS_full = -DOSC_TRIM_ADAPTIVE=0 -DOSC_TRIM_SEED=0
+OSC_BENCH_CFLAGS_adaptive = -DOSC_TRIM_ADAPTIVE=1 -DOSC_TRIM_SEED=0
+OSC_BENCH_CFLAGS_seeded = -DOSC_TRIM_ADAPTIVE=1 -DOSC_TRIM_SEED=1
+
+# osc_bench_template: the rules building the trim code calibration benchmark
+# for the calibration mode $(1).
+define osc_bench_template
+osc_$(1)_OBJ_DIR = $(HOST_BUILD_DIR)/obj/osc_$(1)
+osc_$(1)_OBJS = $$(patsubst $(BL_BASE_DIR)/%.c,$$(osc_$(1)_OBJ_DIR)/%.o, \
+		$(BENCH_DIR)/osc_bench.c $(BL_BASE_DIR)/bootstrap/boot_clk.c)
+
+$$(osc_$(1)_OBJ_DIR)/%.o: $(BL_BASE_DIR)/%.c
+	$$(call mkdir, $$(dir $$@))
+	$$(HOST_CC_$(V)) $$(HOST_CFLAGS) $$(OSC_BENCH_CFLAGS_$(1)) -c -o $$@ $$<
+
+$(HOST_BUILD_DIR)/osc_bench_$(1): $$(osc_$(1)_OBJS)
+	$$(HOST_LD_$(V)) $$(HOST_LDFLAGS) -o $$@ $$^ -lm
+
+-include $$(osc_$(1)_OBJS:.o=.d)
+endef
+
+$(foreach variant,$(OSC_BENCH_VARIANTS),\
+	$(eval $(call osc_bench_template,$(variant))))
+
+OSC_BENCHES = $(addprefix $(HOST_BUILD_DIR)/osc_bench_,$(OSC_BENCH_VARIANTS))
+
+# The firmware update benchmark runs on the simulators of all SoCs and fails
+# if a metric is worse than in the baseline by more than BENCH_THRESHOLD
+# percent.
+BENCH_BASELINE = $(BENCH_DIR)/baseline.json
+BENCH_THRESHOLD ?= 5
+BENCH = $(PYTHON2) $(BENCH_DIR)/fm_bench.py --baseline $(BENCH_BASELINE) \
+	$(BUILD_DIR)/host
+
+$(BENCH_OBJ_DIR)/%.o: $(BL_BASE_DIR)/%.c
+	$(call mkdir, $(dir $@))
+	$(HOST_CC_$(V)) $(HOST_CFLAGS) -c -o $@ $<
+
+$(UART_BENCH): $(UART_BENCH_OBJS)
+	$(HOST_LD_$(V)) $(HOST_LDFLAGS) -o $@ $^
+
+-include $(UART_BENCH_OBJS:.o=.d)
+
+### Targets
+.PHONY: sim sim-test uart-bench crc-bench osc-bench bench bench-baseline
+.PHONY: bench-sims host-clean
+
+sim: $(SIM_BINS)
+
+sim-test: $(SIM_BINS)
+	$(foreach bin,$(SIM_BINS),\
+		$(PYTHON2) $(SIM_DIR)/sim_test.py --soc $(SOC) $(bin) &&) true
+
+uart-bench: $(UART_BENCH)
+	$(foreach baud,$(UART_BENCH_BAUDS),$(UART_BENCH) -b $(baud) && \
+		$(if $(UART_BENCH_PIPELINE_$(SOC)),\
+		$(UART_BENCH) -b $(baud) $(UART_BENCH_PIPELINE_$(SOC)) &&)) true
+
+crc-bench: $(CRC_BENCHES)
+	$(foreach bench,$(CRC_BENCHES),$(bench) &&) true
+
+osc-bench: $(OSC_BENCHES)
+	$(foreach bench,$(OSC_BENCHES),$(bench) &&) true
+
+bench-sims:
+	$(foreach soc,$(SUPPORTED_SOCS),$(MAKE) SOC=$(soc) sim &&) true
+
+bench: bench-sims
+	$(BENCH) --threshold $(BENCH_THRESHOLD)
+
+bench-baseline: bench-sims
+	$(BENCH) --update
+
+host-clean:
+	$(RM) -r $(HOST_BUILD_DIR)
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CLK_H__
+#define __CLK_H__
+
+#include "qm_common.h"
+#include "qm_soc_regs.h"
+
+/**
+ * Host emulation of the QMSI clock API.
+ *
+ * @defgroup groupHostClk Host Clock
+ * @{
+ */
+
+/** System clock sources. */
+typedef enum {
+	CLK_SYS_HYB_OSC_32MHZ,
+	CLK_SYS_HYB_OSC_16MHZ,
+	CLK_SYS_HYB_OSC_8MHZ,
+	CLK_SYS_HYB_OSC_4MHZ,
+	CLK_SYS_RTC_OSC,
+	CLK_SYS_CRYSTAL_OSC
+} clk_sys_mode_t;
+
+/** System clock divisors. */
+typedef enum {
+	CLK_SYS_DIV_1,
+	CLK_SYS_DIV_2,
+	CLK_SYS_DIV_4,
+	CLK_SYS_DIV_8,
+	CLK_SYS_DIV_NUM
+} clk_sys_div_t;
+
+/** Peripheral clock gates. */
+typedef enum {
+	CLK_PERIPH_REGISTER = BIT(0),
+	CLK_PERIPH_CLK = BIT(1),
+	CLK_PERIPH_GPIO_REGISTER = BIT(15),
+	CLK_PERIPH_UARTA_REGISTER = BIT(17),
+	CLK_PERIPH_UARTB_REGISTER = BIT(18),
+} clk_periph_t;
+
+/**
+ * Enable peripheral clocks.
+ *
+ * @param[in] clocks The clocks to enable (OR of clk_periph_t).
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ */
+int clk_periph_enable(const clk_periph_t clocks);
+
+/**
+ * @}
+ */
+
+#endif /* __CLK_H__ */
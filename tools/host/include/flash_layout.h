@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FLASH_LAYOUT_H__
+#define __FLASH_LAYOUT_H__
+
+#include "qm_soc_regs.h"
+
+/**
+ * Host emulation of the flash layout definitions (OTP and shadowed trim
+ * codes).
+ *
+ * @defgroup groupHostFlashLayout Host Flash Layout
+ * @{
+ */
+
+/** The OTP manufacturing data holding the trim codes. */
+typedef struct {
+	QM_RW uint32_t magic;
+	QM_RW uint32_t version;
+	QM_RW uint16_t osc_trim_32mhz;
+	QM_RW uint16_t osc_trim_16mhz;
+	QM_RW uint16_t osc_trim_8mhz;
+	QM_RW uint16_t osc_trim_4mhz;
+} qm_flash_otp_trim_t;
+
+extern qm_flash_otp_trim_t test_otp_trim;
+#define QM_FLASH_OTP_TRIM_CODE (&test_otp_trim)
+#define QM_FLASH_OTP_TRIM_MAGIC (QM_FLASH_OTP_TRIM_CODE->magic)
+#define QM_FLASH_OTP_SOC_DATA_VALID (0x24535021) /* $SP! */
+
+/** The trim codes shadowed in flash (at the beginning of BL-Data). */
+typedef union {
+	struct trim_fields {
+		QM_RW uint16_t osc_trim_32mhz;
+		QM_RW uint16_t osc_trim_16mhz;
+		QM_RW uint16_t osc_trim_8mhz;
+		QM_RW uint16_t osc_trim_4mhz;
+	} fields;
+	QM_RW uint32_t osc_trim_u32[2];
+	QM_RW uint16_t osc_trim_u16[4];
+} qm_flash_data_trim_t;
+
+#if (QUARK_SE)
+#define QM_FLASH_DATA_TRIM_REGION QM_FLASH_REGION_SYS
+#define QM_FLASH_DATA_TRIM_OFFSET (0x2F000)
+#define QM_FLASH_DATA_TRIM_BASE                                                \
+	(QM_FLASH_REGION_SYS_0_BASE + QM_FLASH_DATA_TRIM_OFFSET)
+#elif(QUARK_D2000)
+#define QM_FLASH_DATA_TRIM_REGION QM_FLASH_REGION_DATA
+#define QM_FLASH_DATA_TRIM_OFFSET (0)
+#define QM_FLASH_DATA_TRIM_BASE                                                \
+	(QM_FLASH_REGION_DATA_0_BASE + QM_FLASH_DATA_TRIM_OFFSET)
+#endif
+#define QM_FLASH_DATA_TRIM ((qm_flash_data_trim_t *)QM_FLASH_DATA_TRIM_BASE)
+#define QM_FLASH_DATA_TRIM_CODE (&QM_FLASH_DATA_TRIM->fields)
+
+/* A trim code is present when its 6 most significant bits are clear. */
+#define QM_FLASH_TRIM_PRESENT_MASK (0xFC00)
+#define QM_FLASH_TRIM_PRESENT (0x0000)
+
+/**
+ * @}
+ */
+
+#endif /* __FLASH_LAYOUT_H__ */
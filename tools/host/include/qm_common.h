@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QM_COMMON_H__
+#define __QM_COMMON_H__
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Host emulation of the QMSI common definitions.
+ *
+ * The headers in this folder replace the QMSI ones when the firmware manager
+ * is built for the host (see tools/host/host.mk). They provide only what the
+ * bootloader uses; the emulated peripherals are implemented by the simulator
+ * (tools/host/sim).
+ *
+ * @defgroup groupHostQMSI Host QMSI Emulation
+ * @{
+ */
+
+#define QM_RW volatile
+#define QM_R volatile const
+#define QM_W volatile
+
+#define BIT(x) (1U << (x))
+
+#define QM_PRINTF(...) printf(__VA_ARGS__)
+#define QM_PUTS(str) puts(str)
+
+#define QM_CHECK(cond, error)                                                  \
+	do {                                                                   \
+		if (!(cond)) {                                                 \
+			return (error);                                        \
+		}                                                              \
+	} while (0)
+
+/**
+ * @}
+ */
+
+#endif /* __QM_COMMON_H__ */
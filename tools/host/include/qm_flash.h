@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QM_FLASH_H__
+#define __QM_FLASH_H__
+
+#include "qm_common.h"
+#include "qm_soc_regs.h"
+
+/**
+ * Host emulation of the QMSI flash driver.
+ *
+ * The simulator implements program and erase on the flash regions it maps,
+ * accounting their duration in virtual time.
+ *
+ * @defgroup groupHostFlash Host Flash
+ * @{
+ */
+
+/** Flash regions. */
+typedef enum {
+	QM_FLASH_REGION_SYS = 0,
+#if (QUARK_D2000)
+	QM_FLASH_REGION_DATA,
+#endif
+	QM_FLASH_REGION_OTP,
+	QM_FLASH_REGION_NUM
+} qm_flash_region_t;
+
+/**
+ * Write a 32-bit word to flash.
+ *
+ * @param[in] flash  Flash controller.
+ * @param[in] region Flash region.
+ * @param[in] f_addr Byte offset of the word within the region.
+ * @param[in] data   The word to write.
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ * @retval Negative @ref errno for possible error codes.
+ */
+int qm_flash_word_write(const qm_flash_t flash, const qm_flash_region_t region,
+			uint32_t f_addr, const uint32_t data);
+
+/**
+ * Erase a flash page.
+ *
+ * @param[in] flash   Flash controller.
+ * @param[in] region  Flash region.
+ * @param[in] page_num The page within the region.
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ * @retval Negative @ref errno for possible error codes.
+ */
+int qm_flash_page_erase(const qm_flash_t flash, const qm_flash_region_t region,
+			uint32_t page_num);
+
+/**
+ * Erase a flash page and write words to it.
+ *
+ * @param[in] flash    Flash controller.
+ * @param[in] region   Flash region.
+ * @param[in] page_num The page within the region.
+ * @param[in] data     The words to write, from the start of the page.
+ * @param[in] len      The number of words to write (at most one page).
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ * @retval Negative @ref errno for possible error codes.
+ */
+int qm_flash_page_write(const qm_flash_t flash, const qm_flash_region_t region,
+			uint32_t page_num, const uint32_t *data, uint32_t len);
+
+/**
+ * Update words within a flash page (read-modify-erase-write).
+ *
+ * @param[in] flash       Flash controller.
+ * @param[in] region      Flash region.
+ * @param[in] f_addr      Byte offset of the first word within the region.
+ * @param[in] page_buffer A page-sized scratch buffer.
+ * @param[in] data_buffer The words to write.
+ * @param[in] len         The number of words to write.
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ * @retval Negative @ref errno for possible error codes.
+ */
+int qm_flash_page_update(const qm_flash_t flash, const qm_flash_region_t region,
+			 uint32_t f_addr, uint32_t *const page_buffer,
+			 const uint32_t *data_buffer, uint32_t len);
+
+/**
+ * @}
+ */
+
+#endif /* __QM_FLASH_H__ */
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QM_GPIO_H__
+#define __QM_GPIO_H__
+
+#include "qm_common.h"
+
+/**
+ * Host emulation of the QMSI GPIO driver.
+ *
+ * Only pin reads are supported; the level of the FM pin is set on the
+ * simulator command line.
+ *
+ * @defgroup groupHostGPIO Host GPIO
+ * @{
+ */
+
+/** GPIO ports. */
+typedef enum { QM_GPIO_0 = 0, QM_AON_GPIO_0, QM_GPIO_NUM } qm_gpio_t;
+
+/** GPIO pin levels. */
+typedef enum { QM_GPIO_LOW = 0, QM_GPIO_HIGH } qm_gpio_state_t;
+
+/**
+ * Read the level of a pin.
+ *
+ * @param[in]  gpio  GPIO port.
+ * @param[in]  pin   Pin number.
+ * @param[out] state The level of the pin. Must not be null.
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ * @retval Negative @ref errno for possible error codes.
+ */
+int qm_gpio_read_pin(const qm_gpio_t gpio, const uint8_t pin,
+		     qm_gpio_state_t *const state);
+
+/**
+ * @}
+ */
+
+#endif /* __QM_GPIO_H__ */
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QM_INTERRUPT_H__
+#define __QM_INTERRUPT_H__
+
+#include "qm_common.h"
+#include "qm_soc_regs.h"
+
+/**
+ * Host emulation of the QMSI interrupt API.
+ *
+ * Interrupt handlers are called by the simulator whenever an interrupt is
+ * pending and interrupts are enabled.
+ *
+ * @defgroup groupHostInterrupt Host Interrupt
+ * @{
+ */
+
+/** Interrupt service routine type. */
+typedef void (*qm_isr_t)(void);
+
+/** Enable interrupt delivery. */
+void qm_irq_enable(void);
+
+/** Disable interrupt delivery. */
+void qm_irq_disable(void);
+
+/**
+ * Register an interrupt handler for an interrupt line.
+ *
+ * @param[in] irq The interrupt line.
+ * @param[in] isr The interrupt handler.
+ */
+void qm_irq_request(uint32_t irq, qm_isr_t isr);
+
+/**
+ * Register an interrupt handler for an interrupt vector.
+ *
+ * @param[in] vector The interrupt vector.
+ * @param[in] isr    The interrupt handler.
+ */
+void qm_int_vector_request(uint32_t vector, qm_isr_t isr);
+
+#define QM_IRQ_REQUEST(irq, isr) qm_irq_request((irq), (isr))
+
+/**
+ * @}
+ */
+
+#endif /* __QM_INTERRUPT_H__ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QM_PIC_TIMER_H__
+#define __QM_PIC_TIMER_H__
+
+#include "qm_common.h"
+
+/**
+ * Host emulation of the QMSI PIC timer driver.
+ *
+ * The timer counts at the system clock frequency (32 MHz) in virtual time.
+ *
+ * @defgroup groupHostPICTimer Host PIC Timer
+ * @{
+ */
+
+/** PIC timer mode. */
+typedef enum {
+	QM_PIC_TIMER_MODE_ONE_SHOT, /**< One shot mode. */
+	QM_PIC_TIMER_MODE_PERIODIC  /**< Periodic mode. */
+} qm_pic_timer_mode_t;
+
+/** PIC timer configuration. */
+typedef struct {
+	qm_pic_timer_mode_t mode;	/**< Operation mode. */
+	bool int_en;			/**< Interrupt enable. */
+	void (*callback)(void *data);   /**< Expiration callback. */
+	void *callback_data;		/**< Callback user data. */
+} qm_pic_timer_config_t;
+
+/**
+ * Set the PIC timer configuration.
+ *
+ * @param[in] cfg The configuration. Must not be null.
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ * @retval Negative @ref errno for possible error codes.
+ */
+int qm_pic_timer_set_config(const qm_pic_timer_config_t *const cfg);
+
+/**
+ * Start the timer (or stop it, if count is 0).
+ *
+ * @param[in] count The initial count, in system clock cycles.
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ * @retval Negative @ref errno for possible error codes.
+ */
+int qm_pic_timer_set(const uint32_t count);
+
+/**
+ * @}
+ */
+
+#endif /* __QM_PIC_TIMER_H__ */
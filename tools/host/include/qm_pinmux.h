@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QM_PINMUX_H__
+#define __QM_PINMUX_H__
+
+#include "qm_common.h"
+
+/**
+ * Host emulation of the QMSI pin muxing driver (no-op).
+ *
+ * @defgroup groupHostPinMux Host Pin Muxing
+ * @{
+ */
+
+/** Pin functions. */
+typedef enum {
+	QM_PMUX_FN_0,
+	QM_PMUX_FN_1,
+	QM_PMUX_FN_2,
+	QM_PMUX_FN_3,
+} qm_pmux_fn_t;
+
+/** Pin IDs. */
+typedef enum {
+	QM_PIN_ID_12 = 12,
+	QM_PIN_ID_13,
+	QM_PIN_ID_14,
+	QM_PIN_ID_15,
+	QM_PIN_ID_16,
+	QM_PIN_ID_17,
+	QM_PIN_ID_18,
+	QM_PIN_ID_19,
+	QM_PIN_ID_20,
+	QM_PIN_ID_21,
+	QM_PIN_ID_NUM
+} qm_pin_id_t;
+
+int qm_pmux_select(const qm_pin_id_t pin, const qm_pmux_fn_t fn);
+int qm_pmux_input_en(const qm_pin_id_t pin, const bool enable);
+int qm_pmux_pullup_en(const qm_pin_id_t pin, const bool enable);
+
+/**
+ * @}
+ */
+
+#endif /* __QM_PINMUX_H__ */
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QM_SOC_REGS_H__
+#define __QM_SOC_REGS_H__
+
+#include "qm_common.h"
+
+/**
+ * Host emulation of the SoC registers.
+ *
+ * Only the registers and the fields used by the bootloader are defined. As in
+ * the UNIT_TEST build of QMSI, register blocks are not at their SoC addresses:
+ * the simple ones are plain variables (named test_*), while the ones with
+ * side effects on access are either reached through pointers set up by the
+ * host program, which traps the accesses (UART, see sim_regs.h), or through a
+ * function of the host program called before every access (AON counter).
+ *
+ * Flash regions are the exception: they are mapped by the simulator at their
+ * SoC addresses, so that the partition and BL-Data addresses computed by the
+ * bootloader can be used as they are.
+ *
+ * @defgroup groupHostSoCRegs Host SoC Registers
+ * @{
+ */
+
+#if (QUARK_SE)
+#define HAS_APIC (1)
+#elif(QUARK_D2000)
+#define HAS_MVIC (1)
+#else
+#error "Define QUARK_SE or QUARK_D2000"
+#endif
+
+/*
+ * System Control Subsystem.
+ */
+
+/** General purpose (sticky) registers. */
+typedef struct {
+	QM_RW uint32_t gps0;
+	QM_RW uint32_t gps1;
+	QM_RW uint32_t gps2;
+	QM_RW uint32_t gps3;
+	QM_RW uint32_t reserved;
+	QM_RW uint32_t gp0;
+	QM_RW uint32_t gp1;
+	QM_RW uint32_t gp2;
+	QM_RW uint32_t gp3;
+} qm_scss_gp_reg_t;
+
+extern qm_scss_gp_reg_t test_scss_gp;
+#define QM_SCSS_GP (&test_scss_gp)
+
+#define QM_GPS0_BIT_FM (0)
+
+/** Clock Control Unit. */
+typedef struct {
+	QM_RW uint32_t osc0_cfg0;
+	QM_RW uint32_t osc0_stat1;
+	QM_RW uint32_t osc0_cfg1;
+	QM_RW uint32_t osc1_stat0;
+	QM_RW uint32_t osc1_cfg0;
+	QM_RW uint32_t ccu_periph_clk_gate_ctl;
+	QM_RW uint32_t ccu_periph_clk_div_ctl0;
+	QM_RW uint32_t ccu_sys_clk_ctl;
+} qm_scss_ccu_reg_t;
+
+extern qm_scss_ccu_reg_t test_scss_ccu;
+#define QM_SCSS_CCU (&test_scss_ccu)
+
+#define QM_OSC0_LOCK_SI BIT(0)
+#define QM_OSC0_EN_SI_OSC BIT(1)
+#define QM_OSC0_MODE_SEL BIT(3)
+#define OSC0_CFG1_SI_FREQ_SEL_OFFS (8)
+#define OSC0_CFG1_SI_FREQ_SEL_MASK (0x3 << OSC0_CFG1_SI_FREQ_SEL_OFFS)
+#define OSC0_CFG1_FTRIMOTP_OFFS (20)
+#define OSC0_CFG1_FTRIMOTP_MASK (0x3FF << OSC0_CFG1_FTRIMOTP_OFFS)
+
+#define QM_CCU_SYS_CLK_SEL BIT(0)
+#define QM_CCU_SYS_CLK_DIV_EN BIT(7)
+#define QM_CCU_SYS_CLK_DIV_OFFSET (8)
+#define QM_CCU_SYS_CLK_DIV_MASK (0x7 << QM_CCU_SYS_CLK_DIV_OFFSET)
+#define CLK_SYS_CLK_DIV_DEF_MASK                                               \
+	(~(QM_CCU_SYS_CLK_DIV_MASK | QM_CCU_SYS_CLK_DIV_EN | QM_CCU_SYS_CLK_SEL))
+
+/*
+ * Always-on counter.
+ */
+
+typedef struct {
+	QM_RW uint32_t aonc_cnt;
+	QM_RW uint32_t aonc_cfg;
+	QM_RW uint32_t aonpt_cnt;
+	QM_RW uint32_t aonpt_stat;
+	QM_RW uint32_t aonpt_ctrl;
+	QM_RW uint32_t aonpt_cfg;
+} qm_aonc_reg_t;
+
+typedef enum { QM_AONC_0 = 0, QM_AONC_NUM } qm_aonc_t;
+
+/**
+ * Get the AON counters, before a register access.
+ *
+ * The AON counter is polled in tight loops: a function call per access is
+ * much cheaper than a trapped access.
+ *
+ * @return The AON counter registers, indexed by qm_aonc_t.
+ */
+qm_aonc_reg_t **test_aonc_access(void);
+#define QM_AONC (test_aonc_access())
+
+/*
+ * UART.
+ */
+
+typedef struct {
+	QM_RW uint32_t rbr_thr_dll; /**< Rx Buffer / Tx Holding / Div Latch Low */
+	QM_RW uint32_t ier_dlh;     /**< Interrupt Enable / Div Latch High */
+	QM_RW uint32_t iir_fcr;     /**< Interrupt Id / FIFO Control */
+	QM_RW uint32_t lcr;	 /**< Line Control */
+	QM_RW uint32_t mcr;	 /**< MODEM Control */
+	QM_RW uint32_t lsr;	 /**< Line Status */
+	QM_RW uint32_t msr;	 /**< MODEM Status */
+	QM_RW uint32_t scr;	 /**< Scratchpad */
+	QM_RW uint32_t reserved[40];
+	QM_RW uint32_t dlf; /**< Divisor Latch Fraction */
+	QM_RW uint32_t padding[207];
+} qm_uart_reg_t;
+
+typedef enum { QM_UART_0 = 0, QM_UART_1, QM_UART_NUM } qm_uart_t;
+
+extern qm_uart_reg_t *qm_uart[QM_UART_NUM];
+#define QM_UART qm_uart
+
+#define QM_UART_IER_ERBFI BIT(0)
+#define QM_UART_IER_ETBEI BIT(1)
+#define QM_UART_IER_ELSI BIT(2)
+
+#define QM_UART_LSR_DR BIT(0)
+#define QM_UART_LSR_OE BIT(1)
+#define QM_UART_LSR_PE BIT(2)
+#define QM_UART_LSR_FE BIT(3)
+#define QM_UART_LSR_BI BIT(4)
+#define QM_UART_LSR_THRE BIT(5)
+#define QM_UART_LSR_TEMT BIT(6)
+
+#define QM_UART_LC_8N1 (0x03)
+
+/** Pack the divisor latch fields (high, low, fraction) into a divisor. */
+#define QM_UART_CFG_BAUD_DL_PACK(dlh, dll, dlf)                                \
+	(((dlh) << 16) | ((dll) << 8) | (dlf))
+#define QM_UART_CFG_BAUD_DLH_UNPACK(packed) (((packed) >> 16) & 0xFF)
+#define QM_UART_CFG_BAUD_DLL_UNPACK(packed) (((packed) >> 8) & 0xFF)
+#define QM_UART_CFG_BAUD_DLF_UNPACK(packed) ((packed)&0xF)
+
+/** 115200 bps with the 32 MHz system clock. */
+#define BOOTROM_UART_115200 QM_UART_CFG_BAUD_DL_PACK(0, 17, 6)
+
+/*
+ * Flash.
+ */
+
+typedef struct {
+	QM_RW uint32_t tmg_ctrl;
+	QM_RW uint32_t rom_wr_ctrl;
+	QM_RW uint32_t rom_wr_data;
+	QM_RW uint32_t flash_wr_ctrl;
+	QM_RW uint32_t flash_wr_data;
+	QM_RW uint32_t flash_stts;
+	QM_RW uint32_t ctrl;
+	QM_RW uint32_t fpr_rd_cfg[4];
+	QM_RW uint32_t mpr_wr_cfg;
+	QM_RW uint32_t mpr_vsts;
+} qm_flash_reg_t;
+
+#if (QUARK_SE)
+typedef enum { QM_FLASH_0 = 0, QM_FLASH_1, QM_FLASH_NUM } qm_flash_t;
+
+#define QM_FLASH_REGION_SYS_0_BASE (0x40000000)
+#define QM_FLASH_REGION_SYS_1_BASE (0x40030000)
+/* The size of the system region of each controller. */
+#define QM_FLASH_MAX_ADDR (0x30000)
+#elif(QUARK_D2000)
+typedef enum { QM_FLASH_0 = 0, QM_FLASH_NUM } qm_flash_t;
+
+#define QM_FLASH_REGION_SYS_0_BASE (0x00180000)
+#define QM_FLASH_REGION_DATA_0_BASE (0x00200000)
+#define QM_FLASH_REGION_DATA_0_SIZE (0x1000)
+#define QM_FLASH_MAX_ADDR (0x8000)
+#endif
+#define QM_FLASH_PAGE_SIZE_DWORDS (0x200)
+#define QM_FLASH_PAGE_SIZE_BYTES (QM_FLASH_PAGE_SIZE_DWORDS << 2)
+
+#define QM_FLASH_CTRL_PRE_FLUSH_MASK BIT(3)
+
+extern qm_flash_reg_t test_flash_instance[QM_FLASH_NUM];
+extern qm_flash_reg_t *qm_flash[QM_FLASH_NUM];
+#define QM_FLASH qm_flash
+
+/*
+ * Flash and memory protection.
+ */
+
+typedef enum {
+	QM_MAIN_FLASH_SYSTEM = 0,
+#if (QUARK_D2000)
+	QM_MAIN_FLASH_DATA,
+#endif
+	QM_MAIN_FLASH_NUM
+} qm_flash_region_type_t;
+
+#define QM_FPR_GRANULARITY (1024)
+
+/*
+ * Interrupts.
+ */
+
+#if (QUARK_SE)
+#define QM_IRQ_UART_0_INT (5)
+#define QM_IRQ_UART_1_INT (6)
+#define QM_IRQ_TO_VECTOR(irq) ((irq) + 36)
+#define QM_X86_PIC_TIMER_INT_VECTOR (32)
+#elif(QUARK_D2000)
+#define QM_IRQ_UART_0_INT (8)
+#define QM_IRQ_UART_1_INT (20)
+#define QM_IRQ_PIC_TIMER (10)
+#define QM_IRQ_TO_VECTOR(irq) ((irq) + 32)
+#endif
+#define QM_IRQ_UART_0_INT_VECTOR QM_IRQ_TO_VECTOR(QM_IRQ_UART_0_INT)
+#define QM_IRQ_UART_1_INT_VECTOR QM_IRQ_TO_VECTOR(QM_IRQ_UART_1_INT)
+
+/** The number of interrupt vectors. */
+#define QM_INT_VECTOR_NUM (64)
+
+/**
+ * @}
+ */
+
+#endif /* __QM_SOC_REGS_H__ */
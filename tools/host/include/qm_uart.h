@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QM_UART_H__
+#define __QM_UART_H__
+
+#include "qm_common.h"
+#include "qm_soc_regs.h"
+
+/**
+ * Host emulation of the QMSI UART driver.
+ *
+ * @defgroup groupHostUART Host UART
+ * @{
+ */
+
+/** UART configuration. */
+typedef struct {
+	uint32_t line_control; /**< Line control (LCR). */
+	uint32_t baud_divisor; /**< Packed baud divisor. */
+	bool hw_fc;	    /**< Hardware flow control. */
+} qm_uart_config_t;
+
+/**
+ * Set the UART configuration.
+ *
+ * The UART FIFOs are reset.
+ *
+ * @param[in] uart UART index.
+ * @param[in] cfg  New UART configuration. Must not be null.
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ * @retval Negative @ref errno for possible error codes.
+ */
+int qm_uart_set_config(const qm_uart_t uart, const qm_uart_config_t *cfg);
+
+/**
+ * Polled write of a single byte.
+ *
+ * @param[in] uart UART index.
+ * @param[in] data The byte to write.
+ *
+ * @return Standard errno return type for QMSI.
+ * @retval 0 on success.
+ * @retval Negative @ref errno for possible error codes.
+ */
+int qm_uart_write(const qm_uart_t uart, const uint8_t data);
+
+/**
+ * @}
+ */
+
+#endif /* __QM_UART_H__ */
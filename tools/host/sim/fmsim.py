@@ -0,0 +1,214 @@
+#!/usr/bin/python -tt
+# -*- coding: utf-8 -*-
+# Copyright (c) 2017, Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+# 3. Neither the name of the Intel Corporation nor the names of its
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+"""Helpers to run the firmware manager simulator and the management tools.
+
+The simulator exposes the firmware manager UART on a pseudo-terminal; the
+management tools (qm_manage.py and qm_make_dfu.py) talk to it through the
+dfu-util-qda implementation found next to this file."""
+
+from __future__ import print_function, division
+import json
+import os
+import shutil
+import signal
+import subprocess
+import sys
+import time
+
+SIM_DIR = os.path.dirname(os.path.abspath(__file__))
+BL_BASE_DIR = os.path.dirname(os.path.dirname(os.path.dirname(SIM_DIR)))
+SYSUPDATE_DIR = os.path.join(BL_BASE_DIR, "tools", "sysupdate")
+
+# How long to wait for the simulator to create its pseudo-terminal.
+START_TIMEOUT = 5.0
+
+# The flash regions saved in the flash file, in order: (address, size).
+FLASH_REGIONS = {
+    "quark_se": [(0x40000000, 0x30000), (0x40030000, 0x30000)],
+    "quark_d2000": [(0x00180000, 0x8000), (0x00200000, 0x1000)],
+}
+
+
+class SimError(Exception):
+    """Simulator or tool failure."""
+    pass
+
+
+def run_tool(args, check=True):
+    """Run a management tool (with dfu-util-qda in the PATH).
+
+    Args:
+        args (list): The tool (relative to tools/sysupdate) and its arguments.
+        check (bool): Whether to raise SimError if the tool fails.
+
+    Returns:
+        A (returncode, output) tuple."""
+    env = dict(os.environ)
+    env["PATH"] = SIM_DIR + os.pathsep + env.get("PATH", "")
+    cmd = [sys.executable, os.path.join(SYSUPDATE_DIR, args[0])] + args[1:]
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT, env=env,
+                            universal_newlines=True)
+    out = proc.communicate()[0]
+    if check and proc.returncode:
+        raise SimError("%s failed:\n%s" % (" ".join(args), out))
+    return proc.returncode, out
+
+
+def make_image(binary, out_file, partition, soc, key=None, extra=()):
+    """Create a QFU image (with DFU suffix) with qm_make_dfu.py."""
+    args = ["qm_make_dfu.py", "-q", "-p", str(partition), "--soc", soc,
+            "-o", out_file]
+    if key:
+        args += ["--key", key]
+    run_tool(args + list(extra) + [binary])
+
+
+def flash_read(flash_file, soc, addr, size):
+    """Read the content of a flash file at a SoC address."""
+    offset = 0
+    for base, region_size in FLASH_REGIONS[soc]:
+        if base <= addr and addr + size <= base + region_size:
+            with open(flash_file, "rb") as in_file:
+                in_file.seek(offset + addr - base)
+                return in_file.read(size)
+        offset += region_size
+    raise SimError("no flash at 0x%08x" % addr)
+
+
+class Simulator(object):
+    """A simulator process, with its flash file and pseudo-terminal.
+
+    Can be used as a context manager (the simulator is stopped on exit)."""
+
+    def __init__(self, binary, work_dir, flash=None, options=()):
+        """Prepare a simulator run.
+
+        Args:
+            binary (string): The simulator binary.
+            work_dir (string): Where to put the flash file, the statistics
+                               and the log.
+            flash (string): A flash file to start from (copied, unless it
+                            is the flash file of the work directory); the
+                            flash is blank if None.
+            options (list): Additional simulator options."""
+        self.binary = binary
+        self.port = os.path.join(work_dir, "tty")
+        self.flash = os.path.join(work_dir, "flash.bin")
+        self.stats_file = os.path.join(work_dir, "stats.json")
+        self.log_file = os.path.join(work_dir, "sim.log")
+        self.options = list(options)
+        self.proc = None
+        self.stats = None
+        self.gps0 = 0
+        if flash:
+            if os.path.abspath(flash) != self.flash:
+                shutil.copyfile(flash, self.flash)
+        elif os.path.exists(self.flash):
+            os.remove(self.flash)
+
+    def start(self):
+        """Start the simulator and wait for its pseudo-terminal."""
+        for name in (self.port, self.stats_file):
+            if os.path.lexists(name):
+                os.remove(name)
+        with open(self.log_file, "w") as log:
+            self.proc = subprocess.Popen(
+                [self.binary, "-l", self.port, "-f", self.flash,
+                 "-s", self.stats_file] + self.options,
+                stdout=log, stderr=subprocess.STDOUT)
+        deadline = time.time() + START_TIMEOUT
+        while not os.path.lexists(self.port):
+            if self.proc.poll() is not None or time.time() > deadline:
+                self.stop()
+                raise SimError("the simulator did not start (see %s)" %
+                               self.log_file)
+            time.sleep(0.01)
+        return self
+
+    def stop(self):
+        """Stop the simulator and return its statistics (or None)."""
+        if self.proc:
+            if self.proc.poll() is None:
+                self.proc.send_signal(signal.SIGTERM)
+            self.proc.wait()
+            self.proc = None
+            self._read_stats()
+        return self.stats
+
+    def boot(self, warm=False, options=()):
+        """Boot the application: run the boot flow of the ROM and the model
+        of the application (see the --boot option of the simulator), which
+        ends with a warm reset.
+
+        Args:
+            warm (bool): Whether the device was reset by a warm reset (i.e.,
+                         the GPS0 sticky register is kept from the previous
+                         run) rather than powered on.
+            options (list): Application options (e.g., --confirm).
+
+        Returns:
+            The statistics of the run (the booted partition is
+            "boot_partition", -1 if none)."""
+        args = [self.binary, "--boot", "-f", self.flash, "-s",
+                self.stats_file] + self.options + list(options)
+        if warm:
+            args += ["--gps0", str(self.gps0)]
+        if os.path.exists(self.stats_file):
+            os.remove(self.stats_file)
+        with open(self.log_file, "w") as log:
+            if subprocess.call(args, stdout=log, stderr=subprocess.STDOUT):
+                raise SimError("the simulator failed (see %s)" %
+                               self.log_file)
+        return self._read_stats()
+
+    def _read_stats(self):
+        """Load the statistics written by the simulator on exit."""
+        if os.path.exists(self.stats_file):
+            with open(self.stats_file) as stats_file:
+                self.stats = json.load(stats_file)
+            self.gps0 = self.stats["gps0"]
+        return self.stats
+
+    def manage(self, cmd, *args, **kwargs):
+        """Run a qm_manage.py command against the simulator."""
+        return run_tool(["qm_manage.py", cmd, "-p", self.port] + list(args),
+                        **kwargs)[1]
+
+    def provision(self, rv_key, fw_key):
+        """Set the revocation and the firmware keys of a blank device."""
+        self.manage("set-rv-key", rv_key)
+        self.manage("set-fw-key", fw_key, "--curr-rv-key", rv_key)
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, *exc):
+        self.stop()
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Firmware manager host simulator.
+ *
+ * The firmware manager sources are compiled for the host and run on top of
+ * an emulation of the QMSI drivers they use. The emulation runs in virtual
+ * time, so that the results do not depend on the speed of the host:
+ *
+ * - the CPU is busy only while flash operations and SHA-256 compressions
+ *   are in progress (their duration is given by a cost model); any other
+ *   code runs in zero time;
+ * - the CPU is idle while the firmware waits for UART data, i.e., in the
+ *   XMODEM idle callback; virtual time then jumps to the next event;
+ * - UART bytes sent by the host program (through a pseudo-terminal) arrive
+ *   back to back at the configured baud rate, starting no earlier than the
+ *   end of the last transmission of the device.
+ *
+ * Everything is synchronous: events (byte arrivals, character timeouts,
+ * timer expirations) are processed, and interrupt handlers called, only when
+ * virtual time advances. Events that occurred while interrupts were disabled
+ * are delivered when interrupts are enabled again.
+ *
+ * @defgroup groupHostSim Host Simulator
+ * @{
+ */
+
+/** Virtual time, in nanoseconds. */
+typedef uint64_t sim_time_t;
+
+/** A time that never comes. */
+#define SIM_NEVER (UINT64_MAX)
+
+#define SIM_NS_PER_SEC (1000000000ULL)
+#define SIM_NS_PER_MS (1000000ULL)
+
+/** The system clock frequency (hybrid oscillator at 32 MHz). */
+#define SIM_SYS_CLK_HZ (32000000ULL)
+
+/** Convert system clock cycles to virtual time. */
+#define SIM_CYCLES_TO_NS(cycles) ((cycles)*SIM_NS_PER_SEC / SIM_SYS_CLK_HZ)
+
+/** Simulator options (see sim_main.c for their command line switches). */
+typedef struct {
+	/** Symbolic link to create to the pseudo-terminal (or NULL). */
+	const char *link;
+	/** The file holding the flash content (or NULL). */
+	const char *flash_file;
+	/** The file where statistics are written on exit (or NULL). */
+	const char *stats_file;
+	/** The duration of a page erase, in ns. */
+	uint64_t page_erase_ns;
+	/** The duration of a word program, in ns. */
+	uint64_t word_write_ns;
+	/** The duration of a SHA-256 compression (64-byte block), in ns. */
+	uint64_t sha_block_ns;
+	/** How long to wait for the host before letting a timer expire. */
+	uint32_t host_wait_ms;
+	/** Corrupt one received byte out of error_rate on average (0: none). */
+	uint32_t error_rate;
+	/** The seed of the error generator. */
+	uint32_t seed;
+	/** The level of the FM GPIO pin (0: stay in FM mode). */
+	int fm_pin;
+	/** Boot the application instead of entering FM mode. */
+	bool boot;
+	/** Whether the application confirms its boot. */
+	bool confirm;
+	/** The QFU image the application stages (or NULL). */
+	const char *stage_file;
+	/** The value of the GPS0 sticky register at reset. */
+	uint32_t gps0;
+	/** The flash page where the power is cut (0: none). */
+	uintptr_t cut_page;
+	/** The write of the page that is interrupted (0: none). */
+	uint32_t cut_write;
+	/** The operation of the write before which the power is cut. */
+	uint32_t cut_op;
+} sim_options_t;
+
+/** Simulator statistics, dumped as JSON on exit. */
+typedef struct {
+	/** The virtual time spent idle (waiting for an interrupt). */
+	uint64_t idle_ns;
+	/** The virtual time spent programming and erasing flash. */
+	uint64_t flash_ns;
+	/** The virtual time spent hashing. */
+	uint64_t sha_ns;
+	/** The virtual time of the first and the last received byte. */
+	uint64_t rx_first_ns;
+	uint64_t rx_last_ns;
+	/** The number of bytes received and transmitted. */
+	uint64_t rx_bytes;
+	uint64_t tx_bytes;
+	/** The number of times the host sent data after the device did. */
+	uint64_t round_trips;
+	/** The number of received bytes corrupted on purpose. */
+	uint64_t rx_corrupted;
+	/** The number of bytes lost to UART FIFO overruns. */
+	uint64_t rx_overruns;
+	/** The number of interrupt handlers called. */
+	uint64_t isrs;
+	/** The number of PIC timer expirations. */
+	uint64_t timer_expirations;
+	/** The number of times the host was given time to send data. */
+	uint64_t host_waits;
+	/** The number of flash page erases and word writes. */
+	uint64_t page_erases;
+	uint64_t word_writes;
+	/** The number of SHA-256 compressions. */
+	uint64_t sha_blocks;
+	/** The number of writes of the power cut page (across SoC resets). */
+	uint64_t cut_page_writes;
+	/** Whether the power has been cut. */
+	uint64_t power_cuts;
+} sim_stats_t;
+
+extern sim_options_t sim_opts;
+extern sim_stats_t sim_stats;
+
+/** The current virtual time. */
+extern sim_time_t sim_now;
+
+/** Set when a termination signal has been received. */
+extern volatile int sim_quit;
+
+/**
+ * Keep the CPU busy for some time.
+ *
+ * Events occurring meanwhile are processed (interrupts permitting).
+ *
+ * @param[in] duration The busy time, in ns.
+ */
+void sim_busy(sim_time_t duration);
+
+/**
+ * Wait for an interrupt (i.e., idle until an interrupt handler has run).
+ *
+ * Exit the simulator if a termination signal was received.
+ */
+void sim_wait(void);
+
+/** Whether an interrupt handler is running. */
+bool sim_in_isr(void);
+
+/**
+ * Save the flash content and the statistics and exit.
+ *
+ * @param[in] status The exit status.
+ */
+void sim_exit(int status) __attribute__((noreturn));
+
+/*
+ * UART emulation (sim_uart.c).
+ */
+
+/**
+ * Set up the pseudo-terminal and the UART registers.
+ *
+ * The pseudo-terminal inherited from a previous run of the simulator (after a
+ * SoC reset) is reused, if any.
+ */
+void sim_uart_init(void);
+
+/** Prepare the pseudo-terminal to be inherited across exec(). */
+void sim_uart_keep(void);
+
+/**
+ * Read the data sent by the host.
+ *
+ * @param[in] timeout_ms How long to wait for data (-1: forever).
+ *
+ * @return Whether some data has been read.
+ */
+bool sim_uart_host_poll(int timeout_ms);
+
+/**
+ * Send data to the device as if the host wrote it now.
+ *
+ * Used by programs driving the UART without a host on the pseudo-terminal.
+ *
+ * @param[in] data The data.
+ * @param[in] len  The length of the data.
+ *
+ * @return The number of bytes queued (limited by the room left in the queue).
+ */
+size_t sim_uart_host_send(const uint8_t *data, size_t len);
+
+/**
+ * Let the host know that it was silent until a given time.
+ *
+ * Data read later is stamped after that time.
+ *
+ * @param[in] until The end of the silence.
+ */
+void sim_uart_host_silent(sim_time_t until);
+
+/** Whether data received from the host is yet to be delivered. */
+bool sim_uart_rx_queued(void);
+
+/** The time of the next UART event (SIM_NEVER if none). */
+sim_time_t sim_uart_next_event(void);
+
+/**
+ * Process the UART events due up to a given time.
+ *
+ * @param[in] t The time.
+ */
+void sim_uart_run(sim_time_t t);
+
+/** Whether the UART interrupt line is asserted. */
+bool sim_uart_irq(void);
+
+/*
+ * Flash emulation (sim_flash.c).
+ */
+
+/** Map the flash regions and load their content. */
+void sim_flash_init(void);
+
+/** Save the flash content. */
+void sim_flash_save(void);
+
+/**
+ * @}
+ */
+
+#endif /* __SIM_H__ */
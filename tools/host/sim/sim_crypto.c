@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "tinycrypt/sha256.h"
+#include "tinycrypt/hmac.h"
+
+#include "sim.h"
+
+/*
+ * TinyCrypt SHA-256 and HMAC-SHA256 replacement.
+ *
+ * Each compression (64-byte block) keeps the CPU busy for the time given by
+ * the cost model, so that hashing costs what it does on the SoC.
+ */
+
+#define HMAC_IPAD (0x36)
+#define HMAC_OPAD (0x5c)
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t k256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static void compress(unsigned int *iv, const uint8_t *data)
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h, t1, t2, s0, s1;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		w[i] = ((uint32_t)data[4 * i] << 24) |
+		       ((uint32_t)data[4 * i + 1] << 16) |
+		       ((uint32_t)data[4 * i + 2] << 8) | data[4 * i + 3];
+	}
+	for (i = 16; i < 64; i++) {
+		s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^
+		     (w[i - 15] >> 3);
+		s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	a = iv[0];
+	b = iv[1];
+	c = iv[2];
+	d = iv[3];
+	e = iv[4];
+	f = iv[5];
+	g = iv[6];
+	h = iv[7];
+	for (i = 0; i < 64; i++) {
+		t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) +
+		     ((e & f) ^ (~e & g)) + k256[i] + w[i];
+		t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) +
+		     ((a & b) ^ (a & c) ^ (b & c));
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	iv[0] += a;
+	iv[1] += b;
+	iv[2] += c;
+	iv[3] += d;
+	iv[4] += e;
+	iv[5] += f;
+	iv[6] += g;
+	iv[7] += h;
+
+	sim_stats.sha_blocks++;
+	sim_stats.sha_ns += sim_opts.sha_block_ns;
+	sim_busy(sim_opts.sha_block_ns);
+}
+
+int tc_sha256_init(TCSha256State_t s)
+{
+	static const unsigned int iv[TC_SHA256_STATE_BLOCKS] = {
+	    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+	if (!s) {
+		return TC_CRYPTO_FAIL;
+	}
+	memset(s, 0, sizeof(*s));
+	memcpy(s->iv, iv, sizeof(iv));
+
+	return TC_CRYPTO_SUCCESS;
+}
+
+int tc_sha256_update(TCSha256State_t s, const uint8_t *data, size_t datalen)
+{
+	if (!s || (!data && datalen)) {
+		return TC_CRYPTO_FAIL;
+	}
+	while (datalen--) {
+		s->leftover[s->leftover_offset++] = *data++;
+		if (s->leftover_offset == TC_SHA256_BLOCK_SIZE) {
+			compress(s->iv, s->leftover);
+			s->leftover_offset = 0;
+			s->bits_hashed += TC_SHA256_BLOCK_SIZE * 8;
+		}
+	}
+
+	return TC_CRYPTO_SUCCESS;
+}
+
+int tc_sha256_final(uint8_t *digest, TCSha256State_t s)
+{
+	uint64_t bits;
+	int i;
+
+	if (!digest || !s) {
+		return TC_CRYPTO_FAIL;
+	}
+	bits = s->bits_hashed + s->leftover_offset * 8;
+	s->leftover[s->leftover_offset++] = 0x80;
+	if (s->leftover_offset > TC_SHA256_BLOCK_SIZE - 8) {
+		memset(s->leftover + s->leftover_offset, 0,
+		       TC_SHA256_BLOCK_SIZE - s->leftover_offset);
+		compress(s->iv, s->leftover);
+		s->leftover_offset = 0;
+	}
+	memset(s->leftover + s->leftover_offset, 0,
+	       TC_SHA256_BLOCK_SIZE - 8 - s->leftover_offset);
+	for (i = 0; i < 8; i++) {
+		s->leftover[TC_SHA256_BLOCK_SIZE - 1 - i] = bits >> (8 * i);
+	}
+	compress(s->iv, s->leftover);
+	for (i = 0; i < TC_SHA256_STATE_BLOCKS; i++) {
+		digest[4 * i] = s->iv[i] >> 24;
+		digest[4 * i + 1] = s->iv[i] >> 16;
+		digest[4 * i + 2] = s->iv[i] >> 8;
+		digest[4 * i + 3] = s->iv[i];
+	}
+	memset(s, 0, sizeof(*s));
+
+	return TC_CRYPTO_SUCCESS;
+}
+
+int tc_hmac_set_key(TCHmacState_t ctx, const uint8_t *key,
+		    unsigned int key_size)
+{
+	uint8_t digest[TC_SHA256_DIGEST_SIZE];
+	unsigned int i;
+
+	if (!ctx || !key || !key_size) {
+		return TC_CRYPTO_FAIL;
+	}
+	if (key_size > TC_SHA256_BLOCK_SIZE) {
+		tc_sha256_init(&ctx->hash_state);
+		tc_sha256_update(&ctx->hash_state, key, key_size);
+		tc_sha256_final(digest, &ctx->hash_state);
+		key = digest;
+		key_size = sizeof(digest);
+	}
+	memset(ctx->key, 0, sizeof(ctx->key));
+	for (i = 0; i < TC_SHA256_BLOCK_SIZE; i++) {
+		const uint8_t k = i < key_size ? key[i] : 0;
+
+		ctx->key[i] = k ^ HMAC_IPAD;
+		ctx->key[TC_SHA256_BLOCK_SIZE + i] = k ^ HMAC_OPAD;
+	}
+
+	return TC_CRYPTO_SUCCESS;
+}
+
+int tc_hmac_init(TCHmacState_t ctx)
+{
+	if (!ctx) {
+		return TC_CRYPTO_FAIL;
+	}
+	tc_sha256_init(&ctx->hash_state);
+	tc_sha256_update(&ctx->hash_state, ctx->key, TC_SHA256_BLOCK_SIZE);
+
+	return TC_CRYPTO_SUCCESS;
+}
+
+int tc_hmac_update(TCHmacState_t ctx, const void *data,
+		   unsigned int data_length)
+{
+	if (!ctx) {
+		return TC_CRYPTO_FAIL;
+	}
+
+	return tc_sha256_update(&ctx->hash_state, data, data_length);
+}
+
+int tc_hmac_final(uint8_t *tag, unsigned int taglen, TCHmacState_t ctx)
+{
+	if (!tag || taglen != TC_SHA256_DIGEST_SIZE || !ctx) {
+		return TC_CRYPTO_FAIL;
+	}
+	tc_sha256_final(tag, &ctx->hash_state);
+	tc_sha256_init(&ctx->hash_state);
+	tc_sha256_update(&ctx->hash_state, ctx->key + TC_SHA256_BLOCK_SIZE,
+			 TC_SHA256_BLOCK_SIZE);
+	tc_sha256_update(&ctx->hash_state, tag, TC_SHA256_DIGEST_SIZE);
+	tc_sha256_final(tag, &ctx->hash_state);
+	/* Destroy the key, as TinyCrypt does. */
+	memset(ctx, 0, sizeof(*ctx));
+
+	return TC_CRYPTO_SUCCESS;
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "qm_common.h"
+#include "qm_soc_regs.h"
+#include "qm_flash.h"
+
+#include "sim.h"
+
+/*
+ * Flash emulation.
+ *
+ * Flash regions are mapped at their SoC addresses (the simulator is linked as
+ * a position-dependent executable, so that these addresses are free). Like
+ * NOR flash, programming can only clear bits and erasing sets a whole page to
+ * 0xFF; both keep the CPU busy for the time given by the cost model.
+ *
+ * The power can be cut in the middle of a write of a given page, a write being
+ * a sequence of operations (erases and word programs) on the page that is not
+ * interleaved with operations on other pages (e.g., a BL-Data page write or a
+ * BL-Data log record). Writes are counted across SoC resets.
+ */
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE (0x100000)
+#endif
+
+typedef struct {
+	qm_flash_t ctrl;
+	qm_flash_region_t region;
+	uintptr_t base;
+	uint32_t size;
+} sim_flash_region_t;
+
+static const sim_flash_region_t regions[] = {
+#if (QUARK_SE)
+    {QM_FLASH_0, QM_FLASH_REGION_SYS, QM_FLASH_REGION_SYS_0_BASE,
+     QM_FLASH_MAX_ADDR},
+    {QM_FLASH_1, QM_FLASH_REGION_SYS, QM_FLASH_REGION_SYS_1_BASE,
+     QM_FLASH_MAX_ADDR},
+#elif(QUARK_D2000)
+    {QM_FLASH_0, QM_FLASH_REGION_SYS, QM_FLASH_REGION_SYS_0_BASE,
+     QM_FLASH_MAX_ADDR},
+    {QM_FLASH_0, QM_FLASH_REGION_DATA, QM_FLASH_REGION_DATA_0_BASE,
+     QM_FLASH_REGION_DATA_0_SIZE},
+#endif
+};
+
+#define N_REGIONS (sizeof(regions) / sizeof(regions[0]))
+
+/* Whether the last operation was on the power cut page. */
+static bool cut_page_last;
+/* The number of operations of the current write of the power cut page. */
+static uint32_t cut_page_ops;
+
+qm_flash_reg_t test_flash_instance[QM_FLASH_NUM];
+qm_flash_reg_t *qm_flash[QM_FLASH_NUM] = {
+#if (QUARK_SE)
+    &test_flash_instance[QM_FLASH_0], &test_flash_instance[QM_FLASH_1],
+#else
+    &test_flash_instance[QM_FLASH_0],
+#endif
+};
+
+static const sim_flash_region_t *region_get(qm_flash_t ctrl,
+					    qm_flash_region_t region)
+{
+	size_t i;
+
+	for (i = 0; i < N_REGIONS; i++) {
+		if (regions[i].ctrl == ctrl && regions[i].region == region) {
+			return &regions[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Account for an operation on a flash page and cut the power if it is the one
+ * given by the options.
+ */
+static void power_cut_check(uintptr_t page_addr)
+{
+	if (page_addr != sim_opts.cut_page) {
+		cut_page_last = false;
+		return;
+	}
+	if (!cut_page_last) {
+		cut_page_last = true;
+		cut_page_ops = 0;
+		sim_stats.cut_page_writes++;
+	}
+	cut_page_ops++;
+	if (sim_stats.cut_page_writes == sim_opts.cut_write &&
+	    cut_page_ops == sim_opts.cut_op) {
+		sim_stats.power_cuts++;
+		sim_exit(EXIT_SUCCESS);
+	}
+}
+
+int qm_flash_word_write(const qm_flash_t flash, const qm_flash_region_t region,
+			uint32_t f_addr, const uint32_t data)
+{
+	const sim_flash_region_t *const r = region_get(flash, region);
+
+	QM_CHECK(r != NULL, -EINVAL);
+	QM_CHECK(f_addr < r->size && !(f_addr & 3), -EINVAL);
+
+	power_cut_check(r->base +
+			(f_addr & ~(uint32_t)(QM_FLASH_PAGE_SIZE_BYTES - 1)));
+	*(volatile uint32_t *)(r->base + f_addr) &= data;
+	sim_stats.word_writes++;
+	sim_stats.flash_ns += sim_opts.word_write_ns;
+	sim_busy(sim_opts.word_write_ns);
+
+	return 0;
+}
+
+int qm_flash_page_erase(const qm_flash_t flash, const qm_flash_region_t region,
+			uint32_t page_num)
+{
+	const sim_flash_region_t *const r = region_get(flash, region);
+
+	QM_CHECK(r != NULL, -EINVAL);
+	QM_CHECK(page_num < r->size / QM_FLASH_PAGE_SIZE_BYTES, -EINVAL);
+
+	power_cut_check(r->base + page_num * QM_FLASH_PAGE_SIZE_BYTES);
+	memset((void *)(r->base + page_num * QM_FLASH_PAGE_SIZE_BYTES), 0xFF,
+	       QM_FLASH_PAGE_SIZE_BYTES);
+	sim_stats.page_erases++;
+	sim_stats.flash_ns += sim_opts.page_erase_ns;
+	sim_busy(sim_opts.page_erase_ns);
+
+	return 0;
+}
+
+int qm_flash_page_write(const qm_flash_t flash, const qm_flash_region_t region,
+			uint32_t page_num, const uint32_t *data, uint32_t len)
+{
+	uint32_t i;
+
+	QM_CHECK(data != NULL, -EINVAL);
+	QM_CHECK(len <= QM_FLASH_PAGE_SIZE_DWORDS, -EINVAL);
+
+	if (qm_flash_page_erase(flash, region, page_num)) {
+		return -EINVAL;
+	}
+	for (i = 0; i < len; i++) {
+		qm_flash_word_write(flash, region,
+				    page_num * QM_FLASH_PAGE_SIZE_BYTES +
+					i * sizeof(uint32_t),
+				    data[i]);
+	}
+
+	return 0;
+}
+
+int qm_flash_page_update(const qm_flash_t flash, const qm_flash_region_t region,
+			 uint32_t f_addr, uint32_t *const page_buffer,
+			 const uint32_t *data_buffer, uint32_t len)
+{
+	const sim_flash_region_t *const r = region_get(flash, region);
+	const uint32_t page = f_addr / QM_FLASH_PAGE_SIZE_BYTES;
+	const uint32_t page_addr = page * QM_FLASH_PAGE_SIZE_BYTES;
+	uint32_t i;
+
+	QM_CHECK(r != NULL, -EINVAL);
+	QM_CHECK(page_buffer != NULL && data_buffer != NULL, -EINVAL);
+	QM_CHECK(f_addr < r->size && !(f_addr & 3), -EINVAL);
+	QM_CHECK(f_addr + len * sizeof(uint32_t) <=
+		     page_addr + QM_FLASH_PAGE_SIZE_BYTES,
+		 -EINVAL);
+
+	memcpy(page_buffer, (const void *)(r->base + page_addr),
+	       QM_FLASH_PAGE_SIZE_BYTES);
+	memcpy(page_buffer + (f_addr - page_addr) / sizeof(uint32_t),
+	       data_buffer, len * sizeof(uint32_t));
+	qm_flash_page_erase(flash, region, page);
+	for (i = 0; i < QM_FLASH_PAGE_SIZE_DWORDS; i++) {
+		qm_flash_word_write(flash, region,
+				    page_addr + i * sizeof(uint32_t),
+				    page_buffer[i]);
+	}
+
+	return 0;
+}
+
+void sim_flash_init(void)
+{
+	FILE *f = NULL;
+	void *p;
+	size_t i;
+
+	if (sim_opts.flash_file) {
+		f = fopen(sim_opts.flash_file, "rb");
+	}
+	for (i = 0; i < N_REGIONS; i++) {
+		p = mmap((void *)regions[i].base, regions[i].size,
+			 PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1,
+			 0);
+		if (p != (void *)regions[i].base) {
+			fprintf(stderr, "sim: cannot map flash at 0x%08lx\n",
+				(unsigned long)regions[i].base);
+			exit(EXIT_FAILURE);
+		}
+		if (!f || fread(p, regions[i].size, 1, f) != 1) {
+			memset(p, 0xFF, regions[i].size);
+		}
+	}
+	if (f) {
+		fclose(f);
+	}
+}
+
+void sim_flash_save(void)
+{
+	FILE *f;
+	size_t i;
+
+	if (!sim_opts.flash_file) {
+		return;
+	}
+	f = fopen(sim_opts.flash_file, "wb");
+	if (!f) {
+		perror("sim: flash file");
+		return;
+	}
+	for (i = 0; i < N_REGIONS; i++) {
+		fwrite((const void *)regions[i].base, regions[i].size, 1, f);
+	}
+	fclose(f);
+}
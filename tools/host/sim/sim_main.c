@@ -0,0 +1,484 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "qm_common.h"
+#include "qm_init.h"
+
+#include "bl_data.h"
+#include "fm_boot_confirm.h"
+#include "fm_entry.h"
+#include "fw-manager_config.h"
+#include "dfu/qda/xmodem_io_uart.h"
+#if (FM_CONFIG_QFU_PROFILE || FM_CONFIG_APP_STAGING)
+#include "qfu/qfu.h"
+#endif
+#if (FM_CONFIG_APP_STAGING)
+#include "qfu/qfu_format.h"
+#include "staging/qfu_stage.h"
+#endif
+
+#include "sim.h"
+
+/*
+ * Simulator entry point.
+ *
+ * Run the firmware manager over UART, as the ROM does when the FM pin is
+ * asserted at boot, or (with --boot) the boot flow of the ROM followed by a
+ * model of the application: it may confirm its boot and stage an update, and
+ * then performs a warm reset (i.e., the simulator exits).
+ */
+
+/* Default cost model. */
+#define DEFAULT_PAGE_ERASE_US (5000)
+#define DEFAULT_WORD_WRITE_US (20)
+#define DEFAULT_SHA_BLOCK_CYCLES (4000)
+#define DEFAULT_HOST_WAIT_MS (250)
+
+/*
+ * Environment variables holding the virtual time, the GPS0 register and the
+ * number of writes of the power cut page across SoC resets.
+ */
+#define ENV_TIME "SIM_TIME_NS"
+#define ENV_GPS0 "SIM_GPS0"
+#define ENV_CUT_WRITES "SIM_CUT_WRITES"
+
+/* The size of the DFU suffix (see tools/sysupdate/qmfmlib/dfu.py). */
+#define DFU_SUFFIX_SIZE (16)
+
+sim_options_t sim_opts = {
+    .page_erase_ns = DEFAULT_PAGE_ERASE_US * 1000ULL,
+    .word_write_ns = DEFAULT_WORD_WRITE_US * 1000ULL,
+    .sha_block_ns = SIM_CYCLES_TO_NS((uint64_t)DEFAULT_SHA_BLOCK_CYCLES),
+    .host_wait_ms = DEFAULT_HOST_WAIT_MS,
+};
+
+volatile int sim_quit;
+
+/* The partition booted (-1: none, i.e., no application installed). */
+static int boot_partition = -1;
+/* The result of the staging of the application (0: success). */
+static int stage_errno;
+
+/* The arguments of the simulator, to restart it on SoC resets. */
+static char **sim_argv;
+
+/* The firmware idle callback. */
+static void (*fw_idle_cb)(void);
+
+void __real_xmodem_io_uart_set_idle_cb(void (*idle_cb)(void));
+
+/*
+ * Idle callback installed in place of the firmware one.
+ *
+ * XMODEM calls the idle callback in a loop while waiting for data: run the
+ * firmware callback and, if it had nothing to do (i.e., it took no time and
+ * no interrupt occurred meanwhile), wait for an interrupt.
+ */
+static void sim_idle(void)
+{
+	const uint64_t isrs = sim_stats.isrs;
+	const sim_time_t t = sim_now;
+
+	if (fw_idle_cb) {
+		fw_idle_cb();
+	}
+	if (sim_now == t && sim_stats.isrs == isrs) {
+		sim_wait();
+	}
+}
+
+void __wrap_xmodem_io_uart_set_idle_cb(void (*idle_cb)(void))
+{
+	fw_idle_cb = idle_cb;
+	__real_xmodem_io_uart_set_idle_cb(sim_idle);
+}
+
+static void sim_signal(int sig)
+{
+	(void)sig;
+
+	sim_quit = 1;
+}
+
+static void stats_write(void)
+{
+	FILE *f;
+
+	if (!sim_opts.stats_file) {
+		return;
+	}
+	f = fopen(sim_opts.stats_file, "w");
+	if (!f) {
+		perror("sim: stats file");
+		return;
+	}
+#define U64(name, value)                                                       \
+	fprintf(f, "  \"%s\": %llu,\n", name, (unsigned long long)(value))
+	fprintf(f, "{\n");
+	U64("virtual_ns", sim_now);
+	U64("idle_ns", sim_stats.idle_ns);
+	U64("flash_ns", sim_stats.flash_ns);
+	U64("sha_ns", sim_stats.sha_ns);
+	U64("rx_first_ns", sim_stats.rx_first_ns);
+	U64("rx_last_ns", sim_stats.rx_last_ns);
+	U64("rx_bytes", sim_stats.rx_bytes);
+	U64("tx_bytes", sim_stats.tx_bytes);
+	U64("round_trips", sim_stats.round_trips);
+	U64("rx_corrupted", sim_stats.rx_corrupted);
+	U64("rx_overruns", sim_stats.rx_overruns);
+	U64("isrs", sim_stats.isrs);
+	U64("timer_expirations", sim_stats.timer_expirations);
+	U64("host_waits", sim_stats.host_waits);
+	U64("page_erases", sim_stats.page_erases);
+	U64("word_writes", sim_stats.word_writes);
+	U64("sha_blocks", sim_stats.sha_blocks);
+	U64("cut_page_writes", sim_stats.cut_page_writes);
+	U64("power_cuts", sim_stats.power_cuts);
+	U64("gps0", QM_SCSS_GP->gps0);
+	fprintf(f, "  \"boot_partition\": %d,\n", boot_partition);
+	U64("stage_errno", stage_errno);
+#if (FM_CONFIG_QFU_PROFILE)
+	U64("qfu_blocks", qfu_profile.blocks);
+	U64("qfu_total_cycles", qfu_profile.total_cycles);
+	U64("qfu_hash_cycles", qfu_profile.hash_cycles);
+	U64("qfu_flash_cycles", qfu_profile.flash_cycles);
+#endif
+	U64("bl_erases_skipped", bl_data_stats.erases_skipped);
+	U64("bl_writebacks_skipped", bl_data_stats.writebacks_skipped);
+	U64("bl_page_writes", bl_data_stats.page_writes);
+	U64("bl_page_erases", bl_data_stats.page_erases);
+	U64("bl_flash_runs", bl_data_stats.flash_runs);
+	U64("bl_words_skipped", bl_data_stats.words_skipped);
+	U64("bl_verify_errors", bl_data_stats.verify_errors);
+	fprintf(f, "  \"bl_prefetch_flushes\": %lu\n}\n",
+		(unsigned long)bl_data_stats.prefetch_flushes);
+#undef U64
+	fclose(f);
+}
+
+void sim_exit(int status)
+{
+	sim_flash_save();
+	stats_write();
+	exit(status);
+}
+
+/*
+ * SoC reset: save the state that survives the reset (flash, pseudo-terminal,
+ * virtual time) and restart the simulator.
+ */
+void qm_soc_reset(qm_soc_reset_t reset_type)
+{
+	char buf[32];
+
+	(void)reset_type;
+
+	sim_flash_save();
+	stats_write();
+	sim_uart_keep();
+	snprintf(buf, sizeof(buf), "%llu", (unsigned long long)sim_now);
+	setenv(ENV_TIME, buf, 1);
+	snprintf(buf, sizeof(buf), "%lu", (unsigned long)QM_SCSS_GP->gps0);
+	setenv(ENV_GPS0, buf, 1);
+	snprintf(buf, sizeof(buf), "%llu",
+		 (unsigned long long)sim_stats.cut_page_writes);
+	setenv(ENV_CUT_WRITES, buf, 1);
+	execv("/proc/self/exe", sim_argv);
+	perror("sim: exec");
+	exit(EXIT_FAILURE);
+}
+
+#if (FM_CONFIG_APP_STAGING)
+/*
+ * Stage a QFU image (with DFU suffix) as the application would do, one block
+ * at a time.
+ *
+ * Return 0 on success, negative errno otherwise.
+ */
+static int sim_stage(const char *file)
+{
+	/* Images bigger than a partition are not valid anyway. */
+	static uint8_t img[2 * BL_PARTITION_MAX_PAGES *
+			   QM_FLASH_PAGE_SIZE_BYTES];
+	const qfu_hdr_t *const hdr = (const qfu_hdr_t *)img;
+	uint32_t blk, off, len;
+	size_t size;
+	FILE *f;
+	int rc;
+
+	f = fopen(file, "rb");
+	if (!f) {
+		perror("sim: stage file");
+		return -ENOENT;
+	}
+	size = fread(img, 1, sizeof(img), f);
+	fclose(f);
+	if (size < sizeof(*hdr) + DFU_SUFFIX_SIZE) {
+		return -EINVAL;
+	}
+	size -= DFU_SUFFIX_SIZE;
+
+	for (blk = 0, off = 0; off < size; blk++, off += len) {
+		len = size - off < hdr->block_sz ? size - off : hdr->block_sz;
+		rc = qfu_stage_process_block(blk, img + off, len);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return qfu_stage_finalize();
+}
+#endif
+
+/*
+ * Boot: what the ROM does when the FM pin is not asserted, then what the
+ * application does (if any is installed), and a warm reset.
+ */
+static void sim_boot(void)
+{
+	bl_data_sanitize();
+#if (FM_CONFIG_TRIAL_BOOT)
+	bl_data_trial_boot();
+#endif
+#if (FM_CONFIG_APP_STAGING)
+	qfu_commit_staged();
+#endif
+	if (*bl_data_app_entry(BL_TARGET_IDX_LMT) == 0xffffffff) {
+		/* The ROM would enter FM mode. */
+		sim_exit(EXIT_SUCCESS);
+	}
+	boot_partition =
+	    bl_data->targets[BL_TARGET_IDX_LMT].active_partition_idx;
+
+	if (sim_opts.confirm) {
+		fm_boot_confirm(BL_TARGET_IDX_LMT);
+	}
+	if (sim_opts.stage_file) {
+#if (FM_CONFIG_APP_STAGING)
+		stage_errno = -sim_stage(sim_opts.stage_file);
+#else
+		stage_errno = ENOTSUP;
+#endif
+	}
+	sim_exit(EXIT_SUCCESS);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -l, --link PATH        symlink to the UART pseudo-terminal\n"
+		"  -f, --flash FILE       flash image (loaded and saved)\n"
+		"  -s, --stats FILE       JSON statistics, written on exit\n"
+		"  --erase-us US          page erase time (default %d)\n"
+		"  --write-us US          word program time (default %d)\n"
+		"  --sha-cycles CYCLES    SHA-256 block time (default %d)\n"
+		"  --host-wait-ms MS      host wait before timeouts "
+		"(default %d)\n"
+		"  --error-rate N         corrupt 1 RX byte out of N\n"
+		"  --seed N               error generator seed\n"
+		"  --fm-pin LEVEL         FM pin level (default 0)\n"
+		"  --boot                 boot the application instead of "
+		"entering FM mode\n"
+		"  --confirm              the application confirms its boot\n"
+		"  --stage FILE           the application stages the QFU "
+		"image FILE\n"
+		"  --gps0 VALUE           GPS0 at reset (kept by warm resets)\n"
+		"  --power-cut ADDR:W[:OP]\n"
+		"                         cut the power before the OP-th "
+		"operation (default 1)\n"
+		"                         of the W-th write of the flash "
+		"page at ADDR\n",
+		name, DEFAULT_PAGE_ERASE_US, DEFAULT_WORD_WRITE_US,
+		DEFAULT_SHA_BLOCK_CYCLES, DEFAULT_HOST_WAIT_MS);
+	exit(EXIT_FAILURE);
+}
+
+/* Parse the ADDR:W[:OP] argument of --power-cut. */
+static bool parse_power_cut(const char *arg)
+{
+	char *end;
+
+	sim_opts.cut_page = strtoul(arg, &end, 0) &
+			    ~(uintptr_t)(QM_FLASH_PAGE_SIZE_BYTES - 1);
+	if (*end != ':') {
+		return false;
+	}
+	sim_opts.cut_write = strtoul(end + 1, &end, 0);
+	sim_opts.cut_op = 1;
+	if (*end == ':') {
+		sim_opts.cut_op = strtoul(end + 1, &end, 0);
+	}
+
+	return *end == '\0';
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	enum {
+		OPT_ERASE = 256,
+		OPT_WRITE,
+		OPT_SHA,
+		OPT_HOST_WAIT,
+		OPT_ERROR_RATE,
+		OPT_SEED,
+		OPT_FM_PIN,
+		OPT_BOOT,
+		OPT_CONFIRM,
+		OPT_STAGE,
+		OPT_GPS0,
+		OPT_POWER_CUT,
+	};
+	static const struct option options[] = {
+	    {"link", required_argument, NULL, 'l'},
+	    {"flash", required_argument, NULL, 'f'},
+	    {"stats", required_argument, NULL, 's'},
+	    {"erase-us", required_argument, NULL, OPT_ERASE},
+	    {"write-us", required_argument, NULL, OPT_WRITE},
+	    {"sha-cycles", required_argument, NULL, OPT_SHA},
+	    {"host-wait-ms", required_argument, NULL, OPT_HOST_WAIT},
+	    {"error-rate", required_argument, NULL, OPT_ERROR_RATE},
+	    {"seed", required_argument, NULL, OPT_SEED},
+	    {"fm-pin", required_argument, NULL, OPT_FM_PIN},
+	    {"boot", no_argument, NULL, OPT_BOOT},
+	    {"confirm", no_argument, NULL, OPT_CONFIRM},
+	    {"stage", required_argument, NULL, OPT_STAGE},
+	    {"gps0", required_argument, NULL, OPT_GPS0},
+	    {"power-cut", required_argument, NULL, OPT_POWER_CUT},
+	    {NULL, 0, NULL, 0},
+	};
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "l:f:s:", options, NULL)) !=
+	       -1) {
+		switch (opt) {
+		case 'l':
+			sim_opts.link = optarg;
+			break;
+		case 'f':
+			sim_opts.flash_file = optarg;
+			break;
+		case 's':
+			sim_opts.stats_file = optarg;
+			break;
+		case OPT_ERASE:
+			sim_opts.page_erase_ns = strtod(optarg, NULL) * 1000;
+			break;
+		case OPT_WRITE:
+			sim_opts.word_write_ns = strtod(optarg, NULL) * 1000;
+			break;
+		case OPT_SHA:
+			sim_opts.sha_block_ns =
+			    SIM_CYCLES_TO_NS(strtoull(optarg, NULL, 0));
+			break;
+		case OPT_HOST_WAIT:
+			sim_opts.host_wait_ms = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_ERROR_RATE:
+			sim_opts.error_rate = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_SEED:
+			sim_opts.seed = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_FM_PIN:
+			sim_opts.fm_pin = atoi(optarg);
+			break;
+		case OPT_BOOT:
+			sim_opts.boot = true;
+			break;
+		case OPT_CONFIRM:
+			sim_opts.confirm = true;
+			break;
+		case OPT_STAGE:
+			sim_opts.stage_file = optarg;
+			break;
+		case OPT_GPS0:
+			sim_opts.gps0 = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_POWER_CUT:
+			if (!parse_power_cut(optarg)) {
+				usage(argv[0]);
+			}
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc) {
+		usage(argv[0]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct sigaction sa;
+	const char *t;
+
+	sim_argv = argv;
+	parse_args(argc, argv);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sim_signal;
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	t = getenv(ENV_TIME);
+	if (t) {
+		sim_now = strtoull(t, NULL, 0);
+	}
+	t = getenv(ENV_GPS0);
+	QM_SCSS_GP->gps0 = t ? strtoul(t, NULL, 0) : sim_opts.gps0;
+	t = getenv(ENV_CUT_WRITES);
+	if (t) {
+		sim_stats.cut_page_writes = strtoull(t, NULL, 0);
+	}
+
+	sim_flash_init();
+	if (sim_opts.boot) {
+		sim_boot();
+	}
+	sim_uart_init();
+
+	/* What the ROM does before entering FM mode. */
+	bl_data_sanitize();
+	fm_entry_uart();
+
+	/* Not reached: fm_entry_uart() ends with a SoC reset. */
+	return EXIT_FAILURE;
+}
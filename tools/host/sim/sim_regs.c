@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "sim_regs.h"
+
+/* The maximum number of trapped pages. */
+#define SIM_REGS_MAX (4)
+
+/* Page fault error code: write access. */
+#define PF_WRITE (1 << 1)
+
+/* EFLAGS trap flag. */
+#define EFLAGS_TF (1 << 8)
+
+typedef struct {
+	uint8_t *view;
+	uint8_t *shadow;
+	const sim_regs_ops_t *ops;
+	void *ctx;
+} sim_regs_page_t;
+
+static sim_regs_page_t pages[SIM_REGS_MAX];
+static unsigned int n_pages;
+
+/* The access being single-stepped (if any). */
+static sim_regs_page_t *pending;
+static uint32_t pending_offset;
+static bool pending_write;
+
+/* General purpose registers, in instruction encoding order. */
+static const int gprs[16] = {REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP,
+			     REG_RSI, REG_RDI, REG_R8,	REG_R9,	 REG_R10, REG_R11,
+			     REG_R12, REG_R13, REG_R14, REG_R15};
+
+/*
+ * Emulate the faulting instruction, if it is one of the moves the compiler
+ * uses for volatile accesses: that costs a single signal, instead of a signal
+ * and two mprotect() calls per single-stepped access.
+ *
+ * @param[in] page  The accessed page.
+ * @param[in] addr  The offset of the accessed byte in the page.
+ * @param[in] write Whether the access is a write (from the fault).
+ * @param[in] uc    The firmware context.
+ *
+ * @return Whether the instruction has been emulated.
+ */
+static bool sim_regs_emulate(sim_regs_page_t *page, uint32_t addr, bool write,
+			     ucontext_t *uc)
+{
+	greg_t *const gregs = uc->uc_mcontext.gregs;
+	const uint8_t *ip = (const uint8_t *)gregs[REG_RIP];
+	const uint32_t shift = 8 * (addr & 3);
+	uint32_t *const reg = (uint32_t *)(page->shadow + (addr & ~3U));
+	bool op16 = false, store, imm = false, zext = false;
+	uint8_t rex = 0, modrm, mod, rm;
+	unsigned int size, r;
+	uint32_t mask, value;
+	greg_t *gpr;
+
+	if (*ip == 0x66) {
+		op16 = true;
+		ip++;
+	}
+	if ((*ip & 0xF0) == 0x40) {
+		rex = *ip++;
+	}
+	if (rex & 0x08) {
+		/* 64-bit access. */
+		return false;
+	}
+	switch (*ip++) {
+	case 0x88: /* MOV r/m8, r8 */
+		size = 1;
+		store = true;
+		break;
+	case 0x89: /* MOV r/m, r */
+		size = op16 ? 2 : 4;
+		store = true;
+		break;
+	case 0x8A: /* MOV r8, r/m8 */
+		size = 1;
+		store = false;
+		break;
+	case 0x8B: /* MOV r, r/m */
+		size = op16 ? 2 : 4;
+		store = false;
+		break;
+	case 0xC6: /* MOV r/m8, imm8 */
+		size = 1;
+		store = imm = true;
+		break;
+	case 0xC7: /* MOV r/m, imm */
+		size = op16 ? 2 : 4;
+		store = imm = true;
+		break;
+	case 0x0F: /* MOVZX r, r/m8 and MOVZX r, r/m16 */
+		if (op16 || (*ip != 0xB6 && *ip != 0xB7)) {
+			return false;
+		}
+		size = (*ip++ == 0xB6) ? 1 : 2;
+		store = false;
+		zext = true;
+		break;
+	default:
+		return false;
+	}
+	modrm = *ip++;
+	mod = modrm >> 6;
+	rm = modrm & 7;
+	r = ((modrm >> 3) & 7) | ((rex & 0x04) << 1);
+	if (store != write || mod == 3 || (imm && (modrm & 0x38)) ||
+	    (addr & 3) + size > 4) {
+		return false;
+	}
+	if (size == 1 && !zext && !imm && !rex && r >= 4) {
+		/* AH, CH, DH, BH. */
+		return false;
+	}
+	/* Skip the SIB byte and the displacement. */
+	if (rm == 4) {
+		/* A SIB base of 5 without ModRM displacement means disp32. */
+		if (mod == 0 && (*ip & 7) == 5) {
+			ip += 4;
+		}
+		ip++;
+	} else if (rm == 5 && mod == 0) {
+		/* RIP-relative. */
+		ip += 4;
+	}
+	ip += (mod == 1) ? 1 : (mod == 2) ? 4 : 0;
+
+	mask = (size == 4) ? 0xFFFFFFFF : (1U << (8 * size)) - 1;
+	gpr = &gregs[gprs[r]];
+	if (!store) {
+		value = (*reg >> shift) & mask;
+		if (size == 4 || zext) {
+			*gpr = value;
+		} else {
+			*gpr = (*gpr & ~(greg_t)mask) | value;
+		}
+	} else {
+		if (imm) {
+			value = 0;
+			memcpy(&value, ip, size);
+			ip += size;
+		} else {
+			value = *gpr & mask;
+		}
+		*reg = (*reg & ~(mask << shift)) | (value << shift);
+	}
+	gregs[REG_RIP] = (greg_t)ip;
+
+	return true;
+}
+
+static void sim_regs_die(int sig)
+{
+	/* Not a register access: let the fault kill the process. */
+	signal(sig, SIG_DFL);
+}
+
+static void sim_regs_segv(int sig, siginfo_t *info, void *uc_ptr)
+{
+	ucontext_t *const uc = uc_ptr;
+	uint8_t *const addr = info->si_addr;
+	sim_regs_page_t *page = NULL;
+	uint32_t *reg;
+	uint32_t offset;
+	unsigned int i;
+	bool write;
+
+	for (i = 0; i < n_pages; i++) {
+		if (addr >= pages[i].view &&
+		    addr < pages[i].view + SIM_REGS_PAGE_SIZE) {
+			page = &pages[i];
+			break;
+		}
+	}
+	if (!page || pending) {
+		sim_regs_die(sig);
+		return;
+	}
+
+	offset = (addr - page->view) & ~3U;
+	write = !!(uc->uc_mcontext.gregs[REG_ERR] & PF_WRITE);
+	reg = (uint32_t *)(page->shadow + offset);
+	if (!write && page->ops->read) {
+		*reg = page->ops->read(page->ctx, offset, *reg);
+	}
+	if (sim_regs_emulate(page, addr - page->view, write, uc)) {
+		if (page->ops->access) {
+			page->ops->access(page->ctx, offset, write, *reg);
+		}
+		return;
+	}
+
+	pending = page;
+	pending_offset = offset;
+	pending_write = write;
+	mprotect(page->view, SIM_REGS_PAGE_SIZE, PROT_READ | PROT_WRITE);
+	uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+}
+
+static void sim_regs_trap(int sig, siginfo_t *info, void *uc_ptr)
+{
+	ucontext_t *const uc = uc_ptr;
+	sim_regs_page_t *const page = pending;
+
+	(void)info;
+
+	if (!page) {
+		sim_regs_die(sig);
+		return;
+	}
+
+	mprotect(page->view, SIM_REGS_PAGE_SIZE, PROT_NONE);
+	uc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+	pending = NULL;
+
+	if (page->ops->access) {
+		page->ops->access(
+		    page->ctx, pending_offset, pending_write,
+		    *(uint32_t *)(page->shadow + pending_offset));
+	}
+}
+
+void *sim_regs_map(const sim_regs_ops_t *ops, void *ctx, void **shadow)
+{
+	sim_regs_page_t *page;
+	struct sigaction sa;
+	int fd;
+
+	if (n_pages == SIM_REGS_MAX) {
+		fprintf(stderr, "sim: too many register pages\n");
+		exit(EXIT_FAILURE);
+	}
+	if (!n_pages) {
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_flags = SA_SIGINFO;
+		sa.sa_sigaction = sim_regs_segv;
+		sigaction(SIGSEGV, &sa, NULL);
+		sa.sa_sigaction = sim_regs_trap;
+		sigaction(SIGTRAP, &sa, NULL);
+	}
+
+	page = &pages[n_pages];
+	fd = memfd_create("sim_regs", 0);
+	if (fd < 0 || ftruncate(fd, SIM_REGS_PAGE_SIZE)) {
+		perror("sim: memfd");
+		exit(EXIT_FAILURE);
+	}
+	page->shadow = mmap(NULL, SIM_REGS_PAGE_SIZE, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, fd, 0);
+	page->view = mmap(NULL, SIM_REGS_PAGE_SIZE, PROT_NONE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (page->shadow == MAP_FAILED || page->view == MAP_FAILED) {
+		perror("sim: mmap");
+		exit(EXIT_FAILURE);
+	}
+	page->ops = ops;
+	page->ctx = ctx;
+	n_pages++;
+
+	*shadow = page->shadow;
+
+	return page->view;
+}
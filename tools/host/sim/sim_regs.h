@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SIM_REGS_H__
+#define __SIM_REGS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Trapped register pages.
+ *
+ * A register page is mapped twice: the firmware view has no access rights,
+ * while the simulator view is readable and writable. A firmware access to the
+ * page raises SIGSEGV, whose handler calls the read hook of the page (which
+ * can update the register value about to be read) and then performs the
+ * access: plain moves are emulated on the simulator view, any other
+ * instruction is single-stepped with the firmware view made accessible (the
+ * SIGTRAP handler that follows protects the page again). The access hook is
+ * called once the access is complete.
+ *
+ * Registers are 32-bit wide: the offset passed to the hooks is the offset of
+ * the accessed register, in bytes.
+ *
+ * @defgroup groupHostSimRegs Host Simulator Registers
+ * @{
+ */
+
+/** Register page size. */
+#define SIM_REGS_PAGE_SIZE (4096)
+
+/** Register page hooks. */
+typedef struct {
+	/**
+	 * Called before a register is read.
+	 *
+	 * @param[in] ctx    The page context.
+	 * @param[in] offset The register offset.
+	 * @param[in] value  The current register value.
+	 *
+	 * @return The value to be read.
+	 */
+	uint32_t (*read)(void *ctx, uint32_t offset, uint32_t value);
+	/**
+	 * Called after a register has been read or written.
+	 *
+	 * @param[in] ctx    The page context.
+	 * @param[in] offset The register offset.
+	 * @param[in] write  Whether the register was written.
+	 * @param[in] value  The register value read or written.
+	 */
+	void (*access)(void *ctx, uint32_t offset, bool write, uint32_t value);
+} sim_regs_ops_t;
+
+/**
+ * Map a trapped register page.
+ *
+ * @param[in]  ops    The page hooks.
+ * @param[in]  ctx    The context passed to the hooks.
+ * @param[out] shadow The simulator view of the page.
+ *
+ * @return The firmware view of the page.
+ */
+void *sim_regs_map(const sim_regs_ops_t *ops, void *ctx, void **shadow);
+
+/**
+ * @}
+ */
+
+#endif /* __SIM_REGS_H__ */
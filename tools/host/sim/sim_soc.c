@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "qm_common.h"
+#include "qm_soc_regs.h"
+#include "qm_gpio.h"
+#include "qm_interrupt.h"
+#include "qm_interrupt_router.h"
+#include "qm_isr.h"
+#include "qm_pic_timer.h"
+#include "qm_pinmux.h"
+#include "clk.h"
+#include "x86intrin.h"
+
+#include "boot_clk.h"
+#include "fw-manager_comm.h"
+
+#include "sim.h"
+
+/*
+ * SoC emulation: virtual clock, interrupts, PIC timer, clocks, pin muxing,
+ * GPIO (the FM pin) and general purpose sticky registers.
+ */
+
+#if (HAS_APIC)
+#define TIMER_VECTOR (QM_X86_PIC_TIMER_INT_VECTOR)
+#else
+#define TIMER_VECTOR (QM_IRQ_TO_VECTOR(QM_IRQ_PIC_TIMER))
+#endif
+
+/* The number of interrupt enable transitions remembered. */
+#define IRQ_LOG_SIZE (256)
+#define IRQ_LOG_MASK (IRQ_LOG_SIZE - 1)
+
+/* Bound the handlers called for a single event (level interrupt storm). */
+#define MAX_ISRS_PER_EVENT (16)
+
+sim_time_t sim_now;
+sim_stats_t sim_stats;
+
+/* General purpose sticky registers (GPS0 is initialized by sim_main.c). */
+qm_scss_gp_reg_t test_scss_gp;
+
+/* Interrupt handlers, by vector. */
+static qm_isr_t vectors[QM_INT_VECTOR_NUM];
+/* Unmasked interrupt lines. */
+static uint64_t irq_unmasked;
+/* Whether interrupts are enabled (the ROM enables them before FM mode). */
+static bool irq_enabled = true;
+/* Whether an interrupt handler is running. */
+static bool in_isr;
+
+/*
+ * The log of interrupt enable transitions, used to deliver late events (i.e.,
+ * events processed after the main context went past them) in the right
+ * interrupt state. Transitions alternate, starting with a disable.
+ */
+static struct {
+	sim_time_t t;
+	bool enabled;
+} irq_log[IRQ_LOG_SIZE];
+static uint32_t irq_log_len;
+/* When a deferred interrupt can be delivered. */
+static sim_time_t deferred_at = SIM_NEVER;
+
+/* PIC timer state. */
+static qm_pic_timer_config_t timer_cfg;
+static sim_time_t timer_deadline = SIM_NEVER;
+static bool timer_pending;
+
+/*-------------------------------------------------------------------------*/
+/*                             INTERRUPTS                                  */
+/*-------------------------------------------------------------------------*/
+static void irq_log_add(bool enabled)
+{
+	irq_log[irq_log_len & IRQ_LOG_MASK].t = sim_now;
+	irq_log[irq_log_len & IRQ_LOG_MASK].enabled = enabled;
+	irq_log_len++;
+}
+
+/* Get the interrupt state at a given time (in the past). */
+static bool irq_enabled_at(sim_time_t t)
+{
+	const uint32_t n = irq_log_len < IRQ_LOG_SIZE ? irq_log_len : IRQ_LOG_SIZE;
+	uint32_t i, idx;
+
+	for (i = 1; i <= n; i++) {
+		idx = (irq_log_len - i) & IRQ_LOG_MASK;
+		if (irq_log[idx].t <= t) {
+			return irq_log[idx].enabled;
+		}
+	}
+	if (!n) {
+		return irq_enabled;
+	}
+
+	/* Before the oldest transition remembered. */
+	return !irq_log[(irq_log_len - n) & IRQ_LOG_MASK].enabled;
+}
+
+/* Get the first time interrupts were enabled after a given time. */
+static sim_time_t irq_enabled_after(sim_time_t t)
+{
+	const uint32_t n = irq_log_len < IRQ_LOG_SIZE ? irq_log_len : IRQ_LOG_SIZE;
+	uint32_t i, idx;
+
+	for (i = n; i > 0; i--) {
+		idx = (irq_log_len - i) & IRQ_LOG_MASK;
+		if (irq_log[idx].t > t && irq_log[idx].enabled) {
+			return irq_log[idx].t;
+		}
+	}
+
+	return SIM_NEVER;
+}
+
+static bool irq_is_unmasked(uint32_t vector)
+{
+#if (HAS_APIC)
+	/* The PIC timer is an APIC interrupt, not routed by the IR. */
+	if (vector == TIMER_VECTOR) {
+		return true;
+	}
+#endif
+	return !!(irq_unmasked & (1ULL << (vector - QM_IRQ_TO_VECTOR(0))));
+}
+
+/* Get the handler of the highest priority pending interrupt (if any). */
+static qm_isr_t irq_next(void)
+{
+	const uint32_t uart_vector = FM_COMM_UART_IRQ_VECTOR;
+
+	if (sim_uart_irq() && irq_is_unmasked(uart_vector) &&
+	    vectors[uart_vector]) {
+		return vectors[uart_vector];
+	}
+	if (timer_pending && irq_is_unmasked(TIMER_VECTOR) &&
+	    vectors[TIMER_VECTOR]) {
+		timer_pending = false;
+		return vectors[TIMER_VECTOR];
+	}
+
+	return NULL;
+}
+
+/* Deliver the pending interrupts for an event occurred at time t. */
+static void irq_deliver(sim_time_t t)
+{
+	qm_isr_t isr;
+	int n;
+
+	if (in_isr) {
+		return;
+	}
+	if (!irq_enabled_at(t)) {
+		deferred_at = irq_enabled_after(t);
+		return;
+	}
+	in_isr = true;
+	for (n = 0; n < MAX_ISRS_PER_EVENT && (isr = irq_next()); n++) {
+		sim_stats.isrs++;
+		isr();
+	}
+	in_isr = false;
+}
+
+/* Process the events due up to a given time. */
+static void sim_run(sim_time_t until)
+{
+	sim_time_t t;
+
+	for (;;) {
+		t = sim_uart_next_event();
+		if (timer_deadline < t) {
+			t = timer_deadline;
+		}
+		if (deferred_at < t) {
+			t = deferred_at;
+		}
+		if (t > until) {
+			break;
+		}
+		if (t >= timer_deadline) {
+			timer_deadline = SIM_NEVER;
+			timer_pending = true;
+			sim_stats.timer_expirations++;
+		}
+		sim_uart_run(t);
+		deferred_at = SIM_NEVER;
+		irq_deliver(t);
+	}
+}
+
+void qm_irq_enable(void)
+{
+	if (!irq_enabled) {
+		irq_log_add(true);
+		irq_enabled = true;
+	}
+	irq_deliver(sim_now);
+	sim_run(sim_now);
+}
+
+void qm_irq_disable(void)
+{
+	if (irq_enabled) {
+		irq_log_add(false);
+		irq_enabled = false;
+	}
+}
+
+void qm_irq_request(uint32_t irq, qm_isr_t isr)
+{
+	qm_int_vector_request(QM_IRQ_TO_VECTOR(irq), isr);
+}
+
+void qm_int_vector_request(uint32_t vector, qm_isr_t isr)
+{
+	if (vector < QM_INT_VECTOR_NUM) {
+		vectors[vector] = isr;
+	}
+}
+
+void qm_ir_unmask_int(uint32_t irq)
+{
+	irq_unmasked |= 1ULL << irq;
+}
+
+void qm_ir_mask_int(uint32_t irq)
+{
+	irq_unmasked &= ~(1ULL << irq);
+}
+
+/*-------------------------------------------------------------------------*/
+/*                            VIRTUAL TIME                                 */
+/*-------------------------------------------------------------------------*/
+void sim_busy(sim_time_t duration)
+{
+	sim_now += duration;
+	sim_run(sim_now);
+}
+
+void sim_wait(void)
+{
+	const uint64_t isrs = sim_stats.isrs;
+	sim_time_t t;
+
+	sim_uart_host_poll(0);
+	sim_run(sim_now);
+	while (sim_stats.isrs == isrs) {
+		if (sim_quit) {
+			sim_exit(EXIT_SUCCESS);
+		}
+		t = sim_uart_next_event();
+		if (timer_deadline < t) {
+			t = timer_deadline;
+		}
+		if (t == SIM_NEVER) {
+			/* Only the host can wake the CPU up. */
+			sim_uart_host_poll(-1);
+			sim_run(sim_now);
+			continue;
+		}
+		if (!sim_uart_rx_queued()) {
+			/*
+			 * The next event is a timeout: give the host some (real)
+			 * time to send data before letting it occur. Character
+			 * timeouts are close to the last byte received, so a
+			 * short wait is enough to catch a write in progress.
+			 */
+			if (sim_uart_host_poll(t == timer_deadline
+						   ? (int)sim_opts.host_wait_ms
+						   : 1)) {
+				sim_run(sim_now);
+				continue;
+			}
+			if (t == timer_deadline) {
+				sim_stats.host_waits++;
+			}
+			sim_uart_host_silent(t);
+		}
+		if (t > sim_now) {
+			sim_stats.idle_ns += t - sim_now;
+			sim_now = t;
+		}
+		sim_run(sim_now);
+	}
+}
+
+bool sim_in_isr(void)
+{
+	return in_isr;
+}
+
+uint64_t _rdtsc(void)
+{
+	return sim_now * SIM_SYS_CLK_HZ / SIM_NS_PER_SEC;
+}
+
+/*-------------------------------------------------------------------------*/
+/*                              PIC TIMER                                  */
+/*-------------------------------------------------------------------------*/
+int qm_pic_timer_set_config(const qm_pic_timer_config_t *const cfg)
+{
+	QM_CHECK(cfg != NULL, -EINVAL);
+
+	timer_cfg = *cfg;
+
+	return 0;
+}
+
+int qm_pic_timer_set(const uint32_t count)
+{
+	timer_deadline = count ? sim_now + SIM_CYCLES_TO_NS((uint64_t)count)
+			       : SIM_NEVER;
+
+	return 0;
+}
+
+QM_ISR_DECLARE(qm_pic_timer_0_isr)
+{
+	if (timer_cfg.mode == QM_PIC_TIMER_MODE_PERIODIC) {
+		fprintf(stderr, "sim: periodic PIC timer not supported\n");
+		exit(EXIT_FAILURE);
+	}
+	if (timer_cfg.int_en && timer_cfg.callback) {
+		timer_cfg.callback(timer_cfg.callback_data);
+	}
+}
+
+/*-------------------------------------------------------------------------*/
+/*                          CLOCKS, PINS, GPIO                             */
+/*-------------------------------------------------------------------------*/
+/*
+ * The simulated oscillator needs no calibration: store the factory trim codes
+ * of a typical part.
+ */
+int boot_clk_trim_code_compute(qm_flash_data_trim_t *const ptr_trim_codes)
+{
+	ptr_trim_codes->fields.osc_trim_32mhz = 0x0340;
+	ptr_trim_codes->fields.osc_trim_16mhz = 0x0380;
+	ptr_trim_codes->fields.osc_trim_8mhz = 0x03A0;
+	ptr_trim_codes->fields.osc_trim_4mhz = 0x03B0;
+
+	return 0;
+}
+
+int clk_periph_enable(const clk_periph_t clocks)
+{
+	(void)clocks;
+
+	return 0;
+}
+
+int qm_pmux_select(const qm_pin_id_t pin, const qm_pmux_fn_t fn)
+{
+	(void)pin;
+	(void)fn;
+
+	return 0;
+}
+
+int qm_pmux_input_en(const qm_pin_id_t pin, const bool enable)
+{
+	(void)pin;
+	(void)enable;
+
+	return 0;
+}
+
+int qm_pmux_pullup_en(const qm_pin_id_t pin, const bool enable)
+{
+	(void)pin;
+	(void)enable;
+
+	return 0;
+}
+
+int qm_gpio_read_pin(const qm_gpio_t gpio, const uint8_t pin,
+		     qm_gpio_state_t *const state)
+{
+	(void)gpio;
+	(void)pin;
+
+	*state = sim_opts.fm_pin ? QM_GPIO_HIGH : QM_GPIO_LOW;
+
+	return 0;
+}
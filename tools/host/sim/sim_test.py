@@ -0,0 +1,471 @@
+#!/usr/bin/python -tt
+# -*- coding: utf-8 -*-
+# Copyright (c) 2017, Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+# 3. Neither the name of the Intel Corporation nor the names of its
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+"""sim_test: end-to-end test of the firmware manager on the host simulator.
+
+Run qm_manage.py against the simulator: key provisioning, system information,
+image downloads (at the default and at a higher baud rate, and over a noisy
+link), statistics and application erase.
+
+Then, depending on the features of the simulator binary (told by its name and
+by the SoC), the update features end to end:
+
+- fm_sim and fm_sim_hmac, on Quark SE: compressed images and bundles;
+- fm_sim_hmac, on Quark SE: downloads resumed after a power cut and downloads
+  of the changed blocks only;
+- fm_sim and fm_sim_hmac: BL-Data after a power cut between the write of the
+  main and of the backup copy (logged records on Quark SE, mirrored pages on
+  Quark D2000);
+- fm_sim_ping_pong: BL-Data after a power cut in the middle of the write of
+  each slot;
+- fm_sim_dual_hmac (Quark SE, dual-bank): delta images, trial boots (confirmed
+  and rolled back) and images staged by the application.
+
+The content of the partitions is checked in the flash file of the simulator.
+
+::
+
+   usage: sim_test.py --soc SOC SIM_BINARY"""
+
+from __future__ import print_function, division
+import argparse
+import json
+import os
+import random
+import re
+import shutil
+import sys
+import tempfile
+
+from fmsim import Simulator, SimError, flash_read, make_image
+
+# The application size, in bytes (about half the partition).
+APP_SIZE = {"quark_se": 72 * 1024, "quark_d2000": 14 * 1024}
+# Corrupt one received byte out of ERROR_RATE for the noisy link test (the
+# 9 kB stream packets of Quark SE need a cleaner link than XMODEM-CRC).
+ERROR_RATE = {"quark_se": 50000, "quark_d2000": 2000}
+HIGH_BAUD = 1000000
+# The application size for the feature tests (smaller, for speed).
+FEATURE_APP_SIZE = {"quark_se": 32 * 1024, "quark_d2000": 8 * 1024}
+# The start address of the partitions (numbered as by qm_manage.py info), in
+# single-bank and in dual-bank mode.
+PARTITIONS = {
+    "quark_se": [0x40030000, 0x40000000],
+    "quark_se_dual": [0x40030000, 0x40000000, 0x40048000, 0x40017800],
+    "quark_d2000": [0x00180000],
+}
+# The main BL-Data page (the backup page is the next one).
+BL_DATA = {"quark_se": 0x4002F000, "quark_d2000": 0x00200000}
+FLASH_PAGE_SIZE = 2048
+# The operation of a BL-Data slot write (the page erase being the first) the
+# ping-pong power cut test cuts before.
+TORN_WRITE_OP = 10
+# The errno values reported by --stage.
+EBUSY = 16
+
+
+def check(cond, what):
+    if not cond:
+        raise SimError(what)
+
+
+def write_random(name, size, rnd):
+    with open(name, "wb") as out_file:
+        out_file.write(bytearray(rnd.getrandbits(8) for _ in range(size)))
+
+
+def write_compressible(name, size, rnd):
+    """Write data made of a few random words (as repetitive as code is)."""
+    words = [bytearray(rnd.getrandbits(8) for _ in range(16))
+             for _ in range(64)]
+    data = bytearray()
+    while len(data) < size:
+        data += rnd.choice(words)
+    with open(name, "wb") as out_file:
+        out_file.write(data[:size])
+
+
+def read_file(name):
+    with open(name, "rb") as in_file:
+        return in_file.read()
+
+
+def info(sim):
+    """Return the system information of the device, as a dictionary."""
+    return json.loads(sim.manage("info", "--format", "json").splitlines()[-1])
+
+
+def check_version(sim, partition, version, what):
+    check(info(sim)["partitions"][partition]["app_version"] == version,
+          "%s: application version %d expected" % (what, version))
+
+
+def check_content(args, flash, partition, app, what):
+    """Check that a partition (of a flash file) holds an application."""
+    data = read_file(app)
+    addr = PARTITIONS[args.layout][partition]
+    check(flash_read(flash, args.soc, addr, len(data)) == data,
+          "%s: wrong partition content" % what)
+
+
+def check_bl_data_copies(args, flash, what, same=True):
+    """Check whether the main and the backup BL-Data pages are the same."""
+    main = flash_read(flash, args.soc, BL_DATA[args.soc], FLASH_PAGE_SIZE)
+    backup = flash_read(flash, args.soc, BL_DATA[args.soc] + FLASH_PAGE_SIZE,
+                        FLASH_PAGE_SIZE)
+    check((main == backup) == same,
+          "%s: BL-Data copies %s" % (what, "differ" if same else "match"))
+
+
+def count_page_writes(args, page, *cmd):
+    """Count the writes of a flash page while running a qm_manage.py command
+    on the provisioned device."""
+    with Simulator(args.binary, args.work_dir,
+                   flash=args.path("provisioned.bin"),
+                   options=["--power-cut", "%#x:0" % page]) as sim:
+        sim.manage(*cmd)
+    check(sim.stats["cut_page_writes"] > 0,
+          "no write of the page at 0x%08x" % page)
+    return sim.stats["cut_page_writes"]
+
+
+def power_cut(args, page, write, op, *cmd):
+    """Run a qm_manage.py command on the provisioned device, cutting the
+    power in the middle of it; the flash is saved to cut.bin."""
+    with Simulator(args.binary, args.work_dir,
+                   flash=args.path("provisioned.bin"),
+                   options=["--power-cut",
+                            "%#x:%d:%d" % (page, write, op)]) as sim:
+        sim.manage(*cmd, check=False)
+    check(sim.stats["power_cuts"] == 1, "power not cut")
+    shutil.copyfile(sim.flash, args.path("cut.bin"))
+
+
+def test_compression(args):
+    write_compressible(args.path("lz.bin"), FEATURE_APP_SIZE[args.soc],
+                       args.rnd)
+    make_image(args.path("lz.bin"), args.path("lz.dfu"), 1, args.soc,
+               key=args.key, extra=["--compress", "--app-version", "4"])
+    check(os.path.getsize(args.path("lz.dfu")) <
+          FEATURE_APP_SIZE[args.soc] // 2, "image not compressed")
+    with Simulator(args.binary, args.work_dir,
+                   flash=args.path("provisioned.bin")) as sim:
+        sim.manage("download", args.path("lz.dfu"))
+        check_version(sim, 0, 4, "compressed image")
+    check_content(args, sim.flash, 0, args.path("lz.bin"), "compressed image")
+    print("PASS: compressed image")
+
+
+def test_bundle(args):
+    write_random(args.path("bundle_x86.bin"), FEATURE_APP_SIZE[args.soc],
+                 args.rnd)
+    write_random(args.path("bundle_arc.bin"), FEATURE_APP_SIZE[args.soc],
+                 args.rnd)
+    make_image(args.path("bundle_x86.bin"), args.path("bundle.dfu"), 1,
+               args.soc, key=args.key,
+               extra=["--app-version", "5",
+                      "--bundle", "2:%s:7" % args.path("bundle_arc.bin")])
+    with Simulator(args.binary, args.work_dir,
+                   flash=args.path("provisioned.bin")) as sim:
+        sim.manage("download", args.path("bundle.dfu"))
+        check_version(sim, 0, 5, "bundle")
+        check_version(sim, 1, 7, "bundle")
+    check_content(args, sim.flash, 0, args.path("bundle_x86.bin"), "bundle")
+    check_content(args, sim.flash, 1, args.path("bundle_arc.bin"), "bundle")
+    print("PASS: bundle")
+
+
+def test_skip_unchanged(args):
+    # Change a few bytes of the installed application (in a middle block).
+    data = bytearray(read_file(args.path("app.bin")))
+    for offset in range(10000, 10010):
+        data[offset] ^= 0xff
+    with open(args.path("patched.bin"), "wb") as out_file:
+        out_file.write(data)
+    make_image(args.path("patched.bin"), args.path("patched.dfu"), 1,
+               args.soc, key=args.key, extra=["--app-version", "6"])
+    with Simulator(args.binary, args.work_dir,
+                   flash=args.path("provisioned.bin")) as sim:
+        out = sim.manage("download", args.path("patched.dfu"))
+        # The first and the last blocks are always sent.
+        match = re.search(r"Sending (\d+) of (\d+) blocks", out)
+        check(match and int(match.group(1)) == 3 and
+              int(match.group(2)) > 3, "unchanged blocks sent")
+        check_version(sim, 0, 6, "changed blocks")
+    check_content(args, sim.flash, 0, args.path("patched.bin"),
+                  "changed blocks")
+    print("PASS: download of the changed blocks only")
+
+
+def test_resume(args):
+    write_random(args.path("resume.bin"), APP_SIZE[args.soc], args.rnd)
+    make_image(args.path("resume.bin"), args.path("resume.dfu"), 1, args.soc,
+               key=args.key, extra=["--app-version", "7"])
+    # Cut the power half-way through the download, between the write of the
+    # main and of the backup BL-Data copy of a resume checkpoint.
+    backup = BL_DATA[args.soc] + FLASH_PAGE_SIZE
+    writes = count_page_writes(args, backup, "download",
+                               args.path("resume.dfu"))
+    power_cut(args, backup, writes // 2 + 1, 1, "download",
+              args.path("resume.dfu"))
+    check_bl_data_copies(args, args.path("cut.bin"), "resumed download",
+                         same=False)
+    with Simulator(args.binary, args.work_dir,
+                   flash=args.path("cut.bin")) as sim:
+        out = sim.manage("download", args.path("resume.dfu"))
+        check("Resuming download at block" in out, "download not resumed")
+        check_version(sim, 0, 7, "resumed download")
+    check_content(args, sim.flash, 0, args.path("resume.bin"),
+                  "resumed download")
+    check_bl_data_copies(args, sim.flash, "resumed download")
+    print("PASS: download resumed after a power cut")
+
+
+def test_bl_data_power_cut(args):
+    make_image(args.path("app.bin"), args.path("app8.dfu"), 1, args.soc,
+               key=args.key, extra=["--app-version", "8"])
+    cmd = ("download", "--no-skip", args.path("app8.dfu"))
+    # Cut the power before the last update of the backup copy: the main copy
+    # holds the new application, which must be kept.
+    backup = BL_DATA[args.soc] + FLASH_PAGE_SIZE
+    writes = count_page_writes(args, backup, *cmd)
+    power_cut(args, backup, writes, 1, *cmd)
+    check_bl_data_copies(args, args.path("cut.bin"), "BL-Data power cut",
+                         same=False)
+    with Simulator(args.binary, args.work_dir,
+                   flash=args.path("cut.bin")) as sim:
+        check_version(sim, 0, 8, "BL-Data power cut")
+    check_bl_data_copies(args, sim.flash, "BL-Data power cut")
+    print("PASS: BL-Data power cut between the main and the backup copy")
+
+
+def test_ping_pong_power_cut(args):
+    make_image(args.path("app.bin"), args.path("app8.dfu"), 1, args.soc,
+               key=args.key, extra=["--app-version", "8"])
+    cmd = ("download", "--no-skip", args.path("app8.dfu"))
+    for page in (BL_DATA[args.soc], BL_DATA[args.soc] + FLASH_PAGE_SIZE):
+        # Tear the last write of the slot: the other slot must be used.
+        writes = count_page_writes(args, page, *cmd)
+        power_cut(args, page, writes, TORN_WRITE_OP, *cmd)
+        with Simulator(args.binary, args.work_dir,
+                       flash=args.path("cut.bin")) as sim:
+            sim.manage(*cmd)
+            check_version(sim, 0, 8, "BL-Data power cut")
+        check_content(args, sim.flash, 0, args.path("app.bin"),
+                      "BL-Data power cut")
+    print("PASS: BL-Data power cut in the middle of a slot write")
+
+
+def test_delta(args):
+    # The base is the application installed in partition 0 (the active
+    # one); the delta image goes to the other x86 partition (2).
+    data = bytearray(read_file(args.path("app.bin")))
+    for offset in range(0, len(data), 8192):
+        data[offset:offset + 64] = bytearray(64)
+    with open(args.path("delta.bin"), "wb") as out_file:
+        out_file.write(data)
+    make_image(args.path("delta.bin"), args.path("delta.dfu"), 3, args.soc,
+               key=args.key, extra=["--delta", args.path("app.bin"),
+                                    "--app-version", "9"])
+    check(os.path.getsize(args.path("delta.dfu")) < len(data) // 4,
+          "delta image too big")
+    with Simulator(args.binary, args.work_dir,
+                   flash=args.path("provisioned.bin")) as sim:
+        sim.manage("download", args.path("delta.dfu"))
+        sys_info = info(sim)
+        check(sys_info["partitions"][2]["app_version"] == 9 and
+              sys_info["targets"][0]["active_partition"] == 2,
+              "delta image not installed")
+    check_content(args, sim.flash, 2, args.path("delta.bin"), "delta image")
+    print("PASS: delta image")
+
+
+def test_trial_boot(args):
+    write_random(args.path("app4.bin"), FEATURE_APP_SIZE[args.soc], args.rnd)
+    make_image(args.path("app4.bin"), args.path("app4.dfu"), 3, args.soc,
+               key=args.key, extra=["--app-version", "4"])
+    # Confirm the installed application (partition 0), then install the new
+    # one in partition 2.
+    sim = Simulator(args.binary, args.work_dir,
+                    flash=args.path("provisioned.bin"))
+    check(sim.boot(options=["--confirm"])["boot_partition"] == 0,
+          "application not booted")
+    with sim:
+        sim.manage("download", args.path("app4.dfu"))
+    shutil.copyfile(sim.flash, args.path("trial.bin"))
+
+    # The new application never confirms: rolled back after a few boots.
+    booted = [sim.boot()["boot_partition"]]
+    while booted[-1] == 2 and len(booted) < 10:
+        booted.append(sim.boot(warm=True)["boot_partition"])
+    check(booted[0] == 2 and booted[-1] == 0,
+          "no rollback (booted partitions: %s)" % booted)
+    with sim:
+        check(info(sim)["targets"][0]["active_partition"] == 0,
+              "rollback not recorded")
+    print("PASS: trial boot rolled back after %d boots" % (len(booted) - 1))
+
+    # The new application confirms its first boot: kept.
+    sim = Simulator(args.binary, args.work_dir, flash=args.path("trial.bin"))
+    booted = [sim.boot(options=["--confirm"])["boot_partition"]]
+    for _ in range(5):
+        booted.append(sim.boot(warm=True)["boot_partition"])
+    check(booted == [2] * len(booted),
+          "confirmed image not kept (booted partitions: %s)" % booted)
+    print("PASS: trial boot confirmed")
+
+
+def test_staging(args):
+    write_random(args.path("staged.bin"), FEATURE_APP_SIZE[args.soc],
+                 args.rnd)
+    make_image(args.path("staged.bin"), args.path("staged.dfu"), 3, args.soc,
+               key=args.key, extra=["--app-version", "5"])
+    options = ["--stage", args.path("staged.dfu")]
+    # The installed application is on trial: it cannot stage before it has
+    # confirmed its boot.
+    sim = Simulator(args.binary, args.work_dir,
+                    flash=args.path("provisioned.bin"))
+    stats = sim.boot(options=options)
+    check(stats["boot_partition"] == 0 and stats["stage_errno"] == EBUSY,
+          "staging allowed on an unconfirmed trial boot")
+    stats = sim.boot(warm=True, options=["--confirm"] + options)
+    check(stats["boot_partition"] == 0 and stats["stage_errno"] == 0,
+          "staging failed (errno %d)" % stats["stage_errno"])
+    # Committed by the bootloader at the next reset, and booted on trial.
+    check(sim.boot(warm=True, options=["--confirm"])["boot_partition"] == 2,
+          "staged image not committed")
+    with sim:
+        check_version(sim, 2, 5, "staged image")
+    check_content(args, sim.flash, 2, args.path("staged.bin"), "staged image")
+    print("PASS: image staged by the application")
+
+
+def run(args, work_dir):
+    rnd = random.Random(1)
+    hmac = args.hmac
+    path = args.path
+    write_random(path("rv.key"), 32, rnd)
+    write_random(path("fw.key"), 32, rnd)
+    write_random(path("bad.key"), 32, rnd)
+    write_random(path("app.bin"), APP_SIZE[args.soc], rnd)
+    key = path("fw.key") if hmac else None
+    make_image(path("app.bin"), path("app.dfu"), 1, args.soc, key=key,
+               extra=["--app-version", "3"])
+
+    with Simulator(args.binary, work_dir) as sim:
+        out = sim.manage("info")
+        check("No application installed" in out, "blank device expected")
+        if hmac:
+            sim.provision(path("rv.key"), path("fw.key"))
+            print("PASS: key provisioning")
+        sim.manage("download", path("app.dfu"))
+        out = sim.manage("info")
+        check("App Version 3" in out, "application not installed")
+        print("PASS: download")
+        sim.manage("download", "-b", str(HIGH_BAUD), "--no-skip",
+                   path("app.dfu"))
+        print("PASS: download at %d baud" % HIGH_BAUD)
+        if hmac:
+            make_image(path("app.bin"), path("bad.dfu"), 1, args.soc,
+                       key=path("bad.key"))
+            out = sim.manage("download", path("bad.dfu"), check=False)
+            check("[FAIL]" in out, "image with a wrong key accepted")
+            print("PASS: image with a wrong key rejected")
+        out = sim.manage("stats", "--format", "json")
+        stats = json.loads(out.splitlines()[-1])
+        check(stats["verify_errors"] == 0, "flash verification errors")
+        print("PASS: statistics")
+    shutil.copyfile(sim.flash, path("provisioned.bin"))
+
+    with Simulator(args.binary, work_dir, flash=path("provisioned.bin"),
+                   options=["--error-rate", str(ERROR_RATE[args.soc])]) as sim:
+        sim.manage("download", "-b", str(HIGH_BAUD), "--no-skip",
+                   path("app.dfu"))
+        out = sim.manage("info")
+        check("App Version 3" in out, "application not installed")
+    check(sim.stats["rx_corrupted"] > 0, "no byte corrupted")
+    print("PASS: download over a noisy link (%d bytes corrupted)" %
+          sim.stats["rx_corrupted"])
+
+    # Application erase is available only without authentication.
+    if args.soc == "quark_se" and not hmac:
+        with Simulator(args.binary, work_dir,
+                       flash=path("provisioned.bin")) as sim:
+            sim.manage("erase")
+            out = sim.manage("info")
+            check("No application installed" in out, "erase failed")
+        print("PASS: erase")
+
+    args.key = key
+    args.rnd = rnd
+    if args.layout == "quark_se_dual":
+        test_delta(args)
+        test_trial_boot(args)
+        test_staging(args)
+    elif args.ping_pong:
+        test_ping_pong_power_cut(args)
+    else:
+        if args.soc == "quark_se":
+            test_compression(args)
+            test_bundle(args)
+            if hmac:
+                test_skip_unchanged(args)
+                test_resume(args)
+        test_bl_data_power_cut(args)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulator test.")
+    parser.add_argument("--soc", required=True,
+                        choices=["quark_se", "quark_d2000"])
+    parser.add_argument("binary", help="the simulator binary")
+    args = parser.parse_args()
+    args.binary = os.path.abspath(args.binary)
+    # The features of the binary (see host.mk).
+    name = os.path.basename(args.binary)
+    args.hmac = name.endswith("_hmac")
+    args.ping_pong = name.endswith("_ping_pong")
+    args.layout = args.soc + ("_dual" if "_dual" in name else "")
+
+    work_dir = tempfile.mkdtemp(prefix="fm_sim_")
+    args.work_dir = work_dir
+    args.path = lambda name: os.path.join(work_dir, name)
+    try:
+        print("Testing %s" % os.path.basename(args.binary))
+        run(args, work_dir)
+    except SimError as error:
+        print("FAIL: %s" % error)
+        print("(files kept in %s)" % work_dir)
+        return 1
+    shutil.rmtree(work_dir)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
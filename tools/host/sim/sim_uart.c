@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2017, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the Intel Corporation nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE INTEL CORPORATION OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "qm_common.h"
+#include "qm_soc_regs.h"
+#include "qm_uart.h"
+
+#include "fw-manager_config.h"
+
+#include "sim.h"
+#include "sim_regs.h"
+
+/*
+ * UART emulation.
+ *
+ * The FM UART is connected to a pseudo-terminal. Data from the host is read
+ * only while the CPU is idle (see sim_wait()) and each byte is stamped with
+ * its arrival time, given the baud rate. Bytes enter a 16-byte RX FIFO at
+ * their arrival time; the RX interrupt is asserted when the FIFO reaches its
+ * trigger level or when no byte has been received for 4 character times
+ * (character timeout), like on the DesignWare UART of Quark SoCs.
+ */
+
+/* Environment variables holding the pseudo-terminal across SoC resets. */
+#define ENV_PTY_MASTER "SIM_PTY_MASTER"
+#define ENV_PTY_SLAVE "SIM_PTY_SLAVE"
+
+#define FIFO_SIZE (16)
+/* RX FIFO trigger level (FIFO half full). */
+#define FIFO_TRIGGER (8)
+/* The character timeout, in character times. */
+#define CTO_CHARS (4)
+/* TX depth: holding register and shift register. */
+#define TX_DEPTH (2)
+
+/* The queue of bytes received from the host; must be a power of 2. */
+#define RXQ_SIZE (65536)
+#define RXQ_MASK (RXQ_SIZE - 1)
+
+#define TXBUF_SIZE (65536)
+
+#define REG(field) (offsetof(qm_uart_reg_t, field))
+
+#define LSR_ERROR_BITS                                                         \
+	(QM_UART_LSR_OE | QM_UART_LSR_PE | QM_UART_LSR_FE | QM_UART_LSR_BI)
+
+qm_uart_reg_t *qm_uart[QM_UART_NUM];
+
+/* The simulator view of the FM UART registers. */
+static qm_uart_reg_t *regs;
+
+static int pty_master = -1;
+static int pty_slave = -1;
+
+/* Bytes received from the host, with their arrival time. */
+static struct {
+	uint8_t data;
+	sim_time_t t;
+} rxq[RXQ_SIZE];
+static uint32_t rxq_head;
+static uint32_t rxq_tail;
+/* The arrival time of the last byte queued. */
+static sim_time_t rx_stamp;
+/* The host is known to be silent until this time. */
+static sim_time_t rx_silent_until;
+
+/* The RX FIFO. */
+static uint8_t fifo[FIFO_SIZE];
+static uint32_t fifo_rd;
+static uint32_t fifo_count;
+static uint32_t lsr_errors;
+/* When the character timeout occurs (SIM_NEVER if not armed). */
+static sim_time_t cto_at = SIM_NEVER;
+static bool cto;
+
+/* The duration of a character (10 bits), in ns. */
+static sim_time_t char_ns;
+/* When the transmission of the last byte written completes. */
+static sim_time_t tx_done;
+/* Data written by the firmware, not yet passed to the host. */
+static uint8_t txbuf[TXBUF_SIZE];
+static uint32_t txbuf_len;
+
+/* The state of the packet loss generator. */
+static uint32_t rng_state;
+
+static uint32_t rng_next(void)
+{
+	/* xorshift32. */
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+
+	return rng_state;
+}
+
+static void fifo_reset(void)
+{
+	fifo_rd = 0;
+	fifo_count = 0;
+	lsr_errors = 0;
+	cto_at = SIM_NEVER;
+	cto = false;
+}
+
+/*-------------------------------------------------------------------------*/
+/*                              REGISTERS                                  */
+/*-------------------------------------------------------------------------*/
+static uint32_t uart_reg_read(void *ctx, uint32_t offset, uint32_t value)
+{
+	uint32_t lsr;
+
+	(void)ctx;
+
+	if (offset / sizeof(qm_uart_reg_t) != FM_CONFIG_UART) {
+		return value;
+	}
+	switch (offset % sizeof(qm_uart_reg_t)) {
+	case REG(rbr_thr_dll):
+		return fifo_count ? fifo[fifo_rd] : 0;
+	case REG(lsr):
+		/*
+		 * The main context reads LSR only to wait for TEMT, which would
+		 * spin until the transmission is over: skip to its end.
+		 */
+		if (!sim_in_isr() && sim_now < tx_done) {
+			sim_now = tx_done;
+		}
+		lsr = lsr_errors;
+		if (sim_now >= tx_done) {
+			lsr |= QM_UART_LSR_TEMT;
+		}
+		if (sim_now + char_ns >= tx_done) {
+			lsr |= QM_UART_LSR_THRE;
+		}
+		if (fifo_count) {
+			lsr |= QM_UART_LSR_DR;
+		}
+		return lsr;
+	default:
+		return value;
+	}
+}
+
+static void uart_reg_access(void *ctx, uint32_t offset, bool write,
+			    uint32_t value)
+{
+	(void)ctx;
+	(void)value;
+
+	if (write || offset / sizeof(qm_uart_reg_t) != FM_CONFIG_UART) {
+		return;
+	}
+	switch (offset % sizeof(qm_uart_reg_t)) {
+	case REG(rbr_thr_dll):
+		if (fifo_count) {
+			fifo_rd = (fifo_rd + 1) % FIFO_SIZE;
+			fifo_count--;
+		}
+		if (!fifo_count) {
+			cto_at = SIM_NEVER;
+			cto = false;
+		}
+		break;
+	case REG(lsr):
+		/* Reading LSR clears the line status errors. */
+		lsr_errors = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+static const sim_regs_ops_t uart_regs_ops = {
+    .read = uart_reg_read, .access = uart_reg_access,
+};
+
+/*-------------------------------------------------------------------------*/
+/*                            HOST INTERFACE                               */
+/*-------------------------------------------------------------------------*/
+static void host_flush(void)
+{
+	ssize_t n;
+
+	while (txbuf_len) {
+		n = write(pty_master, txbuf, txbuf_len);
+		if (n <= 0) {
+			/* The host is not reading: keep the data. */
+			return;
+		}
+		memmove(txbuf, txbuf + n, txbuf_len - n);
+		txbuf_len -= n;
+	}
+}
+
+static void host_queue(const uint8_t *data, size_t len)
+{
+	const sim_time_t base =
+	    tx_done > rx_silent_until ? tx_done : rx_silent_until;
+	size_t i;
+	uint8_t byte;
+
+	if (rx_stamp < tx_done) {
+		/* The host answers the device. */
+		sim_stats.round_trips++;
+	}
+	if (rx_stamp < base) {
+		rx_stamp = base;
+	}
+	for (i = 0; i < len; i++) {
+		byte = data[i];
+		if (sim_opts.error_rate &&
+		    rng_next() % sim_opts.error_rate == 0) {
+			byte ^= 1 + rng_next() % 255;
+			sim_stats.rx_corrupted++;
+		}
+		rx_stamp += char_ns;
+		rxq[rxq_tail & RXQ_MASK].data = byte;
+		rxq[rxq_tail & RXQ_MASK].t = rx_stamp;
+		rxq_tail++;
+	}
+}
+
+bool sim_uart_host_poll(int timeout_ms)
+{
+	struct pollfd pfd = {.fd = pty_master, .events = POLLIN};
+	uint8_t buf[4096];
+	size_t room;
+	ssize_t n;
+	bool got = false;
+
+	host_flush();
+	if (poll(&pfd, 1, timeout_ms) <= 0) {
+		return false;
+	}
+	for (;;) {
+		room = RXQ_SIZE - (rxq_tail - rxq_head);
+		if (!room) {
+			break;
+		}
+		n = read(pty_master, buf, room < sizeof(buf) ? room : sizeof(buf));
+		if (n <= 0) {
+			break;
+		}
+		host_queue(buf, n);
+		got = true;
+	}
+
+	return got;
+}
+
+size_t sim_uart_host_send(const uint8_t *data, size_t len)
+{
+	const size_t room = RXQ_SIZE - (rxq_tail - rxq_head);
+
+	if (len > room) {
+		len = room;
+	}
+	sim_uart_host_silent(sim_now);
+	host_queue(data, len);
+
+	return len;
+}
+
+void sim_uart_host_silent(sim_time_t until)
+{
+	if (rx_silent_until < until) {
+		rx_silent_until = until;
+	}
+}
+
+bool sim_uart_rx_queued(void)
+{
+	return rxq_head != rxq_tail;
+}
+
+/*-------------------------------------------------------------------------*/
+/*                                EVENTS                                   */
+/*-------------------------------------------------------------------------*/
+sim_time_t sim_uart_next_event(void)
+{
+	sim_time_t t = cto_at;
+
+	if (rxq_head != rxq_tail && rxq[rxq_head & RXQ_MASK].t < t) {
+		t = rxq[rxq_head & RXQ_MASK].t;
+	}
+
+	return t;
+}
+
+void sim_uart_run(sim_time_t t)
+{
+	sim_time_t arrival;
+
+	for (;;) {
+		arrival = rxq_head != rxq_tail ? rxq[rxq_head & RXQ_MASK].t
+					       : SIM_NEVER;
+		if (cto_at < arrival && cto_at <= t) {
+			cto_at = SIM_NEVER;
+			cto = true;
+			continue;
+		}
+		if (arrival > t) {
+			break;
+		}
+		if (!sim_stats.rx_bytes) {
+			sim_stats.rx_first_ns = arrival;
+		}
+		sim_stats.rx_bytes++;
+		sim_stats.rx_last_ns = arrival;
+		if (fifo_count == FIFO_SIZE) {
+			lsr_errors |= QM_UART_LSR_OE;
+			sim_stats.rx_overruns++;
+		} else {
+			fifo[(fifo_rd + fifo_count) % FIFO_SIZE] =
+			    rxq[rxq_head & RXQ_MASK].data;
+			fifo_count++;
+		}
+		rxq_head++;
+		cto_at = arrival + CTO_CHARS * char_ns;
+		cto = false;
+	}
+}
+
+bool sim_uart_irq(void)
+{
+	const uint32_t ier = regs->ier_dlh;
+
+	if ((ier & QM_UART_IER_ERBFI) &&
+	    (fifo_count >= FIFO_TRIGGER || (fifo_count && cto))) {
+		return true;
+	}
+
+	return (ier & QM_UART_IER_ELSI) && lsr_errors;
+}
+
+/*-------------------------------------------------------------------------*/
+/*                                DRIVER                                   */
+/*-------------------------------------------------------------------------*/
+int qm_uart_set_config(const qm_uart_t uart, const qm_uart_config_t *cfg)
+{
+	uint32_t div16;
+
+	QM_CHECK(uart < QM_UART_NUM, -EINVAL);
+	QM_CHECK(cfg != NULL, -EINVAL);
+
+	if (uart != FM_CONFIG_UART) {
+		return 0;
+	}
+	div16 = (QM_UART_CFG_BAUD_DLH_UNPACK(cfg->baud_divisor) << 12) |
+		(QM_UART_CFG_BAUD_DLL_UNPACK(cfg->baud_divisor) << 4) |
+		QM_UART_CFG_BAUD_DLF_UNPACK(cfg->baud_divisor);
+	QM_CHECK(div16 >= 16, -EINVAL);
+	/* baud = clk / div16; a character is 10 bits. */
+	char_ns = div16 * 10 * SIM_NS_PER_SEC / SIM_SYS_CLK_HZ;
+	regs->lcr = cfg->line_control;
+	fifo_reset();
+
+	return 0;
+}
+
+int qm_uart_write(const qm_uart_t uart, const uint8_t data)
+{
+	QM_CHECK(uart < QM_UART_NUM, -EINVAL);
+
+	if (uart != FM_CONFIG_UART) {
+		return 0;
+	}
+	tx_done = (tx_done > sim_now ? tx_done : sim_now) + char_ns;
+	if (txbuf_len == TXBUF_SIZE) {
+		/* Nobody is listening: drop the oldest data. */
+		memmove(txbuf, txbuf + 1, --txbuf_len);
+	}
+	txbuf[txbuf_len++] = data;
+	sim_stats.tx_bytes++;
+	/* Wait for room in the holding register. */
+	if (tx_done > sim_now + TX_DEPTH * char_ns) {
+		sim_busy(tx_done - TX_DEPTH * char_ns - sim_now);
+	}
+
+	return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+/*                            INITIALIZATION                               */
+/*-------------------------------------------------------------------------*/
+static void pty_open(void)
+{
+	const char *master_env = getenv(ENV_PTY_MASTER);
+	const char *slave_env = getenv(ENV_PTY_SLAVE);
+	struct termios tio;
+	const char *name;
+
+	if (master_env && slave_env) {
+		pty_master = atoi(master_env);
+		pty_slave = atoi(slave_env);
+		return;
+	}
+
+	pty_master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (pty_master < 0 || grantpt(pty_master) || unlockpt(pty_master)) {
+		perror("sim: posix_openpt");
+		exit(EXIT_FAILURE);
+	}
+	name = ptsname(pty_master);
+	/*
+	 * Keep the slave open, so that the terminal settings persist and the
+	 * master does not hang up when the host program closes the port.
+	 */
+	pty_slave = open(name, O_RDWR | O_NOCTTY);
+	if (pty_slave < 0 || tcgetattr(pty_slave, &tio)) {
+		perror("sim: pty");
+		exit(EXIT_FAILURE);
+	}
+	/* No echo, no line discipline: the host must see raw XMODEM. */
+	cfmakeraw(&tio);
+	tcsetattr(pty_slave, TCSANOW, &tio);
+
+	if (sim_opts.link) {
+		unlink(sim_opts.link);
+		if (symlink(name, sim_opts.link)) {
+			perror("sim: symlink");
+			exit(EXIT_FAILURE);
+		}
+	}
+	printf("sim: UART on %s\n", name);
+	fflush(stdout);
+}
+
+void sim_uart_init(void)
+{
+	void *shadow;
+	qm_uart_reg_t *view;
+
+	view = sim_regs_map(&uart_regs_ops, NULL, &shadow);
+	qm_uart[QM_UART_0] = view;
+	qm_uart[QM_UART_1] = view + 1;
+	regs = (qm_uart_reg_t *)shadow + FM_CONFIG_UART;
+	regs->lsr = QM_UART_LSR_THRE | QM_UART_LSR_TEMT;
+
+	/*
+	 * xorshift is linear: spread the seed bits, so that close seeds give
+	 * unrelated sequences (and avoid the all-zero state).
+	 */
+	rng_state = sim_opts.seed + 0x9E3779B9U;
+	rng_state = (rng_state ^ (rng_state >> 16)) * 0x85EBCA6BU;
+	rng_state = (rng_state ^ (rng_state >> 13)) * 0xC2B2AE35U;
+	rng_state ^= rng_state >> 16;
+	if (!rng_state) {
+		rng_state = 1;
+	}
+	char_ns = SIM_NS_PER_SEC;
+
+	pty_open();
+	fcntl(pty_master, F_SETFL, fcntl(pty_master, F_GETFL) | O_NONBLOCK);
+}
+
+void sim_uart_keep(void)
+{
+	char buf[16];
+
+	host_flush();
+	snprintf(buf, sizeof(buf), "%d", pty_master);
+	setenv(ENV_PTY_MASTER, buf, 1);
+	snprintf(buf, sizeof(buf), "%d", pty_slave);
+	setenv(ENV_PTY_SLAVE, buf, 1);
+}
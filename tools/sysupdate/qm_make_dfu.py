@@ -49,7 +49,13 @@ Optional Arguments:
     --sha256       add SHA-256 to header
     -c CFILE       specify the configuration file (C-header format)
     -p PART        target partition number [default: 0]
-    --block-size   size of one dfu block [default: 2048]
+    --block-size   size of one dfu block [default: 8192 on Quark SE, 2048 on
+                   Quark D2000]
+    --compress     compress the image (requires bootloader support)
+    --delta BASE   create a delta image against the BASE binary file
+    --bundle PART:FILE[:VERSION]
+                   add the FILE binary for partition PART to the image,
+                   making it a bundle (can be repeated)
 This script uses C-style header files to generate QFU compatible.dfu image
 files.
 """
@@ -93,11 +99,25 @@ if __name__ == "__main__":
         help="target partition number [default: %(default)s]")
     parser.add_argument(
         "--block-size", metavar="SIZE", type=int, dest="block_size",
-        default=None, help="dfu block size")
+        default=None, help="dfu block size (a power-of-two multiple of the "
+                           "bootloader QFU_BLOCK_SIZE, up to the maximum "
+                           "transfer size of the device)")
     parser.add_argument(
         "--soc", metavar="SOC", type=str, dest="soc",
         default="quark_se", help="Select the used target SoC[default: \
         %(default)s]" ,choices=['quark_se', 'quark_d2000'])
+    parser.add_argument(
+        "--compress", default=False, action="store_true",
+        help="compress the image (requires bootloader support)")
+    parser.add_argument(
+        "--delta", metavar="BASE", type=argparse.FileType('rb'),
+        dest="base_file", help="create a delta image against the BASE "
+        "binary file (requires dual-bank and authentication support)")
+    parser.add_argument(
+        "--bundle", metavar="PART:FILE[:VERSION]", action="append",
+        dest="bundle", default=[], help="add the FILE binary for partition "
+        "PART (with the specified application version) to the image, making "
+        "it a bundle whose payloads are installed together; can be repeated")
     parser.add_argument(
         "--key", metavar="KEY", type=argparse.FileType('r'), dest="key_file",
         help="sign the image using the specified HMAC key")
@@ -149,9 +169,29 @@ if __name__ == "__main__":
         else:
             key_data = None
 
+        if args.base_file:
+            base_data = args.base_file.read()
+            args.base_file.close()
+        else:
+            base_data = None
+
+        bundle = []
+        for spec in args.bundle:
+            fields = spec.split(":")
+            if len(fields) not in (2, 3):
+                parser.error("invalid bundle payload: %s" % spec)
+            try:
+                partition = int(fields[0])
+                version = int(fields[2]) if len(fields) == 3 else 0
+            except ValueError:
+                parser.error("invalid bundle payload: %s" % spec)
+            with open(fields[1], "rb") as payload_file:
+                bundle.append((partition, version, payload_file.read()))
+
         # Read input file size.
         file_content = args.input_file.read()
-        data = image.make(header, file_content, key_data, add_sha256)
+        data = image.make(header, file_content, key_data, add_sha256,
+                          args.compress, base_data, bundle)
 
         args.input_file.close()
     except IOError as error:
@@ -44,6 +44,7 @@ import tempfile
 import qmfmlib
 import re
 import collections
+import time
 __version__ = "1.4"
 # If you plan to use Unicode characters (e.g., ® and ™) in the following string
 # please ensure that your solution works fine on a Windows console.
@@ -72,6 +73,12 @@ class QMManage(object):
             "-p", metavar="SERIAL_PORT", type=str, dest="port", required=False,
             help="specify the serial port to use")
 
+        self.parser.add_argument(
+            "-b", metavar="BAUD_RATE", type=int, dest="baud", required=False,
+            help="negotiate a higher baud rate with the device (serial port "
+                 "only); the device falls back to 115200 if the switch "
+                 "fails")
+
         self.parser.add_argument(
             "-d", metavar="USB_DEVICE", type=str, dest="device", required=False,
             help="specify the USB device (vendor:product) to use")
@@ -91,6 +98,14 @@ class QMManage(object):
             cmd.append("-p")
             cmd.append(self.args.port)
 
+            # -b BAUD_RATE
+            if self.args.baud:
+                cmd.append("-b")
+                cmd.append(str(self.args.baud))
+
+        elif self.args.baud:
+            self.parser.error("-b can only be used with -p option")
+
         else:
             cmd.append("dfu-util")
 
@@ -223,6 +238,91 @@ class QMManage(object):
         else:
             print(info.info_string())
 
+    def _qfm_query(self, cmd, req_type, rsp_type, what):
+        """Send a QFM request without payload and read its response.
+
+        Args:
+            cmd (list): The dfu-util / qm_download command.
+            req_type (int): The QFM request type.
+            rsp_type (int): The expected QFM response type.
+            what (string): The name of the requested information (for
+                           messages).
+
+        Returns:
+            The QFMResponse."""
+
+        request = qmfmlib.QFMRequest(req_type).content
+        image = qmfmlib.DFUImage()
+        file_name = self._create_temp(image.add_suffix(request))
+        msg = "Requesting %s..." % what
+        print(msg + "\t" * ((40 - len(msg) + 7) // 8), end="")
+        retv = self.call_tools(cmd + ["-D", file_name, "-a", "0"])
+        os.remove(file_name)
+        if retv.status:
+            print("[FAIL]")
+            if retv.status == DFU_STATUS_ERR_TARGET:
+                print("%s not supported by the device." %
+                      what.capitalize())
+            exit(1)
+        print("[DONE]")
+
+        file_name = self._create_temp("")
+        os.remove(file_name)
+        msg = "Reading %s..." % what
+        print(msg + "\t" * ((40 - len(msg) + 7) // 8), end="")
+        retv = self.call_tools(cmd + ["-U", file_name, "-a", "0"])
+        if retv.status:
+            print("[FAIL]")
+            exit(1)
+        print("[DONE]")
+        in_file = open(file_name, "rb")
+        response = qmfmlib.QFMResponse(in_file.read())
+        in_file.close()
+        os.remove(file_name)
+
+        if not response.cmd == rsp_type:
+            print("Error: Invalid response.")
+            exit(1)
+        return response
+
+    def stats(self):
+        """Perform 'stats' tasks."""
+
+        self.parser.description += " Retrieve device statistics."
+        self._add_parser_con_arguments()
+        self.parser.add_argument("--format", choices=['text', 'json'],
+                                 help="presentation format [default: text]")
+        self.args = self.parser.parse_args()
+        cmd = self._command()
+
+        response = self._qfm_query(cmd, qmfmlib.QFMRequest.REQ_STATS,
+                                   qmfmlib.QFMResponse.RESP_STATS,
+                                   "statistics")
+        stats = qmfmlib.QFMStats(response.content)
+        if self.args.format == "json":
+            print(stats.info_json())
+        else:
+            print(stats.info_string())
+
+    def boot_timing(self):
+        """Perform 'boot-timing' tasks."""
+
+        self.parser.description += " Retrieve the boot timeline."
+        self._add_parser_con_arguments()
+        self.parser.add_argument("--format", choices=['text', 'json'],
+                                 help="presentation format [default: text]")
+        self.args = self.parser.parse_args()
+        cmd = self._command()
+
+        response = self._qfm_query(cmd, qmfmlib.QFMRequest.REQ_BOOT_TIMING,
+                                   qmfmlib.QFMResponse.RESP_BOOT_TIMING,
+                                   "boot timing")
+        timing = qmfmlib.QFMBootTiming(response.content)
+        if self.args.format == "json":
+            print(timing.info_json())
+        else:
+            print(timing.info_string())
+
     def erase(self):
         """Perform 'erase' tasks."""
         self.parser.description += "Erase all applications on the device."
@@ -253,6 +353,169 @@ class QMManage(object):
         print("[DONE]")
         os.remove(file_name)
 
+    def download(self):
+        """Perform 'download' tasks."""
+        self.parser.description += " Download a QFU image, resuming an " \
+                                   "interrupted download or skipping " \
+                                   "unchanged blocks if possible."
+        self.parser.add_argument("image_file", metavar="image",
+                                 type=argparse.FileType("rb"),
+                                 help="the QFU image (with DFU suffix)")
+        self.parser.add_argument("--no-resume", action="store_true",
+                                 help="do not resume interrupted downloads")
+        self.parser.add_argument("--no-skip", action="store_true",
+                                 help="do not skip the blocks already "
+                                      "present on the device")
+        self.parser.add_argument("--profile", action="store_true",
+                                 help="break down the update time (using "
+                                      "the device statistics)")
+        self._add_parser_con_arguments()
+        self.args = self.parser.parse_args()
+        cmd = self._command()
+
+        data = self.args.image_file.read()
+        self.args.image_file.close()
+        suffix_size = qmfmlib.DFUImage._suffix_struct.size
+        if len(data) < suffix_size or data[-8:-5] != "UFD":
+            self.parser.error("DFU suffix missing")
+        suffix = qmfmlib.DFUImage._suffix_struct.unpack(data[-suffix_size:])
+        data = data[:-suffix_size]
+        header = qmfmlib.QFUHeader()
+        try:
+            header.set_from_data(data[:qmfmlib.QFUHeader.SIZE])
+        except qmfmlib.QFUException as error:
+            self.parser.error(error)
+
+        skip = 0
+        # Bundles are always downloaded in full.
+        bundle = qmfmlib.QFUImage.is_bundle(data)
+        tag = qmfmlib.QFUImage.resume_tag(data)
+        if not self.args.no_resume and not bundle and tag is not None:
+            skip = self._resume_blocks(cmd, header.partition_id - 1, tag)
+        if skip:
+            print("Resuming download at block %d." % skip)
+            data = qmfmlib.QFUImage.skip_blocks(data, skip)
+        elif (not self.args.no_skip and not bundle and
+              qmfmlib.QFUImage.has_block_hashes(data)):
+            blocks = self._changed_blocks(cmd, header.partition_id - 1,
+                                          qmfmlib.QFUImage.block_hashes(data),
+                                          header.block_size)
+            if blocks is not None:
+                print("Sending %d of %d blocks." %
+                      (len(blocks), header.num_blocks - 1))
+                data = qmfmlib.QFUImage.select_blocks(data, blocks)
+
+        image = qmfmlib.DFUImage()
+        data = image.add_suffix(data, suffix[1], suffix[2])
+        file_name = self._create_temp(data)
+        print("Downloading image...\t\t\t", end="")
+        start = time.time()
+        # The DFU transfer size must match the block size of the image.
+        retv = self.call_tools(cmd + ["-D", file_name, "-a",
+                                      str(header.partition_id),
+                                      "-t", str(header.block_size)])
+        elapsed = time.time() - start
+        os.remove(file_name)
+        if retv.status:
+            print("[FAIL]")
+            if not self.args.verbose:
+                print("Run in verbose mode for more info.")
+            exit(1)
+        print("[DONE]")
+        print("Sent %d bytes in %.1f s (%.1f kB/s)." %
+              (len(data), elapsed, len(data) / 1024 / max(elapsed, 0.001)))
+        if self.args.profile:
+            self._print_profile(cmd, elapsed)
+
+    def _print_profile(self, cmd, elapsed):
+        """Print the breakdown of the last update, as profiled by the
+        device."""
+        response = self._qfm_query(cmd, qmfmlib.QFMRequest.REQ_STATS,
+                                   qmfmlib.QFMResponse.RESP_STATS,
+                                   "statistics")
+        stats = qmfmlib.QFMStats(response.content).stats
+        if not stats["qfu_total_cycles"]:
+            print("Update profiling not supported by the device.")
+            return
+        # The CPU runs at 32 MHz in DFU mode.
+        ms = dict((name, stats[name] / 32000.0) for name in
+                  ["qfu_total_cycles", "qfu_hash_cycles", "qfu_flash_cycles"])
+        print("Data blocks:            %10d" % stats["qfu_blocks"])
+        print("Host time [ms]:         %10.1f" % (elapsed * 1000))
+        print("Device time [ms]:       %10.1f" % ms["qfu_total_cycles"])
+        print("  Hash verification:    %10.1f" % ms["qfu_hash_cycles"])
+        print("  Flash programming:    %10.1f" % ms["qfu_flash_cycles"])
+        print("  Transfer / protocol:  %10.1f" %
+              (ms["qfu_total_cycles"] - ms["qfu_hash_cycles"] -
+               ms["qfu_flash_cycles"]))
+
+    def _resume_blocks(self, cmd, partition, tag):
+        """Return the number of data blocks the download can skip."""
+        request = qmfmlib.QFMResume(partition).content
+        image = qmfmlib.DFUImage()
+        file_name = self._create_temp(image.add_suffix(request))
+        print("Requesting resume information...\t", end="")
+        retv = self.call_tools(cmd + ["-D", file_name, "-a", "0"])
+        os.remove(file_name)
+        if retv.status:
+            # Not supported by the device: download the whole image.
+            print("[SKIP]")
+            return 0
+        print("[DONE]")
+
+        file_name = self._create_temp("")
+        os.remove(file_name)
+        print("Reading resume information...\t\t", end="")
+        retv = self.call_tools(cmd + ["-U", file_name, "-a", "0"])
+        if retv.status:
+            print("[FAIL]")
+            exit(1)
+        print("[DONE]")
+        in_file = open(file_name, "rb")
+        response = qmfmlib.QFMResponse(in_file.read())
+        in_file.close()
+        os.remove(file_name)
+
+        if not response.cmd == qmfmlib.QFMResponse.RESP_RESUME:
+            print("Error: Invalid response.")
+            exit(1)
+        info = qmfmlib.QFMResumeInfo(response.content)
+        if info.tag != tag:
+            return 0
+        return info.resume_blk
+
+    def _changed_blocks(self, cmd, partition, hashes, block_size):
+        """Return the data blocks to be sent (None if all of them)."""
+        request = qmfmlib.QFMBlockMap(partition, hashes, block_size).content
+        image = qmfmlib.DFUImage()
+        file_name = self._create_temp(image.add_suffix(request))
+        print("Requesting block map...\t\t\t", end="")
+        retv = self.call_tools(cmd + ["-D", file_name, "-a", "0"])
+        os.remove(file_name)
+        if retv.status:
+            # Not supported by the device: send all the blocks.
+            print("[SKIP]")
+            return None
+        print("[DONE]")
+
+        file_name = self._create_temp("")
+        os.remove(file_name)
+        print("Reading block map...\t\t\t", end="")
+        retv = self.call_tools(cmd + ["-U", file_name, "-a", "0"])
+        if retv.status:
+            print("[FAIL]")
+            exit(1)
+        print("[DONE]")
+        in_file = open(file_name, "rb")
+        response = qmfmlib.QFMResponse(in_file.read())
+        in_file.close()
+        os.remove(file_name)
+
+        if not response.cmd == qmfmlib.QFMResponse.RESP_BLOCK_MAP:
+            print("Error: Invalid response.")
+            exit(1)
+        return qmfmlib.QFMBlockMapInfo(response.content).blocks
+
     def set_key(self, key_type):
         self._add_parser_con_arguments()
 
@@ -364,8 +627,13 @@ def main():
                                     authentication\n" + \
                    "  set-rv-key    set the HMAC rv key used for firmware \
                                     authentication\n" + \
+                   "  download      download an image, resuming an interrupted \
+                                    download or skipping unchanged blocks \
+                                    if possible\n" + \
                    "  erase         erase all applications\n" + \
                    "  info          retrieve device information\n" + \
+                   "  stats         retrieve device statistics\n" + \
+                   "  boot-timing   retrieve the boot timeline\n" + \
                    "  list          retrieve list of connected devices"
     _parser = argparse.ArgumentParser(
         description=DESC,
@@ -376,7 +644,8 @@ def main():
     _parser.add_argument('--version', action='version', version=version)
     _parser.add_argument("cmd", help="run specific command",
                          choices=['set-fw-key', 'set-rv-key', 'info', 'erase',
-                                  'list'])
+                                  'list', 'download', 'stats',
+                                  'boot-timing'])
     group = _parser.add_mutually_exclusive_group()
     group.add_argument("-q", "--quiet", action="store_true",
                        help="suppress non-error messages")
@@ -399,6 +668,18 @@ def main():
         manager.erase()
         exit(0)
 
+    if args.cmd == "stats":
+        manager.stats()
+        exit(0)
+
+    if args.cmd == "boot-timing":
+        manager.boot_timing()
+        exit(0)
+
+    if args.cmd == "download":
+        manager.download()
+        exit(0)
+
     if args.cmd == "set-rv-key":
         manager.set_rv_key()
         exit(0)
@@ -54,5 +54,7 @@ Example usage::
 from qmfmlib.qfu import QFUHeader, QFUImage, QFUException
 from qmfmlib.dfu import DFUImage, DFUException
 from qmfmlib.qfm import QFMRequest, QFMSetKey, QFMResponse, QFMSysInfo, QFMException
+from qmfmlib.qfm import QFMResume, QFMResumeInfo, QFMBlockMap, QFMBlockMapInfo
+from qmfmlib.qfm import QFMStats, QFMBootTiming
 
 __version__ = "1.4"
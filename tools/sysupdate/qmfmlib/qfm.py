@@ -67,6 +67,10 @@ class QFMResponse(object):
         data (string): Raw response data."""
 
     RESP_SYS_INFO = 0x444D8000  # Sys-Info-Response identifier.
+    RESP_RESUME = 0x444D8001    # Resume-Info-Response identifier.
+    RESP_BLOCK_MAP = 0x444D8002  # Block-Map-Response identifier.
+    RESP_STATS = 0x444D8003     # Statistics-Response identifier.
+    RESP_BOOT_TIMING = 0x444D8004  # Boot-Timing-Response identifier.
 
     _data = None
     cmd = 0
@@ -94,6 +98,10 @@ class QFMRequest(object):
     REQ_APP_ERASE = 0x444D0001      # App-Erase-Request identifier.
     REQ_SET_FW_KEY = 0x444D0002     # Set-key-fw-Request identifier.
     REQ_SET_RV_KEY = 0x444D0003     # Set-key-rv-Request identifier.
+    REQ_RESUME = 0x444D0004         # Resume-Info-Request identifier.
+    REQ_BLOCK_MAP = 0x444D0005      # Block-Map-Request identifier.
+    REQ_STATS = 0x444D0006          # Statistics-Request identifier.
+    REQ_BOOT_TIMING = 0x444D0007    # Boot-Timing-Request identifier.
 
     cmd = 0
     content = ""
@@ -132,6 +140,203 @@ class QFMSetKey(QFMRequest):
         self.content += struct.Struct("%s32s" % _ENDIAN).pack(hmac256)
 
 
+class QFMResume(QFMRequest):
+    """The class preparing a QFM resume information request.
+
+    The request also allows the next download to the partition to resume an
+    interrupted one.
+
+    Args:
+        partition (int): The partition index (i.e., QFU partition - 1)."""
+
+    def __init__(self, partition):
+        super(QFMResume, self).__init__(self.REQ_RESUME)
+        self.content += struct.pack("%sB" % _ENDIAN, partition)
+
+
+class QFMResumeInfo(object):
+    """The class parsing a QFM resume information response.
+
+    Attributes:
+        resume_blk (int): The number of data blocks already programmed (0 if
+                          the download cannot be resumed).
+        tag (string): The tag of the image being downloaded.
+
+    Args:
+        data (string): The response content (without response type)."""
+
+    _struct = struct.Struct("%sI32s" % _ENDIAN)
+
+    def __init__(self, data):
+        if len(data) < self._struct.size:
+            raise QFMException("Data invalid. Resume information incomplete.")
+        (self.resume_blk, self.tag) = self._struct.unpack(
+            data[:self._struct.size])
+
+
+class QFMBlockMap(QFMRequest):
+    """The class preparing a QFM block map request.
+
+    The request also allows the next download to the partition to skip the
+    data blocks that have not changed.
+
+    Args:
+        partition (int): The partition index (i.e., QFU partition - 1).
+        hashes (list): The SHA256 hashes of the data blocks of the image.
+        block_size (int): The block size of the image (a power of two)."""
+
+    def __init__(self, partition, hashes, block_size):
+        super(QFMBlockMap, self).__init__(self.REQ_BLOCK_MAP)
+        self.content += struct.pack("%sBBH" % _ENDIAN, partition,
+                                    block_size.bit_length() - 1, len(hashes))
+        self.content += "".join(hashes)
+
+
+class QFMBlockMapInfo(object):
+    """The class parsing a QFM block map response.
+
+    Attributes:
+        blocks (list): The indexes of the data blocks to be sent.
+
+    Args:
+        data (string): The response content (without response type)."""
+
+    def __init__(self, data):
+        if len(data) < 2:
+            raise QFMException("Data invalid. Block map incomplete.")
+        (n_blocks, ) = struct.unpack("%sH" % _ENDIAN, data[:2])
+        bitmap = bytearray(data[2:])
+        if len(bitmap) * 8 < n_blocks:
+            raise QFMException("Data invalid. Block map incomplete.")
+        self.blocks = [i for i in range(n_blocks)
+                       if bitmap[i // 8] & (1 << (i % 8))]
+
+
+class QFMStats(object):
+    """The class parsing a QFM statistics response.
+
+    Fields added by newer devices are ignored; fields missing on older devices
+    are reported as None.
+
+    Attributes:
+        stats (dict): The statistics.
+
+    Args:
+        data (string): The response content (without response type)."""
+
+    # The statistics, in the order of the response.
+    FIELDS = [
+        ("erases_skipped", "Page erases skipped (blank pages)"),
+        ("writebacks_skipped", "BL-Data writebacks skipped (unchanged)"),
+        ("page_writes", "Flash pages written"),
+        ("page_erases", "Flash pages erased"),
+        ("qfu_blocks", "Last update: data blocks received"),
+        ("qfu_total_cycles", "Last update: total CPU cycles"),
+        ("qfu_hash_cycles", "Last update: hash verification cycles"),
+        ("qfu_flash_cycles", "Last update: flash programming cycles"),
+        ("flash_runs", "Flash programming runs"),
+        ("words_skipped", "Flash words skipped (blank)"),
+        ("prefetch_flushes", "Flash prefetch flushes"),
+        ("verify_errors", "Flash verification errors"),
+    ]
+
+    def __init__(self, data):
+        self.stats = {}
+        for i, (name, _) in enumerate(self.FIELDS):
+            self.stats[name] = None
+            if len(data) >= (i + 1) * 4:
+                (self.stats[name], ) = struct.unpack(
+                    "%sI" % _ENDIAN, data[i * 4:(i + 1) * 4])
+
+    def info_json(self):
+        """Returns a JSON formatted string containing the statistics."""
+
+        return json.dumps(self.stats)
+
+    def info_string(self):
+        """Returns a formatted string containing the statistics."""
+
+        ret = ""
+        for name, desc in self.FIELDS:
+            value = self.stats[name]
+            ret += "%-40s: %s\n" % (desc, "n/a" if value is None else value)
+        return ret
+
+
+class QFMBootTiming(object):
+    """The class parsing a QFM boot timing response.
+
+    Attributes:
+        tsc_hz (int): The TSC frequency during the boot flow.
+        timestamps (list): The TSC value at the end of each boot phase (None
+                           if the phase was not executed).
+
+    Args:
+        data (string): The response content (without response type)."""
+
+    # The boot phases, in the order of the response.
+    PHASES = [
+        ("start", "rom_startup() entry"),
+        ("clock", "Power and clock set-up"),
+        ("trim_start", "Trim code computation start"),
+        ("trim_end", "Trim code computation end"),
+        ("bl_data", "BL-Data sanitization"),
+        ("irq", "Interrupt and security set-up"),
+        ("fm_hook", "FM GPIO / sticky bit sampling"),
+        ("sram_scrub", "SRAM clean-up start"),
+        ("app_entry", "SRAM clean-up end"),
+    ]
+
+    def __init__(self, data):
+        if len(data) < 8:
+            raise QFMException("Data invalid. Boot timing incomplete.")
+        (self.tsc_hz, n_ts) = struct.unpack("%sII" % _ENDIAN, data[:8])
+        if len(data) < 8 + n_ts * 4:
+            raise QFMException("Data invalid. Boot timing incomplete.")
+        values = struct.unpack("%s%dI" % (_ENDIAN, n_ts),
+                               data[8:8 + n_ts * 4])
+        self.timestamps = [value if value else None for value in values]
+
+    def _timeline(self):
+        """Returns the list of (name, description, microseconds since boot)
+        of the executed phases."""
+
+        if not self.timestamps or self.timestamps[0] is None:
+            return []
+        start = self.timestamps[0]
+        ret = []
+        for i, value in enumerate(self.timestamps):
+            if value is None:
+                continue
+            if i < len(self.PHASES):
+                (name, desc) = self.PHASES[i]
+            else:
+                (name, desc) = ("phase_%d" % i, "Phase %d" % i)
+            ret.append((name, desc, ((value - start) & 0xFFFFFFFF) *
+                        1000000 // self.tsc_hz))
+        return ret
+
+    def info_json(self):
+        """Returns a JSON formatted string containing the boot timeline (in
+        microseconds since rom_startup() entry)."""
+
+        return json.dumps(dict((name, time_us) for (name, _, time_us)
+                               in self._timeline()))
+
+    def info_string(self):
+        """Returns a formatted string containing the boot timeline."""
+
+        timeline = self._timeline()
+        if not timeline:
+            return "Boot timing not recorded by the device.\n"
+        ret = "%-40s %10s %10s\n" % ("Phase", "Time [us]", "Delta [us]")
+        prev = 0
+        for (_, desc, time_us) in timeline:
+            ret += "%-40s %10d %10d\n" % (desc, time_us, time_us - prev)
+            prev = time_us
+        return ret
+
+
 class QFMSysInfoTarget(dict):
     """The class storing a QFM system info target.
 
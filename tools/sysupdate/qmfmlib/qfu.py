@@ -44,6 +44,26 @@ _ENDIAN = "<"   # Defines the endian for struct packing. ('<'=little, '>'=big)
 _QFU_EXT_HDR_NONE = 0
 _QFU_EXT_HDR_SHA256 = 1
 _QFU_EXT_HDR_HMAC256 = 2
+# Flag of the extended header type signaling a compressed (QFU LZ) payload.
+_QFU_EXT_HDR_LZ = 0x0100
+# Flag of the extended header type signaling a delta payload.
+_QFU_EXT_HDR_DELTA = 0x0200
+# The delta descriptor: base image length and SHA256.
+_QFU_DELTA_STRUCT = struct.Struct("%sI32s" % _ENDIAN)
+# Flag of the extended header type signaling a multi-image bundle.
+_QFU_EXT_HDR_BUNDLE = 0x0400
+# The bundle descriptor: number of payloads, followed by a payload descriptor
+# (partition, number of blocks and version) for each payload.
+_QFU_BUNDLE_STRUCT = struct.Struct("%sI" % _ENDIAN)
+_QFU_PAYLOAD_STRUCT = struct.Struct("%sHHI" % _ENDIAN)
+
+# QFU LZ stream format parameters (see qfu_format.h).
+_LZ_MIN_MATCH = 3
+_LZ_MAX_LITERALS = 128
+_LZ_MAX_OFFSET = 0xFFFF
+_LZ_MATCH_FLAG = 0x80
+_LZ_LEN_MASK = 0x7F
+_LZ_MAX_CHAIN = 64
 
 
 class QFUException(Exception):
@@ -96,13 +116,168 @@ class QFUDefineParser(object):
             self._check_line(line)
 
 
+def _lz_match_len(src, src_pos, data, pos, limit):
+    """Return the length of the match between src[src_pos:] and data[pos:]."""
+    length = 0
+    while length < limit and src[src_pos + length] == data[pos + length]:
+        length += 1
+    return length
+
+
+class _LZIndex(object):
+    """Hash chains of the 3-byte prefixes of a buffer."""
+
+    def __init__(self, data):
+        self.data = data
+        self.head = {}
+        self.prev = [-1] * len(data)
+
+    def insert(self, pos):
+        """Add the prefix at position pos."""
+        if pos + _LZ_MIN_MATCH <= len(self.data):
+            key = bytes(self.data[pos:pos + _LZ_MIN_MATCH])
+            self.prev[pos] = self.head.get(key, -1)
+            self.head[key] = pos
+
+    def find(self, data, pos, min_pos=0):
+        """Find the longest match for data[pos:] in the indexed buffer.
+
+        Only indexed positions >= min_pos are considered.
+
+        Returns:
+            A (length, position) tuple."""
+        best_len = 0
+        best_pos = 0
+        limit = len(data) - pos
+        if limit < _LZ_MIN_MATCH:
+            return best_len, best_pos
+        cand = self.head.get(bytes(data[pos:pos + _LZ_MIN_MATCH]), -1)
+        chain = _LZ_MAX_CHAIN
+        while cand >= min_pos and chain:
+            max_len = min(limit, len(self.data) - cand)
+            # Quickly discard candidates that cannot be longer.
+            if (best_len < max_len and
+                    self.data[cand + best_len] == data[pos + best_len]):
+                length = _lz_match_len(self.data, cand, data, pos, max_len)
+                if length > best_len:
+                    best_len = length
+                    best_pos = cand
+                    if length == limit:
+                        break
+            cand = self.prev[cand]
+            chain -= 1
+        return best_len, best_pos
+
+
+def _lz_match_cost(length):
+    """Return the size of the match token (without offset) for a length."""
+    length -= _LZ_MIN_MATCH
+    if length < _LZ_LEN_MASK:
+        return 1
+    return 2 + (length - _LZ_LEN_MASK) // 0xFF
+
+
+def lz_compress(data, base=None):
+    """Compress data into a QFU LZ stream.
+
+    The stream is a sequence of literal runs and matches (back-references of
+    up to 64 kB), as described in qfu_format.h. Matches are searched greedily
+    using hash chains of 3-byte prefixes.
+
+    If a base image is specified, a delta stream is created: matches can also
+    copy data from the base image.
+
+    Args:
+        data (string): The data to compress.
+        base (string): The base image (for delta streams).
+    Returns:
+        The compressed data."""
+
+    src = bytearray(data)
+    size = len(src)
+    out = bytearray()
+    literals = bytearray()
+    index = _LZIndex(src)
+    base_index = None
+    if base is not None:
+        base_index = _LZIndex(bytearray(base))
+        for i in range(len(base_index.data)):
+            base_index.insert(i)
+    # Base position expected if the last base copy went on (delta only).
+    base_next = 0
+
+    def flush_literals():
+        for start in range(0, len(literals), _LZ_MAX_LITERALS):
+            chunk = literals[start:start + _LZ_MAX_LITERALS]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+        del literals[:]
+
+    def put_match(length, offset):
+        length -= _LZ_MIN_MATCH
+        if length < _LZ_LEN_MASK:
+            out.append(_LZ_MATCH_FLAG | length)
+        else:
+            out.append(_LZ_MATCH_FLAG | _LZ_LEN_MASK)
+            length -= _LZ_LEN_MASK
+            while length >= 0xFF:
+                out.append(0xFF)
+                length -= 0xFF
+            out.append(length)
+        out.extend(struct.pack("%sH" % _ENDIAN, offset))
+
+    pos = 0
+    while pos < size:
+        best_len, best_pos = index.find(src, pos,
+                                        max(0, pos - _LZ_MAX_OFFSET))
+        # Saving with respect to emitting literals.
+        best_gain = best_len - _lz_match_cost(best_len) - 2
+        base_len = 0
+        if base_index is not None:
+            base_len, base_pos = base_index.find(src, pos)
+            # After a small change, the base copy usually goes on.
+            if base_next < len(base_index.data):
+                length = _lz_match_len(
+                    base_index.data, base_next, src, pos,
+                    min(size - pos, len(base_index.data) - base_next))
+                if length >= base_len:
+                    base_len, base_pos = length, base_next
+            base_gain = base_len - _lz_match_cost(base_len) - 5
+            if base_len >= _LZ_MIN_MATCH and base_gain > best_gain:
+                best_gain = base_gain
+            else:
+                base_len = 0
+        if best_gain <= 0:
+            literals.append(src[pos])
+            index.insert(pos)
+            pos += 1
+            base_next += 1
+            continue
+        flush_literals()
+        if base_len:
+            # A match with offset 0 is a copy from the base image.
+            put_match(base_len, 0)
+            out.extend(struct.pack("%sI" % _ENDIAN, base_pos)[:3])
+            best_len = base_len
+            base_next = base_pos + base_len
+        else:
+            put_match(best_len, pos - best_pos)
+            base_next += best_len
+        for i in range(pos, pos + best_len):
+            index.insert(i)
+        pos += best_len
+    flush_literals()
+    return bytes(out)
+
+
 class QFUImage(object):
     """Creates a QFU compatible file from a binary file."""
 
     def __init__(self):
         self.ext_headers = []
 
-    def make(self, header, image_data, key=None, add_sha256=False):
+    def make(self, header, image_data, key=None, add_sha256=False,
+             compress=False, base_data=None, bundle=None):
         """Assembles the QFU Header and the binary data.
 
         Args:
@@ -110,14 +285,57 @@ class QFUImage(object):
                                 create the image.
             image_data (string): Input file data.
             add_sha256 (Bool): Add a sha256 hash to the header.
+            compress (Bool): Compress the binary data (QFU LZ).
+            base_data (string): Create a delta image against this base
+                                image (implies compress).
+            bundle (list): Create a bundle with these additional payloads,
+                           each one a (partition, version, data) tuple; the
+                           image data is the payload of the header partition.
         Returns:
             The newly constructed binary data."""
 
+        delta_desc = b""
+        bundle_desc = b""
+        if bundle:
+            if compress or base_data is not None:
+                raise QFUException("Bundles cannot be compressed.")
+            payloads = [(header.partition_id, header.version,
+                         image_data)] + list(bundle)
+            bundle_desc = _QFU_BUNDLE_STRUCT.pack(len(payloads))
+            image_data = b""
+            for (partition, version, payload) in payloads:
+                if not payload:
+                    raise QFUException("Empty bundle payload.")
+                blocks = ((len(payload) - 1) // header.block_size) + 1
+                bundle_desc += _QFU_PAYLOAD_STRUCT.pack(partition, blocks,
+                                                        version)
+                # Pad the previous payload to a multiple of the block size.
+                if image_data:
+                    image_data += b"\xFF" * (-len(image_data) %
+                                             header.block_size)
+                image_data += payload
+        if base_data is not None:
+            if len(base_data) > 0xFFFFFF:
+                raise QFUException("Base image too big.")
+            delta_desc = _QFU_DELTA_STRUCT.pack(
+                len(base_data), hashlib.sha256(base_data).digest())
+            image_data = lz_compress(image_data, base_data)
+        elif compress:
+            image_data = lz_compress(image_data)
+
         ext_header = QFUExtHeaderNone()
         if add_sha256:
             ext_header = QFUExtHeaderSHA256(image_data)
         elif key:
             ext_header = QFUExtHeaderHMAC256(image_data, header, key)
+        if compress or delta_desc:
+            ext_header.hdr_id |= _QFU_EXT_HDR_LZ
+        if delta_desc:
+            ext_header.hdr_id |= _QFU_EXT_HDR_DELTA
+            ext_header.prefix = delta_desc
+        if bundle_desc:
+            ext_header.hdr_id |= _QFU_EXT_HDR_BUNDLE
+            ext_header.prefix = bundle_desc
 
         data_blocks = ((len(image_data) - 1) // header.block_size) + 1
         header_blocks = ((header.SIZE + ext_header.size() - 1)
@@ -131,15 +349,116 @@ class QFUImage(object):
         return content
 
 
+    @staticmethod
+    def resume_tag(data):
+        """Return the tag identifying a QFU image for resumed downloads.
+
+        That is the HMAC256 signature of the header, which covers the hashes
+        of all the data blocks. Images without authentication cannot be
+        resumed (their header does not identify their content).
+
+        Args:
+            data (string): The QFU image (without DFU suffix).
+        Returns:
+            The 32-byte tag, or None if the image cannot be resumed."""
+
+        header = QFUHeader()
+        header.set_from_data(data[:QFUHeader.SIZE])
+        (ext_hdr_type, ) = struct.unpack(
+            "%sH" % _ENDIAN, data[QFUHeader.SIZE:QFUHeader.SIZE + 2])
+        if (ext_hdr_type & 0xFF) != _QFU_EXT_HDR_HMAC256:
+            return None
+        # Skip type, delta descriptor (if any), SVN and block hashes.
+        offset = QFUHeader.SIZE + 4
+        if ext_hdr_type & _QFU_EXT_HDR_DELTA:
+            offset += _QFU_DELTA_STRUCT.size
+        offset += 4 + 32 * (header.num_blocks - 1)
+        return data[offset:offset + 32]
+
+    @staticmethod
+    def is_bundle(data):
+        """Return whether a QFU image is a multi-image bundle (which can be
+        neither resumed nor sent partially).
+
+        Args:
+            data (string): The QFU image (without DFU suffix)."""
+
+        (ext_hdr_type, ) = struct.unpack(
+            "%sH" % _ENDIAN, data[QFUHeader.SIZE:QFUHeader.SIZE + 2])
+        return bool(ext_hdr_type & _QFU_EXT_HDR_BUNDLE)
+
+    @staticmethod
+    def skip_blocks(data, count):
+        """Return the QFU image without its first count data blocks.
+
+        Args:
+            data (string): The QFU image (without DFU suffix).
+            count (int): The number of data blocks to skip.
+        Returns:
+            The header block followed by the remaining data blocks."""
+
+        header = QFUHeader()
+        header.set_from_data(data[:QFUHeader.SIZE])
+        size = header.block_size
+        return data[:size] + data[size * (count + 1):]
+
+    @staticmethod
+    def block_hashes(data):
+        """Return the SHA256 hashes of the data blocks of a QFU image.
+
+        Args:
+            data (string): The QFU image (without DFU suffix).
+        Returns:
+            The list of hashes."""
+
+        header = QFUHeader()
+        header.set_from_data(data[:QFUHeader.SIZE])
+        size = header.block_size
+        return [hashlib.sha256(data[i:i + size]).digest()
+                for i in range(size, len(data), size)]
+
+    @staticmethod
+    def select_blocks(data, blocks):
+        """Return the QFU image with the given data blocks only.
+
+        Args:
+            data (string): The QFU image (without DFU suffix).
+            blocks (list): The indexes of the data blocks to keep.
+        Returns:
+            The header block followed by the selected data blocks."""
+
+        header = QFUHeader()
+        header.set_from_data(data[:QFUHeader.SIZE])
+        size = header.block_size
+        return data[:size] + "".join(
+            data[size * (i + 1):size * (i + 2)] for i in blocks)
+
+    @staticmethod
+    def has_block_hashes(data):
+        """Return whether the header of a QFU image has the hashes of its
+        (uncompressed) data blocks, i.e., whether unchanged blocks can be
+        skipped.
+
+        Args:
+            data (string): The QFU image (without DFU suffix)."""
+
+        (ext_hdr_type, ) = struct.unpack(
+            "%sH" % _ENDIAN, data[QFUHeader.SIZE:QFUHeader.SIZE + 2])
+        return ext_hdr_type == _QFU_EXT_HDR_HMAC256
+
+
 class QFUExtHeader(object):
     """Generic Extended header class."""
     def __init__(self, ext_hdr_id):
         self.content = ""
         self.hdr_id = ext_hdr_id
+        # Descriptor preceding the type-specific part (e.g., delta one).
+        self.prefix = b""
 
     def size(self):
-        """Return the size of the extended header, which is a minimum of 4"""
-        return 4
+        """Return the size of the extended header, which is a minimum of 4
+        (plus the size of the prefix, if any)"""
+        return 4 + len(self.prefix)
 
     def compute(self):
         pass
@@ -153,7 +472,7 @@ class QFUExtHeaderNone(QFUExtHeader):
 
     def compute(self):
         """Compute extended header content."""
-        self.content = self._struct.pack(self.hdr_id, 0)
+        self.content = self._struct.pack(self.hdr_id, 0) + self.prefix
 
     def size(self):
         """Return the size of the extended header (4 bytes)"""
@@ -167,7 +486,7 @@ class QFUExtHeaderSHA256(QFUExtHeader):
 
     def __init__(self, file_content):
         self.data = file_content
-        self._struct = struct.Struct("%sHH32s" % _ENDIAN)
+        self._struct = struct.Struct("%sHH" % _ENDIAN)
         super(QFUExtHeaderSHA256, self).__init__(_QFU_EXT_HDR_SHA256)
 
     def compute(self):
@@ -177,7 +496,8 @@ class QFUExtHeaderSHA256(QFUExtHeader):
             raise QFUException("No data defined for SHA256 calculation.")
         hasher = hashlib.sha256()
         hasher.update(self.data)
-        self.content = self._struct.pack(self.hdr_id, 0, hasher.digest())
+        self.content = self._struct.pack(self.hdr_id, 0)
+        self.content += self.prefix + hasher.digest()
 
     def size(self):
         """Return the size of the extended hdr (4bytes + 32bytes = 36bytes)"""
@@ -232,7 +552,7 @@ class QFUExtHeaderHMAC256(QFUExtHeader):
     def compute(self):
         """Compute extended header content."""
 
-        header_struct = struct.Struct("%sHHI" % _ENDIAN)
+        header_struct = struct.Struct("%sHH" % _ENDIAN)
         if not self.data:
             raise QFUException("No data defined for SHA256 calculation.")
         if not self.key:
@@ -240,7 +560,8 @@ class QFUExtHeaderHMAC256(QFUExtHeader):
         # if not self.svn:
         #    raise QFUException("No Security version number defined.")
 
-        self.content = header_struct.pack(self.hdr_id, 0, self.svn)
+        self.content = header_struct.pack(self.hdr_id, 0) + self.prefix
+        self.content += struct.pack("%sI" % _ENDIAN, self.svn)
 
         self.content += self.compute_blocks(self.header.block_size,
                                             self.header.num_blocks)
@@ -330,8 +651,9 @@ class QFUHeader(object):
             self.id_product_dfu = args.dfu_pid
 
         if self.block_size is None:
+            # The maximum block size supported by the bootloader.
             if args.soc == "quark_se":
-                self.block_size = 4096
+                self.block_size = 8192
             else:
                 self.block_size = 2048
 